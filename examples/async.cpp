@@ -46,6 +46,17 @@ int main()
     }, 5);
     std::cout << std::endl;
 
+    // page-locked host memory, the driver can DMA straight from it
+    mcf::Mat<int> P(2000, 2000, mcf::PINNED);
+    P.gen(f);
+
+    video << P;
+
+    executionTime([&](){
+        video << P;
+    }, 5);
+    std::cout << std::endl;
+
     // compute
     std::cout << "Compute:" << std::endl;
 
@@ -75,6 +86,11 @@ int main()
         B.receive(video, ecl::EXEC::ASYNC);
         video.await();
     }, 5);
+    std::cout << std::endl;
+
+    executionTime([&](){
+        video >> P;
+    }, 5);
 
     ecl::System::release();
     
@@ -0,0 +1,33 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    float ptr1[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float ptr2[] = {0.1, 0.2, 0.3, 0.4};
+
+    mcf::Mat<float> A(ptr1, 2, 4);
+    mcf::Mat<float> bias(ptr2, 1, 4);
+
+    mcf::Mat<float> C(2, 4);
+    mcf::Mat<float> D(2, 4);
+
+    // cpu, bias row is added to every row of A
+    A.add(bias, C);
+
+    // gpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << A << bias << D;
+    A.add(bias, D, video);
+    video >> D;
+
+    // output
+    std::cout << C << std::endl;
+    std::cout << D;
+
+    ecl::System::release();
+    
+    return 0;
+}
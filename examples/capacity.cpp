@@ -0,0 +1,39 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A;
+    mcf::Mat<float> row(1, 4);
+
+    row.gen([](std::size_t i, std::size_t j){
+        return float(j);
+    });
+
+    // cpu, appends reuse the reserved block and double it when it runs out
+    A.reserve(16);
+    for(std::size_t i = 0; 6 > i; i++) A.appendRows(row);
+
+    // keeps the top-left block, new elements are zero
+    A.resize(6, 5);
+
+    // gpu, the buffer is sent once with spare capacity and rows are copied into its tail
+    mcf::Mat<float> B;
+
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    B.reserve(32, video);
+    video << row;
+    for(std::size_t i = 0; 6 > i; i++) B.appendRows(row, video);
+    video >> B;
+
+    // output
+    std::cout << A << std::endl;
+    std::cout << B << std::endl;
+    std::cout << A.getCapacity() << " " << B.getCapacity() << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
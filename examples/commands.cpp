@@ -0,0 +1,45 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> x(1, 4);
+    mcf::Mat<float> W(4, 3);
+    mcf::Mat<float> y(1, 3);
+    mcf::Mat<float> p(1, 3);
+
+    W.gen([](std::size_t i, std::size_t j){
+        return float(i) - float(j);
+    });
+
+    // gpu
+    auto plat = ecl::System::getPlatform(0);
+    ecl::Computer video(0, plat, ecl::DEVICE::GPU);
+
+    video << x << W << y << p;
+
+    // record once: shapes are checked and kernels built here
+    mcf::CommandList layer(video);
+    layer.record();
+    x.mul(W, y, video);
+    y.map("ret = v > 0 ? v : 0;", y, video);
+    y.softmax(p, video);
+    layer.stop();
+
+    // replay for every input, no sources are built and no host waits between kernels
+    for(std::size_t step = 0; 3 > step; step++){
+        x.full(float(step));
+        video << x;
+
+        layer.run();
+
+        video >> p;
+
+        // output
+        std::cout << p << std::endl;
+    }
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> field(1024, 512);
+
+    field.gen([](std::size_t i, std::size_t j){
+        return std::sin(0.01f * i) * std::cos(0.02f * j);
+    });
+
+    // cpu, blocks of 64 rows are delta coded, byte-shuffled and compressed in parallel
+    field.saveBinary("field.bin", mcf::DELTA_SHUFFLE_LZ, 64);
+
+    // the whole matrix, or rows 100 to 109 from the two blocks holding them
+    auto all = mcf::Mat<float>::loadBinary("field.bin");
+    auto rows = mcf::Mat<float>::loadRows("field.bin", 100, 10);
+
+    // output
+    std::cout << all.equals(field) << std::endl;
+    std::cout << rows.getH() << "x" << rows.getW() << " " << rows.getE(0, 0) << std::endl;
+
+    return 0;
+}
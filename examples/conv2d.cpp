@@ -0,0 +1,38 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    // 2 channels of a 4 x 4 image, one row per channel
+    mcf::Mat<float> image(2, 4 * 4);
+    image.gen([](std::size_t i, std::size_t j){
+        return float(i * 16 + j);
+    });
+
+    // 3 filters of 2 x 3 x 3, padding 1 keeps the 4 x 4 size
+    mcf::Conv2D g = {4, 4, 3, 3, 1, 1};
+    mcf::Mat<float> filters(3, 2 * 3 * 3);
+    filters.full(1.0f / 18);
+
+    mcf::Mat<float> A(3, g.getOutputH() * g.getOutputW());
+    mcf::Mat<float> B(3, g.getOutputH() * g.getOutputW());
+
+    // cpu, no im2col buffer is stored
+    image.conv2d(filters, A, g);
+
+    // gpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << image << filters << B;
+    image.conv2d(filters, B, g, video);
+    video >> B;
+
+    // output
+    std::cout << A << std::endl;
+    std::cout << B << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include "MatrixCF/MatrixCF.hpp"
+
+void executionTime(const std::function<void()>& f, size_t times = 1){
+    for(size_t i = 0; i < times; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto mcs = std::chrono::duration_cast<std::chrono::microseconds>(end - start); 
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start); 
+        std::cout << mcs.count() << " mcs (" << ms.count() << " ms)" << std::endl;
+    }
+}
+
+int main()
+{
+    mcf::Mat<float> A(5000, 5000);
+    mcf::Mat<float> B;
+
+    A.gen([](size_t i, size_t j){
+        return sin(i + j);
+    });
+
+    // export, floats are written in their shortest round-trip form
+    executionTime([&](){
+        A.saveCSV("A.csv");
+    });
+
+    // import, rows are parsed in parallel
+    executionTime([&](){
+        B = mcf::Mat<float>::loadCSV("A.csv");
+    });
+
+    std::cout << std::boolalpha << A.equals(B) << std::endl;
+
+    // tab separated
+    mcf::Mat<int> C(3, 4);
+    C.gen([](size_t i, size_t j){
+        return i * 4 + j;
+    });
+    C.saveCSV("C.tsv", '\t');
+
+    std::cout << mcf::Mat<int>::loadCSV("C.tsv", '\t');
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<double> A(4, 3);
+    mcf::Mat<double> S(3, 3);
+
+    mcf::Mat<double> L(3, 3);
+    mcf::Mat<double> M(3, 3);
+
+    mcf::Mat<double> Q(4, 3);
+    mcf::Mat<double> R(3, 3);
+
+    A.gen([](size_t i, size_t j){
+        return i == j ? 2.0 : 1.0 / (i + j + 1);
+    });
+
+    // S = A^T * A is symmetric positive definite
+    A.mul(A, S, mcf::TRANSPOSE::FIRST);
+
+    // cpu
+    S.cholesky(L);
+    A.qr(Q, R);
+
+    // gpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << S << M;
+    S.cholesky(M, video);
+    video >> M;
+
+    // output
+    std::cout << S << std::endl;
+    std::cout << L << std::endl;
+    std::cout << M << std::endl;
+    std::cout << Q << std::endl;
+    std::cout << R;
+
+    ecl::System::release();
+
+    return 0;
+}
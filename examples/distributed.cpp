@@ -0,0 +1,49 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    // 4 local processes, every process continues from here with its own rank
+    // (build with MATRIXCF_USE_MPI and use mcf::MPITransport to run under mpirun instead)
+    auto transport = mcf::SocketTransport::fork(4);
+
+    mcf::Mat<int> A(6, 4);
+    mcf::Mat<int> B(4, 5);
+    mcf::Mat<int> C(6, 5);
+
+    // only the root holds the full matrices
+    if(transport.getRank() == 0){
+        A.gen([](size_t i, size_t j){
+            return i + j;
+        });
+        B.gen([](size_t i, size_t j){
+            return i * j;
+        });
+    }
+
+    // 2x2 process grid, 2x2 blocks
+    mcf::DistMat<int> dA(transport, 6, 4, 2);
+    mcf::DistMat<int> dB(transport, 4, 5, 2);
+    mcf::DistMat<int> dC(transport, 6, 5, 2);
+    mcf::DistMat<int> dT(transport, 5, 6, 2);
+
+    dA.scatter(A);
+    dB.scatter(B);
+
+    // C = A * B
+    dA.mul(dB, dC);
+    dC.gather(C);
+
+    dC.transpose(dT);
+    int sum = dC.reduce();
+
+    // output
+    if(transport.getRank() == 0){
+        std::cout << A << std::endl;
+        std::cout << B << std::endl;
+        std::cout << C << std::endl;
+        std::cout << sum << std::endl;
+    }
+
+    return 0;
+}
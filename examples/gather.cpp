@@ -0,0 +1,44 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    // an embedding table of 5 tokens and a batch of 4 token ids
+    mcf::Mat<float> table(5, 3);
+    mcf::Mat<int> tokens(1, 4);
+
+    table.gen([](std::size_t i, std::size_t j){
+        return float(10 * i + j);
+    });
+    tokens.gen([](std::size_t i, std::size_t j){
+        return int(j * 3 % 5);
+    });
+
+    // cpu, lookup and a gradient step, repeated tokens add up
+    mcf::Mat<float> embeddings(4, 3);
+    table.gatherRows(tokens, embeddings);
+
+    mcf::Mat<float> grad(4, 3);
+    grad.ones();
+    table.scatterAddRows(tokens, grad, -0.1f);
+
+    // gpu, the same lookup and update with atomic adds
+    mcf::Mat<float> gpu_embeddings(4, 3);
+
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << table << tokens << grad << gpu_embeddings;
+    table.gatherRows(tokens, gpu_embeddings, video);
+    table.scatterAddRows(tokens, grad, video, -0.1f);
+    video >> gpu_embeddings >> table;
+
+    // output
+    std::cout << embeddings << std::endl;
+    std::cout << gpu_embeddings << std::endl;
+    std::cout << table << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
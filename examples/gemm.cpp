@@ -0,0 +1,41 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    float ptr1[] = {1, -2, 3, -4, 5, -6};
+    float ptr2[] = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6};
+    float ptr3[] = {-1, 1};
+
+    mcf::Mat<float> X(ptr1, 2, 3);
+    mcf::Mat<float> W(ptr2, 3, 2);
+    mcf::Mat<float> bias(ptr3, 1, 2);
+
+    mcf::Mat<float> C(2, 2);
+    mcf::Mat<float> D(2, 2);
+
+    // cpu, affine layer in one pass: relu(X * W + bias)
+    X.gemm(W, C, bias, mcf::RELU);
+
+    // gpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << X << W << bias << D;
+    X.gemm(W, D, bias, video, mcf::RELU);
+    video >> D;
+
+    // output
+    std::cout << C << std::endl;
+    std::cout << D << std::endl;
+
+    // C = (0.5 * X * W + C)^2 with a custom epilogue
+    X.gemm(W, C, mcf::Mat<float>(), [](const float& v){
+        return v * v;
+    }, 0.5f, 1.0f);
+    std::cout << C;
+
+    ecl::System::release();
+    
+    return 0;
+}
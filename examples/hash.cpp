@@ -0,0 +1,44 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(256, 64);
+    mcf::Mat<float> row(1, 64);
+
+    A.gen([](std::size_t i, std::size_t j){
+        return float(i * j % 7);
+    });
+    row.ones();
+
+    // cpu, the content hash keys a cache of derived results
+    std::uint64_t key = A.hash();
+
+    // appended rows continue the running hash instead of hashing A again
+    mcf::HashState state;
+    A.hashRows(state);
+
+    A.appendRows(row);
+    row.hashRows(state);
+
+    // the binary file keeps the hash in its header, loadHash reads just that
+    A.saveBinary("A.bin");
+    bool cached = mcf::Mat<float>::loadHash("A.bin") == mcf::hashDigest(state);
+    auto B = mcf::Mat<float>::loadBinary("A.bin");
+
+    // gpu, the same hash computed where the matrix lives
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << A;
+    std::uint64_t gpu_key = A.hash(video);
+    A.release(video);
+
+    // output
+    std::cout << std::hex << key << " " << mcf::hashDigest(state) << " " << gpu_key << std::endl;
+    std::cout << cached << " " << B.equals(A) << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(256, 128);
+    mcf::Mat<float> B(128, 64);
+
+    A.gen([](std::size_t i, std::size_t j){
+        return float((i + j) % 5) - 2;
+    });
+    B.gen([](std::size_t i, std::size_t j){
+        return float(i % 3);
+    });
+
+    // cpu, column sums of a column-major matrix read contiguous memory
+    mcf::Mat<float, mcf::ColumnMajor> C;
+    C.fromDense(A);
+
+    mcf::Mat<float> sums(1, 128);
+    C.reduce(sums, mcf::ROWS);
+
+    // 32 x 32 Morton tiles, the product walks tile by tile
+    mcf::Mat<float, mcf::Tiled<>> TA;
+    mcf::Mat<float, mcf::Tiled<>> TB;
+    mcf::Mat<float, mcf::Tiled<>> TC(256, 64);
+    TA.fromDense(A);
+    TB.fromDense(B);
+    TA.mul(TB, TC);
+
+    // gpu, the block is sent as any other matrix and the kernels compute the offsets of the layout
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    mcf::Mat<float, mcf::Tiled<>> GA(256, 128);
+    mcf::Mat<float, mcf::Tiled<>> GT(128, 256);
+    mcf::Mat<float> D(128, 256);
+
+    video << A << GA.getBlock() << GT.getBlock() << D;
+
+    GA.fromDense(A, video);
+    GA.transpose(GT, video);
+    GT.toDense(D, video);
+
+    video >> D;
+
+    A.release(video);
+    GA.getBlock().release(video);
+    GT.getBlock().release(video);
+    D.release(video);
+
+    // output
+    std::cout << sums.getE(0, 0) << " " << TC.getE(255, 63) << " " << D.getE(127, 255) << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(3, 3);
+    mcf::Mat<float> B(3, 1);
+
+    mcf::Mat<float> C(3, 3);
+    mcf::Mat<float> D(3, 3);
+    mcf::Mat<float> X(3, 1);
+
+    mcf::Mat<std::size_t> P(1, 3);
+    mcf::Mat<std::size_t> Q(1, 3);
+
+    A.gen([](size_t i, size_t j){
+        return i == j ? 4 : i + j;
+    });
+    B.gen([](size_t i, size_t j){
+        return i + 1;
+    });
+
+    // cpu
+    A.lu(C, P);
+    A.solve(B, X);
+
+    // gpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << A << D << Q;
+    A.lu(D, Q, video);
+    video >> D >> Q;
+
+    // output
+    std::cout << A << std::endl;
+    std::cout << C << std::endl;
+    std::cout << P << std::endl;
+    std::cout << D << std::endl;
+    std::cout << Q << std::endl;
+    std::cout << X;
+
+    ecl::System::release();
+
+    return 0;
+}
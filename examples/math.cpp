@@ -0,0 +1,36 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    float ptr[] = {-4, -1, -0.5, 0, 0.5, 1, 4, 8};
+
+    mcf::Mat<float> A(ptr, 2, 4);
+
+    mcf::Mat<float> B(2, 4);
+    mcf::Mat<float> C(2, 4);
+    mcf::Mat<float> D(2, 4);
+
+    // cpu, c++ library and vectorized polynomials
+    A.sigmoid(B);
+    A.sigmoid(C, mcf::FAST);
+
+    // gpu, OpenCL built-ins and native_ functions
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << A << D;
+    A.sigmoid(D, video, mcf::FAST);
+    video >> D;
+
+    // output
+    std::cout << B << std::endl;
+    std::cout << C << std::endl;
+    std::cout << D << std::endl;
+
+    std::cout << C.equals(B, mcf::ULP, 2) << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include "MatrixCF/MatrixCF.hpp"
+
+void executionTime(const std::function<void()>& f, size_t times = 1){
+    for(size_t i = 0; i < times; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto mcs = std::chrono::duration_cast<std::chrono::microseconds>(end - start); 
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start); 
+        std::cout << mcs.count() << " mcs (" << ms.count() << " ms)" << std::endl;
+    }
+}
+
+int main()
+{
+    std::cout << "NUMA nodes: " << mcf::numaNodes() << std::endl;
+
+    // keep every OpenMP thread next to the rows it gets from a static schedule
+    mcf::pinThreads();
+
+    mcf::Mat<float> A(8000, 8000);
+    mcf::Mat<float> B(8000, 8000);
+
+    // rows of A go to the node of the thread that processes them,
+    // pages of B are spread over all nodes
+    A.place(mcf::PLACEMENT::PARTITION);
+    B.place(mcf::PLACEMENT::INTERLEAVE);
+
+    auto f = [](size_t i, size_t j){
+        return sin(i + j);
+    };
+
+    A.gen(f);
+
+    executionTime([&](){
+        A.map([](const float& v){
+            return v * v;
+        }, B);
+    }, 5);
+
+    return 0;
+}
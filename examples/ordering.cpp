@@ -0,0 +1,45 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> scores(3, 6);
+    scores.gen([](std::size_t i, std::size_t j){
+        return float((i * 5 + j * 7) % 9);
+    });
+
+    // cpu, indices of the best score and of the top 3 of every row
+    mcf::Mat<std::size_t> best(3, 1);
+    mcf::Mat<std::size_t> top(3, 3);
+
+    scores.argmax(best);
+    scores.topk(3, top);
+
+    // every column sorted, largest first
+    mcf::Mat<float> sorted(3, 6);
+    scores.sort(sorted, mcf::ROWS, mcf::DESCENDING);
+
+    // gpu, the same selection and a bitonic argsort of every row
+    mcf::Mat<std::size_t> gpu_top(3, 3);
+    mcf::Mat<std::size_t> order(3, 6);
+
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << scores << gpu_top << order;
+    scores.topk(3, gpu_top, video);
+    scores.argsort(order, video);
+    video >> gpu_top >> order;
+
+    // output
+    std::cout << scores << std::endl;
+    std::cout << best << std::endl;
+    std::cout << top << std::endl;
+    std::cout << sorted << std::endl;
+    std::cout << gpu_top << std::endl;
+    std::cout << order << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
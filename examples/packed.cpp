@@ -0,0 +1,55 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(64, 512);
+    mcf::Mat<float> B(512, 4);
+
+    A.gen([](std::size_t i, std::size_t j){
+        return float((i + j) % 5) - 2;
+    });
+    B.ones();
+
+    // cpu, the gram matrix A^T * A keeps only its lower half, 512 * 513 / 2 elements instead of 512 * 512
+    mcf::SymMat<float> S(512);
+    S.syrk(A);
+
+    mcf::Mat<float> C(512, 4);
+    S.mul(B, C);
+
+    // a triangular factor is solved straight from its packed rows
+    mcf::TriMat<float> L(512);
+    for(std::size_t i = 0; 512 > i; i++){
+        L.setE(2, i, i);
+        if(i > 0) L.setE(1, i, i - 1);
+    }
+
+    mcf::Mat<float> X(512, 4);
+    L.solve(B, X);
+
+    // gpu, the packed triangle is sent as any other matrix
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    mcf::SymMat<float> G(512);
+    mcf::Mat<float> D(512, 512);
+
+    video << A << G.getPacked() << D;
+
+    G.syrk(A, video);
+    G.toDense(D, video);
+
+    video >> D;
+
+    A.release(video);
+    G.getPacked().release(video);
+    D.release(video);
+
+    // output
+    std::cout << S.getE(0, 1) << " " << D.getE(1, 0) << " " << C.getE(511, 0) << " " << X.getE(511, 0) << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
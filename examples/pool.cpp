@@ -0,0 +1,50 @@
+#include <iostream>
+#include <thread>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    auto p = ecl::System::getPlatform(0);
+
+    // the pool has to go before ecl::System::release
+    {
+        // two contexts with their own queues shared by eight request threads
+        mcf::ComputerPool pool(2, p, ecl::DEVICE::GPU);
+
+        std::vector<std::thread> workers;
+        std::vector<float> results(8);
+
+        for(size_t t = 0; t < 8; t++){
+            workers.emplace_back([&, t](){
+                mcf::Mat<float> A(256, 256);
+                mcf::Mat<float> B(256, 256);
+                mcf::Mat<float> C(256, 256);
+
+                A.full(float(t));
+                B.eye(1);
+
+                // waits while both computers are busy, gives the computer back at scope exit
+                auto lease = pool.lease();
+                ecl::Computer& video = lease;
+
+                video << A << B << C;
+                A.mul(B, C, video);
+                video >> C;
+
+                A.release(video);
+                B.release(video);
+                C.release(video);
+
+                results[t] = C.getE(0, 0);
+            });
+        }
+        for(auto& w : workers) w.join();
+
+        for(float r : results) std::cout << r << " ";
+        std::cout << std::endl;
+    }
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(3, 4);
+    mcf::Mat<float> B(3, 4);
+    mcf::Mat<int> C(3, 4);
+
+    // cpu, the same seed always gives the same matrix
+    A.random(42, mcf::NORMAL, 0, 1);
+    C.random(42, mcf::UNIFORM, 1, 7);
+
+    // gpu, bit by bit equal to the cpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << B;
+    B.random(42, video, mcf::NORMAL, 0, 1);
+    video >> B;
+
+    // output
+    std::cout << A << std::endl;
+    std::cout << B << std::endl;
+    std::cout << C << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    float ptr[] = {1, 2, 3, 4, 1000, 1001, 1002, 1003};
+
+    mcf::Mat<float> A(ptr, 2, 4);
+
+    mcf::Mat<float> B(2, 4);
+    mcf::Mat<float> C(2, 4);
+    mcf::Mat<float> mean(2, 1);
+    mcf::Mat<float> variance(2, 1);
+
+    // cpu, every row sums to 1 and large values don't overflow
+    A.softmax(B);
+    A.moments(mean, variance);
+
+    // gpu
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << A << C;
+    A.softmax(C, video, mcf::COLUMNS, mcf::FAST);
+    video >> C;
+
+    // output
+    std::cout << B << std::endl;
+    std::cout << C << std::endl;
+    std::cout << mean << std::endl;
+    std::cout << variance << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
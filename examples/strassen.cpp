@@ -0,0 +1,44 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include "MatrixCF/MatrixCF.hpp"
+
+void executionTime(const std::function<void()>& f, size_t times = 1){
+    for(size_t i = 0; i < times; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto mcs = std::chrono::duration_cast<std::chrono::microseconds>(end - start); 
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start); 
+        std::cout << mcs.count() << " mcs (" << ms.count() << " ms)" << std::endl;
+    }
+}
+
+int main()
+{
+    mcf::Mat<float> A(4096, 4096);
+    mcf::Mat<float> B(4096, 4096);
+    mcf::Mat<float> C(4096, 4096);
+    mcf::Mat<float> D(4096, 4096);
+
+    auto f = [](size_t i, size_t j){
+        return sin(i + j);
+    };
+
+    A.gen(f);
+    B.gen(f);
+
+    // blocked kernel
+    executionTime([&](){
+        A.mul(B, C);
+    }, 3);
+    std::cout << std::endl;
+
+    // strassen-winograd, recursion stops at 512 x 512
+    executionTime([&](){
+        A.strassen(B, D, 512);
+    }, 3);
+
+    return 0;
+}
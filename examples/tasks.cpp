@@ -0,0 +1,36 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(512, 512);
+    mcf::Mat<float> B(512, 512);
+
+    A.gen([](size_t i, size_t j){
+        return float(i + j) / 512;
+    });
+    B.gen([](size_t i, size_t j){
+        return float(i * j % 7);
+    });
+
+    mcf::Mat<float> C(512, 512);
+    mcf::Mat<float> D(512, 512);
+    mcf::Mat<float> E(512, 512);
+    mcf::Mat<float> F(512, 512);
+
+    // cpu, one after another
+    A.mul(B, C);
+    B.mul(A, D);
+
+    // cpu, both products share one team and their tiles are tasks
+    mcf::parallelInvoke([&](){
+        A.mul(B, E);
+    }, [&](){
+        B.mul(A, F);
+    });
+
+    // output
+    std::cout << C.equals(E) << " " << D.equals(F) << std::endl;
+
+    return 0;
+}
@@ -32,6 +32,8 @@ int main()
     }, 5);
     std::cout << std::endl;
 
+    mcf::Mat<float> C = A;
+
     // gpu
     auto p = ecl::System::getPlatform(0);
     ecl::Computer video(0, p, ecl::DEVICE::GPU);
@@ -41,9 +43,15 @@ int main()
         A.gen(f2, video);
         B.gen(f2, video);
     }, 5);
+
+    // compared on the device, only the flag is read back
+    std::cout << A.equals(B, video) << std::endl;
+
     video >> A >> B;
 
-    std::cout << A.equals(B) << std::endl;
+    // cpu and gpu sin differ in the last bits
+    std::cout << C.equals(A, mcf::ULP, 4) << std::endl;
+    std::cout << C.equals(A, mcf::RELATIVE, 1e-5) << std::endl;
 
     ecl::System::release();
 
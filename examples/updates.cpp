@@ -0,0 +1,48 @@
+#include <iostream>
+#include "MatrixCF/MatrixCF.hpp"
+
+int main()
+{
+    mcf::Mat<float> A(3, 3);
+    mcf::Mat<float> u(3, 1);
+    mcf::Mat<float> v(1, 3);
+    mcf::Mat<float> U(3, 2);
+
+    A.zeros();
+    u.ones();
+    v.gen([](std::size_t i, std::size_t j){
+        return float(j);
+    });
+    U.gen([](std::size_t i, std::size_t j){
+        return float(i + j);
+    });
+
+    // cpu, in place: A += u * v^T, then A += U * U^T on the lower triangle
+    A.ger(u, v);
+    A.syrk(U);
+
+    // gpu, the same updates without temporaries
+    mcf::Mat<float> B(3, 3);
+    B.zeros();
+
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    video << B << u << v << U;
+    B.ger(u, v, video);
+    B.syrk(U, video);
+    video >> B;
+
+    // rows grow on the cpu
+    mcf::Mat<float> C = A;
+    C.appendRows(v);
+
+    // output
+    std::cout << A << std::endl;
+    std::cout << B << std::endl;
+    std::cout << C << std::endl;
+
+    ecl::System::release();
+
+    return 0;
+}
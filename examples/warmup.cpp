@@ -0,0 +1,44 @@
+#include <iostream>
+#include <chrono>
+#include "MatrixCF/MatrixCF.hpp"
+
+void executionTime(const std::function<void()>& f, size_t times = 1){
+    for(size_t i = 0; i < times; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto mcs = std::chrono::duration_cast<std::chrono::microseconds>(end - start); 
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start); 
+        std::cout << mcs.count() << " mcs (" << ms.count() << " ms)" << std::endl;
+    }
+}
+
+int main()
+{
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    // startup: build the kernels used with 1024 x 1024 operands
+    executionTime([&](){
+        mcf::warmup<float, int>(video, 1024, 1024);
+    });
+
+    mcf::Mat<float> A(1024, 1024);
+    mcf::Mat<float> B(1024, 1024);
+    mcf::Mat<float> C(1024, 1024);
+
+    video << A << B << C;
+
+    // first call doesn't pay for the build anymore
+    executionTime([&](){
+        A.mul(B, C, video);
+    });
+
+    // kernel library for offline builds
+    mcf::saveCache("kernels.cl");
+
+    ecl::System::release();
+
+    return 0;
+}
@@ -2,12 +2,62 @@
 
 #ifndef _WIN32
 #define MATRIXCF_USE_OPENMP
+#define MATRIXCF_USE_SOCKETS
+#define MATRIXCF_USE_PINNED
 #endif // _WIN32
 
+#ifdef __linux__
+#define MATRIXCF_USE_NUMA
+#endif // __linux__
+
 
 #include <functional>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <map>
+#include <deque>
+#include <list>
+#include <tuple>
+#include <mutex>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+#include <cerrno>
 #include <omp.h>
 #include <iomanip>
+#include <charconv>
+#include <limits>
+#include <atomic>
+#include <cstring>
+#include <utility>
+#include <numeric>
+
+#ifdef MATRIXCF_USE_NUMA
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif // MATRIXCF_USE_NUMA
+
+#ifdef MATRIXCF_USE_SOCKETS
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // MATRIXCF_USE_SOCKETS
+
+#ifdef MATRIXCF_USE_PINNED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // MATRIXCF_USE_PINNED
+
+#ifdef MATRIXCF_USE_MPI
+#include <mpi.h>
+#endif // MATRIXCF_USE_MPI
 
 #include "EasyCL.hpp"
 #include "json.hpp"
@@ -18,1347 +68,8357 @@ namespace mcf{
     enum RAVEL {ROW, COLUMN};
     enum REDUCE {FULL, COLUMNS, ROWS};
     enum TRANSPOSE {NONE, FIRST, SECOND, BOTH};
+    enum TRIANGLE {LOWER, UPPER};
+    enum PLACEMENT {INTERLEAVE, PARTITION};
+    enum COMPARE {EXACT, ABSOLUTE, RELATIVE, ULP};
+    enum ACTIVATION {IDENTITY, RELU, SIGMOID, TANH};
+    enum STORAGE {PAGEABLE, PINNED};
+    enum ACCURACY {PRECISE, FAST};
+    enum NORM {L1, L2, LINF};
+    enum DISTRIBUTION {UNIFORM, NORMAL, BERNOULLI};
+    enum ORDER {ASCENDING, DESCENDING};
+    enum CODEC {RAW, SHUFFLE_LZ, DELTA_SHUFFLE_LZ};
 
 	// Cache
-	static std::vector<ecl::Program> cache;
+	// one program per source and ecl::Computer, list nodes keep references valid as it grows and shrinks
+	struct CachedProgram{
+		const ecl::Computer* video;
+		std::size_t hash;
+		ecl::Program prog;
+	};
+
+	// the source is hashed once per lookup, a hit still compares it so colliding sources never share a program
+	struct CacheKey{
+		const ecl::Computer* video;
+		std::size_t hash;
+
+		bool operator==(const CacheKey& other) const{
+			return video == other.video && hash == other.hash;
+		}
+	};
+	struct CacheKeyHash{
+		std::size_t operator()(const CacheKey& key) const{
+			return key.hash ^ (std::hash<const void*>()(key.video) * 0x9e3779b97f4a7c15ull);
+		}
+	};
+
+	inline std::list<CachedProgram> cache;
+	inline std::unordered_multimap<CacheKey, std::list<CachedProgram>::iterator, CacheKeyHash> cache_index;
+	inline std::shared_mutex cache_mutex;
+	inline std::atomic<std::size_t> cache_generation(0);
+
+	inline ecl::Program& cacheProgram(ecl::Program& prog, const ecl::Computer& video){
+		const std::string& source = prog.getSource();
+		CacheKey key = {&video, std::hash<std::string>()(source)};
+
+		// hits are served from a per-thread memo without taking the lock
+		thread_local std::unordered_multimap<CacheKey, ecl::Program*, CacheKeyHash> memo;
+		thread_local std::size_t memo_generation = 0;
+
+		std::size_t generation = cache_generation.load(std::memory_order_acquire);
+		if(memo_generation != generation){
+			memo.clear();
+			memo_generation = generation;
+		}
 
-	ecl::Program& cacheProgram(ecl::Program& prog) {
-		for(ecl::Program& p : cache) {
-			if (p.getSource().compare(prog.getSource()) == 0) return p;
+		auto hits = memo.equal_range(key);
+		for(auto it = hits.first; it != hits.second; it++){
+			if(it->second->getSource() == source) return *it->second;
 		}
 
-		cache.push_back(std::move(prog));
-		return cache.back();
+		auto lookup = [&]() -> ecl::Program*{
+			auto found = cache_index.equal_range(key);
+			for(auto it = found.first; it != found.second; it++){
+				if(it->second->prog.getSource() == source) return &it->second->prog;
+			}
+			return nullptr;
+		};
+
+		ecl::Program* result = nullptr;
+		{
+			std::shared_lock<std::shared_mutex> lock(cache_mutex);
+			result = lookup();
+		}
+		if(!result){
+			std::unique_lock<std::shared_mutex> lock(cache_mutex);
+			result = lookup();
+			if(!result){
+				cache.push_back({&video, key.hash, std::move(prog)});
+				cache_index.emplace(key, std::prev(cache.end()));
+				result = &cache.back().prog;
+			}
+		}
+
+		memo.emplace(key, result);
+		return *result;
 	}
 
-	// Matrix API
-    template<typename T>
-    class Mat{
-    private:
-        std::size_t h, w, total_size;
-        array<T> arr;
-        bool ref;
+	// buffers of ASYNC launches (e.g. per-call parameters) stay alive until the computer has run them,
+	// the queue is in order, so everything before a SYNC launch has finished once it returns
+	inline std::mutex inflight_mutex;
+	inline std::unordered_map<const ecl::Computer*, std::vector<std::shared_ptr<const void>>> inflight;
+
+	inline void retain(const ecl::Computer& video, ecl::EXEC sync, std::shared_ptr<const void> keep){
+		std::vector<std::shared_ptr<const void>> done;
+		{
+			std::lock_guard<std::mutex> lock(inflight_mutex);
+			if(sync == SYNC){
+				auto found = inflight.find(&video);
+				if(found != inflight.end()){
+					done = std::move(found->second);
+					inflight.erase(found);
+				}
+			}else if(keep) inflight[&video].push_back(std::move(keep));
+		}
+		// done and the keep of a SYNC launch are freed here, outside the lock
+	}
 
-        void clear();
-        std::string getTypeName() const;
-        void requireMatrixShape(const Mat<T>&, std::size_t, std::size_t, const std::string&, bool is_result = false) const;
-        void requireMatrixH(std::size_t, std::size_t, const std::string&) const;
-        void requireMatrixW(std::size_t, std::size_t, const std::string&) const;
-        void requireTotalSize(const Mat<T>&, std::size_t, const std::string&) const;
+	// waits for the computer and frees what its ASYNC launches were holding
+	inline void finish(ecl::Computer& video){
+		video.await();
+		retain(video, SYNC, nullptr);
+	}
 
-		void copy(const Mat<T>&);
-		void move(Mat<T>&);
-    public:
-        Mat();
-        Mat(std::size_t, std::size_t);
-        Mat(T*, std::size_t, std::size_t);
+	// frees the programs of a computer that is going away, so a new one at the same address rebuilds them
+	inline void releaseCache(const ecl::Computer& video){
+		retain(video, SYNC, nullptr);
+
+		std::unique_lock<std::shared_mutex> lock(cache_mutex);
+		for(auto it = cache.begin(); it != cache.end();){
+			if(it->video != &video){
+				it++;
+				continue;
+			}
+
+			auto found = cache_index.equal_range({it->video, it->hash});
+			for(auto entry = found.first; entry != found.second; entry++){
+				if(entry->second == it){
+					cache_index.erase(entry);
+					break;
+				}
+			}
+			it = cache.erase(it);
+		}
+		cache_generation++;
+	}
 
-        Mat(const Mat<T>&);
-        Mat<T>& operator=(const Mat<T>&);
+    // writes every cached kernel source into one .cl file, e.g. after warmup, for offline builds
+    inline void saveCache(const std::string& cl_filename){
+        std::ofstream f(cl_filename, std::ios::binary);
+        if(!f.is_open()) throw std::runtime_error("unable to save kernel cache to cl file");
 
-        Mat(Mat<T>&&);
-        Mat<T>& operator=(Mat<T>&&);
+        std::shared_lock<std::shared_mutex> lock(cache_mutex);
 
-        array<T>& getArray();
+        // the same source built for several computers is written once
+        std::vector<const std::string*> sources;
+        std::unordered_set<std::string> seen;
+        for(const CachedProgram& p : cache){
+            if(seen.insert(p.prog.getSource()).second) sources.push_back(&p.prog.getSource());
+        }
 
-        const array<T>& getConstArray() const;
-        const std::size_t getH() const;
-        const std::size_t getW() const;
-        const std::size_t getTotalSize() const;
+        f << "// MatrixCF kernel cache: " << sources.size() << " programs\n";
+        for(std::size_t i = 0; sources.size() > i; i++){
+            f << "\n// program " << i << "\n";
+            f << *sources[i] << "\n";
+        }
+        f.close();
+    }
 
-        std::size_t totalMemoryUsed() const;
-        bool isRef() const;
+    // Tasks (CPU)
+    // elements per chunk of the elementwise loops
+    constexpr std::size_t TASK_GRAIN = 1 << 14;
+
+    // workers shared by all top-level regions, concurrent callers split them instead of oversubscribing
+    inline std::atomic<int>& idleWorkers(){
+        #ifdef MATRIXCF_USE_OPENMP
+        static std::atomic<int> idle(omp_get_max_threads());
+        #else
+        static std::atomic<int> idle(1);
+        #endif
+        return idle;
+    }
 
-        const T& getE(std::size_t, std::size_t) const;
-        void setE(const T&, std::size_t, std::size_t);
+    // runs f on one thread of a team, spawned tasks run on the others
+    // inside a region (e.g. in a task) f just runs, so nested calls become tasks of the enclosing team
+    template<typename F>
+    void parallelRegion(const F& f){
+        #ifdef MATRIXCF_USE_OPENMP
+        if(!omp_in_parallel()){
+            std::atomic<int>& idle = idleWorkers();
+            int want = omp_get_max_threads();
+            int available = idle.load();
+            int taken = 0;
+
+            do{
+                taken = std::min(available, want);
+            }while(taken > 0 && !idle.compare_exchange_weak(available, available - taken));
+            taken = std::max(taken, 0);
+
+            #pragma omp parallel num_threads(std::max(taken, 1))
+            #pragma omp single
+            f();
+
+            idle += taken;
+            return;
+        }
+        #endif
+        f();
+    }
 
-        T* operator[](std::size_t);
-        operator T*();
-        operator const T*() const;
+    // runs f as a task, everything f references must outlive the next sync
+    template<typename F>
+    void spawn(F f){
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp task firstprivate(f)
+        #endif
+        f();
+    }
 
-        void send(ecl::Computer&, ecl::EXEC sync = SYNC);
-        void receive(ecl::Computer&, ecl::EXEC sync = SYNC);
-        void release(ecl::Computer&, ecl::EXEC sync = SYNC);
-        void grab(ecl::Computer&, ecl::EXEC sync = SYNC);
+    // waits for the tasks spawned by the current task
+    inline void sync(){
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp taskwait
+        #endif
+    }
 
-        void save(const std::string&) const;
-        static Mat<T> load(const std::string&);
+    // runs independent functions concurrently, e.g. two ops on different matrices
+    template<typename... F>
+    void parallelInvoke(const F&... f){
+        parallelRegion([&](){
+            (spawn([&f](){ f(); }), ...);
+            sync();
+        });
+    }
 
-        template<typename U>
-        friend std::ostream& operator<<(std::ostream&, const Mat<U>&);
-        template<typename U>
-        friend ecl::Computer& operator<<(ecl::Computer&, Mat<U>&);
-        template<typename U>
-        friend ecl::Computer& operator>>(ecl::Computer&, Mat<U>&);
+    // f(begin, end) on chunks of grain iterations, chunks are tasks that idle threads take
+    template<typename F>
+    void parallelFor(std::size_t first, std::size_t last, std::size_t grain, const F& f){
+        if(first >= last) return;
 
-        // methods (extra)
-        bool equals(const Mat<T>&) const;
+        grain = std::max<std::size_t>(grain, 1);
+        std::size_t chunks = (last - first + grain - 1) / grain;
+        if(chunks == 1){
+            f(first, last);
+            return;
+        }
 
-        void reshape(std::size_t, std::size_t);
-        void ravel(RAVEL option = ROW);
+        parallelRegion([&](){
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp taskloop grainsize(1)
+            #endif
+            for(std::size_t c = 0; chunks > c; c++) f(first + c * grain, std::min(last, first + (c + 1) * grain));
+        });
+    }
 
-        // methods (mutable)
-        void foreach(const std::function<void(std::size_t, std::size_t)>&);
-        void foreach(const std::string&, ecl::Computer&, ecl::EXEC sync = SYNC);
+    // GEMM (CPU)
+    // rows [p, p + kc) and columns [j, j + nc) of op(b) into dst
+    template<typename T>
+    void packPanel(bool trans_b, const T* b, std::size_t ldb, std::size_t pc, std::size_t kc, std::size_t jc, std::size_t nc, T* dst){
+        for(std::size_t p = 0; kc > p; p++){
+            T* row = dst + p * nc;
+            if(trans_b){
+                for(std::size_t j = 0; nc > j; j++) row[j] = b[(jc + j) * ldb + pc + p];
+            }else{
+                const T* src = b + (pc + p) * ldb + jc;
+                std::copy(src, src + nc, row);
+            }
+        }
+    }
 
-        void gen(const std::function<T(std::size_t, std::size_t)>&);
-        void gen(const std::string&, ecl::Computer&, ecl::EXEC sync = SYNC);
+    // c += alpha * op(a) * b, where op(a) is m x k and b is k x n, pack_b(p, kc, j, nc, dst) writes rows [p, p + kc)
+    // and columns [j, j + nc) of b into dst, so b can be computed panel by panel instead of stored (implicit GEMM)
+    template<typename T, typename P>
+    void implicitGemm(bool trans_a, std::size_t m, std::size_t n, std::size_t k, const T& alpha,
+                      const T* a, std::size_t lda, const P& pack_b, T* c, std::size_t ldc){
+        constexpr std::size_t MC = 64;
+        constexpr std::size_t KC = 256;
+        constexpr std::size_t NC = 1024;
+
+        std::vector<T> pa(MC * KC);
+        std::vector<T> pb(KC * NC);
+
+        for(std::size_t jc = 0; n > jc; jc += NC){
+            std::size_t nc = std::min(NC, n - jc);
+
+            for(std::size_t pc = 0; k > pc; pc += KC){
+                std::size_t kc = std::min(KC, k - pc);
+
+                // pack b panel: kc x nc
+                pack_b(pc, kc, jc, nc, pb.data());
+
+                for(std::size_t ic = 0; m > ic; ic += MC){
+                    std::size_t mc = std::min(MC, m - ic);
+
+                    // pack alpha * op(a) block: mc x kc
+                    for(std::size_t i = 0; mc > i; i++){
+                        T* dst = pa.data() + i * kc;
+                        if(trans_a){
+                            for(std::size_t p = 0; kc > p; p++) dst[p] = alpha * a[(pc + p) * lda + ic + i];
+                        }else{
+                            const T* src = a + (ic + i) * lda + pc;
+                            for(std::size_t p = 0; kc > p; p++) dst[p] = alpha * src[p];
+                        }
+                    }
+
+                    // 4 rows of c share every load of b
+                    std::size_t i = 0;
+                    for(; mc >= i + 4; i += 4){
+                        T* c0 = c + (ic + i) * ldc + jc;
+                        T* c1 = c0 + ldc;
+                        T* c2 = c1 + ldc;
+                        T* c3 = c2 + ldc;
+                        const T* a0 = pa.data() + i * kc;
+
+                        for(std::size_t p = 0; kc > p; p++){
+                            const T v0 = a0[p];
+                            const T v1 = a0[kc + p];
+                            const T v2 = a0[2 * kc + p];
+                            const T v3 = a0[3 * kc + p];
+                            const T* b_row = pb.data() + p * nc;
+
+                            #ifdef MATRIXCF_USE_OPENMP
+                            #pragma omp simd
+                            #endif
+                            for(std::size_t j = 0; nc > j; j++){
+                                const T v = b_row[j];
+                                c0[j] += v0 * v;
+                                c1[j] += v1 * v;
+                                c2[j] += v2 * v;
+                                c3[j] += v3 * v;
+                            }
+                        }
+                    }
+                    for(; mc > i; i++){
+                        T* c0 = c + (ic + i) * ldc + jc;
+                        const T* a0 = pa.data() + i * kc;
+
+                        for(std::size_t p = 0; kc > p; p++){
+                            const T v0 = a0[p];
+                            const T* b_row = pb.data() + p * nc;
+
+                            #ifdef MATRIXCF_USE_OPENMP
+                            #pragma omp simd
+                            #endif
+                            for(std::size_t j = 0; nc > j; j++) c0[j] += v0 * b_row[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-        void full(const T&);
-        void full(const T&, ecl::Computer&, ecl::EXEC sync = SYNC);
+    // c += alpha * op(a) * op(b), where op(a) is m x k and op(b) is k x n
+    template<typename T>
+    void blockedGemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k, const T& alpha,
+                     const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc){
+        implicitGemm(trans_a, m, n, k, alpha, a, lda, [&](std::size_t pc, std::size_t kc, std::size_t jc, std::size_t nc, T* pb){
+            packPanel(trans_b, b, ldb, pc, kc, jc, nc, pb);
+        }, c, ldc);
+    }
 
-        void zeros();
-        void zeros(ecl::Computer&, ecl::EXEC sync = SYNC);
+    // same as implicitGemm with c scaled by beta first, tiles of c are computed in parallel
+    // epilogue(row, i, j, count) runs on every finished tile row while the tile is still in cache
+    template<typename T, typename P, typename E = std::nullptr_t>
+    void parallelImplicitGemm(bool trans_a, std::size_t m, std::size_t n, std::size_t k, const T& alpha,
+                              const T* a, std::size_t lda, const P& pack_b, T* c, std::size_t ldc,
+                              const T& beta = T(1), const E& epilogue = nullptr){
+        constexpr std::size_t MB = 128;
+        constexpr std::size_t NB = 512;
+
+        std::size_t m_blocks = (m + MB - 1) / MB;
+        std::size_t n_blocks = (n + NB - 1) / NB;
+
+        parallelFor(0, m_blocks * n_blocks, 1, [&](std::size_t first, std::size_t last){
+            for(std::size_t block = first; last > block; block++){
+                std::size_t i0 = block / n_blocks * MB;
+                std::size_t j0 = block % n_blocks * NB;
+
+                std::size_t mb = std::min(MB, m - i0);
+                std::size_t nb = std::min(NB, n - j0);
+
+                const T* a_block = trans_a ? a + i0 : a + i0 * lda;
+                T* c_block = c + i0 * ldc + j0;
+
+                // beta = 0 ignores the old contents of c
+                if(beta != T(1)){
+                    for(std::size_t i = 0; mb > i; i++){
+                        T* row = c_block + i * ldc;
+                        if(beta == T(0)) std::fill(row, row + nb, T(0));
+                        else for(std::size_t j = 0; nb > j; j++) row[j] *= beta;
+                    }
+                }
+
+                implicitGemm(trans_a, mb, nb, k, alpha, a_block, lda, [&](std::size_t pc, std::size_t kc, std::size_t jc, std::size_t nc, T* pb){
+                    pack_b(pc, kc, j0 + jc, nc, pb);
+                }, c_block, ldc);
+
+                if constexpr(!std::is_same<E, std::nullptr_t>::value){
+                    for(std::size_t i = 0; mb > i; i++) epilogue(c_block + i * ldc, i0 + i, j0, nb);
+                }
+            }
+        });
+    }
 
-        void ones();
-        void ones(ecl::Computer&, ecl::EXEC sync = SYNC);
+    template<typename T, typename E = std::nullptr_t>
+    void parallelGemm(bool trans_a, bool trans_b, std::size_t m, std::size_t n, std::size_t k, const T& alpha,
+                      const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc,
+                      const T& beta = T(1), const E& epilogue = nullptr){
+        parallelImplicitGemm(trans_a, m, n, k, alpha, a, lda, [&](std::size_t pc, std::size_t kc, std::size_t jc, std::size_t nc, T* pb){
+            packPanel(trans_b, b, ldb, pc, kc, jc, nc, pb);
+        }, c, ldc, beta, epilogue);
+    }
 
-        void eye(const T& value = T(1));
-        void eye(const T& value, ecl::Computer&, ecl::EXEC sync = SYNC);
+    template<typename T>
+    T activate(const T& v, ACTIVATION option){
+        if(option == RELU) return v > T(0) ? v : T(0);
+        if(option == SIGMOID) return T(1 / (1 + std::exp(-double(v))));
+        if(option == TANH) return T(std::tanh(double(v)));
+        return v;
+    }
 
-        void hstack(const Mat<T>&, const Mat<T>&);
-        void hstack(const Mat<T>&, const Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC);
+    // Math (CPU)
+    // FAST kernels, ulp from the correctly rounded result for float and double:
+    // exp 1, log 3, sigmoid 2, tanh 3, pow 1 (float) and 1 + |p ln x| (double)
+    template<typename T>
+    struct MathTraits;
+
+    template<>
+    struct MathTraits<float>{
+        using I = std::int32_t;
+        static constexpr int MANTISSA = 23;
+        static constexpr int BIAS = 127;
+        // a + SHIFT rounds a to an integer held in the low mantissa bits
+        static constexpr float SHIFT = 12582912.0f;
+        // first guess of 1 / sqrt(x) on the bits
+        static constexpr I RSQRT = 0x5f3759df;
+        static constexpr float EXP_MAX = 88.8f;
+        static constexpr float EXP_MIN = -104.0f;
+        // 1 / k!
+        static constexpr float EXP_POLY[] = {1.0f, 1.0f, 1.0f / 2, 1.0f / 6, 1.0f / 24, 1.0f / 120, 1.0f / 720, 1.0f / 5040};
+        // 1 / (2k + 1)
+        static constexpr float LOG_POLY[] = {1.0f, 1.0f / 3, 1.0f / 5, 1.0f / 7, 1.0f / 9};
+    };
 
-        void hstack(const std::vector<const Mat<T>*>&);
-        
-        void vstack(const Mat<T>&, const Mat<T>&);
-        void vstack(const Mat<T>&, const Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC);
+    template<>
+    struct MathTraits<double>{
+        using I = std::int64_t;
+        static constexpr int MANTISSA = 52;
+        static constexpr int BIAS = 1023;
+        static constexpr double SHIFT = 6755399441055744.0;
+        static constexpr I RSQRT = 0x5fe6eb50c7b537a9;
+        static constexpr double EXP_MAX = 709.8;
+        static constexpr double EXP_MIN = -745.2;
+        static constexpr double EXP_POLY[] = {1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+                                              1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800};
+        static constexpr double LOG_POLY[] = {1.0, 1.0 / 3, 1.0 / 5, 1.0 / 7, 1.0 / 9, 1.0 / 11, 1.0 / 13, 1.0 / 15, 1.0 / 17, 1.0 / 19, 1.0 / 21};
+    };
 
-        void vstack(const std::vector<const Mat<T>*>&);
+    // the kernels below avoid branches, loops and float to int conversions, so omp simd loops calling them vectorize
+    template<typename T>
+    typename MathTraits<T>::I asBits(const T& x){
+        typename MathTraits<T>::I bits;
+        std::memcpy(&bits, &x, sizeof(T));
+        return bits;
+    }
 
-        void cpy(const Mat<T>&);
-        void view(Mat<T>&);
-        
-        // higher-order methods (immutable)
-        void map(const std::function<T(const T&)>&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void map(const std::string&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    template<typename T>
+    T asFloat(const typename MathTraits<T>::I& bits){
+        T x;
+        std::memcpy(&x, &bits, sizeof(T));
+        return x;
+    }
 
-        void transform(const Mat<T>&, const std::function<T(const T&, const T&)>&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void transform(const Mat<T>&, const std::string&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    // all bits set for nan, clampBits turns nan into a number
+    template<typename T>
+    typename MathTraits<T>::I nanMask(const T& x){
+        using I = typename MathTraits<T>::I;
+        I magnitude = asBits(x) & std::numeric_limits<I>::max();
+        return magnitude > asBits(std::numeric_limits<T>::infinity()) ? I(-1) : I(0);
+    }
 
-        // methods (immutable)
-        void transpose(Mat<T>&) const;
-        void transpose(Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+    // c ? a : b on the bit patterns, gcc turns float selects back into branches
+    template<typename T>
+    T blend(bool c, const T& a, const T& b){
+        using I = typename MathTraits<T>::I;
+        I mask = -I(c);
+        return asFloat<T>((asBits(a) & mask) | (asBits(b) & ~mask));
+    }
 
-        void reduce(Mat<T>&, REDUCE option = FULL, TRANSPOSE transpose_option = NONE) const;
-        void reduce(Mat<T>&, ecl::Computer&, REDUCE option = FULL, TRANSPOSE transpose_option = NONE, ecl::EXEC sync = SYNC) const;
+    // clamps on the bit patterns for the same reason
+    template<typename T>
+    T clampBits(const T& x, const T& low, const T& high){
+        using I = typename MathTraits<T>::I;
+        using U = typename std::make_unsigned<I>::type;
+        // negative floats grow as unsigned integers with their magnitude, positive ones as signed integers
+        U u = U(asBits(x));
+        u = u > U(asBits(low)) ? U(asBits(low)) : u;
+        I b = I(u);
+        b = b > asBits(high) ? asBits(high) : b;
+        return asFloat<T>(b);
+    }
 
-        T reduce() const;
-		T mreduce(const std::function<T(const T&)>&) const;
+    // unrolled, a loop here keeps the caller from vectorizing
+    template<typename T, std::size_t N, std::size_t... I>
+    inline T horner(const T (&c)[N], const T& x, std::index_sequence<I...>){
+        T r = c[N - 1];
+        ((r = r * x + c[N - 2 - I]), ...);
+        return r;
+    }
 
-        void add(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void add(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    template<typename T, std::size_t N>
+    inline T horner(const T (&c)[N], const T& x){
+        return horner(c, x, std::make_index_sequence<N - 1>());
+    }
 
-        void sub(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void sub(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    template<typename T>
+    inline T fastExp(const T& x){
+        using M = MathTraits<T>;
+        using I = typename M::I;
+        const T LOG2E = T(1.44269504088896340736);
+        const T LN2_HI = T(0.693145751953125);
+        const T LN2_LO = T(1.42860682030941723212e-6);
+
+        // x = n ln2 + r, |r| <= ln2 / 2
+        T c = clampBits(x, M::EXP_MIN, M::EXP_MAX);
+        T k = c * LOG2E + M::SHIFT;
+        I n = asBits(k) - asBits(M::SHIFT);
+        k -= M::SHIFT;
+        T r = c - k * LN2_HI - k * LN2_LO;
+
+        // 2^n in two steps, so results near overflow and underflow stay finite and subnormal
+        I n1 = n >> 1;
+        T e = horner(M::EXP_POLY, r) * asFloat<T>((n1 + M::BIAS) << M::MANTISSA) * asFloat<T>((n - n1 + M::BIAS) << M::MANTISSA);
+        return asFloat<T>(asBits(e) | nanMask(x));
+    }
 
-        void hadamard(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void hadamard(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    template<typename T>
+    inline T fastLog(const T& x){
+        using M = MathTraits<T>;
+        using I = typename M::I;
+        const T LN2_HI = T(0.693145751953125);
+        const T LN2_LO = T(1.42860682030941723212e-6);
+        const I SQRT2 = asBits(T(1.41421356237309504880));
+        const I ONE = I(M::BIAS) << M::MANTISSA;
+
+        // subnormals are scaled into the normal range first
+        bool subnormal = x < std::numeric_limits<T>::min();
+        T s = blend(subnormal, x * asFloat<T>(I(M::BIAS + M::MANTISSA) << M::MANTISSA), x);
+
+        // x = m 2^e, sqrt(1/2) <= m < sqrt(2)
+        I bits = asBits(s);
+        I e = (bits >> M::MANTISSA) - (subnormal ? M::BIAS + M::MANTISSA : M::BIAS);
+        I m_bits = (bits & ((I(1) << M::MANTISSA) - 1)) | ONE;
+        bool high = m_bits > SQRT2;
+        e = high ? e + 1 : e;
+        T m = asFloat<T>(high ? m_bits - (I(1) << M::MANTISSA) : m_bits);
+
+        // log(m) = 2 atanh((m - 1) / (m + 1))
+        T f = (m - 1) / (m + 1);
+        T l = 2 * f * horner(M::LOG_POLY, f * f);
+        T k = asFloat<T>(asBits(M::SHIFT) + e) - M::SHIFT;
+        T r = k * LN2_HI + (l + k * LN2_LO);
+
+        r = blend(x == std::numeric_limits<T>::infinity(), x, r);
+        r = blend(x == 0, -std::numeric_limits<T>::infinity(), r);
+        return blend(x >= 0, r, std::numeric_limits<T>::quiet_NaN());
+    }
 
-        void mul(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void mul(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    template<typename T>
+    inline T fastSigmoid(const T& x){
+        // e^x / (1 + e^x) for negative x, e^-x would overflow before the result leaves the subnormals
+        T e = fastExp(-std::abs(x));
+        return blend(x < 0, e, T(1)) / (1 + e);
+    }
 
-        void mul(const T&, Mat<T>&, TRANSPOSE option = NONE) const;
-        void mul(const T&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+    template<typename T>
+    inline T fastTanh(const T& x){
+        // taylor series near 0, where 1 - 2 / (e^2x + 1) cancels
+        constexpr T POLY[] = {T(1), T(-1.0 / 3), T(2.0 / 15), T(-17.0 / 315), T(62.0 / 2835), T(-1382.0 / 155925),
+                              T(21844.0 / 6081075), T(-929569.0 / 638512875), T(6404582.0 / 10854718875)};
+        T a = std::abs(x);
+        T t = fastExp(-2 * a);
+        T r = blend(a < T(0.2), a * horner(POLY, a * a), (1 - t) / (1 + t));
+        return std::copysign(r, x);
+    }
 
-        void hsplit(Mat<T>&, Mat<T>&) const;
-        void hsplit(Mat<T>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+    template<typename T>
+    inline T fastPow(const T& x, const T& p){
+        // float goes through double, so the error of log isn't scaled by p log x
+        using W = typename std::conditional<std::is_same<T, float>::value, double, T>::type;
+        T r = T(fastExp(W(p) * fastLog(W(std::abs(x)))));
+
+        // negative bases only have integer powers, odd ones keep the sign
+        bool integer = std::trunc(p) == p;
+        bool odd = std::trunc(p * T(0.5)) * 2 != p;
+        bool negative = x < 0;
+        r = blend(negative & odd, -r, r);
+        r = blend(negative & !integer, std::numeric_limits<T>::quiet_NaN(), r);
+        return blend((p == 0) | (x == 1), T(1), r);
+    }
 
-        void vsplit(Mat<T>&, Mat<T>&) const;
-        void vsplit(Mat<T>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+    // float and double have FAST kernels, other types use the c++ library
+    template<typename T>
+    constexpr bool hasFastMath(){
+        return std::is_same<T, float>::value || std::is_same<T, double>::value;
+    }
 
-        ~Mat();
+    // Statistics (CPU)
+    // Welford state, two states merge with Chan's formula
+    template<typename T>
+    struct Moments{
+        T n = 0;
+        T mean = 0;
+        T m2 = 0;
     };
-}
-
-// IMPLEMENTATION
-template<typename T>
-void mcf::Mat<T>::clear(){
-    h = 0;
-    w = 0;
-    total_size = 0;
-    arr.clear();
-    ref = 0;
-}
 
-template<typename T>
-std::string mcf::Mat<T>::getTypeName() const{
-    if constexpr (std::is_same<T, bool>::value) return "bool";
-    else if constexpr (std::is_same<T, char>::value) return "char";
-    else if constexpr (std::is_same<T, unsigned char>::value) return "unsigned char";
-    else if constexpr (std::is_same<T, short>::value) return "short";
-    else if constexpr (std::is_same<T, unsigned short>::value) return "unsigned short";
-    else if constexpr(std::is_same<T, int>::value) return "int";
-    else if constexpr(std::is_same<T, unsigned int>::value) return "unsigned int";
-    else if constexpr(std::is_same<T, long>::value) return "long";
-    else if constexpr(std::is_same<T, unsigned long>::value) return "unsigned long";
-    else if constexpr(std::is_same<T, float>::value) return "float";
-    else if constexpr (std::is_same<T, double>::value) return "double";
-    else if constexpr(std::is_same<T, std::size_t>::value) return "size_t";
-    else throw std::runtime_error("Get matrix typename: ecl::Computer calculations on matrices with this template aren't supported");
-}
+    template<typename T>
+    void welford(Moments<T>& m, const T& x){
+        m.n += 1;
+        T delta = x - m.mean;
+        m.mean += delta / m.n;
+        m.m2 += delta * (x - m.mean);
+    }
 
-template<typename T>
-void mcf::Mat<T>::requireMatrixShape(const Mat<T>& X, std::size_t require_h, std::size_t require_w, const std::string& where, bool is_result) const{
-    std::size_t r_h = X.getH();
-    std::size_t r_w = X.getW();
+    template<typename T>
+    void mergeMoments(Moments<T>& a, const Moments<T>& b){
+        T n = a.n + b.n;
+        if(n == 0) return;
+
+        T delta = b.mean - a.mean;
+        a.mean += delta * b.n / n;
+        a.m2 += b.m2 + delta * delta * a.n * b.n / n;
+        a.n = n;
+    }
 
-    if(r_h != require_h || r_w != require_w){
-        std::string what = is_result ? "result matrix" : "matrix";
+    // Ordering (CPU)
+    // NaN is above every number and ties go to the lower index, so every order is total and sorts are stable
+    template<typename T>
+    inline bool orderLess(const T& x, const T& y){
+        if constexpr(std::is_floating_point<T>::value) return x < y || (std::isnan(y) && !std::isnan(x));
+        else return x < y;
+    }
 
-        std::string e = "Require shape [" + where + "]: ";
-        e += "wrong " + what + " shape ";
-        e += std::to_string(r_h) + "x" + std::to_string(r_w);
-        e += " != ";
-        e += std::to_string(require_h) + "x" + std::to_string(require_w);
+    template<typename T>
+    inline bool orderBefore(const T& x, std::size_t i, const T& y, std::size_t j, ORDER order){
+        if(order == DESCENDING ? orderLess(y, x) : orderLess(x, y)) return true;
+        if(order == DESCENDING ? orderLess(x, y) : orderLess(y, x)) return false;
+        return j > i;
+    }
 
-        throw std::runtime_error(e);
+    // keeps the k first offered indices in a heap, its top is the last of them
+    template<typename B>
+    inline void offerHeap(std::size_t* heap, std::size_t& size, std::size_t k, std::size_t i, const B& before){
+        if(k > size){
+            heap[size++] = i;
+            std::push_heap(heap, heap + size, before);
+        }else if(before(i, heap[0])){
+            std::pop_heap(heap, heap + size, before);
+            heap[size - 1] = i;
+            std::push_heap(heap, heap + size, before);
+        }
     }
-}
 
-template<typename T>
-void mcf::Mat<T>::requireMatrixH(std::size_t r_h, std::size_t require_h, const std::string& where) const{
-    if(r_h != require_h){
-        std::string e = "Require h [" + where + "]: ";
-        e += "wrong matrix h ";
-        e += std::to_string(r_h) + " != " + std::to_string(require_h);
-        throw std::runtime_error(e);
+    // whether any value comes strictly before the bound, elements at or after it can't enter a full heap
+    template<typename T>
+    inline bool anyBefore(const T* x, std::size_t n, const T& bound, ORDER order){
+        int any = 0;
+        if(order == DESCENDING){
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd reduction(|:any)
+            #endif
+            for(std::size_t i = 0; n > i; i++) any |= orderLess(bound, x[i]);
+        }else{
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd reduction(|:any)
+            #endif
+            for(std::size_t i = 0; n > i; i++) any |= orderLess(x[i], bound);
+        }
+        return any;
     }
-}
-template<typename T>
-void mcf::Mat<T>::requireMatrixW(std::size_t r_w, std::size_t require_w, const std::string& where) const{
-    if(r_w != require_w){
-        std::string e = "Require w [" + where + "]: ";
-        e += "wrong matrix w ";
-        e += std::to_string(r_w) + " != " + std::to_string(require_w);
-        throw std::runtime_error(e);
+
+    // sorted runs merged pairwise, every pass runs its merges in parallel
+    template<typename V, typename C>
+    void parallelSort(V* data, std::size_t n, const C& less){
+        std::size_t run = std::max<std::size_t>(TASK_GRAIN, (n + 63) / 64);
+        std::size_t runs = (n + run - 1) / run;
+
+        parallelFor(0, runs, 1, [&](std::size_t first, std::size_t last){
+            for(std::size_t r = first; last > r; r++) std::sort(data + r * run, data + std::min(n, (r + 1) * run), less);
+        });
+        if(2 > runs) return;
+
+        std::vector<V> buffer(n);
+        V* src = data;
+        V* dst = buffer.data();
+        for(; n > run; run *= 2){
+            parallelFor(0, (n + 2 * run - 1) / (2 * run), 1, [&](std::size_t first, std::size_t last){
+                for(std::size_t r = first; last > r; r++){
+                    std::size_t lo = 2 * r * run;
+                    std::size_t mid = std::min(n, lo + run);
+                    std::size_t hi = std::min(n, lo + 2 * run);
+                    std::merge(src + lo, src + mid, src + mid, src + hi, dst + lo, less);
+                }
+            });
+            std::swap(src, dst);
+        }
+        if(src != data) std::copy(src, src + n, data);
     }
-}
 
-template<typename T>
-void mcf::Mat<T>::requireTotalSize(const Mat<T>& X, std::size_t require_total_size, const std::string& where) const{
-    std::size_t r_total_size = X.getTotalSize();
+    // Random (CPU)
+    // Philox4x32-10 (Salmon et al., Random123), a block of 4 words is a function of its counter and the key only
+    constexpr std::uint32_t PHILOX_M0 = 0xD2511F53;
+    constexpr std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+    constexpr std::uint32_t PHILOX_W0 = 0x9E3779B9;
+    constexpr std::uint32_t PHILOX_W1 = 0xBB67AE85;
 
-    if(r_total_size != require_total_size){
-        std::string e = "Require total size [" + where + "]: ";
-        e += "wrong matrix total size ";
-        e += std::to_string(r_total_size) + " != " + std::to_string(require_total_size);
-        throw std::runtime_error(e);
+    inline void philoxRound(std::uint32_t (&c)[4], std::uint32_t& k0, std::uint32_t& k1){
+        std::uint64_t p0 = std::uint64_t(PHILOX_M0) * c[0];
+        std::uint64_t p1 = std::uint64_t(PHILOX_M1) * c[2];
+
+        c[0] = std::uint32_t(p1 >> 32) ^ c[1] ^ k0;
+        c[1] = std::uint32_t(p1);
+        c[2] = std::uint32_t(p0 >> 32) ^ c[3] ^ k1;
+        c[3] = std::uint32_t(p0);
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
     }
-}
 
-template<typename T>
-void mcf::Mat<T>::copy(const Mat<T>& other) {
-	clear();
+    template<std::size_t... R>
+    inline void philox(std::uint32_t (&c)[4], std::uint32_t k0, std::uint32_t k1, std::index_sequence<R...>){
+        ((philoxRound(c, k0, k1), void(R)), ...);
+    }
 
-	h = other.h;
+    inline void philox(std::uint32_t (&c)[4], std::uint32_t k0, std::uint32_t k1){
+        philox(c, k0, k1, std::make_index_sequence<10>());
+    }
+
+    // a + range * u rounds up to b for u close to 1, those values go to the last one before b
+    template<typename T>
+    inline T randomBelow(const T& v, const T& a, const T& b, const T& top){
+        return (b > a ? b > v : v > b) ? v : top;
+    }
+
+    // the normal quantile below uses only +, *, fma, exact conversions and bit operations in a fixed order, every product
+    // that feeds a sum is an explicit fma, so no compiler can fuse it differently; the OpenCL kernel repeats the same steps
+    // with fma and both round every step the same way
+    template<typename T>
+    constexpr T RANDOM_LOG[] = {T(1.0), T(1.0 / 3), T(1.0 / 5), T(1.0 / 7), T(1.0 / 9)};
+
+    // sqrt(2) erfinv(2u - 1), Giles' single precision approximation for w < 5 and w >= 5
+    template<typename T>
+    constexpr T RANDOM_CENTER[] = {T(1.50140941), T(0.246640727), T(-0.00417768164), T(-0.00125372503), T(0.00021858087),
+                                   T(-4.39150654e-06), T(-3.5233877e-06), T(3.43273939e-07), T(2.81022636e-08)};
+    template<typename T>
+    constexpr T RANDOM_TAIL[] = {T(2.83297682), T(1.00167406), T(0.00943887047), T(-0.0076224613), T(0.00573950773),
+                                 T(-0.00367342844), T(0.00134934322), T(0.000100950558), T(-0.000200214257)};
+
+    template<typename T, std::size_t N, std::size_t... I>
+    inline T randomHorner(const T (&c)[N], const T& x, std::index_sequence<I...>){
+        T r = c[N - 1];
+        ((r = std::fma(r, x, c[N - 2 - I])), ...);
+        return r;
+    }
+
+    template<typename T, std::size_t N>
+    inline T randomHorner(const T (&c)[N], const T& x){
+        return randomHorner(c, x, std::make_index_sequence<N - 1>());
+    }
+
+    template<typename T>
+    inline T randomLog(const T& x){
+        using M = MathTraits<T>;
+        using I = typename M::I;
+        const I SQRT2 = asBits(T(1.41421356237309504880));
+
+        // x = m 2^e, sqrt(1/2) <= m < sqrt(2), x is normal and positive
+        I bits = asBits(x);
+        I e = (bits >> M::MANTISSA) - M::BIAS;
+        I m_bits = (bits & ((I(1) << M::MANTISSA) - 1)) | (I(M::BIAS) << M::MANTISSA);
+        bool high = m_bits > SQRT2;
+        e = high ? e + 1 : e;
+        T m = asFloat<T>(high ? m_bits - (I(1) << M::MANTISSA) : m_bits);
+
+        // 1 / (m + 1) by newton steps instead of a division, OpenCL float division isn't correctly rounded
+        T d = (m + 1) * T(0.25);
+        T y = std::fma(T(-32.0 / 17), d, T(48.0 / 17));
+        y = y * std::fma(-d, y, T(2));
+        y = y * std::fma(-d, y, T(2));
+        y = y * std::fma(-d, y, T(2));
+        y = y * std::fma(-d, y, T(2));
+
+        T f = (m - 1) * (y * T(0.25));
+        T k = asFloat<T>(asBits(M::SHIFT) + e) - M::SHIFT;
+        return std::fma(k, T(0.693147180559945309417), 2 * f * randomHorner(RANDOM_LOG<T>, f * f));
+    }
+
+    // 1 / sqrt(x), the caller multiplies by x in its own fma
+    template<typename T>
+    inline T randomRsqrt(const T& x){
+        using M = MathTraits<T>;
+
+        T half = T(0.5) * x;
+        T y = asFloat<T>(M::RSQRT - (asBits(x) >> 1));
+        y = y * std::fma(-(half * y), y, T(1.5));
+        y = y * std::fma(-(half * y), y, T(1.5));
+        y = y * std::fma(-(half * y), y, T(1.5));
+        y = y * std::fma(-(half * y), y, T(1.5));
+        return y;
+    }
+
+    // u in (0, 1)
+    template<typename T>
+    inline T normalQuantile(const T& u){
+        T x = std::fma(T(2), u, T(-1));
+        T w = -randomLog((1 - x) * (1 + x));
+        T center = randomHorner(RANDOM_CENTER<T>, w - T(2.5));
+        T tail = randomHorner(RANDOM_TAIL<T>, std::fma(w, randomRsqrt(w), T(-3)));
+        return T(1.41421356237309504880) * (x * blend(w < 5, center, tail));
+    }
+
+    // Convolution (CPU)
+    // an image is a Mat of channels x (height * width), filters are a Mat of out channels x (channels * kernel_h * kernel_w)
+    // and the output an image of out channels x (output_h * output_w), so a convolution is filters * im2col(image)
+    struct Conv2D{
+        std::size_t height;
+        std::size_t width;
+        std::size_t kernel_h;
+        std::size_t kernel_w;
+        std::size_t stride = 1;
+        std::size_t padding = 0;
+        std::size_t dilation = 1;
+
+        std::size_t getOutputH() const{
+            return (height + 2 * padding - dilation * (kernel_h - 1) - 1) / stride + 1;
+        }
+        std::size_t getOutputW() const{
+            return (width + 2 * padding - dilation * (kernel_w - 1) - 1) / stride + 1;
+        }
+    };
+
+    // columns [q, q + count) of im2col row kk into dst, one output row at a time: zeros, a strided copy, zeros
+    template<typename T, bool ADD = false>
+    void im2colRow(const Conv2D& g, std::size_t kk, std::size_t q, std::size_t count, const T* image, T* dst){
+        std::size_t out_w = g.getOutputW();
+        std::size_t ch = kk / (g.kernel_h * g.kernel_w);
+        std::size_t ky = kk / g.kernel_w % g.kernel_h;
+        std::size_t kx = kk % g.kernel_w;
+
+        auto stride = std::ptrdiff_t(g.stride);
+        auto width = std::ptrdiff_t(g.width);
+        std::size_t oy = q / out_w;
+        std::size_t ox = q % out_w;
+
+        while(count > 0){
+            std::size_t n = std::min(count, out_w - ox);
+            std::ptrdiff_t iy = std::ptrdiff_t(oy * g.stride + ky * g.dilation) - std::ptrdiff_t(g.padding);
+            std::ptrdiff_t ix = std::ptrdiff_t(ox * g.stride + kx * g.dilation) - std::ptrdiff_t(g.padding);
+
+            // output columns [lo, hi) read inside the image
+            std::size_t lo = 0;
+            std::size_t hi = 0;
+            if(iy >= 0 && iy < std::ptrdiff_t(g.height) && ix < width){
+                lo = ix < 0 ? std::size_t((-ix + stride - 1) / stride) : 0;
+                hi = std::size_t((width - ix + stride - 1) / stride);
+                lo = std::min(lo, n);
+                hi = std::max(lo, std::min(hi, n));
+            }
+
+            std::size_t offset = (ch * g.height + std::size_t(std::clamp<std::ptrdiff_t>(iy, 0, std::ptrdiff_t(g.height) - 1))) * g.width;
+            const T* row = image + offset;
+            if constexpr(ADD){
+                // dst is the image here and image the im2col row
+                T* out = dst + offset;
+                for(std::size_t j = lo; hi > j; j++) out[ix + std::ptrdiff_t(j) * stride] += image[j];
+                image += n;
+            }else{
+                std::fill(dst, dst + lo, T(0));
+                if(stride == 1) std::copy(row + ix + std::ptrdiff_t(lo), row + ix + std::ptrdiff_t(hi), dst + lo);
+                else for(std::size_t j = lo; hi > j; j++) dst[j] = row[ix + std::ptrdiff_t(j) * stride];
+                std::fill(dst + hi, dst + n, T(0));
+                dst += n;
+            }
+
+            count -= n;
+            ox = 0;
+            oy++;
+        }
+    }
+
+    // Packed (CPU)
+    // one triangle (with the diagonal) of an n x n matrix in n(n + 1) / 2 elements row after row, a row of a LOWER
+    // triangle starts at column 0 and a row of an UPPER triangle at the diagonal
+    inline std::size_t packedRow(std::size_t i, std::size_t n, TRIANGLE option){
+        return option == LOWER ? i * (i + 1) / 2 : i * n - i * (i - 1) / 2;
+    }
+
+    inline std::size_t packedOffset(std::size_t i, std::size_t j, std::size_t n, TRIANGLE option){
+        return packedRow(i, n, option) + (option == LOWER ? j : j - i);
+    }
+
+    // packedOffset in OpenCL for one order and triangle
+    inline std::string getPackedOffset(std::size_t n, TRIANGLE option){
+        std::string offset = "size_t packedOffset(size_t i, size_t j){\n";
+        if(option == LOWER) offset += "return i * (i + 1) / 2 + j;\n";
+        else offset += "return i * " + std::to_string(n) + " - i * (i - 1) / 2 + j - i;\n";
+        offset += "}\n";
+        return offset;
+    }
+
+    // Layout (CPU)
+    // a layout places element (i, j) of an h x w matrix at offset(i, j, h, w) of a block of getExtent(h, w) elements,
+    // getOffset(name, h, w) is the same function in OpenCL, so the kernels of a layout are specialized when they're built
+    struct RowMajor{
+        static std::pair<std::size_t, std::size_t> getExtent(std::size_t h, std::size_t w){
+            return {h, w};
+        }
+        static std::size_t offset(std::size_t i, std::size_t j, std::size_t, std::size_t w){
+            return i * w + j;
+        }
+        static std::string getOffset(const std::string& name, std::size_t, std::size_t w){
+            return "size_t " + name + "(size_t i, size_t j){\nreturn i * " + std::to_string(w) + " + j;\n}\n";
+        }
+    };
+
+    // the block of a column-major matrix is its row-major transpose
+    struct ColumnMajor{
+        static std::pair<std::size_t, std::size_t> getExtent(std::size_t h, std::size_t w){
+            return {w, h};
+        }
+        static std::size_t offset(std::size_t i, std::size_t j, std::size_t h, std::size_t){
+            return j * h + i;
+        }
+        static std::string getOffset(const std::string& name, std::size_t h, std::size_t){
+            return "size_t " + name + "(size_t i, size_t j){\nreturn j * " + std::to_string(h) + " + i;\n}\n";
+        }
+    };
+
+    // bits of x in the even bits of the result
+    inline std::size_t spreadBits(std::size_t x){
+        x &= 0xFFFF;
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        return (x | (x << 1)) & 0x55555555;
+    }
+
+    inline std::size_t mortonCode(std::size_t i, std::size_t j){
+        return (spreadBits(i) << 1) | spreadBits(j);
+    }
+
+    // B x B tiles in row-major order, one tile per row of the block, elements of a tile in Morton (Z) order;
+    // edge tiles are padded with zeros
+    template<std::size_t B = 32>
+    struct Tiled{
+        static_assert(B > 0 && B <= 65536 && (B & (B - 1)) == 0, "Tiled: the tile size must be a power of two");
+
+        static std::pair<std::size_t, std::size_t> getExtent(std::size_t h, std::size_t w){
+            return {((h + B - 1) / B) * ((w + B - 1) / B), B * B};
+        }
+        static std::size_t offset(std::size_t i, std::size_t j, std::size_t, std::size_t w){
+            return ((i / B) * ((w + B - 1) / B) + j / B) * B * B + mortonCode(i % B, j % B);
+        }
+        static std::string getOffset(const std::string& name, std::size_t, std::size_t w){
+            std::size_t bits = 0;
+            while((std::size_t(1) << bits) < B) bits++;
+
+            std::string b = std::to_string(B);
+            std::string offset = "size_t " + name + "(size_t i, size_t j){\n";
+            offset += "size_t ti = i % " + b + ";\n";
+            offset += "size_t tj = j % " + b + ";\n";
+            offset += "size_t m = 0;\n";
+            offset += "for(size_t k = 0; k < " + std::to_string(bits) + "; k++) m |= (((ti >> k) & 1) << (2 * k + 1)) | (((tj >> k) & 1) << (2 * k));\n";
+            offset += "return ((i / " + b + ") * " + std::to_string((w + B - 1) / B) + " + j / " + b + ") * " + std::to_string(B * B) + " + m;\n";
+            offset += "}\n";
+            return offset;
+        }
+    };
+
+    // f(i, j, band) over the LAYOUT_BLOCK x LAYOUT_BLOCK squares of an h x w matrix, band is i / LAYOUT_BLOCK and a task
+    // runs whole bands, so both a row-major side and the other layout stay in cache
+    constexpr std::size_t LAYOUT_BLOCK = 32;
+
+    template<typename F>
+    void layoutBlocks(std::size_t h, std::size_t w, const F& f){
+        std::size_t grain = std::max<std::size_t>(TASK_GRAIN / (LAYOUT_BLOCK * std::max<std::size_t>(w, 1)), 1);
+
+        parallelFor(0, (h + LAYOUT_BLOCK - 1) / LAYOUT_BLOCK, grain, [&](std::size_t first, std::size_t last){
+            for(std::size_t bi = first; last > bi; bi++){
+                for(std::size_t j0 = 0; w > j0; j0 += LAYOUT_BLOCK){
+                    for(std::size_t i = bi * LAYOUT_BLOCK; std::min(h, (bi + 1) * LAYOUT_BLOCK) > i; i++){
+                        for(std::size_t j = j0; std::min(w, j0 + LAYOUT_BLOCK) > j; j++) f(i, j, bi);
+                    }
+                }
+            }
+        });
+    }
+
+    // Strassen-Winograd (CPU)
+    // extra memory needed by strassenGemm, it is allocated once and carved by every level
+    inline std::size_t strassenWorkspace(std::size_t m, std::size_t n, std::size_t k, std::size_t crossover, std::size_t task_depth){
+        if(crossover >= std::min({m, n, k})) return 0;
+
+        std::size_t hm = m / 2;
+        std::size_t hn = n / 2;
+        std::size_t hk = k / 2;
+
+        if(task_depth > 0) return 4 * hm * hk + 4 * hk * hn + 7 * hm * hn + 7 * strassenWorkspace(hm, hn, hk, crossover, task_depth - 1);
+        return hm * hk + hk * hn + hm * hn + strassenWorkspace(hm, hn, hk, crossover, 0);
+    }
+
+    // z = x + sign * y
+    template<typename T>
+    void strassenAdd(std::size_t m, std::size_t n, const T* x, std::size_t ldx, const T* y, std::size_t ldy, T* z, std::size_t ldz, const T& sign){
+        for(std::size_t i = 0; m > i; i++){
+            const T* x_row = x + i * ldx;
+            const T* y_row = y + i * ldy;
+            T* z_row = z + i * ldz;
+
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd
+            #endif
+            for(std::size_t j = 0; n > j; j++) z_row[j] = x_row[j] + sign * y_row[j];
+        }
+    }
+
+    // z = x
+    template<typename T>
+    void strassenCopy(std::size_t m, std::size_t n, const T* x, std::size_t ldx, T* z, std::size_t ldz){
+        for(std::size_t i = 0; m > i; i++) std::copy(x + i * ldx, x + i * ldx + n, z + i * ldz);
+    }
+
+    // c = a * b, where a is m x k and b is k x n
+    // the first task_depth levels compute their seven products as OpenMP tasks
+    template<typename T>
+    void strassenGemm(std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb,
+                      T* c, std::size_t ldc, T* workspace, std::size_t crossover, std::size_t task_depth){
+        if(crossover >= std::min({m, n, k})){
+            for(std::size_t i = 0; m > i; i++) std::fill(c + i * ldc, c + i * ldc + n, T(0));
+            blockedGemm(false, false, m, n, k, T(1), a, lda, b, ldb, c, ldc);
+            return;
+        }
+
+        std::size_t hm = m / 2;
+        std::size_t hn = n / 2;
+        std::size_t hk = k / 2;
+
+        const T* a11 = a;
+        const T* a12 = a + hk;
+        const T* a21 = a + hm * lda;
+        const T* a22 = a21 + hk;
+
+        const T* b11 = b;
+        const T* b12 = b + hn;
+        const T* b21 = b + hk * ldb;
+        const T* b22 = b21 + hn;
+
+        T* c11 = c;
+        T* c12 = c + hn;
+        T* c21 = c + hm * ldc;
+        T* c22 = c21 + hn;
+
+        if(task_depth > 0){
+            std::size_t child_size = strassenWorkspace(hm, hn, hk, crossover, task_depth - 1);
+
+            T* s[4];
+            T* t[4];
+            T* p[7];
+            for(std::size_t i = 0; 4 > i; i++) s[i] = workspace + i * hm * hk;
+            for(std::size_t i = 0; 4 > i; i++) t[i] = workspace + 4 * hm * hk + i * hk * hn;
+            for(std::size_t i = 0; 7 > i; i++) p[i] = workspace + 4 * hm * hk + 4 * hk * hn + i * hm * hn;
+            T* child = workspace + 4 * hm * hk + 4 * hk * hn + 7 * hm * hn;
+
+            spawn([&](){
+                strassenAdd(hm, hk, a21, lda, a22, lda, s[0], hk, T(1));
+                strassenAdd(hm, hk, s[0], hk, a11, lda, s[1], hk, T(-1));
+                strassenAdd(hm, hk, a12, lda, s[1], hk, s[3], hk, T(-1));
+            });
+            spawn([&](){
+                strassenAdd(hm, hk, a11, lda, a21, lda, s[2], hk, T(-1));
+            });
+            spawn([&](){
+                strassenAdd(hk, hn, b12, ldb, b11, ldb, t[0], hn, T(-1));
+                strassenAdd(hk, hn, b22, ldb, t[0], hn, t[1], hn, T(-1));
+                strassenAdd(hk, hn, t[1], hn, b21, ldb, t[3], hn, T(-1));
+            });
+            spawn([&](){
+                strassenAdd(hk, hn, b22, ldb, b12, ldb, t[2], hn, T(-1));
+            });
+            sync();
+
+            const T* left[7] = {a11, a12, s[3], a22, s[0], s[1], s[2]};
+            const T* right[7] = {b11, b21, b22, t[3], t[0], t[1], t[2]};
+            std::size_t ld_left[7] = {lda, lda, hk, lda, hk, hk, hk};
+            std::size_t ld_right[7] = {ldb, ldb, ldb, hn, hn, hn, hn};
+
+            for(std::size_t i = 0; 7 > i; i++){
+                spawn([&, i](){
+                    strassenGemm(hm, hn, hk, left[i], ld_left[i], right[i], ld_right[i], p[i], hn, child + i * child_size, crossover, task_depth - 1);
+                });
+            }
+            sync();
+
+            // c11 = m1 + m2, c12 = m1 + m6 + m5 + m3, c21 = m1 + m6 + m7 - m4, c22 = m1 + m6 + m7 + m5
+            T* quadrants[4] = {c11, c12, c21, c22};
+            int terms[4][7] = {
+                {1, 1, 0, 0, 0, 0, 0},
+                {1, 0, 1, 0, 1, 1, 0},
+                {1, 0, 0, -1, 0, 1, 1},
+                {1, 0, 0, 0, 1, 1, 1}
+            };
+
+            for(std::size_t q = 0; 4 > q; q++){
+                spawn([&, q](){
+                    strassenCopy(hm, hn, p[0], hn, quadrants[q], ldc);
+                    for(std::size_t i = 1; 7 > i; i++){
+                        if(terms[q][i] != 0) strassenAdd(hm, hn, quadrants[q], ldc, p[i], hn, quadrants[q], ldc, T(terms[q][i]));
+                    }
+                });
+            }
+            sync();
+        }else{
+            // one temporary per operand and one per product, products are accumulated into c
+            T* s = workspace;
+            T* t = s + hm * hk;
+            T* p = t + hk * hn;
+            T* child = p + hm * hn;
+
+            auto accumulate = [&](T* quadrant, const T& sign){
+                strassenAdd(hm, hn, quadrant, ldc, p, hn, quadrant, ldc, sign);
+            };
+
+            // m1
+            strassenGemm(hm, hn, hk, a11, lda, b11, ldb, c11, ldc, child, crossover, 0);
+            strassenCopy(hm, hn, c11, ldc, c12, ldc);
+            strassenCopy(hm, hn, c11, ldc, c21, ldc);
+            strassenCopy(hm, hn, c11, ldc, c22, ldc);
+
+            // m2
+            strassenGemm(hm, hn, hk, a12, lda, b21, ldb, p, hn, child, crossover, 0);
+            accumulate(c11, T(1));
+
+            // m5 = s1 * t1
+            strassenAdd(hm, hk, a21, lda, a22, lda, s, hk, T(1));
+            strassenAdd(hk, hn, b12, ldb, b11, ldb, t, hn, T(-1));
+            strassenGemm(hm, hn, hk, s, hk, t, hn, p, hn, child, crossover, 0);
+            accumulate(c12, T(1));
+            accumulate(c22, T(1));
+
+            // m6 = s2 * t2
+            strassenAdd(hm, hk, s, hk, a11, lda, s, hk, T(-1));
+            strassenAdd(hk, hn, b22, ldb, t, hn, t, hn, T(-1));
+            strassenGemm(hm, hn, hk, s, hk, t, hn, p, hn, child, crossover, 0);
+            accumulate(c12, T(1));
+            accumulate(c21, T(1));
+            accumulate(c22, T(1));
+
+            // m3 = s4 * b22
+            strassenAdd(hm, hk, a12, lda, s, hk, s, hk, T(-1));
+            strassenGemm(hm, hn, hk, s, hk, b22, ldb, p, hn, child, crossover, 0);
+            accumulate(c12, T(1));
+
+            // m4 = a22 * t4
+            strassenAdd(hk, hn, t, hn, b21, ldb, t, hn, T(-1));
+            strassenGemm(hm, hn, hk, a22, lda, t, hn, p, hn, child, crossover, 0);
+            accumulate(c21, T(-1));
+
+            // m7 = s3 * t3
+            strassenAdd(hm, hk, a11, lda, a21, lda, s, hk, T(-1));
+            strassenAdd(hk, hn, b22, ldb, b12, ldb, t, hn, T(-1));
+            strassenGemm(hm, hn, hk, s, hk, t, hn, p, hn, child, crossover, 0);
+            accumulate(c21, T(1));
+            accumulate(c22, T(1));
+        }
+
+        // odd dimensions are peeled off and fixed up with the blocked kernel
+        std::size_t me = 2 * hm;
+        std::size_t ne = 2 * hn;
+        std::size_t ke = 2 * hk;
+
+        if(k > ke) blockedGemm(false, false, me, ne, std::size_t(1), T(1), a + ke, lda, b + ke * ldb, ldb, c, ldc);
+        if(n > ne){
+            for(std::size_t i = 0; m > i; i++) c[i * ldc + ne] = T(0);
+            blockedGemm(false, false, m, std::size_t(1), k, T(1), a, lda, b + ne, ldb, c + ne, ldc);
+        }
+        if(m > me){
+            std::fill(c + me * ldc, c + me * ldc + ne, T(0));
+            blockedGemm(false, false, std::size_t(1), ne, k, T(1), a + me * lda, lda, b, ldb, c + me * ldc, ldc);
+        }
+    }
+
+    // Memory
+    inline std::size_t pageSize(){
+        #ifdef MATRIXCF_USE_PINNED
+        return sysconf(_SC_PAGESIZE);
+        #else
+        return 4096;
+        #endif
+    }
+
+    // the first lines of a block into cache ahead of a random access, the hardware prefetcher follows the rest
+    inline void prefetch(const void* p, std::size_t bytes){
+        #if defined(__GNUC__)
+        const char* c = static_cast<const char*>(p);
+        for(std::size_t k = 0; std::min<std::size_t>(bytes, 512) > k; k += 64) __builtin_prefetch(c + k);
+        #endif
+    }
+
+    // NUMA
+    inline std::vector<std::size_t> parseCpuList(const std::string& list){
+        std::vector<std::size_t> result;
+        std::stringstream s(list);
+        std::string range;
+
+        while(std::getline(s, range, ',')){
+            if(range.empty()) continue;
+
+            std::size_t dash = range.find('-');
+            std::size_t first = std::stoul(range.substr(0, dash));
+            std::size_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+            for(std::size_t i = first; last >= i; i++) result.push_back(i);
+        }
+        return result;
+    }
+
+    inline std::size_t numaNodes(){
+        #ifdef MATRIXCF_USE_NUMA
+        std::ifstream f("/sys/devices/system/node/online");
+        std::string list;
+        if(f >> list){
+            auto nodes = parseCpuList(list);
+            if(!nodes.empty()) return nodes.back() + 1;
+        }
+        #endif
+        return 1;
+    }
+
+    // node of the cpu the calling thread runs on
+    inline std::size_t numaNode(){
+        #ifdef MATRIXCF_USE_NUMA
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if(syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node;
+        #endif
+        return 0;
+    }
+
+    // pins OpenMP threads node by node, so the static schedule gives neighbouring
+    // threads (and their rows) the same node
+    inline void pinThreads(){
+        #ifdef MATRIXCF_USE_NUMA
+        cpu_set_t allowed;
+        if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+
+        std::size_t nodes = numaNodes();
+        std::vector<std::size_t> cpus;
+        for(std::size_t node = 0; nodes > node; node++){
+            std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if(!(f >> list)) continue;
+
+            for(std::size_t cpu : parseCpuList(list)){
+                if(CPU_SETSIZE > cpu && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            }
+        }
+        if(cpus.empty()) return;
+
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp parallel
+        #endif
+        {
+            std::size_t t = omp_get_thread_num();
+            std::size_t n = omp_get_num_threads();
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[t * cpus.size() / n], &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        #endif
+    }
+
+    // moves the pages of [addr, addr + bytes) to the given nodes, pages not touched yet get the policy
+    inline bool numaMove(const void* addr, std::size_t bytes, const std::vector<std::size_t>& nodes, PLACEMENT option){
+        #ifdef MATRIXCF_USE_NUMA
+        constexpr std::size_t BITS = 8 * sizeof(unsigned long);
+        unsigned long mask[4] = {};
+        for(std::size_t node : nodes){
+            if(4 * BITS > node) mask[node / BITS] |= 1UL << (node % BITS);
+        }
+
+        std::uintptr_t page = sysconf(_SC_PAGESIZE);
+        std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(addr) / page * page;
+        std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(addr) + bytes + page - 1) / page * page;
+        int mode = option == INTERLEAVE ? MPOL_INTERLEAVE : MPOL_BIND;
+
+        return syscall(SYS_mbind, begin, end - begin, mode, mask, 4 * BITS + 1, MPOL_MF_MOVE) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    // Compare (CPU)
+    // ULP distance maps the float bits onto a monotonic integer line
+    template<typename T>
+    std::uint64_t ulpDistance(const T& a, const T& b){
+        using I = typename std::conditional<sizeof(T) == 4, std::int32_t, std::int64_t>::type;
+        using U = typename std::make_unsigned<I>::type;
+
+        I x, y;
+        std::memcpy(&x, &a, sizeof(T));
+        std::memcpy(&y, &b, sizeof(T));
+        if(0 > x) x = std::numeric_limits<I>::min() - x;
+        if(0 > y) y = std::numeric_limits<I>::min() - y;
+
+        return x > y ? U(x) - U(y) : U(y) - U(x);
+    }
+
+    // |a - b| of two integers, the modular difference of the sign-extended values is exact
+    template<typename T>
+    std::uint64_t integerDistance(const T& a, const T& b){
+        return a > b ? std::uint64_t(a) - std::uint64_t(b) : std::uint64_t(b) - std::uint64_t(a);
+    }
+    template<typename T>
+    std::uint64_t integerMagnitude(const T& a){
+        if constexpr(std::is_signed<T>::value) return a < 0 ? std::uint64_t(0) - std::uint64_t(a) : std::uint64_t(a);
+        else return std::uint64_t(a);
+    }
+
+    template<typename T>
+    bool nearlyEqual(const T& a, const T& b, COMPARE option, double tolerance){
+        if(a == b) return true;
+        if(option == EXACT) return false;
+
+        if constexpr(std::is_floating_point<T>::value){
+            if(std::isnan(a) || std::isnan(b)) return false;
+
+            if(option == ULP){
+                if constexpr(sizeof(T) == 4 || sizeof(T) == 8) return tolerance >= double(ulpDistance(a, b));
+                else return std::abs(a - b) <= T(tolerance) * std::numeric_limits<T>::epsilon() * std::max(std::abs(a), std::abs(b));
+            }
+            if(option == ABSOLUTE) return std::abs(a - b) <= T(tolerance);
+            return std::abs(a - b) <= T(tolerance) * std::max(std::abs(a), std::abs(b));
+        } else {
+            // one ulp of an integer is 1; distances are exact in 64 bits, the equals kernel repeats the same steps
+            std::uint64_t d = integerDistance(a, b);
+            if(option == RELATIVE) return double(d) <= tolerance * double(std::max(integerMagnitude(a), integerMagnitude(b)));
+            return tolerance >= 0 && (tolerance >= 18446744073709551616.0 || std::uint64_t(tolerance) >= d);
+        }
+    }
+
+    // Hash (CPU)
+    // xxHash64 (Collet), a matrix hashes its row-major bytes in HASH_CHUNK pieces and folds the piece hashes in order,
+    // so pieces hash in parallel and appending rows only continues the fold
+    constexpr std::size_t HASH_CHUNK = 1 << 14;
+
+    constexpr std::uint64_t XXH_P1 = 0x9E3779B185EBCA87ULL;
+    constexpr std::uint64_t XXH_P2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr std::uint64_t XXH_P3 = 0x165667B19E3779F9ULL;
+    constexpr std::uint64_t XXH_P4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr std::uint64_t XXH_P5 = 0x27D4EB2F165667C5ULL;
+
+    inline std::uint64_t rotl64(std::uint64_t x, int r){
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline std::uint64_t xxhRound(std::uint64_t acc, std::uint64_t x){
+        return rotl64(acc + x * XXH_P2, 31) * XXH_P1;
+    }
+
+    inline std::uint64_t xxhMerge(std::uint64_t acc, std::uint64_t x){
+        return (acc ^ xxhRound(0, x)) * XXH_P1 + XXH_P4;
+    }
+
+    inline std::uint64_t xxhAvalanche(std::uint64_t x){
+        x = (x ^ (x >> 33)) * XXH_P2;
+        x = (x ^ (x >> 29)) * XXH_P3;
+        return x ^ (x >> 32);
+    }
+
+    // words are read in host order, the hashes match other xxHash64 implementations on little-endian hosts
+    inline std::uint64_t xxHash64(const void* data, std::size_t bytes, std::uint64_t seed = 0){
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + bytes;
+        std::uint64_t h = seed + XXH_P5;
+
+        if(bytes >= 32){
+            // four independent lanes per 32-byte stripe
+            std::uint64_t v[4] = {seed + XXH_P1 + XXH_P2, seed + XXH_P2, seed, seed - XXH_P1};
+            for(; end - p >= 32; p += 32){
+                std::uint64_t x[4];
+                std::memcpy(x, p, 32);
+                for(int l = 0; 4 > l; l++) v[l] = xxhRound(v[l], x[l]);
+            }
+
+            h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+            for(int l = 0; 4 > l; l++) h = xxhMerge(h, v[l]);
+        }
+
+        h += bytes;
+        for(; end - p >= 8; p += 8){
+            std::uint64_t x;
+            std::memcpy(&x, p, 8);
+            h = rotl64(h ^ xxhRound(0, x), 27) * XXH_P1 + XXH_P4;
+        }
+        if(end - p >= 4){
+            std::uint32_t x;
+            std::memcpy(&x, p, 4);
+            h = rotl64(h ^ (x * XXH_P1), 23) * XXH_P2 + XXH_P3;
+            p += 4;
+        }
+        for(; end > p; p++) h = rotl64(h ^ (*p * XXH_P5), 11) * XXH_P1;
+
+        return xxhAvalanche(h);
+    }
+
+    // running hash of rows appended block after block, the bytes after the last full chunk wait in tail
+    struct HashState{
+        std::uint64_t seed;
+        std::uint64_t fold;
+        std::size_t h = 0;
+        std::size_t w = 0;
+        std::size_t element = 0;
+        std::vector<unsigned char> tail;
+
+        explicit HashState(std::uint64_t seed = 0) : seed(seed), fold(seed + XXH_P5){}
+    };
+
+    inline void hashUpdate(HashState& s, const void* data, std::size_t bytes){
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+
+        if(!s.tail.empty()){
+            std::size_t take = std::min(bytes, HASH_CHUNK - s.tail.size());
+            s.tail.insert(s.tail.end(), p, p + take);
+            p += take;
+            bytes -= take;
+
+            if(HASH_CHUNK > s.tail.size()) return;
+            s.fold = xxhMerge(s.fold, xxHash64(s.tail.data(), HASH_CHUNK, s.seed));
+            s.tail.clear();
+        }
+
+        // full chunks in batches, so the piece hashes of a large matrix aren't all kept at once
+        constexpr std::size_t BATCH = 1 << 12;
+        std::size_t chunks = bytes / HASH_CHUNK;
+        std::vector<std::uint64_t> hashes(std::min(chunks, BATCH));
+
+        for(std::size_t first = 0; chunks > first; first += BATCH){
+            std::size_t count = std::min(BATCH, chunks - first);
+            const unsigned char* batch = p + first * HASH_CHUNK;
+
+            parallelFor(0, count, 8, [&](std::size_t begin, std::size_t end){
+                for(std::size_t c = begin; end > c; c++) hashes[c] = xxHash64(batch + c * HASH_CHUNK, HASH_CHUNK, s.seed);
+            });
+            for(std::size_t c = 0; count > c; c++) s.fold = xxhMerge(s.fold, hashes[c]);
+        }
+
+        s.tail.assign(p + chunks * HASH_CHUNK, p + bytes);
+    }
+
+    // the state itself is unchanged, more rows can follow
+    inline std::uint64_t hashDigest(const HashState& s){
+        std::uint64_t fold = s.fold;
+        if(!s.tail.empty()) fold = xxhMerge(fold, xxHash64(s.tail.data(), s.tail.size(), s.seed));
+
+        fold = xxhMerge(fold, s.h);
+        fold = xxhMerge(fold, s.w);
+        fold = xxhMerge(fold, s.element);
+        return xxhAvalanche(fold);
+    }
+
+    // Compression (CPU)
+    // Blosc-style byte shuffle: byte k of every element goes to plane k, so the slowly changing high bytes of a smooth
+    // field line up into runs the codec finds
+    template<std::size_t E, std::size_t... K>
+    void shuffleBytes(const unsigned char* src, unsigned char* dst, std::size_t n, std::index_sequence<K...>){
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp simd
+        #endif
+        for(std::size_t i = 0; n > i; i++) ((dst[K * n + i] = src[i * E + K]), ...);
+    }
+
+    template<std::size_t E, std::size_t... K>
+    void unshuffleBytes(const unsigned char* src, unsigned char* dst, std::size_t n, std::index_sequence<K...>){
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp simd
+        #endif
+        for(std::size_t i = 0; n > i; i++) ((dst[i * E + K] = src[K * n + i]), ...);
+    }
+
+    // n elements of E bytes, the unrolled byte copies let the loops vectorize
+    template<std::size_t E>
+    void shuffleBytes(const unsigned char* src, unsigned char* dst, std::size_t n){
+        shuffleBytes<E>(src, dst, n, std::make_index_sequence<E>());
+    }
+
+    template<std::size_t E>
+    void unshuffleBytes(const unsigned char* src, unsigned char* dst, std::size_t n){
+        unshuffleBytes<E>(src, dst, n, std::make_index_sequence<E>());
+    }
+
+    // differences of neighbouring elements as unsigned words of N bytes, they are small for smooth data and leave the
+    // high byte planes mostly zero or all ones
+    template<std::size_t N>
+    using DeltaWord = typename std::conditional<N == 1, std::uint8_t, typename std::conditional<N == 2, std::uint16_t,
+        typename std::conditional<N == 4, std::uint32_t, std::uint64_t>::type>::type>::type;
+
+    template<std::size_t N>
+    void deltaEncode(const unsigned char* src, unsigned char* dst, std::size_t n){
+        static_assert(sizeof(DeltaWord<N>) == N, "delta coding needs 1, 2, 4 or 8-byte elements");
+
+        DeltaWord<N> last = 0;
+        for(std::size_t i = 0; n > i; i++){
+            DeltaWord<N> x;
+            std::memcpy(&x, src + i * N, N);
+            DeltaWord<N> d = x - last;
+            std::memcpy(dst + i * N, &d, N);
+            last = x;
+        }
+    }
+
+    template<std::size_t N>
+    void deltaDecode(unsigned char* data, std::size_t n){
+        static_assert(sizeof(DeltaWord<N>) == N, "delta coding needs 1, 2, 4 or 8-byte elements");
+
+        DeltaWord<N> last = 0;
+        for(std::size_t i = 0; n > i; i++){
+            DeltaWord<N> d;
+            std::memcpy(&d, data + i * N, N);
+            last += d;
+            std::memcpy(data + i * N, &last, N);
+        }
+    }
+
+    // LZ4 block format (Collet): sequences of a token (literal count << 4 | match length - 4), length bytes of 255 for
+    // counts from 15 on, the literals and a 2-byte little-endian match offset; the last sequence has only literals
+    constexpr std::size_t LZ_MIN_MATCH = 4;
+    constexpr std::size_t LZ_WINDOW = 65535;
+
+    inline std::size_t lzBound(std::size_t bytes){
+        return bytes + bytes / 255 + 16;
+    }
+
+    inline unsigned char* lzLength(unsigned char* dst, std::size_t length){
+        for(; length >= 255; length -= 255) *dst++ = 255;
+        *dst++ = static_cast<unsigned char>(length);
+        return dst;
+    }
+
+    // greedy matches over a hash table of the last position of every 4-byte prefix, dst needs lzBound(bytes)
+    inline std::size_t lzCompress(const unsigned char* src, std::size_t bytes, unsigned char* dst){
+        constexpr int TABLE_LOG = 14;
+        // like LZ4, the last 12 bytes don't start a match and the last 5 stay literals
+        constexpr std::size_t MATCH_LIMIT = 12;
+        constexpr std::size_t LAST_LITERALS = 5;
+
+        std::vector<std::uint32_t> table(std::size_t(1) << TABLE_LOG, 0);
+        unsigned char* out = dst;
+        std::size_t anchor = 0;
+        std::size_t misses = 0;
+
+        auto sequence = [&](std::size_t literals, const unsigned char* first){
+            *out = static_cast<unsigned char>(std::min<std::size_t>(literals, 15) << 4);
+            unsigned char* token = out++;
+            if(literals >= 15) out = lzLength(out, literals - 15);
+            std::memcpy(out, first, literals);
+            out += literals;
+            return token;
+        };
+
+        for(std::size_t i = 0; bytes > MATCH_LIMIT && bytes - MATCH_LIMIT > i;){
+            std::uint32_t prefix;
+            std::memcpy(&prefix, src + i, 4);
+            std::uint32_t slot = (prefix * 2654435761U) >> (32 - TABLE_LOG);
+            std::size_t candidate = table[slot];
+            table[slot] = static_cast<std::uint32_t>(i);
+
+            if(candidate >= i || i - candidate > LZ_WINDOW || std::memcmp(src + candidate, src + i, 4) != 0){
+                // steps grow on incompressible stretches
+                i += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            // 8 bytes at a time, then bytes up to the first difference
+            std::size_t length = LZ_MIN_MATCH;
+            std::size_t limit = bytes - LAST_LITERALS - i;
+            for(; limit >= length + 8; length += 8){
+                std::uint64_t a, b;
+                std::memcpy(&a, src + candidate + length, 8);
+                std::memcpy(&b, src + i + length, 8);
+                if(a != b) break;
+            }
+            while(limit > length && src[candidate + length] == src[i + length]) length++;
+
+            unsigned char* token = sequence(i - anchor, src + anchor);
+            std::size_t offset = i - candidate;
+            *out++ = static_cast<unsigned char>(offset);
+            *out++ = static_cast<unsigned char>(offset >> 8);
+
+            std::size_t extra = length - LZ_MIN_MATCH;
+            *token |= static_cast<unsigned char>(std::min<std::size_t>(extra, 15));
+            if(extra >= 15) out = lzLength(out, extra - 15);
+
+            i += length;
+            anchor = i;
+        }
+
+        sequence(bytes - anchor, src + anchor);
+        return out - dst;
+    }
+
+    // false for input that isn't a block of exactly raw bytes, nothing outside dst[0, raw) is written
+    inline bool lzDecompress(const unsigned char* src, std::size_t bytes, unsigned char* dst, std::size_t raw){
+        const unsigned char* in = src;
+        const unsigned char* in_end = src + bytes;
+        unsigned char* out = dst;
+        unsigned char* out_end = dst + raw;
+
+        auto length = [&](std::size_t& count){
+            for(unsigned char b = 255; b == 255;){
+                if(in == in_end) return false;
+                b = *in++;
+                count += b;
+            }
+            return true;
+        };
+
+        // 8-byte copies, which may run up to 8 bytes past n, forward over overlaps of at least 8 bytes
+        auto wildCopy = [](unsigned char* d, const unsigned char* s, std::size_t n){
+            for(std::size_t k = 0; n > k; k += 8) std::memcpy(d + k, s + k, 8);
+        };
+
+        while(in_end > in){
+            std::size_t token = *in++;
+
+            // short literals and a short match far enough back, with room for whole 16 and 24-byte copies
+            if(token < 0xF0 && (token & 15) != 15 && in_end - in >= 32 && out_end - out >= 40){
+                std::size_t literals = token >> 4;
+                std::memcpy(out, in, 16);
+                in += literals;
+                out += literals;
+
+                std::size_t offset = in[0] | std::size_t(in[1]) << 8;
+                in += 2;
+                std::size_t match = (token & 15) + LZ_MIN_MATCH;
+                if(offset >= 8 && offset <= std::size_t(out - dst)){
+                    wildCopy(out, out - offset, match);
+                    out += match;
+                    continue;
+                }
+
+                // back to the general match copy
+                in -= 2;
+                token &= 15;
+            }
+
+            std::size_t literals = token >> 4;
+            if(literals == 15 && !length(literals)) return false;
+            if(std::size_t(in_end - in) < literals || std::size_t(out_end - out) < literals) return false;
+
+            if(std::size_t(in_end - in) >= literals + 8 && std::size_t(out_end - out) >= literals + 8) wildCopy(out, in, literals);
+            else std::memcpy(out, in, literals);
+            in += literals;
+            out += literals;
+
+            if(in == in_end) break;
+
+            if(2 > in_end - in) return false;
+            std::size_t offset = in[0] | std::size_t(in[1]) << 8;
+            in += 2;
+            if(offset == 0 || offset > std::size_t(out - dst)) return false;
+
+            std::size_t match = token & 15;
+            if(match == 15 && !length(match)) return false;
+            match += LZ_MIN_MATCH;
+            if(std::size_t(out_end - out) < match) return false;
+
+            const unsigned char* from = out - offset;
+            if(offset >= 8 && std::size_t(out_end - out) >= match + 8) wildCopy(out, from, match);
+            else for(std::size_t k = 0; match > k; k++) out[k] = from[k];
+            out += match;
+        }
+
+        return out == out_end;
+    }
+
+    // Text (CPU)
+    template<typename T>
+    char* formatValue(char* first, char* last, const T& value, std::chars_format format, int precision){
+        if constexpr(std::is_same<T, bool>::value){
+            *first = value ? '1' : '0';
+            return first + 1;
+        } else if constexpr(std::is_floating_point<T>::value){
+            // negative precision gives the shortest representation that round-trips
+            if(0 > precision) return std::to_chars(first, last, value).ptr;
+            return std::to_chars(first, last, value, format, precision).ptr;
+        } else return std::to_chars(first, last, value).ptr;
+    }
+
+    template<typename T>
+    const char* parseValue(const char* first, const char* last, T& value){
+        if(last > first && *first == '+') first++;
+
+        if constexpr(std::is_same<T, bool>::value){
+            int temp = 0;
+            auto [ptr, ec] = std::from_chars(first, last, temp);
+            value = temp != 0;
+            return ec == std::errc() ? ptr : nullptr;
+        } else {
+            auto [ptr, ec] = std::from_chars(first, last, value);
+            return ec == std::errc() ? ptr : nullptr;
+        }
+    }
+
+    inline const char* skipBlank(const char* first, const char* last, char delimiter){
+        while(last > first && (*first == ' ' || *first == '\t') && *first != delimiter) first++;
+        return first;
+    }
+
+    // formats rows in parallel chunks and joins them into one buffer
+    template<typename T>
+    std::string formatRows(const T* data, std::size_t h, std::size_t w, const std::string& open, const std::string& delimiter, const std::string& close, std::chars_format format, int precision){
+        constexpr std::size_t CHUNK = 1 << 16;
+
+        std::size_t bound = 64 + std::max(precision, 0);
+        if(format == std::chars_format::fixed) bound += std::numeric_limits<T>::max_exponent10;
+
+        std::size_t rows = std::max<std::size_t>(1, CHUNK / (w + 1));
+        std::size_t count = (h + rows - 1) / rows;
+        std::vector<std::string> chunks(count);
+
+        parallelFor(0, count, 1, [&](std::size_t first, std::size_t last){
+            std::vector<char> buffer(bound);
+
+            for(std::size_t c = first; last > c; c++){
+                std::string& out = chunks[c];
+                for(std::size_t i = c * rows; std::min(h, (c + 1) * rows) > i; i++){
+                    out += open;
+                    for(std::size_t j = 0; w > j; j++){
+                        if(j > 0) out += delimiter;
+                        char* end = formatValue(buffer.data(), buffer.data() + bound, data[i * w + j], format, precision);
+                        out.append(buffer.data(), end);
+                    }
+                    out += close;
+                }
+            }
+        });
+
+        std::vector<std::size_t> offsets(count + 1, 0);
+        for(std::size_t c = 0; count > c; c++) offsets[c + 1] = offsets[c] + chunks[c].size();
+
+        std::string result(offsets[count], '\0');
+
+        parallelFor(0, count, 1, [&](std::size_t first, std::size_t last){
+            for(std::size_t c = first; last > c; c++) std::copy(chunks[c].begin(), chunks[c].end(), result.begin() + offsets[c]);
+        });
+
+        return result;
+    }
+
+    // Binary
+    // file header, hash is the content hash of the elements with seed 0; RAW elements follow in host byte order,
+    // otherwise a table of blocks of block_rows rows follows, each block byte-shuffled (after delta coding for
+    // DELTA_SHUFFLE_LZ) and LZ-compressed on its own, or kept plain when that doesn't shrink it, so blocks decode in
+    // parallel and a range of rows decodes only its blocks; version 1 files have zero in place of codec and block_rows,
+    // so they read as RAW
+    struct BinaryHeader{
+        char magic[4] = {'M', 'C', 'F', 'B'};
+        std::uint32_t version = 2;
+        std::uint32_t element = 0;
+        std::uint32_t kind = 0;
+        std::uint64_t h = 0;
+        std::uint64_t w = 0;
+        std::uint64_t hash = 0;
+        std::uint32_t codec = RAW;
+        std::uint32_t block_rows = 0;
+    };
+    static_assert(sizeof(BinaryHeader) == 48, "binary header must not be padded");
+
+    // offset after the table and stored size of a block, hash is xxHash64 of its plain elements
+    struct BinaryBlock{
+        std::uint64_t offset = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t hash = 0;
+    };
+
+    // 'b' bool, 'f' floating point, 'i' signed and 'u' unsigned elements
+    template<typename T>
+    constexpr std::uint32_t binaryKind(){
+        if constexpr(std::is_same<T, bool>::value) return 'b';
+        else if constexpr(std::is_floating_point<T>::value) return 'f';
+        else if constexpr(std::is_signed<T>::value) return 'i';
+        else return 'u';
+    }
+
+	// Matrix API
+    // L is the layout of the elements, everything below is the row-major Mat, other layouts are in the Layout matrix API
+    template<typename T, typename L = RowMajor>
+    class Mat;
+
+    template<typename T>
+    class Mat<T, RowMajor>{
+        template<typename U, typename V>
+        friend class Mat;
+        template<typename U>
+        friend class SymMat;
+        template<typename U>
+        friend class TriMat;
+    private:
+        std::size_t h, w, total_size;
+        array<T> arr;
+        bool ref;
+
+        // elements behind arr, h * w of them are in use and the device buffer has the same size
+        std::size_t capacity = 0;
+
+        // page-aligned locked block behind arr in PINNED storage
+        STORAGE storage = PAGEABLE;
+        T* pinned = nullptr;
+        std::size_t pinned_bytes = 0;
+
+        void allocate(std::size_t, STORAGE);
+        void regrow(std::size_t);
+        void clear();
+        std::string getTypeName() const;
+        void requireMatrixShape(const Mat<T>&, std::size_t, std::size_t, const std::string&, bool is_result = false) const;
+        void requireMatrixH(std::size_t, std::size_t, const std::string&) const;
+        void requireMatrixW(std::size_t, std::size_t, const std::string&) const;
+        void requireTotalSize(const Mat<T>&, std::size_t, const std::string&) const;
+        void requireFloatingPoint(const std::string&) const;
+        static void requireImmediate(const ecl::Computer&, const std::string&);
+        std::pair<std::size_t, std::size_t> requireBroadcastShape(const Mat<T>&, const std::string&) const;
+        std::string getBroadcastIndex(std::size_t, std::size_t) const;
+        std::string getLiteral(const T&) const;
+
+        static BinaryHeader readBinaryHeader(std::ifstream&, const std::string&);
+        static void readBinaryBlocks(std::ifstream&, const BinaryHeader&, std::size_t, std::size_t, T*, const std::string&);
+        static std::string getXxHash();
+
+        template<typename F>
+        void fusedGemm(const Mat<T>&, Mat<T>&, const Mat<T>&, const F&, const T&, const T&, TRANSPOSE) const;
+        void fusedGemm(const Mat<T>&, Mat<T>&, const Mat<T>&, const std::string&, ecl::Computer&, const T&, const T&, TRANSPOSE, ecl::EXEC) const;
+
+        template<typename F>
+        void math(Mat<T>&, const F&, const std::string&) const;
+        std::string getNative(const std::string&, ACCURACY) const;
+
+        template<typename A, typename F, typename M>
+        void groupReduce(REDUCE, std::vector<A>&, const A&, const F&, const M&) const;
+        template<typename F>
+        void groupMap(REDUCE, const F&) const;
+        template<bool WRITE>
+        void expSum(REDUCE, ACCURACY, std::vector<T>&, std::vector<T>&, T*) const;
+        std::pair<std::size_t, std::size_t> getGroupShape(REDUCE) const;
+        std::string getGroupBase(REDUCE) const;
+        std::string getGroupLoop(REDUCE) const;
+        std::string getGroupIndex(REDUCE) const;
+        std::size_t getGroupCount(REDUCE) const;
+        std::shared_ptr<Mat<T>> groupReduce(REDUCE, std::size_t, const std::string&, const std::string&, const std::string&, const std::string&, ecl::Computer&) const;
+        std::shared_ptr<Mat<T>> expSum(REDUCE, ACCURACY, ecl::Computer&) const;
+        std::shared_ptr<Mat<T>> groupNorm(REDUCE, NORM, ecl::Computer&) const;
+
+        void requireSelection(std::size_t, REDUCE, const std::string&) const;
+        std::string getOrderBefore(ORDER) const;
+        void groupArg(Mat<std::size_t>&, REDUCE, ORDER, const std::string&) const;
+        void groupArg(Mat<std::size_t>&, ecl::Computer&, REDUCE, ORDER, const std::string&, ecl::EXEC) const;
+        template<typename F>
+        void groupSort(REDUCE, ORDER, ecl::Computer&, const F&) const;
+
+        template<typename I>
+        void requireIndex(const Mat<I>&, std::size_t, const std::string&) const;
+        std::string getAtomicAdd(const std::string&) const;
+
+        void requireConvolution(const Conv2D&, std::size_t, const std::string&) const;
+        std::string getConvolutionTap(const Conv2D&) const;
+
+        template<std::size_t WORDS, typename F>
+        void randomBlocks(std::uint64_t, const F&);
+        std::uint64_t getRandomRange(DISTRIBUTION, double, double) const;
+
+		void copy(const Mat<T>&);
+		void move(Mat<T>&);
+    public:
+        Mat();
+        Mat(std::size_t, std::size_t, STORAGE storage = PAGEABLE);
+        Mat(T*, std::size_t, std::size_t);
+
+        Mat(const Mat<T>&);
+        Mat<T>& operator=(const Mat<T>&);
+
+        Mat(Mat<T>&&);
+        Mat<T>& operator=(Mat<T>&&);
+
+        array<T>& getArray();
+
+        const array<T>& getConstArray() const;
+        const std::size_t getH() const;
+        const std::size_t getW() const;
+        const std::size_t getTotalSize() const;
+
+        std::size_t totalMemoryUsed() const;
+        bool isRef() const;
+        STORAGE getStorage() const;
+        std::size_t getCapacity() const;
+
+        const T& getE(std::size_t, std::size_t) const;
+        void setE(const T&, std::size_t, std::size_t);
+
+        T* operator[](std::size_t);
+        operator T*();
+        operator const T*() const;
+
+        void place(PLACEMENT option = PARTITION);
+
+        void send(ecl::Computer&, ecl::EXEC sync = SYNC);
+        void receive(ecl::Computer&, ecl::EXEC sync = SYNC);
+        void release(ecl::Computer&, ecl::EXEC sync = SYNC);
+        void grab(ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        // builds the built-in kernels for h x w operands before the first real call
+        static void warmup(ecl::Computer&, std::size_t, std::size_t);
+
+        void save(const std::string&) const;
+        static Mat<T> load(const std::string&);
+        void saveCSV(const std::string&, char delimiter = ',') const;
+        static Mat<T> loadCSV(const std::string&, char delimiter = ',');
+
+        // a BinaryHeader and the elements, RAW or compressed in blocks of block_rows rows (0 picks about 256 KB), where
+        // DELTA_SHUFFLE_LZ suits smooth data; loading checks the content hash or the hashes of the decoded blocks,
+        // loadRows reads count rows from first on and loadHash only the header, so a cached result can be matched
+        // against hash() without loading it
+        void saveBinary(const std::string&, CODEC option = RAW, std::size_t block_rows = 0) const;
+        static Mat<T> loadBinary(const std::string&);
+        static Mat<T> loadRows(const std::string&, std::size_t, std::size_t);
+        static std::uint64_t loadHash(const std::string&);
+
+        template<typename U>
+        friend std::ostream& operator<<(std::ostream&, const Mat<U>&);
+        template<typename U>
+        friend ecl::Computer& operator<<(ecl::Computer&, Mat<U>&);
+        template<typename U>
+        friend ecl::Computer& operator>>(ecl::Computer&, Mat<U>&);
+
+        // methods (extra)
+        bool equals(const Mat<T>&, COMPARE option = EXACT, double tolerance = 0) const;
+        bool equals(const Mat<T>&, ecl::Computer&, COMPARE option = EXACT, double tolerance = 0) const;
+
+        // content hash of the shape, the element size and the row-major bytes, the device computes the same value;
+        // hashRows continues a state, so the state of A updated by X.hashRows gives the hash of A after appendRows(X)
+        std::uint64_t hash(std::uint64_t seed = 0) const;
+        std::uint64_t hash(ecl::Computer&, std::uint64_t seed = 0) const;
+        void hashRows(HashState&) const;
+
+        void reshape(std::size_t, std::size_t);
+        void ravel(RAVEL option = ROW);
+
+        // capacity in elements, growing past it moves the data once into a new buffer; on a computer the matrix is
+        // received, released and sent again with the new capacity, so later growth up to it stays on the device
+        void reserve(std::size_t);
+        void reserve(std::size_t, ecl::Computer&);
+        void shrinkToFit();
+
+        // keeps the top-left block in place, new elements are zero; a view gets its own buffer first
+        void resize(std::size_t, std::size_t);
+
+        // methods (mutable)
+        void foreach(const std::function<void(std::size_t, std::size_t)>&);
+        void foreach(const std::string&, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void gen(const std::function<T(std::size_t, std::size_t)>&);
+        void gen(const std::string&, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        // counter based (Philox4x32-10), element k only depends on the seed and k, so every thread count and the device
+        // give the same bits whatever the compiler flags (multiply-adds are explicit fma on both):
+        // UNIFORM is in [a, b), NORMAL has mean a and deviation b, BERNOULLI is 1 with probability a
+        void random(std::uint64_t, DISTRIBUTION distribution = UNIFORM, double a = 0, double b = 1);
+        void random(std::uint64_t, ecl::Computer&, DISTRIBUTION distribution = UNIFORM, double a = 0, double b = 1, ecl::EXEC sync = SYNC);
+
+        void full(const T&);
+        void full(const T&, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void zeros();
+        void zeros(ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void ones();
+        void ones(ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void eye(const T& value = T(1));
+        void eye(const T& value, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void hstack(const Mat<T>&, const Mat<T>&);
+        void hstack(const Mat<T>&, const Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void hstack(const std::vector<const Mat<T>*>&);
+        
+        void vstack(const Mat<T>&, const Mat<T>&);
+        void vstack(const Mat<T>&, const Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        void vstack(const std::vector<const Mat<T>*>&);
+
+        void cpy(const Mat<T>&);
+        void view(Mat<T>&);
+
+        // in-place updates, nothing of the size of the matrix is allocated:
+        // ger adds alpha * u * v^T for vectors of h and w elements, rankUpdate alpha * U * V^T for U of h x k and V of w x k
+        void ger(const Mat<T>&, const Mat<T>&, const T& alpha = 1);
+        void ger(const Mat<T>&, const Mat<T>&, ecl::Computer&, const T& alpha = 1, ecl::EXEC sync = SYNC);
+
+        void rankUpdate(const Mat<T>&, const Mat<T>&, const T& alpha = 1);
+        void rankUpdate(const Mat<T>&, const Mat<T>&, ecl::Computer&, const T& alpha = 1, ecl::EXEC sync = SYNC);
+
+        // adds alpha * U * U^T to one triangle (with the diagonal) of a square matrix, the other one isn't touched
+        void syrk(const Mat<T>&, const T& alpha = 1, TRIANGLE option = LOWER);
+        void syrk(const Mat<T>&, ecl::Computer&, const T& alpha = 1, TRIANGLE option = LOWER, ecl::EXEC sync = SYNC);
+
+        // appends the rows of a matrix of w columns or the columns of a matrix of h rows, an empty matrix takes any shape;
+        // the capacity at least doubles when it runs out, so appending is amortized O(appended elements)
+        void appendRows(const Mat<T>&);
+        void appendRows(const Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC);
+        void appendColumns(const Mat<T>&);
+        
+        // higher-order methods (immutable)
+        void map(const std::function<T(const T&)>&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void map(const std::string&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void transform(const Mat<T>&, const std::function<T(const T&, const T&)>&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void transform(const Mat<T>&, const std::string&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        // methods (immutable)
+        void transpose(Mat<T>&) const;
+        void transpose(Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void reduce(Mat<T>&, REDUCE option = FULL, TRANSPOSE transpose_option = NONE) const;
+        void reduce(Mat<T>&, ecl::Computer&, REDUCE option = FULL, TRANSPOSE transpose_option = NONE, ecl::EXEC sync = SYNC) const;
+
+        T reduce() const;
+		T mreduce(const std::function<T(const T&)>&) const;
+
+        void add(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void add(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void sub(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void sub(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void hadamard(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void hadamard(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void mul(const Mat<T>&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void mul(const Mat<T>&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void mul(const T&, Mat<T>&, TRANSPOSE option = NONE) const;
+        void mul(const T&, Mat<T>&, ecl::Computer&, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void strassen(const Mat<T>&, Mat<T>&, std::size_t crossover = 512) const;
+
+        // result = epilogue(alpha * op(A) * op(X) + beta * result + bias), an empty bias matrix means no bias
+        void gemm(const Mat<T>&, Mat<T>&, const T& alpha = 1, const T& beta = 0, TRANSPOSE option = NONE) const;
+        void gemm(const Mat<T>&, Mat<T>&, ecl::Computer&, const T& alpha = 1, const T& beta = 0, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void gemm(const Mat<T>&, Mat<T>&, const Mat<T>&, ACTIVATION activation = IDENTITY, const T& alpha = 1, const T& beta = 0, TRANSPOSE option = NONE) const;
+        void gemm(const Mat<T>&, Mat<T>&, const Mat<T>&, ecl::Computer&, ACTIVATION activation = IDENTITY, const T& alpha = 1, const T& beta = 0, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void gemm(const Mat<T>&, Mat<T>&, const Mat<T>&, const std::function<T(const T&)>&, const T& alpha = 1, const T& beta = 0, TRANSPOSE option = NONE) const;
+        void gemm(const Mat<T>&, Mat<T>&, const Mat<T>&, const std::string&, ecl::Computer&, const T& alpha = 1, const T& beta = 0, TRANSPOSE option = NONE, ecl::EXEC sync = SYNC) const;
+
+        void hsplit(Mat<T>&, Mat<T>&) const;
+        void hsplit(Mat<T>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void vsplit(Mat<T>&, Mat<T>&) const;
+        void vsplit(Mat<T>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        // methods (math)
+        // FAST runs vectorized polynomials on cpu (ulp bounds at Math (CPU)) and native_ built-ins on the device for float,
+        // which OpenCL leaves without an accuracy bound (tested only to 1e-3 on a computer), so take PRECISE where ulp matter;
+        // PRECISE keeps the c++ library on cpu and the OpenCL bounds on the device (float exp 3, log 3, tanh 5, pow 16 ulp)
+        void exp(Mat<T>&, ACCURACY accuracy = PRECISE) const;
+        void exp(Mat<T>&, ecl::Computer&, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        void log(Mat<T>&, ACCURACY accuracy = PRECISE) const;
+        void log(Mat<T>&, ecl::Computer&, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        void sigmoid(Mat<T>&, ACCURACY accuracy = PRECISE) const;
+        void sigmoid(Mat<T>&, ecl::Computer&, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        void tanh(Mat<T>&, ACCURACY accuracy = PRECISE) const;
+        void tanh(Mat<T>&, ecl::Computer&, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        void pow(const T&, Mat<T>&, ACCURACY accuracy = PRECISE) const;
+        void pow(const T&, Mat<T>&, ecl::Computer&, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        // methods (rows and columns)
+        // the option picks the groups as in reduce: every row for COLUMNS, every column for ROWS, all elements for FULL,
+        // results per group are h x 1, 1 x w or 1 x 1; the device folds chunks of every group in parallel and merges them
+        void softmax(Mat<T>&, REDUCE option = COLUMNS, ACCURACY accuracy = PRECISE) const;
+        void softmax(Mat<T>&, ecl::Computer&, REDUCE option = COLUMNS, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        void logsumexp(Mat<T>&, REDUCE option = COLUMNS, ACCURACY accuracy = PRECISE) const;
+        void logsumexp(Mat<T>&, ecl::Computer&, REDUCE option = COLUMNS, ACCURACY accuracy = PRECISE, ecl::EXEC sync = SYNC) const;
+
+        // mean and population variance in one pass
+        void moments(Mat<T>&, Mat<T>&, REDUCE option = COLUMNS) const;
+        void moments(Mat<T>&, Mat<T>&, ecl::Computer&, REDUCE option = COLUMNS, ecl::EXEC sync = SYNC) const;
+
+        void norm(Mat<T>&, REDUCE option = COLUMNS, NORM norm = L2) const;
+        void norm(Mat<T>&, ecl::Computer&, REDUCE option = COLUMNS, NORM norm = L2, ecl::EXEC sync = SYNC) const;
+
+        // divides every group by its norm, zero groups stay zero
+        void normalize(Mat<T>&, REDUCE option = COLUMNS, NORM norm = L2) const;
+        void normalize(Mat<T>&, ecl::Computer&, REDUCE option = COLUMNS, NORM norm = L2, ecl::EXEC sync = SYNC) const;
+
+        // indices inside the group: columns for COLUMNS, rows for ROWS, row-major positions for FULL; NaN is above every
+        // number and ties go to the lower index
+        void argmax(Mat<std::size_t>&, REDUCE option = COLUMNS) const;
+        void argmax(Mat<std::size_t>&, ecl::Computer&, REDUCE option = COLUMNS, ecl::EXEC sync = SYNC) const;
+
+        void argmin(Mat<std::size_t>&, REDUCE option = COLUMNS) const;
+        void argmin(Mat<std::size_t>&, ecl::Computer&, REDUCE option = COLUMNS, ecl::EXEC sync = SYNC) const;
+
+        // indices of the first k elements of every group in order, h x k for COLUMNS, k x w for ROWS and 1 x k for FULL;
+        // a heap of k per group on cpu, an insertion list per work-item on the device
+        void topk(std::size_t, Mat<std::size_t>&, REDUCE option = COLUMNS, ORDER order = DESCENDING) const;
+        void topk(std::size_t, Mat<std::size_t>&, ecl::Computer&, REDUCE option = COLUMNS, ORDER order = DESCENDING, ecl::EXEC sync = SYNC) const;
+
+        // the whole order of every group, argsort places indices where sort places values; the device runs a bitonic
+        // network over every group padded to a power of two
+        void argsort(Mat<std::size_t>&, REDUCE option = COLUMNS, ORDER order = ASCENDING) const;
+        void argsort(Mat<std::size_t>&, ecl::Computer&, REDUCE option = COLUMNS, ORDER order = ASCENDING, ecl::EXEC sync = SYNC) const;
+
+        void sort(Mat<T>&, REDUCE option = COLUMNS, ORDER order = ASCENDING) const;
+        void sort(Mat<T>&, ecl::Computer&, REDUCE option = COLUMNS, ORDER order = ASCENDING, ecl::EXEC sync = SYNC) const;
+
+        // rows or columns picked by the n = getTotalSize() integers of an index matrix of any shape: gather writes an
+        // n x w or h x n result, scatterAdd adds alpha times the rows or columns of an n x w or h x n matrix at them and
+        // repeated indices add up; the cpu throws on an index out of range, a computer skips it and leaves the row or column
+        // it would have written as it was; device scatters use atomics in no fixed order
+        template<typename I>
+        void gatherRows(const Mat<I>&, Mat<T>&) const;
+        template<typename I>
+        void gatherRows(const Mat<I>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        template<typename I>
+        void gatherColumns(const Mat<I>&, Mat<T>&) const;
+        template<typename I>
+        void gatherColumns(const Mat<I>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        template<typename I>
+        void scatterAddRows(const Mat<I>&, const Mat<T>&, const T& alpha = 1);
+        template<typename I>
+        void scatterAddRows(const Mat<I>&, const Mat<T>&, ecl::Computer&, const T& alpha = 1, ecl::EXEC sync = SYNC);
+
+        template<typename I>
+        void scatterAddColumns(const Mat<I>&, const Mat<T>&, const T& alpha = 1);
+        template<typename I>
+        void scatterAddColumns(const Mat<I>&, const Mat<T>&, ecl::Computer&, const T& alpha = 1, ecl::EXEC sync = SYNC);
+
+        // methods (images)
+        // the matrix is an image of h channels, see Conv2D; conv2d multiplies the filters by im2col panels built on the
+        // fly, so the h * kernel_h * kernel_w x output_h * output_w buffer is never stored
+        void im2col(const Conv2D&, Mat<T>&) const;
+        void im2col(const Conv2D&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        // the adjoint of im2col: overlapping columns are summed back into the image
+        void col2im(const Conv2D&, Mat<T>&) const;
+        void col2im(const Conv2D&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void conv2d(const Mat<T>&, Mat<T>&, const Conv2D&) const;
+        void conv2d(const Mat<T>&, Mat<T>&, const Conv2D&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        // methods (linear algebra)
+        void lu(Mat<T>&, Mat<std::size_t>&) const;
+        void lu(Mat<T>&, Mat<std::size_t>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void cholesky(Mat<T>&) const;
+        void cholesky(Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void qr(Mat<T>&, Mat<T>&) const;
+
+        void solveTriangular(const Mat<T>&, Mat<T>&, TRIANGLE option = LOWER, bool unit_diagonal = false) const;
+        void solve(const Mat<T>&, Mat<T>&) const;
+
+        ~Mat();
+    };
+
+    // Command list
+    // records the kernels of Mat ops on one computer instead of launching them: shapes are checked and programs are
+    // built once while recording, run() then enqueues the kernels back to back without host synchronization.
+    // The matrices must outlive the list and keep their shapes, transfers (send, receive) aren't recorded
+    class CommandList{
+    private:
+        struct Command{
+            ecl::Program* prog;
+            ecl::Kernel kernel;
+            decltype(ecl::Frame::args) args;
+            std::vector<std::size_t> global;
+            std::shared_ptr<const void> keep;
+        };
+
+        ecl::Computer* video;
+        std::vector<Command> commands;
+
+        static CommandList*& getActive();
+
+        // launches every command on a single work item, so the computer builds the programs without the full-size work;
+        // the results are wrong, only warmup uses it, on matrices of its own
+        void build();
+
+        template<typename T, typename L>
+        friend class Mat;
+    public:
+        CommandList(ecl::Computer&);
+        CommandList(const CommandList&) = delete;
+        CommandList& operator=(const CommandList&) = delete;
+        ~CommandList();
+
+        // ops on the computer from this thread are recorded until stop(), one list records per thread at a time
+        void record();
+        void stop();
+        void run(ecl::EXEC sync = SYNC);
+        void clear();
+
+        void add(ecl::Frame&, const std::vector<std::size_t>&, std::shared_ptr<const void> keep = nullptr);
+
+        std::size_t getSize() const;
+        bool isRecording() const;
+        ecl::Computer& getComputer() const;
+
+        // the list recording on this thread for the computer, if any
+        static CommandList* getRecording(const ecl::Computer&);
+    };
+
+    // every kernel of a Mat op is launched here, so a recording list can take it instead;
+    // keep (e.g. the parameters of the call) lives as long as the recorded command or the launch
+    inline void launch(ecl::Computer& video, ecl::Frame& frame, const std::vector<std::size_t>& global, ecl::EXEC sync, std::shared_ptr<const void> keep = nullptr){
+        CommandList* list = CommandList::getRecording(video);
+
+        if(list) list->add(frame, global, std::move(keep));
+        else{
+            video.grid(frame, global, sync);
+            retain(video, sync, std::move(keep));
+        }
+    }
+
+    // per-call values (scalars, offsets, seeds) go to the kernel in a small buffer instead of the source,
+    // so a new value doesn't build and cache a new program
+    template<typename T>
+    std::shared_ptr<Mat<T>> deviceParameters(ecl::Computer& video, std::initializer_list<T> values){
+        std::shared_ptr<Mat<T>> params(new Mat<T>(1, values.size()), [&video](Mat<T>* p){
+            p->release(video);
+            delete p;
+        });
+
+        std::copy(values.begin(), values.end(), static_cast<T*>(*params));
+        params->send(video);
+        return params;
+    }
+
+    // scratch buffer of a device op, kept by the launches using it and released once they are done
+    template<typename T>
+    std::shared_ptr<Mat<T>> deviceScratch(ecl::Computer& video, std::size_t h, std::size_t w){
+        std::shared_ptr<Mat<T>> scratch(new Mat<T>(h, w), [&video](Mat<T>* p){
+            p->release(video);
+            delete p;
+        });
+
+        scratch->send(video);
+        return scratch;
+    }
+
+    // Computer pool
+    // ecl::Computer and the device buffers of a Mat aren't shared between threads,
+    // every request thread leases its own computer (context and queue) instead
+    class ComputerPool{
+    private:
+        std::vector<std::unique_ptr<ecl::Computer>> computers;
+        std::vector<ecl::Computer*> idle;
+        std::mutex mutex;
+        std::condition_variable available;
+
+        void giveBack(ecl::Computer*);
+    public:
+        class Lease{
+        private:
+            ComputerPool* pool;
+            ecl::Computer* video;
+        public:
+            Lease(ComputerPool&, ecl::Computer&);
+            Lease(Lease&&);
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+            ~Lease();
+
+            ecl::Computer& get();
+            operator ecl::Computer&();
+        };
+
+        ComputerPool(std::size_t, const ecl::Platform&, ecl::DEVICE device = ecl::DEVICE::GPU, std::size_t device_index = 0);
+        ComputerPool(const ComputerPool&) = delete;
+        ComputerPool& operator=(const ComputerPool&) = delete;
+        ~ComputerPool();
+
+        // blocks until a computer is idle
+        Lease lease();
+        std::size_t getSize() const;
+    };
+
+    // Transport
+    class Transport{
+    public:
+        virtual std::size_t getRank() const = 0;
+        virtual std::size_t getSize() const = 0;
+
+        virtual void send(std::size_t, const void*, std::size_t, int tag = 0) = 0;
+        virtual void receive(std::size_t, void*, std::size_t, int tag = 0) = 0;
+        virtual void barrier() = 0;
+
+        virtual ~Transport() = default;
+    };
+
+    // in-process stand-in, every rank is a thread sharing one hub
+    class LocalHub{
+    private:
+        std::size_t size;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::map<std::tuple<std::size_t, std::size_t, int>, std::deque<std::vector<char>>> mailbox;
+        std::size_t arrived, generation;
+
+        friend class LocalTransport;
+    public:
+        LocalHub(std::size_t);
+    };
+
+    class LocalTransport : public Transport{
+    private:
+        LocalHub& hub;
+        std::size_t rank;
+    public:
+        LocalTransport(LocalHub&, std::size_t);
+
+        std::size_t getRank() const override;
+        std::size_t getSize() const override;
+
+        void send(std::size_t, const void*, std::size_t, int tag = 0) override;
+        void receive(std::size_t, void*, std::size_t, int tag = 0) override;
+        void barrier() override;
+    };
+
+    #ifdef MATRIXCF_USE_SOCKETS
+    // local processes connected by unix sockets, messages between two ranks with the same tag arrive in order
+    class SocketTransport : public Transport{
+    private:
+        std::size_t rank, size;
+        std::vector<int> sockets;
+
+        // messages read while waiting for another tag, per source rank
+        std::vector<std::map<int, std::deque<std::vector<char>>>> pending;
+
+        SocketTransport(std::size_t, std::size_t, std::vector<int>&&);
+
+        void write(std::size_t, const void*, std::size_t);
+        void read(std::size_t, void*, std::size_t);
+    public:
+        // forks size - 1 children, every process continues with its own rank (call before any OpenMP region)
+        static SocketTransport fork(std::size_t);
+
+        SocketTransport(SocketTransport&&);
+        SocketTransport(const SocketTransport&) = delete;
+
+        std::size_t getRank() const override;
+        std::size_t getSize() const override;
+
+        void send(std::size_t, const void*, std::size_t, int tag = 0) override;
+        void receive(std::size_t, void*, std::size_t, int tag = 0) override;
+        void barrier() override;
+
+        ~SocketTransport();
+    };
+    #endif // MATRIXCF_USE_SOCKETS
+
+    #ifdef MATRIXCF_USE_MPI
+    class MPITransport : public Transport{
+    private:
+        MPI_Comm comm;
+    public:
+        MPITransport(MPI_Comm comm = MPI_COMM_WORLD);
+
+        std::size_t getRank() const override;
+        std::size_t getSize() const override;
+
+        void send(std::size_t, const void*, std::size_t, int tag = 0) override;
+        void receive(std::size_t, void*, std::size_t, int tag = 0) override;
+        void barrier() override;
+    };
+    #endif // MATRIXCF_USE_MPI
+
+    // Distributed matrix API
+    // 2D block-cyclic layout: block (I, J) lives on process (I % grid_h, J % grid_w)
+    template<typename T>
+    class DistMat{
+    private:
+        std::size_t h, w, block;
+        std::size_t grid_h, grid_w, grid_i, grid_j;
+        Transport* transport;
+        Mat<T> local;
+
+        std::size_t localSize(std::size_t, std::size_t, std::size_t) const;
+        std::size_t owner(std::size_t, std::size_t) const;
+        std::size_t blockSize(std::size_t, std::size_t) const;
+
+        void broadcast(T*, std::size_t, std::size_t, const std::vector<std::size_t>&, int) const;
+        void sum(T*, std::size_t, int) const;
+    public:
+        DistMat(Transport&, std::size_t, std::size_t, std::size_t block = 64, std::size_t grid_h = 0);
+
+        const std::size_t getH() const;
+        const std::size_t getW() const;
+        const std::size_t getBlock() const;
+        const std::size_t getGridH() const;
+        const std::size_t getGridW() const;
+
+        Mat<T>& getLocal();
+        const Mat<T>& getConstLocal() const;
+
+        void scatter(const Mat<T>&, std::size_t root = 0);
+        void gather(Mat<T>&, std::size_t root = 0) const;
+
+        void mul(const DistMat<T>&, DistMat<T>&) const;
+        void transpose(DistMat<T>&) const;
+
+        void reduce(Mat<T>&, REDUCE option = FULL) const;
+        T reduce() const;
+    };
+
+    // Packed matrix API
+    // the packed triangle is a 1 x n(n + 1) / 2 Mat, on a computer it is sent and received as any other matrix
+
+    // symmetric matrix in its packed LOWER triangle, (i, j) and (j, i) are the same element
+    template<typename T>
+    class SymMat{
+    private:
+        std::size_t n;
+        Mat<T> packed;
+    public:
+        SymMat();
+        explicit SymMat(std::size_t);
+
+        const std::size_t getN() const;
+        Mat<T>& getPacked();
+        const Mat<T>& getConstPacked() const;
+
+        const T& getE(std::size_t, std::size_t) const;
+        void setE(const T&, std::size_t, std::size_t);
+
+        // alpha * A^T * A + beta * this for FIRST (A of k x n) or alpha * A * A^T + beta * this for NONE (A of n x k),
+        // only the lower half of the product is computed
+        void syrk(const Mat<T>&, TRANSPOSE option = FIRST, const T& alpha = 1, const T& beta = 0);
+        void syrk(const Mat<T>&, ecl::Computer&, TRANSPOSE option = FIRST, const T& alpha = 1, const T& beta = 0, ecl::EXEC sync = SYNC);
+
+        // this * B for B of n x m
+        void mul(const Mat<T>&, Mat<T>&) const;
+        void mul(const Mat<T>&, Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void toDense(Mat<T>&) const;
+        void toDense(Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        // takes the lower triangle of a square matrix
+        void fromDense(const Mat<T>&);
+    };
+
+    // triangular matrix in its packed triangle, the elements of the other triangle are zero
+    template<typename T>
+    class TriMat{
+    private:
+        std::size_t n;
+        TRIANGLE option;
+        Mat<T> packed;
+    public:
+        TriMat();
+        explicit TriMat(std::size_t, TRIANGLE option = LOWER);
+
+        const std::size_t getN() const;
+        TRIANGLE getTriangle() const;
+        Mat<T>& getPacked();
+        const Mat<T>& getConstPacked() const;
+
+        T getE(std::size_t, std::size_t) const;
+        void setE(const T&, std::size_t, std::size_t);
+
+        // X of this * X = B for B of n x m, result may be B
+        void solve(const Mat<T>&, Mat<T>&, bool unit_diagonal = false) const;
+        void solve(const Mat<T>&, Mat<T>&, ecl::Computer&, bool unit_diagonal = false, ecl::EXEC sync = SYNC) const;
+
+        void toDense(Mat<T>&) const;
+        void toDense(Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        // takes the triangle of a square matrix
+        void fromDense(const Mat<T>&);
+    };
+
+    // Layout matrix API
+    // an h x w matrix laid out as L (ColumnMajor or Tiled<B>) in a row-major block of L::getExtent(h, w) elements, on a
+    // computer the block is sent and received as any other matrix. Element access, the conversions, reduce, transpose
+    // and mul follow the layout; every other op is row-major only and doesn't exist here, so using one doesn't compile.
+    // ColumnMajor ops run on the block (the row-major transpose) with rows and columns swapped, Tiled ops walk the tiles
+    template<typename T, typename L>
+    class Mat{
+        template<typename U, typename V>
+        friend class Mat;
+    private:
+        std::size_t h, w;
+        Mat<T> block;
+
+        void requireLayoutShape(const Mat<T, L>&, std::size_t, std::size_t, const std::string&, bool is_result = false) const;
+    public:
+        Mat();
+        Mat(std::size_t, std::size_t);
+
+        const std::size_t getH() const;
+        const std::size_t getW() const;
+        Mat<T>& getBlock();
+        const Mat<T>& getConstBlock() const;
+
+        const T& getE(std::size_t, std::size_t) const;
+        void setE(const T&, std::size_t, std::size_t);
+
+        void toDense(Mat<T>&) const;
+        void toDense(Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        // the cpu overload takes the shape of the matrix, on a computer the shapes must match
+        void fromDense(const Mat<T>&);
+        void fromDense(const Mat<T>&, ecl::Computer&, ecl::EXEC sync = SYNC);
+
+        // as the row-major reduce, the result is a row-major 1 x 1, 1 x w (ROWS) or h x 1 (COLUMNS) matrix
+        void reduce(Mat<T>&, REDUCE option = FULL) const;
+        void reduce(Mat<T>&, ecl::Computer&, REDUCE option = FULL, ecl::EXEC sync = SYNC) const;
+
+        void transpose(Mat<T, L>&) const;
+        void transpose(Mat<T, L>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+
+        void mul(const Mat<T, L>&, Mat<T, L>&) const;
+        void mul(const Mat<T, L>&, Mat<T, L>&, ecl::Computer&, ecl::EXEC sync = SYNC) const;
+    };
+}
+
+// IMPLEMENTATION
+template<typename T>
+void mcf::Mat<T>::allocate(std::size_t size, STORAGE option){
+    storage = option;
+    capacity = size;
+    if(option == PAGEABLE){
+        arr = array<T>(size);
+        return;
+    }
+
+    // whole pages, so the block can be locked and handed to DMA as is
+    std::size_t page = pageSize();
+    pinned_bytes = std::max<std::size_t>(1, (size * sizeof(T) + page - 1) / page) * page;
+    pinned = static_cast<T*>(::operator new(pinned_bytes, std::align_val_t(page)));
+
+    // failing to lock (e.g. RLIMIT_MEMLOCK) still leaves an aligned buffer
+    #ifdef MATRIXCF_USE_PINNED
+    mlock(pinned, pinned_bytes);
+    #endif
+
+    arr = array<T>(pinned, size, READ_WRITE);
+}
+template<typename T>
+void mcf::Mat<T>::clear(){
+    h = 0;
+    w = 0;
+    total_size = 0;
+    capacity = 0;
+    arr.clear();
+    ref = 0;
+
+    if(pinned){
+        #ifdef MATRIXCF_USE_PINNED
+        munlock(pinned, pinned_bytes);
+        #endif
+        ::operator delete(pinned, std::align_val_t(pageSize()));
+    }
+    storage = PAGEABLE;
+    pinned = nullptr;
+    pinned_bytes = 0;
+}
+
+template<typename T>
+std::string mcf::Mat<T>::getTypeName() const{
+    if constexpr (std::is_same<T, bool>::value) return "bool";
+    else if constexpr (std::is_same<T, char>::value) return "char";
+    else if constexpr (std::is_same<T, unsigned char>::value) return "unsigned char";
+    else if constexpr (std::is_same<T, short>::value) return "short";
+    else if constexpr (std::is_same<T, unsigned short>::value) return "unsigned short";
+    else if constexpr(std::is_same<T, int>::value) return "int";
+    else if constexpr(std::is_same<T, unsigned int>::value) return "unsigned int";
+    else if constexpr(std::is_same<T, long>::value) return "long";
+    else if constexpr(std::is_same<T, unsigned long>::value) return "unsigned long";
+    else if constexpr(std::is_same<T, float>::value) return "float";
+    else if constexpr (std::is_same<T, double>::value) return "double";
+    else if constexpr(std::is_same<T, std::size_t>::value) return "size_t";
+    else throw std::runtime_error("Get matrix typename: ecl::Computer calculations on matrices with this template aren't supported");
+}
+
+template<typename T>
+void mcf::Mat<T>::requireMatrixShape(const Mat<T>& X, std::size_t require_h, std::size_t require_w, const std::string& where, bool is_result) const{
+    std::size_t r_h = X.getH();
+    std::size_t r_w = X.getW();
+
+    if(r_h != require_h || r_w != require_w){
+        std::string what = is_result ? "result matrix" : "matrix";
+
+        std::string e = "Require shape [" + where + "]: ";
+        e += "wrong " + what + " shape ";
+        e += std::to_string(r_h) + "x" + std::to_string(r_w);
+        e += " != ";
+        e += std::to_string(require_h) + "x" + std::to_string(require_w);
+
+        throw std::runtime_error(e);
+    }
+}
+template<typename T>
+std::pair<std::size_t, std::size_t> mcf::Mat<T>::requireBroadcastShape(const Mat<T>& X, const std::string& where) const{
+    // every dimension must match or be 1 on either side
+    bool valid_h = h == X.h || h == 1 || X.h == 1;
+    bool valid_w = w == X.w || w == 1 || X.w == 1;
+
+    if(!valid_h || !valid_w){
+        std::string e = "Require broadcast [" + where + "]: ";
+        e += "matrix shapes " + std::to_string(h) + "x" + std::to_string(w);
+        e += " and " + std::to_string(X.h) + "x" + std::to_string(X.w);
+        e += " aren't broadcastable";
+        throw std::runtime_error(e);
+    }
+
+    return {h == 1 ? X.h : h, w == 1 ? X.w : w};
+}
+template<typename T>
+std::string mcf::Mat<T>::getLiteral(const T& value) const{
+    // full precision, std::to_string keeps only 6 digits
+    if constexpr(std::is_floating_point<T>::value){
+        std::ostringstream s;
+        s.imbue(std::locale::classic());
+        s << std::scientific << std::setprecision(std::numeric_limits<T>::max_digits10) << value;
+        return std::is_same<T, float>::value ? s.str() + "f" : s.str();
+    }else return std::to_string(value);
+}
+template<typename T>
+std::string mcf::Mat<T>::getBroadcastIndex(std::size_t r_h, std::size_t r_w) const{
+    // index of this matrix element inside a r_h x r_w kernel grid
+    if(h == r_h && w == r_w) return "index";
+    if(h == r_h) return "get_global_id(0)";
+    if(w == r_w) return "get_global_id(1)";
+    return "0";
+}
+
+template<typename T>
+void mcf::Mat<T>::requireMatrixH(std::size_t r_h, std::size_t require_h, const std::string& where) const{
+    if(r_h != require_h){
+        std::string e = "Require h [" + where + "]: ";
+        e += "wrong matrix h ";
+        e += std::to_string(r_h) + " != " + std::to_string(require_h);
+        throw std::runtime_error(e);
+    }
+}
+template<typename T>
+void mcf::Mat<T>::requireMatrixW(std::size_t r_w, std::size_t require_w, const std::string& where) const{
+    if(r_w != require_w){
+        std::string e = "Require w [" + where + "]: ";
+        e += "wrong matrix w ";
+        e += std::to_string(r_w) + " != " + std::to_string(require_w);
+        throw std::runtime_error(e);
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::requireTotalSize(const Mat<T>& X, std::size_t require_total_size, const std::string& where) const{
+    std::size_t r_total_size = X.getTotalSize();
+
+    if(r_total_size != require_total_size){
+        std::string e = "Require total size [" + where + "]: ";
+        e += "wrong matrix total size ";
+        e += std::to_string(r_total_size) + " != " + std::to_string(require_total_size);
+        throw std::runtime_error(e);
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::requireFloatingPoint(const std::string& where) const{
+    if(!std::is_floating_point<T>::value){
+        std::string e = "Require floating point [" + where + "]: ";
+        e += "wrong matrix type " + getTypeName();
+        throw std::runtime_error(e);
+    }
+}
+template<typename T>
+void mcf::Mat<T>::requireImmediate(const ecl::Computer& video, const std::string& where){
+    // ops that read results back or keep device state of their own can't be recorded
+    if(CommandList::getRecording(video)){
+        std::string e = "Require immediate [" + where + "]: ";
+        e += "computer has a recording command list";
+        throw std::runtime_error(e);
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::copy(const Mat<T>& other) {
+	clear();
+
+	if(other.storage == PINNED){
+		allocate(other.total_size, PINNED);
+		std::copy(static_cast<const T*>(other.arr), other.arr + other.total_size, pinned);
+	}else{
+		arr = other.arr;
+		capacity = other.capacity;
+	}
+
+	h = other.h;
 	w = other.w;
 	total_size = other.total_size;
-	arr = other.arr;
 	ref = false;
 }
 template<typename T>
-void mcf::Mat<T>::move(Mat<T>& other) {
-	h = other.h;
-	w = other.w;
-	total_size = other.total_size;
-	arr = std::move(other.arr);
-	ref = other.ref;
+void mcf::Mat<T>::move(Mat<T>& other) {
+	h = other.h;
+	w = other.w;
+	total_size = other.total_size;
+	capacity = other.capacity;
+	arr = std::move(other.arr);
+	ref = other.ref;
+
+	std::swap(storage, other.storage);
+	std::swap(pinned, other.pinned);
+	std::swap(pinned_bytes, other.pinned_bytes);
+
+	other.h = 0;
+	other.w = 0;
+	other.total_size = 0;
+	other.ref = false;
+
+	other.clear();
+}
+
+// Constructors
+template<typename T>
+mcf::Mat<T>::Mat(){
+    h = 0;
+    w = 0;
+    total_size = 0;
+    ref = false;
+}
+
+template<typename T>
+mcf::Mat<T>::Mat(std::size_t h, std::size_t w, STORAGE storage){
+    allocate(w * h, storage);
+    this->h = h;
+    this->w = w;
+    total_size = w * h;
+    ref = false;
+}
+
+template<typename T>
+mcf::Mat<T>::Mat(T* arr, std::size_t h, std::size_t w) : arr(arr, h * w, READ_WRITE){
+    this->h = h;
+    this->w = w;
+    total_size = w * h;
+    capacity = total_size;
+    ref = true;
+}
+
+
+template<typename T>
+mcf::Mat<T>::Mat(const Mat<T>& other){
+	copy(other);
+}
+template<typename T>
+mcf::Mat<T>& mcf::Mat<T>::operator=(const Mat<T>& other){
+	copy(other);
+
+    return *this;
+}
+
+template<typename T>
+mcf::Mat<T>::Mat(Mat<T>&& other){
+	move(other);
+}
+
+template<typename T>
+mcf::Mat<T>& mcf::Mat<T>::operator=(Mat<T>&& other){
+	move(other);
+
+    return *this;
+}
+
+// Getters
+template<typename T>
+const mcf::array<T>& mcf::Mat<T>::getConstArray() const{
+    return arr;
+}
+template<typename T>
+const std::size_t mcf::Mat<T>::getH() const{
+    return h;
+}
+template<typename T>
+const std::size_t mcf::Mat<T>::getW() const{
+    return w;
+}
+template<typename T>
+const std::size_t mcf::Mat<T>::getTotalSize() const{
+    return total_size;
+}
+
+template<typename T>
+mcf::array<T>& mcf::Mat<T>::getArray(){
+    return arr;
+}
+
+template<typename T>
+std::size_t mcf::Mat<T>::totalMemoryUsed() const{
+    return capacity * sizeof(T);
+}
+template<typename T>
+bool mcf::Mat<T>::isRef() const{
+    return ref;
+}
+template<typename T>
+mcf::STORAGE mcf::Mat<T>::getStorage() const{
+    return storage;
+}
+template<typename T>
+std::size_t mcf::Mat<T>::getCapacity() const{
+    return capacity;
+}
+
+template<typename T>
+const T& mcf::Mat<T>::getE(std::size_t i, std::size_t j) const{
+    return arr[w * i + j];
+}
+template<typename T>
+void mcf::Mat<T>::setE(const T& value, std::size_t i, std::size_t j){
+    arr[w * i + j] = value;
+}
+
+template<typename T>
+T* mcf::Mat<T>::operator[](std::size_t i){
+    return arr + i * w;
+}
+
+template<typename T>
+mcf::Mat<T>::operator T*(){
+    return arr;
+}
+template<typename T>
+mcf::Mat<T>::operator const T*() const{
+    return arr;
+}
+
+template<typename T>
+void mcf::Mat<T>::place(PLACEMENT option){
+    std::size_t nodes = numaNodes();
+    if(2 > nodes || total_size == 0) return;
+
+    const T* data = arr;
+
+    if(option == INTERLEAVE){
+        std::vector<std::size_t> all(nodes);
+        for(std::size_t i = 0; nodes > i; i++) all[i] = i;
+
+        numaMove(data, totalMemoryUsed(), all, INTERLEAVE);
+        return;
+    }
+
+    // every thread binds the rows it gets from a static schedule to its own node;
+    // inner boundaries are rounded up to a page, so a page shared by two ranges goes to the later one only
+    std::uintptr_t page = pageSize();
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(data);
+    std::uintptr_t end = base + total_size * sizeof(T);
+
+    #ifdef MATRIXCF_USE_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        std::size_t first = h;
+        std::size_t last = 0;
+
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(std::size_t i = 0; h > i; i++){
+            first = std::min(first, i);
+            last = i + 1;
+        }
+
+        if(last > first){
+            std::uintptr_t lo = first == 0 ? base / page * page : (base + first * w * sizeof(T) + page - 1) / page * page;
+            std::uintptr_t hi = last == h ? (end + page - 1) / page * page : (base + last * w * sizeof(T) + page - 1) / page * page;
+            if(hi > lo) numaMove(reinterpret_cast<const void*>(lo), hi - lo, {numaNode()}, PARTITION);
+        }
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::send(ecl::Computer& video, ecl::EXEC sync){
+    video.send(arr, sync);
+}
+template<typename T>
+void mcf::Mat<T>::receive(ecl::Computer& video, ecl::EXEC sync){
+    video.receive(arr, sync);
+}
+template<typename T>
+void mcf::Mat<T>::release(ecl::Computer& video, ecl::EXEC sync){
+    video.release(arr, sync);
+}
+template<typename T>
+void mcf::Mat<T>::grab(ecl::Computer& video, ecl::EXEC sync){
+    video.grab(arr, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::warmup(ecl::Computer& video, std::size_t h, std::size_t w){
+    // kernel sources bake in the shapes, so the ops are recorded with the shapes of real calls;
+    // the recorded kernels then run on one work item each, which builds them without the full-size work
+    requireImmediate(video, "warmup");
+
+    Mat<T> A(h, w);
+    Mat<T> B(h, w);
+    Mat<T> C(h, w);
+    Mat<T> At(w, h);
+    Mat<T> S(h, h);
+    Mat<T> H(h, 2 * w);
+    Mat<T> V(2 * h, w);
+    Mat<T> rows(1, w);
+    Mat<T> columns(h, 1);
+
+    for(Mat<T>* M : {&A, &B, &C, &At, &S, &H, &V, &rows, &columns}) M->send(video);
+
+    CommandList list(video);
+    list.record();
+
+    A.zeros(video);
+    A.ones(video);
+    A.eye(1, video);
+
+    A.transpose(At, video);
+    A.reduce(rows, video, ROWS);
+    A.reduce(columns, video, COLUMNS);
+
+    A.add(B, C, video);
+    A.sub(B, C, video);
+    A.hadamard(B, C, video);
+    A.mul(At, S, video);
+    A.mul(B, S, video, SECOND);
+
+    H.hstack(A, B, video);
+    V.vstack(A, B, video);
+    H.hsplit(A, B, video);
+    V.vsplit(A, B, video);
+
+    list.stop();
+    list.build();
+
+    for(Mat<T>* M : {&A, &B, &C, &At, &S, &H, &V, &rows, &columns}) M->release(video);
+}
+
+template<typename T>
+void mcf::Mat<T>::save(const std::string& json_filename) const{
+    std::ofstream f(json_filename);
+    if(!f.is_open()) throw std::runtime_error("unable to save matrix to json file");
+
+    auto j = nlohmann::json();
+    j["w"] = static_cast<std::size_t>(w);
+    j["h"] = static_cast<std::size_t>(h);
+    j["total_size"] = static_cast<std::size_t>(total_size);
+    j["array"] = std::vector<T>(static_cast<const T*>(arr), arr + total_size);
+
+    f << std::setw(4) << j;
+    f.close();
+}
+template<typename T>
+mcf::Mat<T> mcf::Mat<T>::load(const std::string& json_filename){
+    std::ifstream f(json_filename);
+        if(!f.is_open()) throw std::runtime_error("unable to load matrix to json file");
+
+        auto j = nlohmann::json::parse(f);
+        T* temp = new T[(std::size_t)j["total_size"]];
+        std::copy(j["array"].begin(), j["array"].end(), temp);
+
+        Mat<T> result(temp, j["h"], j["w"]);
+        result.requireTotalSize(result, j["total_size"], "load");
+
+        f.close();
+
+        return std::move(result);
+}
+template<typename T>
+void mcf::Mat<T>::saveCSV(const std::string& csv_filename, char delimiter) const{
+    std::ofstream f(csv_filename, std::ios::binary);
+    if(!f.is_open()) throw std::runtime_error("unable to save matrix to csv file");
+
+    std::string text = formatRows(static_cast<const T*>(arr), h, w, "", std::string(1, delimiter), "\n", std::chars_format::general, -1);
+    f.write(text.data(), text.size());
+    f.close();
+}
+template<typename T>
+mcf::Mat<T> mcf::Mat<T>::loadCSV(const std::string& csv_filename, char delimiter){
+    std::ifstream f(csv_filename, std::ios::binary | std::ios::ate);
+    if(!f.is_open()) throw std::runtime_error("unable to load matrix from csv file");
+
+    std::string text(static_cast<std::size_t>(f.tellg()), '\0');
+    f.seekg(0);
+    f.read(&text[0], text.size());
+    f.close();
+
+    // non-empty lines without line endings
+    std::vector<std::pair<std::size_t, std::size_t>> lines;
+    for(std::size_t begin = 0; text.size() > begin;){
+        std::size_t end = text.find('\n', begin);
+        if(end == std::string::npos) end = text.size();
+
+        std::size_t stop = end;
+        if(stop > begin && text[stop - 1] == '\r') stop--;
+        if(stop > begin) lines.emplace_back(begin, stop);
+
+        begin = end + 1;
+    }
+    if(lines.empty()) throw std::runtime_error("loadCSV: file is empty");
+
+    std::size_t rows = lines.size();
+    std::size_t cols = std::count(text.begin() + lines[0].first, text.begin() + lines[0].second, delimiter) + 1;
+
+    Mat<T> result(rows, cols);
+    T* data = result;
+    std::atomic<std::size_t> bad(rows);
+
+    parallelFor(0, rows, TASK_GRAIN / std::max<std::size_t>(cols, 1), [&](std::size_t first, std::size_t end){
+        for(std::size_t i = first; end > i; i++){
+            const char* it = text.data() + lines[i].first;
+            const char* last = text.data() + lines[i].second;
+
+            for(std::size_t j = 0; cols > j && it; j++){
+                it = parseValue(skipBlank(it, last, delimiter), last, data[i * cols + j]);
+                if(!it) break;
+
+                it = skipBlank(it, last, delimiter);
+                if(cols > j + 1) it = it != last && *it == delimiter ? it + 1 : nullptr;
+            }
+
+            // the first malformed row is reported
+            if(!it || it != last){
+                std::size_t old = bad.load();
+                while(i < old && !bad.compare_exchange_weak(old, i));
+                break;
+            }
+        }
+    });
+
+    if(bad != rows) throw std::runtime_error("loadCSV: malformed row " + std::to_string(bad + 1));
+
+    return result;
+}
+template<typename T>
+mcf::BinaryHeader mcf::Mat<T>::readBinaryHeader(std::ifstream& f, const std::string& where){
+    BinaryHeader header;
+    f.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!f) throw std::runtime_error(where + ": file is shorter than the header");
+    if(std::memcmp(header.magic, "MCFB", 4) != 0) throw std::runtime_error(where + ": not a matrix binary file");
+    if(header.version == 0 || header.version > 2) throw std::runtime_error(where + ": unsupported version " + std::to_string(header.version));
+    if(header.version == 1 && (header.codec != RAW || header.block_rows != 0)) throw std::runtime_error(where + ": version 1 file with a codec");
+
+    if(header.element != sizeof(T) || header.kind != binaryKind<T>()){
+        std::string e = where + ": wrong element type, file has " + std::to_string(header.element) + "-byte '";
+        e += char(header.kind);
+        e += "' elements";
+        throw std::runtime_error(e);
+    }
+
+    if(header.codec > DELTA_SHUFFLE_LZ) throw std::runtime_error(where + ": unsupported codec " + std::to_string(header.codec));
+    if(header.codec != RAW && header.h > 0 && header.block_rows == 0) throw std::runtime_error(where + ": empty blocks");
+
+    // the shape is checked against the file before anything is allocated for it; an LZ byte decodes to at most
+    // 255 bytes, so a compressed file can't hold more than 255 times its blocks
+    std::string shape = std::to_string(header.h) + "x" + std::to_string(header.w);
+    if(header.w > 0 && header.h > std::numeric_limits<std::size_t>::max() / sizeof(T) / header.w) throw std::runtime_error(where + ": " + shape + " matrix is too large");
+
+    std::streamoff start = f.tellg();
+    f.seekg(0, std::ios::end);
+    std::uint64_t left = std::uint64_t(f.tellg() - start);
+    f.seekg(start);
+
+    std::uint64_t bytes = header.h * header.w * sizeof(T);
+    if(header.codec == RAW){
+        if(bytes > left) throw std::runtime_error(where + ": file is shorter than its " + shape + " matrix");
+        return header;
+    }
+
+    std::uint64_t count = header.h > 0 ? header.h / header.block_rows + (header.h % header.block_rows != 0) : 0;
+    if(count > left / sizeof(BinaryBlock)) throw std::runtime_error(where + ": file is shorter than the block table");
+    if((bytes + 254) / 255 > left - count * sizeof(BinaryBlock)) throw std::runtime_error(where + ": file is shorter than its " + shape + " matrix");
+
+    return header;
+}
+template<typename T>
+void mcf::Mat<T>::readBinaryBlocks(std::ifstream& f, const BinaryHeader& header, std::size_t first, std::size_t last, T* dst, const std::string& where){
+    std::size_t rows = header.block_rows;
+    std::size_t row_bytes = header.w * sizeof(T);
+    std::size_t count = header.h > 0 ? (header.h + rows - 1) / rows : 0;
+
+    std::vector<BinaryBlock> blocks(count);
+    f.read(reinterpret_cast<char*>(blocks.data()), count * sizeof(BinaryBlock));
+    if(!f) throw std::runtime_error(where + ": file is shorter than the block table");
+
+    // blocks are stored back to back, a stored block is never larger than the plain one
+    for(std::size_t b = 0, offset = 0; count > b; offset += blocks[b].bytes, b++){
+        std::size_t plain = std::min(rows, header.h - b * rows) * row_bytes;
+        if(blocks[b].offset != offset || blocks[b].bytes > plain) throw std::runtime_error(where + ": corrupt block table");
+    }
+    if(first == last) return;
+
+    std::size_t begin = blocks[first].offset;
+    std::size_t end = blocks[last - 1].offset + blocks[last - 1].bytes;
+    std::vector<unsigned char> stored(end - begin);
+
+    f.seekg(begin, std::ios::cur);
+    f.read(reinterpret_cast<char*>(stored.data()), stored.size());
+    if(!f) throw std::runtime_error(where + ": file is shorter than its blocks");
+
+    std::vector<char> ok(last - first, 0);
+    parallelFor(first, last, 1, [&](std::size_t b0, std::size_t b1){
+        std::vector<unsigned char> shuffled;
+
+        for(std::size_t b = b0; b1 > b; b++){
+            std::size_t n = std::min(rows, header.h - b * rows) * header.w;
+            const unsigned char* src = stored.data() + (blocks[b].offset - begin);
+            unsigned char* plain = reinterpret_cast<unsigned char*>(dst + (b - first) * rows * header.w);
+
+            if(blocks[b].bytes == n * sizeof(T)) std::memcpy(plain, src, n * sizeof(T));
+            else{
+                shuffled.resize(n * sizeof(T));
+                if(!lzDecompress(src, blocks[b].bytes, shuffled.data(), shuffled.size())) continue;
+                unshuffleBytes<sizeof(T)>(shuffled.data(), plain, n);
+                if constexpr(sizeof(DeltaWord<sizeof(T)>) == sizeof(T)){
+                    if(header.codec == DELTA_SHUFFLE_LZ) deltaDecode<sizeof(T)>(plain, n);
+                }
+            }
+
+            ok[b - first] = xxHash64(plain, n * sizeof(T)) == blocks[b].hash;
+        }
+    });
+
+    for(std::size_t b = first; last > b; b++){
+        if(!ok[b - first]) throw std::runtime_error(where + ": corrupt block " + std::to_string(b));
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::saveBinary(const std::string& binary_filename, CODEC option, std::size_t block_rows) const{
+    std::ofstream f(binary_filename, std::ios::binary);
+    if(!f.is_open()) throw std::runtime_error("unable to save matrix to binary file");
+
+    BinaryHeader header;
+    header.element = sizeof(T);
+    header.kind = binaryKind<T>();
+    header.h = h;
+    header.w = w;
+    header.hash = hash();
+    header.codec = option;
+
+    if(option == DELTA_SHUFFLE_LZ && sizeof(DeltaWord<sizeof(T)>) != sizeof(T)){
+        throw std::runtime_error("saveBinary: delta coding needs 1, 2, 4 or 8-byte elements");
+    }
+
+    if(option == RAW){
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(static_cast<const T*>(arr)), total_size * sizeof(T));
+        if(!f) throw std::runtime_error("saveBinary: write failed");
+        f.close();
+        return;
+    }
+
+    std::size_t row_bytes = w * sizeof(T);
+    if(block_rows == 0) block_rows = std::max<std::size_t>(1, (std::size_t(1) << 18) / std::max<std::size_t>(row_bytes, 1));
+    block_rows = std::min<std::size_t>(block_rows, std::numeric_limits<std::uint32_t>::max());
+    header.block_rows = static_cast<std::uint32_t>(block_rows);
+
+    std::size_t count = (h + block_rows - 1) / block_rows;
+    std::vector<BinaryBlock> blocks(count);
+    std::vector<std::vector<unsigned char>> stored(count);
+
+    parallelFor(0, count, 1, [&](std::size_t b0, std::size_t b1){
+        std::vector<unsigned char> delta;
+        std::vector<unsigned char> shuffled;
+
+        for(std::size_t b = b0; b1 > b; b++){
+            std::size_t n = std::min(block_rows, h - b * block_rows) * w;
+            const unsigned char* plain = reinterpret_cast<const unsigned char*>(static_cast<const T*>(arr) + b * block_rows * w);
+            const unsigned char* words = plain;
+
+            if constexpr(sizeof(DeltaWord<sizeof(T)>) == sizeof(T)){
+                if(option == DELTA_SHUFFLE_LZ){
+                    delta.resize(n * sizeof(T));
+                    deltaEncode<sizeof(T)>(plain, delta.data(), n);
+                    words = delta.data();
+                }
+            }
+
+            shuffled.resize(n * sizeof(T));
+            shuffleBytes<sizeof(T)>(words, shuffled.data(), n);
+
+            stored[b].resize(lzBound(shuffled.size()));
+            std::size_t bytes = lzCompress(shuffled.data(), shuffled.size(), stored[b].data());
+
+            if(shuffled.size() > bytes) stored[b].resize(bytes);
+            else stored[b].assign(plain, plain + n * sizeof(T));
+
+            blocks[b].bytes = stored[b].size();
+            blocks[b].hash = xxHash64(plain, n * sizeof(T));
+        }
+    });
+
+    for(std::size_t b = 1; count > b; b++) blocks[b].offset = blocks[b - 1].offset + blocks[b - 1].bytes;
+
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(blocks.data()), count * sizeof(BinaryBlock));
+    for(auto& block : stored) f.write(reinterpret_cast<const char*>(block.data()), block.size());
+    if(!f) throw std::runtime_error("saveBinary: write failed");
+    f.close();
+}
+template<typename T>
+mcf::Mat<T> mcf::Mat<T>::loadBinary(const std::string& binary_filename){
+    std::ifstream f(binary_filename, std::ios::binary);
+    if(!f.is_open()) throw std::runtime_error("unable to load matrix from binary file");
+
+    BinaryHeader header = readBinaryHeader(f, "loadBinary");
+    Mat<T> result(header.h, header.w);
+
+    if(header.codec != RAW){
+        // every block checks its own hash while decoding
+        std::size_t count = header.h > 0 ? (header.h + header.block_rows - 1) / header.block_rows : 0;
+        readBinaryBlocks(f, header, 0, count, result, "loadBinary");
+        return result;
+    }
+
+    f.read(reinterpret_cast<char*>(static_cast<T*>(result.arr)), result.total_size * sizeof(T));
+    if(!f) throw std::runtime_error("loadBinary: file is shorter than its " + std::to_string(header.h) + "x" + std::to_string(header.w) + " matrix");
+    f.close();
+
+    if(result.hash() != header.hash) throw std::runtime_error("loadBinary: content hash mismatch");
+
+    return result;
+}
+template<typename T>
+mcf::Mat<T> mcf::Mat<T>::loadRows(const std::string& binary_filename, std::size_t first, std::size_t count){
+    std::ifstream f(binary_filename, std::ios::binary);
+    if(!f.is_open()) throw std::runtime_error("unable to load matrix from binary file");
+
+    BinaryHeader header = readBinaryHeader(f, "loadRows");
+    if(first > header.h || count > header.h - first){
+        std::string e = "loadRows: rows [" + std::to_string(first) + ", " + std::to_string(first + count) + ")";
+        e += " outside a " + std::to_string(header.h) + "x" + std::to_string(header.w) + " matrix";
+        throw std::runtime_error(e);
+    }
+
+    Mat<T> result(count, header.w);
+    if(count == 0) return result;
+
+    if(header.codec == RAW){
+        // a slice of a RAW file can't be checked against the content hash
+        f.seekg(first * header.w * sizeof(T), std::ios::cur);
+        f.read(reinterpret_cast<char*>(static_cast<T*>(result.arr)), result.total_size * sizeof(T));
+        if(!f) throw std::runtime_error("loadRows: file is shorter than its matrix");
+        return result;
+    }
+
+    // the blocks holding the rows, then the rows out of them
+    std::size_t rows = header.block_rows;
+    std::size_t first_block = first / rows;
+    std::size_t last_block = (first + count + rows - 1) / rows;
+
+    Mat<T> blocks(std::min<std::size_t>((last_block - first_block) * rows, header.h - first_block * rows), header.w);
+    readBinaryBlocks(f, header, first_block, last_block, blocks, "loadRows");
+
+    const T* src = blocks;
+    std::copy(src + (first - first_block * rows) * header.w, src + (first - first_block * rows + count) * header.w, static_cast<T*>(result.arr));
+
+    return result;
+}
+template<typename T>
+std::uint64_t mcf::Mat<T>::loadHash(const std::string& binary_filename){
+    std::ifstream f(binary_filename, std::ios::binary);
+    if(!f.is_open()) throw std::runtime_error("unable to load matrix from binary file");
+
+    return readBinaryHeader(f, "loadHash").hash;
+}
+
+namespace mcf{
+    template<typename T>
+    std::ostream& operator<<(std::ostream& s, const Mat<T>& other){
+        constexpr bool character = std::is_same<T, char>::value || std::is_same<T, signed char>::value || std::is_same<T, unsigned char>::value;
+
+        if constexpr(std::is_arithmetic<T>::value && !character){
+            // fast path for plain decimal streams, anything else goes through the stream formatting
+            auto flags = s.flags();
+            auto floatfield = flags & std::ios::floatfield;
+            bool plain = !(flags & (std::ios::showpos | std::ios::showpoint | std::ios::uppercase | std::ios::boolalpha));
+            plain = plain && (!std::is_integral<T>::value || (flags & std::ios::basefield) == std::ios::dec);
+            plain = plain && floatfield != (std::ios::fixed | std::ios::scientific) && s.width() == 0 && s.getloc() == std::locale::classic();
+
+            if(plain){
+                std::chars_format format = std::chars_format::general;
+                if(floatfield == std::ios::fixed) format = std::chars_format::fixed;
+                if(floatfield == std::ios::scientific) format = std::chars_format::scientific;
+
+                std::string text = formatRows(static_cast<const T*>(other.arr), other.h, other.w, "(", ", ", ")\n", format, static_cast<int>(s.precision()));
+                return s.write(text.data(), text.size());
+            }
+        }
+
+        for(std::size_t i = 0; other.h > i; i++){
+            s << "(" << other.getE(i, 0);
+            for(std::size_t j = 1; other.w > j; j++) s << ", " << other.getE(i, j);
+            s << ")\n";
+        }
+        return s;
+    }
+
+    template<typename T>
+    ecl::Computer& operator<<(ecl::Computer& video, Mat<T>& other){
+        other.send(video);
+        return video;
+    }
+    template<typename T>
+    ecl::Computer& operator>>(ecl::Computer& video, Mat<T>& other){
+        other.receive(video);
+        return video;
+    }
+
+    // warmup for several types at once: mcf::warmup<float, double>(video, h, w)
+    template<typename... T>
+    void warmup(ecl::Computer& video, std::size_t h, std::size_t w){
+        (Mat<T>::warmup(video, h, w), ...);
+    }
+}
+
+// methods (extra)
+template<typename T>
+bool mcf::Mat<T>::equals(const Mat<T>& X, COMPARE option, double tolerance) const{
+    if(h != X.h || w != X.w) return false;
+
+    constexpr std::size_t CHUNK = 4096;
+    std::atomic<bool> same(true);
+
+    const T* a = arr;
+    const T* b = X.arr;
+
+    // chunks are compared independently, the first mismatch stops the rest
+    parallelFor(0, total_size, CHUNK, [&](std::size_t begin, std::size_t end){
+        if(!same.load(std::memory_order_relaxed)) return;
+
+        bool chunk_same = true;
+
+        if constexpr(std::is_integral<T>::value){
+            if(option == EXACT) chunk_same = std::memcmp(a + begin, b + begin, (end - begin) * sizeof(T)) == 0;
+            else for(std::size_t i = begin; end > i && chunk_same; i++) chunk_same = nearlyEqual(a[i], b[i], option, tolerance);
+        } else if(option == EXACT){
+            int diff = 0;
+
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd reduction(|:diff)
+            #endif
+            for(std::size_t i = begin; end > i; i++) diff |= !(a[i] == b[i]);
+            chunk_same = diff == 0;
+        } else {
+            for(std::size_t i = begin; end > i && chunk_same; i++) chunk_same = nearlyEqual(a[i], b[i], option, tolerance);
+        }
+
+        if(!chunk_same) same.store(false, std::memory_order_relaxed);
+    });
+
+    return same.load();
+}
+template<typename T>
+bool mcf::Mat<T>::equals(const Mat<T>& X, ecl::Computer& video, COMPARE option, double tolerance) const{
+    requireImmediate(video, "equals");
+    if(h != X.h || w != X.w) return false;
+    if(total_size == 0) return true;
+
+    std::string type = getTypeName();
+    bool floating = std::is_floating_point<T>::value;
+
+    // the tolerance goes in a parameter buffer: params[0] is a count of ulps or an integer distance, clamped like nearlyEqual,
+    // params[1] holds the bits of the scale (a T for floating types, a double for integers)
+    std::uint64_t distance = 0;
+    if(tolerance >= 18446744073709551616.0) distance = std::numeric_limits<std::uint64_t>::max();
+    else if(tolerance >= 0) distance = static_cast<std::uint64_t>(tolerance);
+
+    std::uint64_t bits = 0;
+    std::string scale = "as_double(params[1])";
+    if constexpr(std::is_same<T, float>::value){
+        float f = float(tolerance);
+        std::uint32_t b;
+        std::memcpy(&b, &f, sizeof(b));
+        bits = b;
+        scale = "as_float((uint)params[1])";
+    }else std::memcpy(&bits, &tolerance, sizeof(bits));
+
+    // same is nonzero when v1 and v2 are considered equal
+    std::string same = "int same = v1 == v2;\n";
+
+    if(option != EXACT && !std::is_same<T, bool>::value){
+        if(floating && option == ULP){
+            std::string I = std::is_same<T, double>::value ? "long" : "int";
+            std::string MIN = std::is_same<T, double>::value ? "LONG_MIN" : "INT_MIN";
+
+            same = I + " x = as_" + I + "(v1);\n";
+            same += I + " y = as_" + I + "(v2);\n";
+            same += "if(x < 0) x = " + MIN + " - x;\n";
+            same += "if(y < 0) y = " + MIN + " - y;\n";
+            same += "ulong ulp = x > y ? (u" + I + ")x - (u" + I + ")y : (u" + I + ")y - (u" + I + ")x;\n";
+            same += "int same = v1 == v2 || (!isnan(v1) && !isnan(v2) && ulp <= params[0]);\n";
+        }else if(floating){
+            std::string relative = option == RELATIVE ? " * fmax(fabs(v1), fabs(v2))" : "";
+            same = "int same = v1 == v2 || fabs(v1 - v2) <= " + scale + relative + ";\n";
+        }else{
+            // integers as in nearlyEqual: an exact 64-bit distance, RELATIVE scales in double
+            same = "ulong d = v1 > v2 ? (ulong)v1 - (ulong)v2 : (ulong)v2 - (ulong)v1;\n";
+            if(option == RELATIVE){
+                same += "ulong m1 = v1 < 0 ? 0 - (ulong)v1 : (ulong)v1;\n";
+                same += "ulong m2 = v2 < 0 ? 0 - (ulong)v2 : (ulong)v2;\n";
+                same += "int same = v1 == v2 || (double)d <= " + scale + " * (double)max(m1, m2);\n";
+            }else{
+                same += "int same = v1 == v2 || d <= params[0];\n";
+            }
+        }
+    }
+
+    ecl::Program prog = "__kernel void equals";
+    prog += "(__global " + type + "* a, __global " + type + "* b, __global int* flag, __global ulong* params)";
+    prog += "{\n";
+    prog += "if(!flag[0]) return;\n";
+    prog += "size_t index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
+    prog += type + " v1 = a[index];\n";
+    prog += type + " v2 = b[index];\n";
+    prog += same;
+    prog += "if(!same) flag[0] = 0;\n";
+    prog += "}";
+
+    ecl::Kernel equals = "equals";
+
+    // only the flag goes back to the host
+    Mat<int> flag(1, 1);
+    flag.setE(1, 0, 0);
+    flag.send(video);
+
+    auto params = deviceParameters<std::uint64_t>(video, {distance, bits});
+    ecl::Frame frame = {cacheProgram(prog, video), equals, {&arr, &X.arr, &flag.arr, &params->arr}};
+    launch(video, frame, {h, w}, SYNC, params);
+
+    flag.receive(video);
+    flag.release(video);
+
+    return flag.getE(0, 0) != 0;
+}
+
+template<typename T>
+std::uint64_t mcf::Mat<T>::hash(std::uint64_t seed) const{
+    HashState state(seed);
+    hashRows(state);
+    return hashDigest(state);
+}
+template<typename T>
+void mcf::Mat<T>::hashRows(HashState& state) const{
+    // the first block fixes the width and the element size
+    if(state.element == 0){
+        state.w = w;
+        state.element = sizeof(T);
+    }
+
+    requireMatrixW(w, state.w, "hashRows");
+    if(state.element != sizeof(T)){
+        std::string e = "Require element size [hashRows]: ";
+        e += "wrong matrix element size " + std::to_string(sizeof(T)) + " != " + std::to_string(state.element);
+        throw std::runtime_error(e);
+    }
+
+    hashUpdate(state, static_cast<const T*>(arr), total_size * sizeof(T));
+    state.h += h;
+}
+
+template<typename T>
+std::string mcf::Mat<T>::getXxHash(){
+    // the chunks start at multiples of HASH_CHUNK and every read of xxHash64 is aligned to its size within a chunk
+    std::string xxh = "#define XXH_P1 " + std::to_string(XXH_P1) + "UL\n";
+    xxh += "#define XXH_P2 " + std::to_string(XXH_P2) + "UL\n";
+    xxh += "#define XXH_P3 " + std::to_string(XXH_P3) + "UL\n";
+    xxh += "#define XXH_P4 " + std::to_string(XXH_P4) + "UL\n";
+    xxh += "#define XXH_P5 " + std::to_string(XXH_P5) + "UL\n";
+
+    xxh += "ulong xxhRound(ulong acc, ulong x){\n";
+    xxh += "return rotate(acc + x * XXH_P2, (ulong)31) * XXH_P1;\n";
+    xxh += "}\n";
+
+    xxh += "ulong xxhMerge(ulong acc, ulong x){\n";
+    xxh += "return (acc ^ xxhRound(0, x)) * XXH_P1 + XXH_P4;\n";
+    xxh += "}\n";
+
+    xxh += "ulong xxhAvalanche(ulong x){\n";
+    xxh += "x = (x ^ (x >> 33)) * XXH_P2;\n";
+    xxh += "x = (x ^ (x >> 29)) * XXH_P3;\n";
+    xxh += "return x ^ (x >> 32);\n";
+    xxh += "}\n";
+
+    xxh += "ulong xxHash64(__global const uchar* p, size_t bytes, ulong seed){\n";
+    xxh += "size_t k = 0;\n";
+    xxh += "ulong h = seed + XXH_P5;\n";
+    xxh += "if(bytes >= 32){\n";
+    xxh += "ulong v0 = seed + XXH_P1 + XXH_P2;\n";
+    xxh += "ulong v1 = seed + XXH_P2;\n";
+    xxh += "ulong v2 = seed;\n";
+    xxh += "ulong v3 = seed - XXH_P1;\n";
+    xxh += "for(; bytes - k >= 32; k += 32){\n";
+    xxh += "__global const ulong* x = (__global const ulong*)(p + k);\n";
+    xxh += "v0 = xxhRound(v0, x[0]);\n";
+    xxh += "v1 = xxhRound(v1, x[1]);\n";
+    xxh += "v2 = xxhRound(v2, x[2]);\n";
+    xxh += "v3 = xxhRound(v3, x[3]);\n";
+    xxh += "}\n";
+    xxh += "h = rotate(v0, (ulong)1) + rotate(v1, (ulong)7) + rotate(v2, (ulong)12) + rotate(v3, (ulong)18);\n";
+    xxh += "h = xxhMerge(xxhMerge(xxhMerge(xxhMerge(h, v0), v1), v2), v3);\n";
+    xxh += "}\n";
+    xxh += "h += bytes;\n";
+    xxh += "for(; bytes - k >= 8; k += 8) h = rotate(h ^ xxhRound(0, *(__global const ulong*)(p + k)), (ulong)27) * XXH_P1 + XXH_P4;\n";
+    xxh += "if(bytes - k >= 4){\n";
+    xxh += "h = rotate(h ^ ((ulong)*(__global const uint*)(p + k) * XXH_P1), (ulong)23) * XXH_P2 + XXH_P3;\n";
+    xxh += "k += 4;\n";
+    xxh += "}\n";
+    xxh += "for(; bytes > k; k++) h = rotate(h ^ (p[k] * XXH_P5), (ulong)11) * XXH_P1;\n";
+    xxh += "return xxhAvalanche(h);\n";
+    xxh += "}\n";
+
+    return xxh;
+}
+
+template<typename T>
+std::uint64_t mcf::Mat<T>::hash(ecl::Computer& video, std::uint64_t seed) const{
+    requireImmediate(video, "hash");
+
+    std::size_t bytes = total_size * sizeof(T);
+    std::size_t count = (bytes + HASH_CHUNK - 1) / HASH_CHUNK;
+    if(count == 0) return hash(seed);
+
+    // one work item per chunk, then one folds the chunk hashes in order; the seed comes in params[0]
+    ecl::Program chunk_prog = getXxHash();
+    chunk_prog += "__kernel void hashChunks";
+    chunk_prog += "(__global const uchar* a, __global ulong* chunks, __global ulong* params){\n";
+    chunk_prog += "size_t k = get_global_id(0);\n";
+    chunk_prog += "size_t bytes = " + std::to_string(bytes) + "UL - k * " + std::to_string(HASH_CHUNK) + "UL;\n";
+    chunk_prog += "if(bytes > " + std::to_string(HASH_CHUNK) + "UL) bytes = " + std::to_string(HASH_CHUNK) + "UL;\n";
+    chunk_prog += "chunks[k] = xxHash64(a + k * " + std::to_string(HASH_CHUNK) + "UL, bytes, params[0]);\n";
+    chunk_prog += "}";
+
+    ecl::Program fold_prog = getXxHash();
+    fold_prog += "__kernel void hashFold";
+    fold_prog += "(__global ulong* chunks, __global ulong* digest, __global ulong* params){\n";
+    fold_prog += "ulong fold = params[0] + XXH_P5;\n";
+    fold_prog += "for(size_t k = 0; k < " + std::to_string(count) + "UL; k++) fold = xxhMerge(fold, chunks[k]);\n";
+    fold_prog += "fold = xxhMerge(fold, " + std::to_string(h) + "UL);\n";
+    fold_prog += "fold = xxhMerge(fold, " + std::to_string(w) + "UL);\n";
+    fold_prog += "fold = xxhMerge(fold, " + std::to_string(sizeof(T)) + "UL);\n";
+    fold_prog += "digest[0] = xxhAvalanche(fold);\n";
+    fold_prog += "}";
+
+    ecl::Kernel hashChunks = "hashChunks";
+    ecl::Kernel hashFold = "hashFold";
+
+    auto params = deviceParameters<std::uint64_t>(video, {seed});
+    auto chunks = deviceScratch<std::uint64_t>(video, 1, count);
+    Mat<std::uint64_t> digest(1, 1);
+    digest.send(video);
+
+    ecl::Frame chunk_frame = {cacheProgram(chunk_prog, video), hashChunks, {&arr, &chunks->arr, &params->arr}};
+    ecl::Frame fold_frame = {cacheProgram(fold_prog, video), hashFold, {&chunks->arr, &digest.arr, &params->arr}};
+    launch(video, chunk_frame, {count}, ASYNC, params);
+    launch(video, fold_frame, {1}, SYNC, chunks);
+
+    digest.receive(video);
+    digest.release(video);
+
+    return digest.getE(0, 0);
+}
+
+template<typename T>
+void mcf::Mat<T>::reshape(std::size_t new_h, std::size_t new_w){
+    requireTotalSize(*this, new_h * new_w, "reshape");
+    h = new_h;
+    w = new_w;
+}
+template<typename T>
+void mcf::Mat<T>::ravel(mcf::RAVEL option){
+    if(option == COLUMN) reshape(total_size, 1);
+    else reshape(1, total_size);
+}
+
+template<typename T>
+void mcf::Mat<T>::regrow(std::size_t new_capacity){
+    // views and pinned blocks are left behind too, the new buffer is owned and keeps the storage mode
+    Mat<T> old(std::move(*this));
+
+    allocate(new_capacity, old.storage);
+    h = old.h;
+    w = old.w;
+    total_size = old.total_size;
+    ref = false;
+
+    const T* src = old.arr;
+    parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+        std::copy(src + first, src + last, arr + first);
+    });
+}
+
+template<typename T>
+void mcf::Mat<T>::reserve(std::size_t size){
+    if(size > capacity) regrow(size);
+}
+template<typename T>
+void mcf::Mat<T>::reserve(std::size_t size, ecl::Computer& video){
+    if(capacity >= size) return;
+    requireImmediate(video, "reserve");
+
+    // an empty matrix has nothing on the computer yet
+    if(capacity > 0){
+        receive(video);
+        release(video);
+    }
+    regrow(size);
+    send(video);
+}
+template<typename T>
+void mcf::Mat<T>::shrinkToFit(){
+    if(capacity > total_size) regrow(total_size);
+}
+
+template<typename T>
+void mcf::Mat<T>::resize(std::size_t new_h, std::size_t new_w){
+    // a view is copied into an owned buffer first, the block it looks at isn't written
+    if(ref) regrow(std::max(new_h * new_w, total_size));
+    else reserve(new_h * new_w);
+
+    // rows move to their new stride in place: from the back when they grow, from the front when they shrink
+    std::size_t rows = std::min(h, new_h);
+    T* a = arr;
+    if(new_w > w){
+        for(std::size_t i = rows; i > 0; i--){
+            std::copy_backward(a + (i - 1) * w, a + (i - 1) * w + w, a + (i - 1) * new_w + w);
+            std::fill(a + (i - 1) * new_w + w, a + i * new_w, T(0));
+        }
+    }else if(new_w < w){
+        for(std::size_t i = 0; rows > i; i++) std::copy(a + i * w, a + i * w + new_w, a + i * new_w);
+    }
+    if(new_h > rows) std::fill(a + rows * new_w, a + new_h * new_w, T(0));
+
+    h = new_h;
+    w = new_w;
+    total_size = new_h * new_w;
+}
+
+// methods (mutable)
+template<typename T>
+void mcf::Mat<T>::foreach(const std::function<void(std::size_t, std::size_t)>& f){
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            for(std::size_t j = 0; w > j; j++) f(i, j);
+        }
+    });
+}
+template<typename T>
+void mcf::Mat<T>::foreach(const std::string& body, ecl::Computer& video, ecl::EXEC sync){
+    std::string type = getTypeName();
+
+    ecl::Program prog = "__kernel void foreach";
+    prog += "(__global " + type + "* result)";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t h = get_global_size(0);\n";
+    prog += "size_t w = get_global_size(1);\n";
+    prog += body + "\n";
+    prog += "}";
+
+    ecl::Kernel foreach = "foreach";
+
+    ecl::Frame frame = {cacheProgram(prog, video), foreach, {&arr}};
+    launch(video, frame, {h, w}, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::gen(const std::function<T(std::size_t, std::size_t)>& f){
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            for(std::size_t j = 0; w > j; j++) setE(f(i, j), i, j);
+        }
+    });
+}
+template<typename T>
+void mcf::Mat<T>::gen(const std::string& body, ecl::Computer& video, ecl::EXEC sync){
+    std::string type = getTypeName();
+
+    ecl::Program prog = "__kernel void gen";
+    prog += "(__global " + type + "* result)";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t h = get_global_size(0);\n";
+    prog += "size_t w = get_global_size(1);\n";
+    prog += "size_t index = i * w + j;\n";
+    prog += type + " ret;\n";
+    prog += body + "\n";
+    prog += "result[index] = ret;";
+    prog += "}";
+
+    ecl::Kernel gen = "gen";
+
+    ecl::Frame frame = {cacheProgram(prog, video), gen, {&arr}};
+    launch(video, frame, {h, w}, sync);
+}
+
+template<typename T>
+template<std::size_t WORDS, typename F>
+void mcf::Mat<T>::randomBlocks(std::uint64_t seed, const F& f){
+    // value k takes words [k * WORDS, (k + 1) * WORDS) of the stream, block n of the stream is philox(n, seed)
+    constexpr std::size_t PER_BLOCK = 4 / WORDS;
+    constexpr std::size_t TILE = 256;
+    std::size_t blocks = (total_size + PER_BLOCK - 1) / PER_BLOCK;
+    std::uint32_t k0 = std::uint32_t(seed);
+    std::uint32_t k1 = std::uint32_t(seed >> 32);
+    T* r = arr;
+
+    parallelFor(0, blocks, TASK_GRAIN / PER_BLOCK, [&](std::size_t first, std::size_t last){
+        // the words of a tile first, then the values, so both loops vectorize
+        std::uint32_t stream[4 * TILE];
+
+        for(std::size_t tile = first; last > tile; tile += TILE){
+            std::size_t count = std::min(TILE, last - tile);
+
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd
+            #endif
+            for(std::size_t n = 0; count > n; n++){
+                std::uint32_t c[4] = {std::uint32_t(tile + n), std::uint32_t(std::uint64_t(tile + n) >> 32), 0, 0};
+                philox(c, k0, k1);
+                stream[4 * n] = c[0];
+                stream[4 * n + 1] = c[1];
+                stream[4 * n + 2] = c[2];
+                stream[4 * n + 3] = c[3];
+            }
+
+            std::size_t begin = tile * PER_BLOCK;
+            std::size_t end = std::min(total_size, (tile + count) * PER_BLOCK);
+
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd
+            #endif
+            for(std::size_t k = begin; end > k; k++) r[k] = f(stream + (k - begin) * WORDS);
+        }
+    });
+}
+template<typename T>
+std::uint64_t mcf::Mat<T>::getRandomRange(DISTRIBUTION distribution, double a, double b) const{
+    // integer UNIFORM maps a 32 bit word onto [a, b), BERNOULLI compares a word with p 2^32
+    if(distribution == NORMAL) requireFloatingPoint("random");
+
+    if(distribution == BERNOULLI){
+        if(!(a >= 0 && a <= 1)) throw std::runtime_error("Random: probability " + std::to_string(a) + " isn't in [0, 1]");
+        return std::uint64_t(std::ldexp(a, 32));
+    }
+
+    if(distribution == UNIFORM && !std::is_floating_point<T>::value){
+        if(!(b > a) || b - a > std::ldexp(1.0, 32)) throw std::runtime_error("Random: wrong integer range [" + std::to_string(a) + ", " + std::to_string(b) + ")");
+        return std::uint64_t(T(b)) - std::uint64_t(T(a));
+    }
+
+    return 0;
+}
+
+template<typename T>
+void mcf::Mat<T>::random(std::uint64_t seed, DISTRIBUTION distribution, double a, double b){
+    std::uint64_t range = getRandomRange(distribution, a, b);
+
+    if(distribution == BERNOULLI){
+        randomBlocks<1>(seed, [range](const std::uint32_t* c){
+            return T(range > c[0]);
+        });
+    }else if constexpr(std::is_same<T, double>::value){
+        // 53 bits from two words, products by powers of two are exact and fusing them changes nothing
+        auto uniform = [](const std::uint32_t* c){
+            return double(((std::uint64_t(c[0]) << 32) | c[1]) >> 11) * 0x1p-53;
+        };
+
+        if(distribution == UNIFORM){
+            double range = b - a;
+            double top = std::nextafter(b, a);
+            randomBlocks<2>(seed, [=](const std::uint32_t* c){
+                return randomBelow(std::fma(range, uniform(c), a), a, b, top);
+            });
+        }else{
+            randomBlocks<2>(seed, [=](const std::uint32_t* c){
+                return std::fma(b, normalQuantile(uniform(c) + 0x1p-53), a);
+            });
+        }
+    }else if constexpr(std::is_same<T, float>::value){
+        // 24 bits, 23 with the half step for the open interval of NORMAL
+        T low = T(a);
+        T high = T(b);
+
+        if(distribution == UNIFORM){
+            T range = high - low;
+            T top = std::nextafter(high, low);
+            randomBlocks<1>(seed, [=](const std::uint32_t* c){
+                return randomBelow(std::fma(range, T(c[0] >> 8) * 0x1p-24f, low), low, high, top);
+            });
+        }else{
+            randomBlocks<1>(seed, [=](const std::uint32_t* c){
+                return std::fma(high, normalQuantile(T(c[0] >> 9) * 0x1p-23f + 0x1p-24f), low);
+            });
+        }
+    }else if constexpr(std::is_floating_point<T>::value){
+        Mat<double> values(h, w);
+        values.random(seed, distribution, a, b);
+        for(std::size_t i = 0; total_size > i; i++) arr[i] = T(values.arr[i]);
+    }else{
+        std::uint64_t low = std::uint64_t(T(a));
+        randomBlocks<1>(seed, [=](const std::uint32_t* c){
+            return T(low + ((std::uint64_t(c[0]) * range) >> 32));
+        });
+    }
+}
+template<typename T>
+void mcf::Mat<T>::random(std::uint64_t seed, ecl::Computer& video, DISTRIBUTION distribution, double a, double b, ecl::EXEC sync){
+    std::uint64_t range = getRandomRange(distribution, a, b);
+
+    std::string type = getTypeName();
+    bool is_double = std::is_same<T, double>::value;
+    std::string bits = is_double ? "long" : "int";
+    std::size_t words = is_double && distribution != BERNOULLI ? 2 : 1;
+    std::size_t per_block = 4 / words;
+    std::size_t blocks = (total_size + per_block - 1) / per_block;
+
+    ecl::Program prog = "";
+
+    // the same operations as randomLog, randomRsqrt and normalQuantile
+    if(distribution == NORMAL){
+        using F = typename std::conditional<std::is_same<T, double>::value, double, float>::type;
+        using M = MathTraits<F>;
+        auto literal = [&](double v){
+            return getLiteral(T(v));
+        };
+        auto horner = [&](const T* c, std::size_t n, const std::string& x){
+            std::string r = literal(c[n - 1]);
+            for(std::size_t i = n - 1; i > 0; i--) r = "fma(" + r + ", " + x + ", " + literal(c[i - 1]) + ")";
+            return r;
+        };
+
+        prog += type + " randomLog(" + type + " x){\n";
+        prog += bits + " bits = as_" + bits + "(x);\n";
+        prog += bits + " e = (bits >> " + std::to_string(M::MANTISSA) + ") - " + std::to_string(M::BIAS) + ";\n";
+        prog += bits + " m_bits = (bits & " + std::to_string((typename M::I(1) << M::MANTISSA) - 1) + (is_double ? "L" : "") + ") | ((" + bits + ")" + std::to_string(M::BIAS) + " << " + std::to_string(M::MANTISSA) + ");\n";
+        prog += "int high = m_bits > " + std::to_string(asBits(F(1.41421356237309504880))) + (is_double ? "L" : "") + ";\n";
+        prog += "e = high ? e + 1 : e;\n";
+        prog += type + " m = as_" + type + "(high ? m_bits - ((" + bits + ")1 << " + std::to_string(M::MANTISSA) + ") : m_bits);\n";
+        prog += type + " d = (m + 1) * " + literal(0.25) + ";\n";
+        prog += type + " y = fma(" + literal(-32.0 / 17) + ", d, " + literal(48.0 / 17) + ");\n";
+        for(std::size_t i = 0; 4 > i; i++) prog += "y = y * fma(-d, y, " + literal(2) + ");\n";
+        prog += type + " f = (m - 1) * (y * " + literal(0.25) + ");\n";
+        prog += "return fma((" + type + ")e, " + literal(0.693147180559945309417) + ", 2 * f * " + horner(RANDOM_LOG<T>, 5, "(f * f)") + ");\n";
+        prog += "}\n";
+
+        prog += type + " randomRsqrt(" + type + " x){\n";
+        prog += type + " half = " + literal(0.5) + " * x;\n";
+        prog += type + " y = as_" + type + "(" + std::to_string(M::RSQRT) + (is_double ? "L" : "") + " - (as_" + bits + "(x) >> 1));\n";
+        for(std::size_t i = 0; 4 > i; i++) prog += "y = y * fma(-(half * y), y, " + literal(1.5) + ");\n";
+        prog += "return y;\n";
+        prog += "}\n";
+
+        prog += type + " normalQuantile(" + type + " u){\n";
+        prog += type + " x = fma(" + literal(2) + ", u, " + literal(-1) + ");\n";
+        prog += type + " w = -randomLog((1 - x) * (1 + x));\n";
+        prog += type + " center = " + horner(RANDOM_CENTER<T>, 9, "(w - " + literal(2.5) + ")") + ";\n";
+        prog += type + " tail = " + horner(RANDOM_TAIL<T>, 9, "fma(w, randomRsqrt(w), " + literal(-3) + ")") + ";\n";
+        prog += "return " + literal(1.41421356237309504880) + " * (x * (w < 5 ? center : tail));\n";
+        prog += "}\n";
+    }
+
+    // the value v of words c[l * words], ... and the stored element
+    std::string value;
+    std::string store = "v";
+    if(distribution == BERNOULLI) value = "(" + type + ")(" + std::to_string(range) + "UL > c[l])";
+    else if(!std::is_floating_point<T>::value) value = "(" + type + ")(" + std::to_string(std::uint64_t(T(a))) + "UL + (((ulong)c[l] * " + std::to_string(range) + "UL) >> 32))";
+    else{
+        std::string uniform = is_double ? "(double)((((ulong)c[2 * l] << 32) | c[2 * l + 1]) >> 11) * " + getLiteral(T(0x1p-53)) : "(float)(c[l] >> 8) * " + getLiteral(T(0x1p-24));
+        if(distribution == UNIFORM){
+            // as randomBelow
+            value = "fma(" + getLiteral(T(b) - T(a)) + ", " + uniform + ", " + getLiteral(T(a)) + ")";
+            store = "(" + (T(b) > T(a) ? getLiteral(T(b)) + " > v" : "v > " + getLiteral(T(b))) + " ? v : " + getLiteral(std::nextafter(T(b), T(a))) + ")";
+        }else{
+            std::string open = is_double ? uniform + " + " + getLiteral(T(0x1p-53)) : "(float)(c[l] >> 9) * " + getLiteral(T(0x1p-23)) + " + " + getLiteral(T(0x1p-24));
+            value = "fma(" + getLiteral(T(b)) + ", normalQuantile(" + open + "), " + getLiteral(T(a)) + ")";
+        }
+    }
+
+    // the seed and the size come in a buffer, so a new seed doesn't build a new program
+    prog += "__kernel void random";
+    prog += "(__global " + type + "* result, __global ulong* params){\n";
+    prog += "size_t n = get_global_id(0);\n";
+    prog += "uint c[4] = {(uint)n, (uint)((ulong)n >> 32), 0, 0};\n";
+    prog += "uint k0 = (uint)params[0];\n";
+    prog += "uint k1 = (uint)(params[0] >> 32);\n";
+    prog += "for(int r = 0; r < 10; r++){\n";
+    prog += "ulong p0 = (ulong)" + std::to_string(PHILOX_M0) + "U * c[0];\n";
+    prog += "ulong p1 = (ulong)" + std::to_string(PHILOX_M1) + "U * c[2];\n";
+    prog += "c[0] = (uint)(p1 >> 32) ^ c[1] ^ k0;\n";
+    prog += "c[1] = (uint)p1;\n";
+    prog += "c[2] = (uint)(p0 >> 32) ^ c[3] ^ k1;\n";
+    prog += "c[3] = (uint)p0;\n";
+    prog += "k0 += " + std::to_string(PHILOX_W0) + "U;\n";
+    prog += "k1 += " + std::to_string(PHILOX_W1) + "U;\n";
+    prog += "}\n";
+    prog += "for(size_t l = 0; l < " + std::to_string(per_block) + "; l++){\n";
+    prog += "size_t index = n * " + std::to_string(per_block) + " + l;\n";
+    prog += "if(index < params[1]){\n";
+    prog += type + " v = " + value + ";\n";
+    prog += "result[index] = " + store + ";\n";
+    prog += "}\n";
+    prog += "}\n";
+    prog += "}";
+
+    ecl::Kernel random = "random";
+
+    auto params = deviceParameters<std::uint64_t>(video, {seed, total_size});
+
+    ecl::Frame frame = {cacheProgram(prog, video), random, {&arr, &params->arr}};
+    launch(video, frame, {blocks}, sync, params);
+}
+
+template<typename T>
+void mcf::Mat<T>::full(const T& value){
+    gen([&](std::size_t i, std::size_t j){
+        return value;
+    });
+}
+template<typename T>
+void mcf::Mat<T>::full(const T& value, ecl::Computer& video, ecl::EXEC sync){
+    std::string val = std::to_string(value);
+    gen("ret = " + val + ";", video, sync);
+}
+template<typename T>
+void mcf::Mat<T>::zeros(){
+    gen([](std::size_t i, std::size_t j){
+        return T(0);
+    });
+}
+template<typename T>
+void mcf::Mat<T>::zeros(ecl::Computer& video, ecl::EXEC sync){
+    gen("ret = 0;", video, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::ones(){
+    gen([](std::size_t i, std::size_t j){
+        return T(1);
+    });
+}
+template<typename T>
+void mcf::Mat<T>::ones(ecl::Computer& video, ecl::EXEC sync){
+    gen("ret = 1;", video, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::eye(const T& value){
+    gen([&](std::size_t i, std::size_t j){
+        return i == j ? value : T(0);
+    });
+}
+template<typename T>
+void mcf::Mat<T>::eye(const T& value, ecl::Computer& video, ecl::EXEC sync){
+    std::string val = std::to_string(value);
+    gen("ret = i == j ? + " + val + " : 0;", video, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::hstack(const Mat<T>& A, const Mat<T>& B){
+    requireMatrixH(A.h, B.h, "hstack");
+    requireMatrixShape(*this, A.h, A.w + B.w, "hstack", true);
+
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            for(std::size_t j = 0; w > j; j++){
+                if(A.w > j) setE(A.getE(i, j), i, j);
+                else setE(B.getE(i, j - A.w), i, j);
+            }
+        }
+    });
+}
+
+template<typename T>
+void mcf::Mat<T>::hstack(const Mat<T>& A, const Mat<T>& B, ecl::Computer& video, ecl::EXEC sync){
+    std::string type = getTypeName();
+
+    requireMatrixH(A.h, B.h, "hstack");
+    requireMatrixShape(*this, A.h, A.w + B.w, "hstack", true);
+
+    ecl::Program prog = "__kernel void hstack";
+    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t w = get_global_size(1);\n";
+    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
+    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
+    prog += "if(j < a_w) result[i * w + j] = a[i * a_w + j];\n";
+    prog += "else result[i * w + j] = b[i * b_w + j - a_w];\n";
+    prog += "}";
+
+    ecl::Kernel hstack = "hstack";
+
+    ecl::Frame frame = {cacheProgram(prog, video), hstack, {&A.arr, &B.arr, &arr}};
+    launch(video, frame, {h, w}, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::hstack(const std::vector<const mcf::Mat<T>*>& vec){
+    size_t total_h = vec[0]->getH();
+    size_t total_w = 0;
+
+    for(auto* m : vec){
+        requireMatrixH(total_h, m->getH(), "hstack");
+        total_w += m->getW();
+    }
+    requireMatrixShape(*this, total_h, total_w, "hstack", true);
+
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            const auto* curr = vec[0];
+            size_t index = 0;
+            size_t offset = 0;
+            for(std::size_t j = 0; w > j; j++){
+                if(curr->w + offset <= j) {
+                    index++;
+                    offset += curr->getW();
+                    curr = vec[index];
+                }
+                setE(curr->getE(i, j - offset), i, j);
+            }
+        }
+    });
+}
+
+template<typename T>
+void mcf::Mat<T>::vstack(const Mat<T>& A, const Mat<T>& B){
+    requireMatrixH(A.w, B.w, "vstack");
+    requireMatrixShape(*this, A.h + B.h, A.w, "vstack", true);
+
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            for(std::size_t j = 0; w > j; j++){
+                if(A.h > i) setE(A.getE(i, j), i, j);
+                else setE(B.getE(i - A.h, j), i, j);
+            }
+        }
+    });
+}
+template<typename T>
+void mcf::Mat<T>::vstack(const Mat<T>& A, const Mat<T>& B, ecl::Computer& video, ecl::EXEC sync){
+    std::string type = getTypeName();
+
+    requireMatrixH(A.w, B.w, "vstack");
+    requireMatrixShape(*this, A.h + B.h, A.w, "vstack", true);
+
+    ecl::Program prog = "__kernel void vstack";
+    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t w = get_global_size(1);\n";
+    prog += "size_t a_h = " + std::to_string(A.h) + ";\n";
+    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
+    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
+    prog += "if(i < a_h) result[i * w + j] = a[i * a_w + j];\n";
+    prog += "else result[i * w + j] = b[(i - a_h) * b_w + j];\n";
+    prog += "}";
+
+    ecl::Kernel vstack = "vstack";
+
+    ecl::Frame frame = {cacheProgram(prog, video), vstack, {&A.arr, &B.arr, &arr}};
+    launch(video, frame, {h, w}, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::vstack(const std::vector<const mcf::Mat<T>*>& vec){
+    size_t total_h = 0;
+    size_t total_w = vec[0]->getW();
+
+    for(auto* m : vec){
+        requireMatrixW(total_w, m->getW(), "vstack");
+        total_h += m->getH();
+    }
+    requireMatrixShape(*this, total_h, total_w, "vstack", true);
+
+    parallelFor(0, w, TASK_GRAIN / std::max<std::size_t>(h, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t j = first; last > j; j++){
+            const auto* curr = vec[0];
+            size_t index = 0;
+            size_t offset = 0;
+            for(std::size_t i = 0; h > i; i++){
+                if(curr->h + offset <= i) {
+                    index++;
+                    offset += curr->getH();
+                    curr = vec[index];
+                }
+                setE(curr->getE(i - offset, j), i, j);
+            }
+        }
+    });
+}
+
+template<typename T>
+void mcf::Mat<T>::cpy(const Mat<T>& X){
+    requireMatrixShape(X, h, w, "cpy");
+
+    const T* src = X.arr;
+    parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+        std::copy(src + first, src + last, arr + first);
+    });
+}
+template<typename T>
+void mcf::Mat<T>::view(Mat<T>& X){
+    requireTotalSize(X, total_size, "view");
+
+	arr.view(X.getArray());
+	capacity = total_size;
+	ref = true;
+}
+
+template<typename T>
+void mcf::Mat<T>::ger(const Mat<T>& u, const Mat<T>& v, const T& alpha){
+    requireTotalSize(u, h, "ger");
+    requireTotalSize(v, w, "ger");
+
+    const T* a = u.arr;
+    const T* b = v.arr;
+    T* r = arr;
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            T s = alpha * a[i];
+            T* row = r + i * w;
+
+            #ifdef MATRIXCF_USE_OPENMP
+            #pragma omp simd
+            #endif
+            for(std::size_t j = 0; w > j; j++) row[j] += s * b[j];
+        }
+    });
+}
+template<typename T>
+void mcf::Mat<T>::ger(const Mat<T>& u, const Mat<T>& v, ecl::Computer& video, const T& alpha, ecl::EXEC sync){
+    requireTotalSize(u, h, "ger");
+    requireTotalSize(v, w, "ger");
+
+    std::string type = getTypeName();
+
+    ecl::Program prog = "__kernel void ger";
+    prog += "(__global " + type + "* a, __global " + type + "* u, __global " + type + "* v, __global " + type + "* scale){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "a[i * " + std::to_string(w) + " + j] += (scale[0] * u[i]) * v[j];\n";
+    prog += "}";
+
+    ecl::Kernel ger = "ger";
+
+    auto scale = deviceParameters(video, {alpha});
+
+    ecl::Frame frame = {cacheProgram(prog, video), ger, {&arr, &u.arr, &v.arr, &scale->arr}};
+    launch(video, frame, {h, w}, sync, scale);
+}
+
+template<typename T>
+void mcf::Mat<T>::rankUpdate(const Mat<T>& U, const Mat<T>& V, const T& alpha){
+    requireMatrixShape(U, h, U.w, "rankUpdate");
+    requireMatrixShape(V, w, U.w, "rankUpdate");
+    if(&U == this || &V == this) throw std::runtime_error("rankUpdate: the matrix can't update itself");
+
+    parallelGemm(false, true, h, w, U.w, alpha, static_cast<const T*>(U.arr), U.w, static_cast<const T*>(V.arr), V.w, static_cast<T*>(arr), w);
+}
+template<typename T>
+void mcf::Mat<T>::rankUpdate(const Mat<T>& U, const Mat<T>& V, ecl::Computer& video, const T& alpha, ecl::EXEC sync){
+    requireMatrixShape(U, h, U.w, "rankUpdate");
+    requireMatrixShape(V, w, U.w, "rankUpdate");
+    if(&U == this || &V == this) throw std::runtime_error("rankUpdate: the matrix can't update itself");
+
+    // beta = 1 reads every element once in the epilogue and writes it back
+    U.gemm(V, *this, video, alpha, T(1), SECOND, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::syrk(const Mat<T>& U, const T& alpha, TRIANGLE option){
+    requireMatrixShape(*this, h, h, "syrk");
+    requireMatrixShape(U, h, U.w, "syrk");
+    if(&U == this) throw std::runtime_error("syrk: the matrix can't update itself");
+
+    // tiles on one side of the diagonal only, diagonal tiles go through a small buffer to keep the other triangle
+    constexpr std::size_t TB = 128;
+    std::size_t k = U.w;
+    std::size_t blocks = (h + TB - 1) / TB;
+    const T* u = U.arr;
+    T* a = arr;
+
+    parallelFor(0, blocks * (blocks + 1) / 2, 1, [&](std::size_t first, std::size_t last){
+        std::vector<T> tile;
+
+        for(std::size_t pair = first; last > pair; pair++){
+            std::size_t bi = 0;
+            while((bi + 1) * (bi + 2) / 2 <= pair) bi++;
+            std::size_t bj = pair - bi * (bi + 1) / 2;
+            if(option == UPPER) std::swap(bi, bj);
+
+            std::size_t i0 = bi * TB;
+            std::size_t j0 = bj * TB;
+            std::size_t mb = std::min(TB, h - i0);
+            std::size_t nb = std::min(TB, h - j0);
+
+            if(bi != bj){
+                blockedGemm(false, true, mb, nb, k, alpha, u + i0 * k, k, u + j0 * k, k, a + i0 * h + j0, h);
+                continue;
+            }
+
+            tile.assign(mb * mb, T(0));
+            blockedGemm(false, true, mb, mb, k, alpha, u + i0 * k, k, u + i0 * k, k, tile.data(), mb);
+            for(std::size_t i = 0; mb > i; i++){
+                std::size_t j_first = option == LOWER ? 0 : i;
+                std::size_t j_last = option == LOWER ? i + 1 : mb;
+                for(std::size_t j = j_first; j_last > j; j++) a[(i0 + i) * h + i0 + j] += tile[i * mb + j];
+            }
+        }
+    });
+}
+template<typename T>
+void mcf::Mat<T>::syrk(const Mat<T>& U, ecl::Computer& video, const T& alpha, TRIANGLE option, ecl::EXEC sync){
+    requireMatrixShape(*this, h, h, "syrk");
+    requireMatrixShape(U, h, U.w, "syrk");
+    if(&U == this) throw std::runtime_error("syrk: the matrix can't update itself");
+
+    std::string type = getTypeName();
+    std::string k = std::to_string(U.w);
+
+    ecl::Program prog = "__kernel void syrk";
+    prog += "(__global " + type + "* a, __global " + type + "* u, __global " + type + "* scale){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += option == LOWER ? "if(j > i) return;\n" : "if(j < i) return;\n";
+    prog += type + " sum = 0;\n";
+    prog += "for(size_t p = 0; p < " + k + "; p++) sum += u[i * " + k + " + p] * u[j * " + k + " + p];\n";
+    prog += "a[i * " + std::to_string(h) + " + j] += scale[0] * sum;\n";
+    prog += "}";
+
+    ecl::Kernel syrk = "syrk";
+
+    auto scale = deviceParameters(video, {alpha});
+
+    ecl::Frame frame = {cacheProgram(prog, video), syrk, {&arr, &U.arr, &scale->arr}};
+    launch(video, frame, {h, h}, sync, scale);
+}
+
+template<typename T>
+void mcf::Mat<T>::appendRows(const Mat<T>& X){
+    if(X.total_size == 0) return;
+    if(&X == this){
+        Mat<T> copy = X;
+        appendRows(copy);
+        return;
+    }
+    if(total_size > 0) requireMatrixW(X.w, w, "appendRows");
+
+    std::size_t size = total_size + X.total_size;
+    if(size > capacity) reserve(std::max(size, 2 * capacity));
+
+    // rows are contiguous, X goes right behind the used block
+    const T* src = X.arr;
+    T* dst = arr + total_size;
+    parallelFor(0, X.total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+        std::copy(src + first, src + last, dst + first);
+    });
+
+    h = (total_size > 0 ? h : 0) + X.h;
+    w = X.w;
+    total_size = size;
+}
+template<typename T>
+void mcf::Mat<T>::appendRows(const Mat<T>& X, ecl::Computer& video, ecl::EXEC sync){
+    if(X.total_size == 0) return;
+    if(&X == this) throw std::runtime_error("appendRows: the matrix can't append itself on a computer");
+    if(total_size > 0) requireMatrixW(X.w, w, "appendRows");
+
+    std::size_t size = total_size + X.total_size;
+    if(size > capacity) reserve(std::max(size, 2 * capacity), video);
+
+    // within the capacity the device buffer stays, only X is copied into its tail
+    std::string type = getTypeName();
+
+    // the offset is an input, so appends of the same block share a program
+    ecl::Program prog = "__kernel void appendRows";
+    prog += "(__global " + type + "* a, __global " + type + "* x, __global ulong* offset){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "a[offset[0] + i] = x[i];\n";
+    prog += "}";
+
+    ecl::Kernel append = "appendRows";
+
+    auto offset = deviceParameters<std::uint64_t>(video, {total_size});
+
+    ecl::Frame frame = {cacheProgram(prog, video), append, {&arr, &X.arr, &offset->arr}};
+    launch(video, frame, {X.total_size}, sync, offset);
+
+    h = (total_size > 0 ? h : 0) + X.h;
+    w = X.w;
+    total_size = size;
+}
+template<typename T>
+void mcf::Mat<T>::appendColumns(const Mat<T>& X){
+    if(X.total_size == 0) return;
+    if(&X == this){
+        Mat<T> copy = X;
+        appendColumns(copy);
+        return;
+    }
+    if(total_size > 0) requireMatrixH(X.h, h, "appendColumns");
+
+    std::size_t left_w = total_size > 0 ? w : 0;
+    std::size_t size = X.h * (left_w + X.w);
+    if(size > capacity) reserve(std::max(size, 2 * capacity));
+    resize(X.h, left_w + X.w);
+
+    const T* right = X.arr;
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++) std::copy(right + i * X.w, right + (i + 1) * X.w, arr + i * w + left_w);
+    });
+}
+
+// higher-order methods (immutable)
+template<typename T>
+void mcf::Mat<T>::map(const std::function<T(const T&)>& f, mcf::Mat<T>& result, TRANSPOSE option) const
+{
+    if(option == NONE){
+        requireMatrixShape(result, h, w, "map", true);
+
+        parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++) result.arr[i] = f(arr[i]);
+        });
+    }
+    else{
+        requireMatrixShape(result, w, h, "map", true);
+
+        parallelFor(0, w, TASK_GRAIN / std::max<std::size_t>(h, 1), [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++){
+                for(std::size_t j = 0; h > j; j++) result[i][j] = f(getE(j, i));
+            }
+        });
+    }
+}
+template<typename T>
+void mcf::Mat<T>::map(const std::string& body, mcf::Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const
+{
+    std::string type = getTypeName();
+
+    if(option == NONE){
+        requireMatrixShape(result, h, w, "map", true);
+
+        ecl::Program prog = "__kernel void map";
+        prog += "(__global " + type + "* a, __global " + type + "* result){\n";
+        prog += "size_t index = get_global_id(0);\n";
+        prog += type + " v = a[index];\n";
+        prog += type + " ret;\n";
+        prog += body + "\n";
+        prog += "result[index] = ret;\n";
+        prog += "}";
+
+        ecl::Kernel map = "map";
+
+        ecl::Frame frame = {cacheProgram(prog, video), map, {&arr, &result.arr}};
+        launch(video, frame, {total_size}, sync);
+    }
+    else{
+        requireMatrixShape(result, w, h, "map", true);
+
+        ecl::Program prog = "__kernel void map";
+        prog += "(__global " + type + "* a, __global " + type + "* result)";
+        prog += "{\n";
+        prog += "";
+        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
+        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
+        prog += type + " v = a[index];\n";
+        prog += type + " ret;\n";
+        prog += body + "\n";
+        prog += "result[result_index] = ret;\n";
+        prog += "}";
+
+        ecl::Kernel map = "map";
+
+        ecl::Frame frame = {cacheProgram(prog, video), map, {&arr, &result.arr}};
+        launch(video, frame, {w, h}, sync);
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::transform(const Mat<T>& X, const std::function<T(const T&, const T&)>& f, Mat<T>& result, TRANSPOSE option) const{
+    if(option == NONE){
+        auto [r_h, r_w] = requireBroadcastShape(X, "transform");
+        requireMatrixShape(result, r_h, r_w, "transform", true);
+
+        if(h == X.h && w == X.w){
+            parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+                for(std::size_t i = first; last > i; i++) result.arr[i] = f(arr[i], X.arr[i]);
+            });
+        }else{
+            // broadcast dimensions get zero stride, operands aren't expanded
+            std::size_t a_row = h == 1 ? 0 : w;
+            std::size_t a_col = w == 1 ? 0 : 1;
+            std::size_t b_row = X.h == 1 ? 0 : X.w;
+            std::size_t b_col = X.w == 1 ? 0 : 1;
+
+            parallelFor(0, r_h, TASK_GRAIN / std::max<std::size_t>(r_w, 1), [&](std::size_t first, std::size_t last){
+                for(std::size_t i = first; last > i; i++){
+                    const T* a = arr + i * a_row;
+                    const T* b = X.arr + i * b_row;
+                    T* r = result.arr + i * r_w;
+                    for(std::size_t j = 0; r_w > j; j++) r[j] = f(a[j * a_col], b[j * b_col]);
+                }
+            });
+        }
+
+    }else if(option == FIRST){
+        requireMatrixShape(X, w, h, "transform");
+        requireMatrixShape(result, w, h, "transform", true);
+
+        parallelFor(0, w, TASK_GRAIN / std::max<std::size_t>(h, 1), [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++){
+                for(std::size_t j = 0; h > j; j++) result[i][j] = f(getE(j, i), X.getE(i, j));
+            }
+        });
+
+    }else if(option == SECOND){
+        requireMatrixShape(*this, X.w, X.h, "transform");
+        requireMatrixShape(result, X.w, X.h, "transform", true);
+
+        parallelFor(0, X.w, TASK_GRAIN / std::max<std::size_t>(X.h, 1), [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++){
+                for(std::size_t j = 0; X.h > j; j++) result[i][j] = f(getE(i, j), X.getE(j, i));
+            }
+        });
+    }else{
+        requireMatrixShape(X, h, w, "transform");
+        requireMatrixShape(result, w, h, "transform", true);
+
+        parallelFor(0, w, TASK_GRAIN / std::max<std::size_t>(h, 1), [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++){
+                for(std::size_t j = 0; h > j; j++) result[i][j] = f(getE(j, i), X.getE(j, i));
+            }
+        });
+    }
+}
+template<typename T>
+void mcf::Mat<T>::transform(const Mat<T>& X, const std::string& body, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
+    if(option == NONE){
+        auto [r_h, r_w] = requireBroadcastShape(X, "transform");
+        requireMatrixShape(result, r_h, r_w, "transform", true);
+
+        std::string type = getTypeName();
+
+        ecl::Program prog = "__kernel void transform";
+        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+        prog += "{\n";
+        prog += "size_t index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
+        prog += type + " v1 = a[" + getBroadcastIndex(r_h, r_w) + "];\n";
+        prog += type + " v2 = b[" + X.getBroadcastIndex(r_h, r_w) + "];\n";
+        prog += type + " ret;\n";
+        prog += body + "\n";
+        prog += "result[index] = ret;\n";
+        prog += "}";
+
+        ecl::Kernel transform = "transform";
+
+        ecl::Frame frame = {cacheProgram(prog, video), transform, {&arr, &X.arr, &result.arr}};
+        launch(video, frame, {r_h, r_w}, sync);
+
+    }else if(option == FIRST){
+        requireMatrixShape(X, w, h, "transform");
+        requireMatrixShape(result, w, h, "transform", true);
+
+        std::string type = getTypeName();
+
+        ecl::Program prog = "__kernel void transform";
+        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+        prog += "{\n";
+        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
+        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
+        prog += type + " v1 = a[index];\n";
+        prog += type + " v2 = b[result_index];\n";
+        prog += type + " ret;\n";
+        prog += body + "\n";
+        prog += "result[result_index] = ret;\n";
+        prog += "}";
+
+        ecl::Kernel transform = "transform";
+
+        ecl::Frame frame = {cacheProgram(prog, video), transform, {&arr, &X.arr, &result.arr}};
+        launch(video, frame, {w, h}, sync);
+
+    }else if(option == SECOND){
+        requireMatrixShape(*this, X.w, X.h, "transform");
+        requireMatrixShape(result, X.w, X.h, "transform", true);
+
+        std::string type = getTypeName();
+
+        ecl::Program prog = "__kernel void transform";
+        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+        prog += "{\n";
+        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
+        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
+        prog += type + " v1 = a[result_index];\n";
+        prog += type + " v2 = b[index];\n";
+        prog += type + " ret;\n";
+        prog += body + "\n";
+        prog += "result[result_index] = ret;\n";
+        prog += "}";
+
+        ecl::Kernel transform = "transform";
+
+        ecl::Frame frame = {cacheProgram(prog, video), transform, {&arr, &X.arr, &result.arr}};
+        launch(video, frame, {X.w, X.h}, sync);
+    }else{
+        requireMatrixShape(X, h, w, "transform");
+        requireMatrixShape(result, w, h, "transform", true);
+
+        std::string type = getTypeName();
+
+        ecl::Program prog = "__kernel void transform";
+        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+        prog += "{\n";
+        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
+        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
+        prog += type + " v1 = a[index];\n";
+        prog += type + " v2 = b[index];\n";
+        prog += type + " ret;\n";
+        prog += body + "\n";
+        prog += "result[result_index] = ret;\n";
+        prog += "}";
+
+        ecl::Kernel transform = "transform";
+
+        ecl::Frame frame = {cacheProgram(prog, video), transform, {&arr, &X.arr, &result.arr}};
+        launch(video, frame, {w, h}, sync);
+    }
+}
+
+// methods (immutable)
+template<typename T>
+void mcf::Mat<T>::transpose(Mat<T>& result) const{
+    map([](const T& v){
+        return v;
+    }, result, FIRST);
+}
+template<typename T>
+void mcf::Mat<T>::transpose(Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    map("ret = v;", result, video, FIRST, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::reduce(Mat<T>& result, REDUCE option, TRANSPOSE transpose_option) const{
+    if(transpose_option == NONE){
+
+        if(option == FULL){
+            requireMatrixShape(result, 1, 1, "reduce", true);
+            result.zeros();
+
+            for(std::size_t i = 0; total_size > i; i++) result[0][0] += arr[i];
+        }else if(option == ROWS){
+            requireMatrixShape(result, 1, w, "reduce", true);
+            result.zeros();
+
+            // #pragma omp parallel for
+            for(std::size_t j = 0; w > j; j++){
+                for(std::size_t i = 0; h > i; i++) result[0][j] += getE(i, j);
+            }
+        } else if(option == COLUMNS){
+            requireMatrixShape(result, h, 1, "reduce", true);
+            result.zeros();
+
+            // #pragma omp parallel for
+            for(std::size_t i = 0; h > i; i++){
+                for(std::size_t j = 0; w > j; j++) result[i][0] += getE(i, j);
+            }
+        }
+    }else{
+            if(option == FULL){
+            requireMatrixShape(result, 1, 1, "reduce", true);
+            result.zeros();
+
+            // #pragma omp parallel for
+            for(std::size_t j = 0; h > j; j++){
+                for(std::size_t i = 0; w > i; i++) result[0][0] += getE(j, i);
+            }
+        }else if(option == ROWS){
+            requireMatrixShape(result, 1, h, "reduce", true);
+            result.zeros();
+
+            // #pragma omp parallel for
+            for(std::size_t j = 0; h > j; j++){
+                for(std::size_t i = 0; w > i; i++) result[0][j] += getE(j, i);
+            }
+        } else if(option == COLUMNS){
+            requireMatrixShape(result, w, 1, "reduce", true);
+            result.zeros();
+
+            // #pragma omp parallel for
+            for(std::size_t i = 0; w > i; i++){
+                for(std::size_t j = 0; h > j; j++) result[i][0] += getE(j, i);
+            }
+        }
+    }
+}
+template<typename T>
+void mcf::Mat<T>::reduce(Mat<T>& result, ecl::Computer& video, REDUCE option, TRANSPOSE transpose_option, ecl::EXEC sync) const{
+    if(transpose_option == NONE){
+        if(option == FULL){
+            throw std::runtime_error("full reduce on ecl::Computer temporary unavailable");
+        }else if(option == ROWS){
+            requireMatrixShape(result, 1, w, "reduce", true);
+            result.zeros(video);
+
+            std::string type = getTypeName();
+
+            ecl::Program prog = "__kernel void reduce";
+            prog += "(__global " + type + "* a, __global " + type + "* result)";
+            prog += "{\n";
+            prog += "size_t j = get_global_id(0);\n";
+            prog += "size_t w = get_global_size(0);\n";
+            prog += type + " sum = 0;\n";
+            prog += "for(size_t i = 0; i < " + std::to_string(h) + "; i++){\n";
+            prog += "sum += a[i * w + j];\n";
+            prog += "}\n";
+            prog += "result[j] = sum;\n";
+            prog += "}";
+
+            ecl::Kernel reduce = "reduce";
+
+            ecl::Frame frame = {cacheProgram(prog, video), reduce, {&arr, &result.arr}};
+            launch(video, frame, {w}, sync);
+
+        } else if(option == COLUMNS){
+            requireMatrixShape(result, h, 1, "reduce", true);
+            result.zeros(video);
+
+            std::string type = getTypeName();
+
+            ecl::Program prog = "__kernel void reduce";
+            prog += "(__global " + type + "* a, __global " + type + "* result)";
+            prog += "{\n";
+            prog += "size_t i = get_global_id(0);";
+            prog += "size_t h = get_global_size(0);";
+            prog += "size_t w = " + std::to_string(w) + ";";
+            prog += "size_t iw = i * w;\n";
+            prog += type + " sum = 0;\n";
+            prog += "for(size_t j = 0; j < w; j++){\n";
+            prog += "sum += a[iw + j];";
+            prog += "}\n";
+            prog += "result[i] = sum;\n";
+            prog += "}";
+
+            ecl::Kernel reduce = "reduce";
+
+            ecl::Frame frame = {cacheProgram(prog, video), reduce, {&arr, &result.arr}};
+            launch(video, frame, {h}, sync);
+        }
+    }else{
+        if(option == FULL){
+            throw std::runtime_error("full reduce on ecl::Computer temporary unavailable");
+        }else if(option == ROWS){
+            requireMatrixShape(result, 1, h, "reduce", true);
+            result.zeros(video);
+
+            std::string type = getTypeName();
+
+            ecl::Program prog = "__kernel void reduce";
+            prog += "(__global " + type + "* a, __global " + type + "* result)";
+            prog += "{\n";
+            prog += "size_t j = get_global_id(0);\n";
+            prog += "size_t w = " + std::to_string(w) + ";\n";
+            prog += type + " sum = 0;\n";
+            prog += "for(size_t i = 0; i < w; i++){\n";
+            prog += "sum += a[j * w + i];\n";
+            prog += "}\n";
+            prog += "result[j] = sum;\n";
+            prog += "}";
+
+            ecl::Kernel reduce = "reduce";
+
+            ecl::Frame frame = {cacheProgram(prog, video), reduce, {&arr, &result.arr}};
+            launch(video, frame, {h}, sync);
+
+        } else if(option == COLUMNS){
+            requireMatrixShape(result, w, 1, "reduce", true);
+            result.zeros(video);
+
+            std::string type = getTypeName();
+
+            ecl::Program prog = "__kernel void reduce";
+            prog += "(__global " + type + "* a, __global " + type + "* result)";
+            prog += "{\n";
+            prog += "size_t i = get_global_id(0);";
+            prog += "size_t h = " + std::to_string(h) + ";";
+            prog += "size_t w = get_global_size(0);";
+            prog += type + " sum = 0;\n";
+            prog += "for(size_t j = 0; j < h; j++){\n";
+            prog += "sum += a[j * w + i];";
+            prog += "}\n";
+            prog += "result[i] = sum;\n";
+            prog += "}";
+
+            ecl::Kernel reduce = "reduce";
+
+            ecl::Frame frame = {cacheProgram(prog, video), reduce, {&arr, &result.arr}};
+            launch(video, frame, {w}, sync);
+        }
+    }
+}
+
+template<typename T>
+T mcf::Mat<T>::reduce() const{
+    T result = 0;
+
+    for(std::size_t i = 0; i < total_size; i++) result += arr[i];
+
+    return result;
+}
+template<typename T>
+T mcf::Mat<T>::mreduce(const std::function<T(const T&)>& f) const {
+	T result = 0;
+
+	for (std::size_t i = 0; i < total_size; i++) result += f(arr[i]);
+
+	return result;
+}
+
+template<typename T>
+void mcf::Mat<T>::add(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
+    transform(X, [](const T& v1, const T& v2){
+        return v1 + v2;
+    }, result, option);
+}
+template<typename T>
+void mcf::Mat<T>::add(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
+    transform(X, "ret = v1 + v2;", result, video, option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::sub(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
+    transform(X, [](const T& v1, const T& v2){
+        return v1 - v2;
+    }, result, option);
+}
+template<typename T>
+void mcf::Mat<T>::sub(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
+    transform(X, "ret = v1 - v2;", result, video, option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::hadamard(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
+    transform(X, [](const T& v1, const T& v2){
+        return v1 * v2;
+    }, result, option);
+}
+template<typename T>
+void mcf::Mat<T>::hadamard(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
+    transform(X, "ret = v1 * v2;", result, video, option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::mul(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
+    gemm(X, result, T(1), T(0), option);
+}
+template<typename T>
+void mcf::Mat<T>::mul(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
+    gemm(X, result, video, T(1), T(0), option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::mul(const T& value, Mat<T>& result, TRANSPOSE option) const{
+    map([&](const T& v){
+        return v * value;
+    }, result, option);
+}
+template<typename T>
+void mcf::Mat<T>::mul(const T& value, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
+    std::string val = std::to_string(value);
+    map("ret = v * " + val + ";", result, video, option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::strassen(const Mat<T>& X, Mat<T>& result, std::size_t crossover) const{
+    requireMatrixShape(result, h, X.w, "strassen", true);
+    requireMatrixH(w, X.h, "strassen");
+
+    crossover = std::max(crossover, std::size_t(16));
+    if(crossover >= std::min({h, w, X.w})){
+        mul(X, result);
+        return;
+    }
+
+    // seven products per level as tasks, two levels once there are more threads than products
+    std::size_t task_depth = omp_get_max_threads() > 7 ? 2 : 1;
+    std::vector<T> workspace(strassenWorkspace(h, X.w, w, crossover, task_depth));
+
+    parallelRegion([&](){
+        strassenGemm(h, X.w, w, static_cast<const T*>(arr), w, static_cast<const T*>(X.arr), X.w,
+                     static_cast<T*>(result.arr), result.w, workspace.data(), crossover, task_depth);
+    });
+}
+
+template<typename T>
+template<typename F>
+void mcf::Mat<T>::fusedGemm(const Mat<T>& X, Mat<T>& result, const Mat<T>& bias, const F& f, const T& alpha, const T& beta, TRANSPOSE option) const{
+    bool trans_a = option == FIRST || option == BOTH;
+    bool trans_b = option == SECOND || option == BOTH;
+
+    std::size_t m = trans_a ? w : h;
+    std::size_t k = trans_a ? h : w;
+    std::size_t n = trans_b ? X.h : X.w;
+
+    requireMatrixShape(result, m, n, "gemm", true);
+    requireMatrixH(k, trans_b ? X.w : X.h, "gemm");
+    if(bias.total_size > 0) requireMatrixShape(bias, bias.h == 1 ? 1 : m, bias.w == 1 ? 1 : n, "gemm");
+
+    const T* bias_data = bias.total_size > 0 ? static_cast<const T*>(bias.arr) : nullptr;
+    std::size_t bias_row = bias.h == 1 ? 0 : bias.w;
+    std::size_t bias_col = bias.w == 1 ? 0 : 1;
+
+    // f = nullptr is the identity
+    auto apply = [&](const T& v){
+        if constexpr(std::is_same<F, std::nullptr_t>::value) return v;
+        else return T(f(v));
+    };
+    auto epilogue = [&](T* row, std::size_t i, std::size_t j0, std::size_t count){
+        if(bias_data){
+            const T* b = bias_data + i * bias_row + j0 * bias_col;
+            for(std::size_t j = 0; count > j; j++) row[j] = apply(row[j] + b[j * bias_col]);
+        }else{
+            for(std::size_t j = 0; count > j; j++) row[j] = apply(row[j]);
+        }
+    };
+
+    const T* a_data = arr;
+    const T* b_data = X.arr;
+    T* c_data = result.arr;
+
+    if(bias_data || !std::is_same<F, std::nullptr_t>::value) parallelGemm(trans_a, trans_b, m, n, k, alpha, a_data, w, b_data, X.w, c_data, result.w, beta, epilogue);
+    else parallelGemm(trans_a, trans_b, m, n, k, alpha, a_data, w, b_data, X.w, c_data, result.w, beta);
+}
+template<typename T>
+void mcf::Mat<T>::fusedGemm(const Mat<T>& X, Mat<T>& result, const Mat<T>& bias, const std::string& body, ecl::Computer& video, const T& alpha, const T& beta, TRANSPOSE option, ecl::EXEC sync) const{
+    std::string type = getTypeName();
+
+    bool trans_a = option == FIRST || option == BOTH;
+    bool trans_b = option == SECOND || option == BOTH;
+
+    std::size_t m = trans_a ? w : h;
+    std::size_t k = trans_a ? h : w;
+    std::size_t n = trans_b ? X.h : X.w;
+
+    requireMatrixShape(result, m, n, "gemm", true);
+    requireMatrixH(k, trans_b ? X.w : X.h, "gemm");
+    if(bias.total_size > 0) requireMatrixShape(bias, bias.h == 1 ? 1 : m, bias.w == 1 ? 1 : n, "gemm");
+
+    std::string a_index = trans_a ? "k * " + std::to_string(w) + " + i" : "i * " + std::to_string(w) + " + k";
+    std::string b_index = trans_b ? "j * " + std::to_string(X.w) + " + k" : "k * " + std::to_string(X.w) + " + j";
+
+    ecl::Program prog = "__kernel void gemm";
+    prog += "(__global " + type +  "* a, __global " + type + "* b, __global " + type + "* result, __global " + type + "* scale";
+    if(bias.total_size > 0) prog += ", __global " + type + "* bias";
+    prog += ")";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t index = i * get_global_size(1) + j;\n";
+    prog += type + " sum = 0;\n";
+    prog += "for(size_t k = 0; k < " + std::to_string(k) + "; k++) ";
+    prog += "sum += a[" + a_index + "] * b[" + b_index + "];\n";
+
+    // epilogue, the accumulator is still in a register; alpha and beta are inputs, beta = 0 never reads result
+    prog += type + " v = scale[0] * sum;\n";
+    prog += "if(scale[1] != 0) v += scale[1] * result[index];\n";
+    if(bias.total_size > 0) prog += "v += bias[" + bias.getBroadcastIndex(m, n) + "];\n";
+    prog += type + " ret = v;\n";
+    prog += body + "\n";
+    prog += "result[index] = ret;\n";
+    prog += "}";
+
+    ecl::Kernel gemm = "gemm";
+
+    auto scale = deviceParameters(video, {alpha, beta});
+
+    if(bias.total_size > 0){
+        ecl::Frame frame = {cacheProgram(prog, video), gemm, {&arr, &X.arr, &result.arr, &scale->arr, &bias.arr}};
+        launch(video, frame, {m, n}, sync, scale);
+    }else{
+        ecl::Frame frame = {cacheProgram(prog, video), gemm, {&arr, &X.arr, &result.arr, &scale->arr}};
+        launch(video, frame, {m, n}, sync, scale);
+    }
+}
+
+template<typename T>
+void mcf::Mat<T>::gemm(const Mat<T>& X, Mat<T>& result, const T& alpha, const T& beta, TRANSPOSE option) const{
+    fusedGemm(X, result, Mat<T>(), nullptr, alpha, beta, option);
+}
+template<typename T>
+void mcf::Mat<T>::gemm(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, const T& alpha, const T& beta, TRANSPOSE option, ecl::EXEC sync) const{
+    fusedGemm(X, result, Mat<T>(), "", video, alpha, beta, option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::gemm(const Mat<T>& X, Mat<T>& result, const Mat<T>& bias, ACTIVATION activation, const T& alpha, const T& beta, TRANSPOSE option) const{
+    // one instantiation per activation keeps the switch out of the tile loop
+    if(activation == RELU) fusedGemm(X, result, bias, [](const T& v){ return activate(v, RELU); }, alpha, beta, option);
+    else if(activation == SIGMOID) fusedGemm(X, result, bias, [](const T& v){ return activate(v, SIGMOID); }, alpha, beta, option);
+    else if(activation == TANH) fusedGemm(X, result, bias, [](const T& v){ return activate(v, TANH); }, alpha, beta, option);
+    else fusedGemm(X, result, bias, nullptr, alpha, beta, option);
+}
+template<typename T>
+void mcf::Mat<T>::gemm(const Mat<T>& X, Mat<T>& result, const Mat<T>& bias, ecl::Computer& video, ACTIVATION activation, const T& alpha, const T& beta, TRANSPOSE option, ecl::EXEC sync) const{
+    std::string type = getTypeName();
+    std::string v = std::is_floating_point<T>::value ? "v" : "(float)v";
 
-	other.h = 0;
-	other.w = 0;
-	other.total_size = 0;
-	other.ref = false;
+    std::string body;
+    if(activation == RELU) body = "ret = v > 0 ? v : 0;";
+    else if(activation == SIGMOID) body = "ret = (" + type + ")(1 / (1 + exp(-" + v + ")));";
+    else if(activation == TANH) body = "ret = (" + type + ")tanh(" + v + ");";
 
-	other.clear();
+    fusedGemm(X, result, bias, body, video, alpha, beta, option, sync);
 }
 
-// Constructors
 template<typename T>
-mcf::Mat<T>::Mat(){
-    h = 0;
-    w = 0;
-    total_size = 0;
-    ref = false;
+void mcf::Mat<T>::gemm(const Mat<T>& X, Mat<T>& result, const Mat<T>& bias, const std::function<T(const T&)>& f, const T& alpha, const T& beta, TRANSPOSE option) const{
+    fusedGemm(X, result, bias, f, alpha, beta, option);
+}
+template<typename T>
+void mcf::Mat<T>::gemm(const Mat<T>& X, Mat<T>& result, const Mat<T>& bias, const std::string& body, ecl::Computer& video, const T& alpha, const T& beta, TRANSPOSE option, ecl::EXEC sync) const{
+    fusedGemm(X, result, bias, body, video, alpha, beta, option, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::hsplit(Mat<T>& A, Mat<T>& B) const{
+    requireMatrixH(A.h, B.h, "hsplit");
+    requireMatrixShape(*this, A.h, A.w + B.w, "hsplit", true);
+
+    // #pragma omp parallel for collapse(2)
+    for(std::size_t i = 0; h > i; i++){
+        for(std::size_t j = 0; w > j; j++){
+            if(A.w > j) A[i][j] = getE(i, j);
+            else B[i][j - A.w] = getE(i, j);
+        }
+    }
+}
+template<typename T>
+void mcf::Mat<T>::hsplit(Mat<T>& A, Mat<T>& B, ecl::Computer& video, ecl::EXEC sync) const{
+    std::string type = getTypeName();
+
+    requireMatrixH(A.h, B.h, "hsplit");
+    requireMatrixShape(*this, A.h, A.w + B.w, "hsplit", true);
+
+    ecl::Program prog = "__kernel void hsplit";
+    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t w = get_global_size(1);\n";
+    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
+    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
+    prog += "if(j < a_w) a[i * a_w + j] = result[i * w + j];\n";
+    prog += "else b[i * b_w + j - a_w] = result[i * w + j];\n";
+    prog += "}";
+
+    ecl::Kernel hsplit = "hsplit";
+
+    ecl::Frame frame = {cacheProgram(prog, video), hsplit, {&A.arr, &B.arr, &arr}};
+    launch(video, frame, {h, w}, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::vsplit(Mat<T>& A, Mat<T>& B) const{
+    requireMatrixH(A.w, B.w, "vsplit");
+    requireMatrixShape(*this, A.h + B.h, A.w, "vsplit", true);
+
+    // #pragma omp parallel for collapse(2)
+    for(std::size_t i = 0; h > i; i++){
+        for(std::size_t j = 0; w > j; j++){
+            if(A.h > i) A[i][j] = getE(i, j);
+            else B[i - A.h][j] = getE(i, j);
+        }
+    }
+}
+template<typename T>
+void mcf::Mat<T>::vsplit(Mat<T>& A, Mat<T>& B, ecl::Computer& video, ecl::EXEC sync) const{
+    std::string type = getTypeName();
+
+    requireMatrixH(A.w, B.w, "vsplit");
+    requireMatrixShape(*this, A.h + B.h, A.w, "vsplit", true);
+
+    ecl::Program prog = "__kernel void vsplit";
+    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
+    prog += "{\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "size_t w = get_global_size(1);\n";
+    prog += "size_t a_h = " + std::to_string(A.h) + ";\n";
+    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
+    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
+    prog += "if(i < a_h) a[i * a_w + j] = result[i * w + j];\n";
+    prog += "else b[(i - a_h) * b_w + j] = result[i * w + j];\n";
+    prog += "}";
+
+    ecl::Kernel vsplit = "vsplit";
+
+    ecl::Frame frame = {cacheProgram(prog, video), vsplit, {&A.arr, &B.arr, &arr}};
+    launch(video, frame, {h, w}, sync);
+}
+
+// methods (math)
+template<typename T>
+template<typename F>
+void mcf::Mat<T>::math(Mat<T>& result, const F& f, const std::string& where) const{
+    requireFloatingPoint(where);
+    requireMatrixShape(result, h, w, where, true);
+
+    const T* a = arr;
+    T* r = result.arr;
+
+    // f is inlined into the simd loop, no indirect call per element
+    parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+        #ifdef MATRIXCF_USE_OPENMP
+        #pragma omp simd
+        #endif
+        for(std::size_t i = first; last > i; i++) r[i] = f(a[i]);
+    });
+}
+template<typename T>
+std::string mcf::Mat<T>::getNative(const std::string& name, ACCURACY accuracy) const{
+    // native_ functions only exist for float
+    return accuracy == FAST && std::is_same<T, float>::value ? "native_" + name : name;
+}
+
+template<typename T>
+void mcf::Mat<T>::exp(Mat<T>& result, ACCURACY accuracy) const{
+    if constexpr(hasFastMath<T>()){
+        if(accuracy == FAST) return math(result, [](const T& v){ return fastExp(v); }, "exp");
+    }
+    math(result, [](const T& v){ return T(std::exp(v)); }, "exp");
+}
+template<typename T>
+void mcf::Mat<T>::exp(Mat<T>& result, ecl::Computer& video, ACCURACY accuracy, ecl::EXEC sync) const{
+    requireFloatingPoint("exp");
+    map("ret = " + getNative("exp", accuracy) + "(v);", result, video, NONE, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::log(Mat<T>& result, ACCURACY accuracy) const{
+    if constexpr(hasFastMath<T>()){
+        if(accuracy == FAST) return math(result, [](const T& v){ return fastLog(v); }, "log");
+    }
+    math(result, [](const T& v){ return T(std::log(v)); }, "log");
+}
+template<typename T>
+void mcf::Mat<T>::log(Mat<T>& result, ecl::Computer& video, ACCURACY accuracy, ecl::EXEC sync) const{
+    requireFloatingPoint("log");
+    map("ret = " + getNative("log", accuracy) + "(v);", result, video, NONE, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::sigmoid(Mat<T>& result, ACCURACY accuracy) const{
+    if constexpr(hasFastMath<T>()){
+        if(accuracy == FAST) return math(result, [](const T& v){ return fastSigmoid(v); }, "sigmoid");
+    }
+    math(result, [](const T& v){
+        T e = T(std::exp(-std::abs(v)));
+        return (v < 0 ? e : T(1)) / (1 + e);
+    }, "sigmoid");
+}
+template<typename T>
+void mcf::Mat<T>::sigmoid(Mat<T>& result, ecl::Computer& video, ACCURACY accuracy, ecl::EXEC sync) const{
+    requireFloatingPoint("sigmoid");
+
+    // e^x / (1 + e^x) for negative x, as on cpu
+    std::string body = getTypeName() + " e = " + getNative("exp", accuracy) + "(-fabs(v));\n";
+    body += "ret = (v < 0 ? e : 1) / (1 + e);";
+    map(body, result, video, NONE, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::tanh(Mat<T>& result, ACCURACY accuracy) const{
+    if constexpr(hasFastMath<T>()){
+        if(accuracy == FAST) return math(result, [](const T& v){ return fastTanh(v); }, "tanh");
+    }
+    math(result, [](const T& v){ return T(std::tanh(v)); }, "tanh");
+}
+template<typename T>
+void mcf::Mat<T>::tanh(Mat<T>& result, ecl::Computer& video, ACCURACY, ecl::EXEC sync) const{
+    requireFloatingPoint("tanh");
+
+    // OpenCL has no native_tanh
+    map("ret = tanh(v);", result, video, NONE, sync);
+}
+
+template<typename T>
+void mcf::Mat<T>::pow(const T& p, Mat<T>& result, ACCURACY accuracy) const{
+    if constexpr(hasFastMath<T>()){
+        if(accuracy == FAST) return math(result, [p](const T& v){ return fastPow(v, p); }, "pow");
+    }
+    math(result, [p](const T& v){ return T(std::pow(v, p)); }, "pow");
+}
+template<typename T>
+void mcf::Mat<T>::pow(const T& p, Mat<T>& result, ecl::Computer& video, ACCURACY accuracy, ecl::EXEC sync) const{
+    requireFloatingPoint("pow");
+    requireMatrixShape(result, h, w, "pow", true);
+
+    std::string type = getTypeName();
+
+    // native_powr is undefined for negative bases
+    std::string body = "ret = pow(v, power[0]);";
+    if(accuracy == FAST && std::is_same<T, float>::value) body = "ret = v < 0 ? pow(v, power[0]) : native_powr(v, power[0]);";
+
+    ecl::Program prog = "__kernel void pow_map";
+    prog += "(__global " + type + "* a, __global " + type + "* result, __global " + type + "* power){\n";
+    prog += "size_t index = get_global_id(0);\n";
+    prog += type + " v = a[index];\n";
+    prog += type + " ret;\n";
+    prog += body + "\n";
+    prog += "result[index] = ret;\n";
+    prog += "}";
+
+    ecl::Kernel pow_map = "pow_map";
+
+    auto power = deviceParameters(video, {p});
+
+    ecl::Frame frame = {cacheProgram(prog, video), pow_map, {&arr, &result.arr, &power->arr}};
+    launch(video, frame, {total_size}, sync, power);
+}
+
+// methods (rows and columns)
+template<typename T>
+template<typename A, typename F, typename M>
+void mcf::Mat<T>::groupReduce(REDUCE option, std::vector<A>& acc, const A& init, const F& fold, const M& merge) const{
+    // fold(state, index, group) every element into the state of its group, partial states are merged in order
+    constexpr std::size_t LANES = 8;
+
+    if(option == ROWS){
+        // panels of rows keep the simd loop on contiguous columns, tall panels are split into chunks
+        std::size_t panel_w = std::min<std::size_t>(w, 256);
+        std::size_t panels = (w + panel_w - 1) / std::max<std::size_t>(panel_w, 1);
+        std::size_t chunk_h = std::max<std::size_t>(TASK_GRAIN / std::max<std::size_t>(panel_w, 1), 1);
+        std::size_t chunks = (h + chunk_h - 1) / chunk_h;
+
+        std::vector<A> partial(chunks * w, init);
+        parallelFor(0, chunks * panels, 1, [&](std::size_t first, std::size_t last){
+            for(std::size_t t = first; last > t; t++){
+                std::size_t c = t / panels;
+                std::size_t j0 = (t % panels) * panel_w;
+                std::size_t j1 = std::min(w, j0 + panel_w);
+                A* p = partial.data() + c * w;
+
+                for(std::size_t i = c * chunk_h; std::min(h, (c + 1) * chunk_h) > i; i++){
+                    #ifdef MATRIXCF_USE_OPENMP
+                    #pragma omp simd
+                    #endif
+                    for(std::size_t j = j0; j1 > j; j++) fold(p[j], i * w + j, j);
+                }
+            }
+        });
+
+        acc.assign(w, init);
+        for(std::size_t c = 0; chunks > c; c++){
+            for(std::size_t j = 0; w > j; j++) merge(acc[j], partial[c * w + j]);
+        }
+    }else{
+        // contiguous groups, long ones are split into chunks of interleaved lanes
+        std::size_t groups = option == COLUMNS ? h : 1;
+        std::size_t n = option == COLUMNS ? w : total_size;
+        std::size_t chunks = std::max<std::size_t>((n + TASK_GRAIN - 1) / TASK_GRAIN, 1);
+
+        std::vector<A> partial(groups * chunks, init);
+        parallelFor(0, groups * chunks, TASK_GRAIN / std::max<std::size_t>(n, 1), [&](std::size_t first, std::size_t last){
+            for(std::size_t t = first; last > t; t++){
+                std::size_t g = t / chunks;
+                std::size_t k = g * n + (t % chunks) * TASK_GRAIN;
+                std::size_t end = std::min(g * n + n, k + TASK_GRAIN);
+
+                A lanes[LANES];
+                std::fill(lanes, lanes + LANES, init);
+
+                for(; end >= k + LANES; k += LANES){
+                    #ifdef MATRIXCF_USE_OPENMP
+                    #pragma omp simd
+                    #endif
+                    for(std::size_t l = 0; LANES > l; l++) fold(lanes[l], k + l, g);
+                }
+                for(std::size_t l = 0; end > k + l; l++) fold(lanes[l], k + l, g);
+
+                for(std::size_t l = 1; LANES > l; l++) merge(lanes[0], lanes[l]);
+                partial[t] = lanes[0];
+            }
+        });
+
+        acc.assign(groups, init);
+        for(std::size_t g = 0; groups > g; g++){
+            for(std::size_t c = 0; chunks > c; c++) merge(acc[g], partial[g * chunks + c]);
+        }
+    }
+}
+template<typename T>
+template<typename F>
+void mcf::Mat<T>::groupMap(REDUCE option, const F& f) const{
+    // f(index, group) for every element
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            if(option == ROWS){
+                #ifdef MATRIXCF_USE_OPENMP
+                #pragma omp simd
+                #endif
+                for(std::size_t j = 0; w > j; j++) f(i * w + j, j);
+            }else{
+                std::size_t g = option == COLUMNS ? i : 0;
+
+                #ifdef MATRIXCF_USE_OPENMP
+                #pragma omp simd
+                #endif
+                for(std::size_t j = 0; w > j; j++) f(i * w + j, g);
+            }
+        }
+    });
+}
+template<typename T>
+template<bool WRITE>
+void mcf::Mat<T>::expSum(REDUCE option, ACCURACY accuracy, std::vector<T>& shift, std::vector<T>& sum, T* out) const{
+    // sum of exp(x - max) per group, the max keeps exp from overflowing
+    const T* a = arr;
+
+    groupReduce(option, shift, -std::numeric_limits<T>::infinity(), [a](T& m, std::size_t k, std::size_t){
+        m = a[k] > m ? a[k] : m;
+    }, [](T& m, const T& other){
+        m = other > m ? other : m;
+    });
+
+    // groups of -inf sum to 0 instead of nan
+    for(T& m : shift) m = std::isinf(m) ? T(0) : m;
+
+    auto exps = [&](const auto& e){
+        groupReduce(option, sum, T(0), [&](T& acc, std::size_t k, std::size_t g){
+            T v = e(a[k] - shift[g]);
+            if constexpr(WRITE) out[k] = v;
+            acc += v;
+        }, [](T& acc, const T& other){
+            acc += other;
+        });
+    };
+
+    if constexpr(hasFastMath<T>()){
+        if(accuracy == FAST) return exps([](const T& v){ return fastExp(v); });
+    }
+    exps([](const T& v){ return T(std::exp(v)); });
+}
+template<typename T>
+std::pair<std::size_t, std::size_t> mcf::Mat<T>::getGroupShape(REDUCE option) const{
+    if(option == COLUMNS) return {h, 1};
+    if(option == ROWS) return {1, w};
+    return {1, 1};
+}
+template<typename T>
+std::string mcf::Mat<T>::getGroupBase(REDUCE option) const{
+    // elements of group g are a[base + k * step]
+    if(option == COLUMNS) return "size_t base = g * " + std::to_string(w) + ";\nsize_t step = 1;\n";
+    if(option == ROWS) return "size_t base = g;\nsize_t step = " + std::to_string(w) + ";\n";
+    return "size_t base = 0;\nsize_t step = 1;\n";
+}
+template<typename T>
+std::string mcf::Mat<T>::getGroupLoop(REDUCE option) const{
+    // one work-item per group of count elements
+    std::string loop = "size_t g = get_global_id(0);\n";
+    loop += getGroupBase(option);
+    loop += "size_t count = " + std::to_string(getGroupCount(option)) + ";\n";
+    return loop;
+}
+template<typename T>
+std::size_t mcf::Mat<T>::getGroupCount(REDUCE option) const{
+    if(option == COLUMNS) return w;
+    if(option == ROWS) return h;
+    return total_size;
+}
+template<typename T>
+std::string mcf::Mat<T>::getGroupIndex(REDUCE option) const{
+    // group of element (i, j)
+    if(option == COLUMNS) return "size_t g = i;\n";
+    if(option == ROWS) return "size_t g = j;\n";
+    return "size_t g = 0;\n";
+}
+template<typename T>
+std::shared_ptr<mcf::Mat<T>> mcf::Mat<T>::groupReduce(REDUCE option, std::size_t size, const std::string& init, const std::string& fold, const std::string& merge, const std::string& finish, ecl::Computer& video) const{
+    // work-item (g, c) folds chunk c of group g into a partial state s of size values, then one work-item per group
+    // merges the partials o of its chunks in order and finishes s; returns the states of the groups, g_h * g_w x size
+    constexpr std::size_t CHUNK = 256;
+
+    std::string type = getTypeName();
+    auto [g_h, g_w] = getGroupShape(option);
+    std::size_t groups = g_h * g_w;
+    std::size_t count = getGroupCount(option);
+    std::size_t chunks = std::max<std::size_t>((count + CHUNK - 1) / CHUNK, 1);
+
+    std::string S = std::to_string(size);
+    std::string C = std::to_string(chunks);
+
+    auto partial = deviceScratch<T>(video, groups * chunks, size);
+    auto state = deviceScratch<T>(video, groups, size);
+
+    ecl::Program partial_prog = "__kernel void group_partial";
+    partial_prog += "(__global " + type + "* a, __global " + type + "* partial){\n";
+    partial_prog += "size_t g = get_global_id(0);\n";
+    partial_prog += "size_t c = get_global_id(1);\n";
+    partial_prog += getGroupBase(option);
+    partial_prog += "size_t last = min((size_t)" + std::to_string(count) + ", (c + 1) * " + std::to_string(CHUNK) + ");\n";
+    partial_prog += type + " s[" + S + "];\n";
+    partial_prog += "{\n" + init + "\n}\n";
+    partial_prog += "for(size_t k = c * " + std::to_string(CHUNK) + "; k < last; k++){\n";
+    partial_prog += type + " x = a[base + k * step];\n";
+    partial_prog += "{\n" + fold + "\n}\n";
+    partial_prog += "}\n";
+    partial_prog += "for(size_t i = 0; i < " + S + "; i++) partial[(g * " + C + " + c) * " + S + " + i] = s[i];\n";
+    partial_prog += "}";
+
+    ecl::Program merge_prog = "__kernel void group_merge";
+    merge_prog += "(__global " + type + "* partial, __global " + type + "* state){\n";
+    merge_prog += "size_t g = get_global_id(0);\n";
+    merge_prog += "__global " + type + "* p = partial + g * " + C + " * " + S + ";\n";
+    merge_prog += type + " s[" + S + "];\n";
+    merge_prog += type + " o[" + S + "];\n";
+    merge_prog += "for(size_t i = 0; i < " + S + "; i++) s[i] = p[i];\n";
+    merge_prog += "for(size_t c = 1; c < " + C + "; c++){\n";
+    merge_prog += "for(size_t i = 0; i < " + S + "; i++) o[i] = p[c * " + S + " + i];\n";
+    merge_prog += "{\n" + merge + "\n}\n";
+    merge_prog += "}\n";
+    merge_prog += "{\n" + finish + "\n}\n";
+    merge_prog += "for(size_t i = 0; i < " + S + "; i++) state[g * " + S + " + i] = s[i];\n";
+    merge_prog += "}";
+
+    ecl::Kernel partial_kernel = "group_partial";
+    ecl::Kernel merge_kernel = "group_merge";
+
+    // the queue keeps the order, the op launches its last kernel with the caller's sync
+    ecl::Frame partial_frame = {cacheProgram(partial_prog, video), partial_kernel, {&arr, &partial->arr}};
+    launch(video, partial_frame, {groups, chunks}, ASYNC, partial);
+
+    ecl::Frame merge_frame = {cacheProgram(merge_prog, video), merge_kernel, {&partial->arr, &state->arr}};
+    launch(video, merge_frame, {groups}, ASYNC, partial);
+
+    return state;
+}
+template<typename T>
+std::shared_ptr<mcf::Mat<T>> mcf::Mat<T>::expSum(REDUCE option, ACCURACY accuracy, ecl::Computer& video) const{
+    // s[0] is the max and s[1] the sum of exp(x - shift), shift is the max or 0 for groups of +-inf as on cpu;
+    // merged sums are rescaled to the larger shift
+    std::string type = getTypeName();
+    std::string exp = getNative("exp", accuracy);
+
+    std::string init = "s[0] = -INFINITY;\n";
+    init += "s[1] = 0;";
+
+    std::string fold = "if(x > s[0]){\n";
+    fold += "s[1] = isinf(s[0]) ? s[1] : s[1] * " + exp + "(s[0] - x);\n";
+    fold += "s[0] = x;\n";
+    fold += "}\n";
+    fold += "s[1] += " + exp + "(x - (isinf(s[0]) ? 0 : s[0]));";
+
+    std::string merge = type + " m = fmax(s[0], o[0]);\n";
+    merge += type + " shift = isinf(m) ? 0 : m;\n";
+    merge += "s[1] = (s[1] == 0 ? 0 : s[1] * " + exp + "((isinf(s[0]) ? 0 : s[0]) - shift)) + ";
+    merge += "(o[1] == 0 ? 0 : o[1] * " + exp + "((isinf(o[0]) ? 0 : o[0]) - shift));\n";
+    merge += "s[0] = m;";
+
+    return groupReduce(option, 2, init, fold, merge, "s[0] = isinf(s[0]) ? 0 : s[0];", video);
+}
+template<typename T>
+std::shared_ptr<mcf::Mat<T>> mcf::Mat<T>::groupNorm(REDUCE option, NORM norm, ecl::Computer& video) const{
+    std::string fold = "s[0] += fabs(x);";
+    std::string merge = "s[0] += o[0];";
+    if(norm == L2){
+        fold = "s[0] += x * x;";
+    }else if(norm == LINF){
+        fold = "s[0] = fmax(s[0], fabs(x));";
+        merge = "s[0] = fmax(s[0], o[0]);";
+    }
+
+    return groupReduce(option, 1, "s[0] = 0;", fold, merge, norm == L2 ? "s[0] = sqrt(s[0]);" : "", video);
+}
+
+template<typename T>
+void mcf::Mat<T>::softmax(Mat<T>& result, REDUCE option, ACCURACY accuracy) const{
+    requireFloatingPoint("softmax");
+    requireMatrixShape(result, h, w, "softmax", true);
+
+    std::vector<T> shift;
+    std::vector<T> sum;
+    expSum<true>(option, accuracy, shift, sum, result.arr);
+
+    for(T& s : sum) s = 1 / s;
+
+    T* r = result.arr;
+    groupMap(option, [&](std::size_t k, std::size_t g){
+        r[k] *= sum[g];
+    });
+}
+template<typename T>
+void mcf::Mat<T>::softmax(Mat<T>& result, ecl::Computer& video, REDUCE option, ACCURACY accuracy, ecl::EXEC sync) const{
+    requireFloatingPoint("softmax");
+    requireMatrixShape(result, h, w, "softmax", true);
+
+    std::string type = getTypeName();
+    auto state = expSum(option, accuracy, video);
+
+    ecl::Program prog = "__kernel void softmax";
+    prog += "(__global " + type + "* a, __global " + type + "* state, __global " + type + "* result){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += getGroupIndex(option);
+    prog += "size_t index = i * " + std::to_string(w) + " + j;\n";
+    prog += "result[index] = " + getNative("exp", accuracy) + "(a[index] - state[g * 2]) / state[g * 2 + 1];\n";
+    prog += "}";
+
+    ecl::Kernel softmax = "softmax";
+
+    ecl::Frame frame = {cacheProgram(prog, video), softmax, {&arr, &state->arr, &result.arr}};
+    launch(video, frame, {h, w}, sync, state);
+}
+
+template<typename T>
+void mcf::Mat<T>::logsumexp(Mat<T>& result, REDUCE option, ACCURACY accuracy) const{
+    requireFloatingPoint("logsumexp");
+
+    auto [g_h, g_w] = getGroupShape(option);
+    requireMatrixShape(result, g_h, g_w, "logsumexp", true);
+
+    std::vector<T> shift;
+    std::vector<T> sum;
+    expSum<false>(option, accuracy, shift, sum, nullptr);
+
+    for(std::size_t g = 0; shift.size() > g; g++) result.arr[g] = shift[g] + T(std::log(sum[g]));
+}
+template<typename T>
+void mcf::Mat<T>::logsumexp(Mat<T>& result, ecl::Computer& video, REDUCE option, ACCURACY accuracy, ecl::EXEC sync) const{
+    requireFloatingPoint("logsumexp");
+
+    auto [g_h, g_w] = getGroupShape(option);
+    requireMatrixShape(result, g_h, g_w, "logsumexp", true);
+
+    std::string type = getTypeName();
+    auto state = expSum(option, accuracy, video);
+
+    ecl::Program prog = "__kernel void logsumexp";
+    prog += "(__global " + type + "* state, __global " + type + "* result){\n";
+    prog += "size_t g = get_global_id(0);\n";
+    prog += "result[g] = state[g * 2] + " + getNative("log", accuracy) + "(state[g * 2 + 1]);\n";
+    prog += "}";
+
+    ecl::Kernel logsumexp = "logsumexp";
+
+    ecl::Frame frame = {cacheProgram(prog, video), logsumexp, {&state->arr, &result.arr}};
+    launch(video, frame, {g_h * g_w}, sync, state);
+}
+
+template<typename T>
+void mcf::Mat<T>::moments(Mat<T>& mean, Mat<T>& variance, REDUCE option) const{
+    requireFloatingPoint("moments");
+
+    auto [g_h, g_w] = getGroupShape(option);
+    requireMatrixShape(mean, g_h, g_w, "moments", true);
+    requireMatrixShape(variance, g_h, g_w, "moments", true);
+
+    const T* a = arr;
+    std::vector<Moments<T>> m;
+    groupReduce(option, m, Moments<T>(), [a](Moments<T>& state, std::size_t k, std::size_t){
+        welford(state, a[k]);
+    }, [](Moments<T>& state, const Moments<T>& other){
+        mergeMoments(state, other);
+    });
+
+    for(std::size_t g = 0; m.size() > g; g++){
+        mean.arr[g] = m[g].mean;
+        variance.arr[g] = m[g].m2 / m[g].n;
+    }
+}
+template<typename T>
+void mcf::Mat<T>::moments(Mat<T>& mean, Mat<T>& variance, ecl::Computer& video, REDUCE option, ecl::EXEC sync) const{
+    requireFloatingPoint("moments");
+
+    auto [g_h, g_w] = getGroupShape(option);
+    requireMatrixShape(mean, g_h, g_w, "moments", true);
+    requireMatrixShape(variance, g_h, g_w, "moments", true);
+
+    std::string type = getTypeName();
+
+    // count, mean and m2 as in welford and mergeMoments on cpu
+    std::string fold = "s[0] += 1;\n";
+    fold += type + " delta = x - s[1];\n";
+    fold += "s[1] += delta / s[0];\n";
+    fold += "s[2] += delta * (x - s[1]);";
+
+    std::string merge = type + " n = s[0] + o[0];\n";
+    merge += "if(n > 0){\n";
+    merge += type + " delta = o[1] - s[1];\n";
+    merge += "s[1] += delta * o[0] / n;\n";
+    merge += "s[2] += o[2] + delta * delta * s[0] * o[0] / n;\n";
+    merge += "s[0] = n;\n";
+    merge += "}";
+
+    auto state = groupReduce(option, 3, "s[0] = 0;\ns[1] = 0;\ns[2] = 0;", fold, merge, "", video);
+
+    ecl::Program prog = "__kernel void moments";
+    prog += "(__global " + type + "* state, __global " + type + "* mean, __global " + type + "* variance){\n";
+    prog += "size_t g = get_global_id(0);\n";
+    prog += "mean[g] = state[g * 3 + 1];\n";
+    prog += "variance[g] = state[g * 3 + 2] / state[g * 3];\n";
+    prog += "}";
+
+    ecl::Kernel moments = "moments";
+
+    ecl::Frame frame = {cacheProgram(prog, video), moments, {&state->arr, &mean.arr, &variance.arr}};
+    launch(video, frame, {g_h * g_w}, sync, state);
+}
+
+template<typename T>
+void mcf::Mat<T>::norm(Mat<T>& result, REDUCE option, NORM norm) const{
+    requireFloatingPoint("norm");
+
+    auto [g_h, g_w] = getGroupShape(option);
+    requireMatrixShape(result, g_h, g_w, "norm", true);
+
+    const T* a = arr;
+    std::vector<T> acc;
+    auto sum = [](T& acc, const T& other){
+        acc += other;
+    };
+
+    if(norm == L1){
+        groupReduce(option, acc, T(0), [a](T& acc, std::size_t k, std::size_t){
+            acc += std::abs(a[k]);
+        }, sum);
+    }else if(norm == L2){
+        groupReduce(option, acc, T(0), [a](T& acc, std::size_t k, std::size_t){
+            acc += a[k] * a[k];
+        }, sum);
+        for(T& v : acc) v = std::sqrt(v);
+    }else{
+        groupReduce(option, acc, T(0), [a](T& acc, std::size_t k, std::size_t){
+            T v = std::abs(a[k]);
+            acc = v > acc ? v : acc;
+        }, [](T& acc, const T& other){
+            acc = other > acc ? other : acc;
+        });
+    }
+
+    std::copy(acc.begin(), acc.end(), (T*)result.arr);
 }
+template<typename T>
+void mcf::Mat<T>::norm(Mat<T>& result, ecl::Computer& video, REDUCE option, NORM norm, ecl::EXEC sync) const{
+    requireFloatingPoint("norm");
+
+    auto [g_h, g_w] = getGroupShape(option);
+    requireMatrixShape(result, g_h, g_w, "norm", true);
+
+    std::string type = getTypeName();
+    auto state = groupNorm(option, norm, video);
+
+    ecl::Program prog = "__kernel void norm";
+    prog += "(__global " + type + "* state, __global " + type + "* result){\n";
+    prog += "size_t g = get_global_id(0);\n";
+    prog += "result[g] = state[g];\n";
+    prog += "}";
 
-template<typename T>
-mcf::Mat<T>::Mat(std::size_t h, std::size_t w) : arr(w * h){
-    this->h = h;
-    this->w = w;
-    total_size = w * h;
-    ref = false;
+    ecl::Kernel kernel = "norm";
+
+    ecl::Frame frame = {cacheProgram(prog, video), kernel, {&state->arr, &result.arr}};
+    launch(video, frame, {g_h * g_w}, sync, state);
 }
 
 template<typename T>
-mcf::Mat<T>::Mat(T* arr, std::size_t h, std::size_t w) : arr(arr, h * w, READ_WRITE){
-    this->h = h;
-    this->w = w;
-    total_size = w * h;
-    ref = true;
-}
+void mcf::Mat<T>::normalize(Mat<T>& result, REDUCE option, NORM norm) const{
+    requireFloatingPoint("normalize");
+    requireMatrixShape(result, h, w, "normalize", true);
 
+    auto [g_h, g_w] = getGroupShape(option);
+    Mat<T> n(g_h, g_w);
+    this->norm(n, option, norm);
 
-template<typename T>
-mcf::Mat<T>::Mat(const Mat<T>& other){
-	copy(other);
+    for(std::size_t g = 0; n.total_size > g; g++) n.arr[g] = n.arr[g] > 0 ? 1 / n.arr[g] : T(0);
+
+    const T* a = arr;
+    const T* scale = n.arr;
+    T* r = result.arr;
+    groupMap(option, [&](std::size_t k, std::size_t g){
+        r[k] = a[k] * scale[g];
+    });
 }
 template<typename T>
-mcf::Mat<T>& mcf::Mat<T>::operator=(const Mat<T>& other){
-	copy(other);
+void mcf::Mat<T>::normalize(Mat<T>& result, ecl::Computer& video, REDUCE option, NORM norm, ecl::EXEC sync) const{
+    requireFloatingPoint("normalize");
+    requireMatrixShape(result, h, w, "normalize", true);
 
-    return *this;
-}
+    std::string type = getTypeName();
+    auto state = groupNorm(option, norm, video);
 
-template<typename T>
-mcf::Mat<T>::Mat(Mat<T>&& other){
-	move(other);
-}
+    ecl::Program prog = "__kernel void normalize";
+    prog += "(__global " + type + "* a, __global " + type + "* state, __global " + type + "* result){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += getGroupIndex(option);
+    prog += "size_t index = i * " + std::to_string(w) + " + j;\n";
+    prog += "result[index] = state[g] > 0 ? a[index] * (1 / state[g]) : 0;\n";
+    prog += "}";
 
-template<typename T>
-mcf::Mat<T>& mcf::Mat<T>::operator=(Mat<T>&& other){
-	move(other);
+    ecl::Kernel normalize = "normalize";
 
-    return *this;
+    ecl::Frame frame = {cacheProgram(prog, video), normalize, {&arr, &state->arr, &result.arr}};
+    launch(video, frame, {h, w}, sync, state);
 }
 
-// Getters
 template<typename T>
-const mcf::array<T>& mcf::Mat<T>::getConstArray() const{
-    return arr;
+void mcf::Mat<T>::requireSelection(std::size_t k, REDUCE option, const std::string& where) const{
+    std::size_t count = getGroupCount(option);
+    if(k > count){
+        std::string e = "Require selection [" + where + "]: ";
+        e += std::to_string(k) + " elements from groups of " + std::to_string(count);
+        throw std::runtime_error(e);
+    }
 }
 template<typename T>
-const std::size_t mcf::Mat<T>::getH() const{
-    return h;
+std::string mcf::Mat<T>::getOrderBefore(ORDER order) const{
+    // strict order of values, ties are left to the indices
+    std::string type = getTypeName();
+    std::string x = order == DESCENDING ? "y" : "x";
+    std::string y = order == DESCENDING ? "x" : "y";
+
+    std::string before = "int before(" + type + " x, " + type + " y){\n";
+    if(std::is_floating_point<T>::value) before += "return " + x + " < " + y + " || (isnan(" + y + ") && !isnan(" + x + "));\n";
+    else before += "return " + x + " < " + y + ";\n";
+    before += "}\n";
+    return before;
 }
+
 template<typename T>
-const std::size_t mcf::Mat<T>::getW() const{
-    return w;
+void mcf::Mat<T>::groupArg(Mat<std::size_t>& result, REDUCE option, ORDER order, const std::string& where) const{
+    auto [g_h, g_w] = getGroupShape(option);
+    result.requireMatrixShape(result, g_h, g_w, where, true);
+    if(total_size == 0) return;
+
+    // (value, position) states, the first element of a lane always takes an unset state
+    struct Arg{
+        T v;
+        std::size_t k;
+    };
+    constexpr std::size_t UNSET = std::numeric_limits<std::size_t>::max();
+
+    const T* a = arr;
+    std::vector<Arg> acc;
+    groupReduce(option, acc, Arg{T(0), UNSET}, [a, order](Arg& s, std::size_t k, std::size_t){
+        if(s.k == UNSET || orderBefore(a[k], k, s.v, s.k, order)) s = Arg{a[k], k};
+    }, [order](Arg& s, const Arg& other){
+        if(other.k != UNSET && (s.k == UNSET || orderBefore(other.v, other.k, s.v, s.k, order))) s = other;
+    });
+
+    std::size_t* r = result.arr;
+    for(std::size_t g = 0; acc.size() > g; g++){
+        std::size_t k = acc[g].k;
+        r[g] = option == COLUMNS ? k % w : (option == ROWS ? k / w : k);
+    }
 }
 template<typename T>
-const std::size_t mcf::Mat<T>::getTotalSize() const{
-    return total_size;
-}
+void mcf::Mat<T>::groupArg(Mat<std::size_t>& result, ecl::Computer& video, REDUCE option, ORDER order, const std::string& where, ecl::EXEC sync) const{
+    auto [g_h, g_w] = getGroupShape(option);
+    result.requireMatrixShape(result, g_h, g_w, where, true);
+    if(total_size == 0) return;
 
-template<typename T>
-mcf::array<T>& mcf::Mat<T>::getArray(){
-    return arr;
+    // work-item (g, c) finds the best of chunk c of group g, then one work-item per group picks among its chunks
+    // in order, so ties keep the first position as on the cpu and a long group isn't walked by one work-item
+    constexpr std::size_t CHUNK = 256;
+
+    std::string type = getTypeName();
+    std::size_t groups = g_h * g_w;
+    std::size_t count = getGroupCount(option);
+    std::size_t chunks = (count + CHUNK - 1) / CHUNK;
+
+    std::string C = std::to_string(chunks);
+
+    auto partial = deviceScratch<std::size_t>(video, groups, chunks);
+
+    ecl::Program partial_prog = getOrderBefore(order);
+    partial_prog += "__kernel void " + where + "_partial";
+    partial_prog += "(__global " + type + "* a, __global ulong* partial){\n";
+    partial_prog += "size_t g = get_global_id(0);\n";
+    partial_prog += "size_t c = get_global_id(1);\n";
+    partial_prog += getGroupBase(option);
+    partial_prog += "size_t first = c * " + std::to_string(CHUNK) + ";\n";
+    partial_prog += "size_t last = min((size_t)" + std::to_string(count) + ", first + " + std::to_string(CHUNK) + ");\n";
+    partial_prog += "size_t best = first;\n";
+    partial_prog += type + " m = a[base + first * step];\n";
+    partial_prog += "for(size_t k = first + 1; k < last; k++){\n";
+    partial_prog += type + " x = a[base + k * step];\n";
+    partial_prog += "if(before(x, m)){\n";
+    partial_prog += "m = x;\n";
+    partial_prog += "best = k;\n";
+    partial_prog += "}\n";
+    partial_prog += "}\n";
+    partial_prog += "partial[g * " + C + " + c] = best;\n";
+    partial_prog += "}";
+
+    ecl::Program prog = getOrderBefore(order);
+    prog += "__kernel void " + where;
+    prog += "(__global " + type + "* a, __global ulong* partial, __global ulong* result){\n";
+    prog += "size_t g = get_global_id(0);\n";
+    prog += getGroupBase(option);
+    prog += "ulong best = partial[g * " + C + "];\n";
+    prog += type + " m = a[base + best * step];\n";
+    prog += "for(size_t c = 1; c < " + C + "; c++){\n";
+    prog += "ulong k = partial[g * " + C + " + c];\n";
+    prog += type + " x = a[base + k * step];\n";
+    prog += "if(before(x, m)){\n";
+    prog += "m = x;\n";
+    prog += "best = k;\n";
+    prog += "}\n";
+    prog += "}\n";
+    prog += "result[g] = best;\n";
+    prog += "}";
+
+    ecl::Kernel partial_kernel = where + "_partial";
+    ecl::Kernel arg = where;
+
+    ecl::Frame partial_frame = {cacheProgram(partial_prog, video), partial_kernel, {&arr, &partial->arr}};
+    launch(video, partial_frame, {groups, chunks}, ASYNC, partial);
+
+    ecl::Frame frame = {cacheProgram(prog, video), arg, {&arr, &partial->arr, &result.arr}};
+    launch(video, frame, {groups}, sync, partial);
 }
 
 template<typename T>
-std::size_t mcf::Mat<T>::totalMemoryUsed() const{
-    return total_size * sizeof(T);
+void mcf::Mat<T>::argmax(Mat<std::size_t>& result, REDUCE option) const{
+    groupArg(result, option, DESCENDING, "argmax");
 }
 template<typename T>
-bool mcf::Mat<T>::isRef() const{
-    return ref;
+void mcf::Mat<T>::argmax(Mat<std::size_t>& result, ecl::Computer& video, REDUCE option, ecl::EXEC sync) const{
+    groupArg(result, video, option, DESCENDING, "argmax", sync);
 }
 
 template<typename T>
-const T& mcf::Mat<T>::getE(std::size_t i, std::size_t j) const{
-    return arr[w * i + j];
+void mcf::Mat<T>::argmin(Mat<std::size_t>& result, REDUCE option) const{
+    groupArg(result, option, ASCENDING, "argmin");
 }
 template<typename T>
-void mcf::Mat<T>::setE(const T& value, std::size_t i, std::size_t j){
-    arr[w * i + j] = value;
+void mcf::Mat<T>::argmin(Mat<std::size_t>& result, ecl::Computer& video, REDUCE option, ecl::EXEC sync) const{
+    groupArg(result, video, option, ASCENDING, "argmin", sync);
 }
 
 template<typename T>
-T* mcf::Mat<T>::operator[](std::size_t i){
-    return arr + i * w;
-}
+void mcf::Mat<T>::topk(std::size_t k, Mat<std::size_t>& indices, REDUCE option, ORDER order) const{
+    requireSelection(k, option, "topk");
+    indices.requireMatrixShape(indices, option == ROWS ? k : getGroupShape(option).first, option == ROWS ? w : k, "topk", true);
+    if(k == 0) return;
+
+    const T* a = arr;
+    std::size_t* out = indices.arr;
+
+    if(option == ROWS){
+        // panels of columns keep the row loop on contiguous memory, every column has a heap of its own
+        std::size_t panel_w = std::min<std::size_t>(w, 64);
+        std::size_t panels = (w + panel_w - 1) / panel_w;
+
+        parallelFor(0, panels, 1, [&](std::size_t first, std::size_t last){
+            std::vector<std::size_t> heaps(panel_w * k);
+            std::vector<std::size_t> sizes(panel_w);
+
+            for(std::size_t p = first; last > p; p++){
+                std::size_t j0 = p * panel_w;
+                std::size_t j1 = std::min(w, j0 + panel_w);
+                std::fill(sizes.begin(), sizes.end(), 0);
+
+                for(std::size_t i = 0; h > i; i++){
+                    for(std::size_t j = j0; j1 > j; j++){
+                        offerHeap(heaps.data() + (j - j0) * k, sizes[j - j0], k, i, [&](std::size_t x, std::size_t y){
+                            return orderBefore(a[x * w + j], x, a[y * w + j], y, order);
+                        });
+                    }
+                }
+                for(std::size_t j = j0; j1 > j; j++){
+                    std::size_t* heap = heaps.data() + (j - j0) * k;
+                    std::sort_heap(heap, heap + k, [&](std::size_t x, std::size_t y){
+                        return orderBefore(a[x * w + j], x, a[y * w + j], y, order);
+                    });
+                    for(std::size_t r = 0; k > r; r++) out[r * w + j] = heap[r];
+                }
+            }
+        });
+        return;
+    }
 
-template<typename T>
-mcf::Mat<T>::operator T*(){
-    return arr;
+    // contiguous groups, long ones are split into chunks whose heaps are merged at the end
+    std::size_t groups = option == COLUMNS ? h : 1;
+    std::size_t count = getGroupCount(option);
+    std::size_t chunk = std::max<std::size_t>(TASK_GRAIN, k);
+    std::size_t chunks = std::max<std::size_t>((count + chunk - 1) / chunk, 1);
+
+    std::vector<std::size_t> candidates(groups * chunks * k);
+    std::vector<std::size_t> sizes(groups * chunks, 0);
+
+    parallelFor(0, groups * chunks, TASK_GRAIN / std::max<std::size_t>(std::min(count, chunk), 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t t = first; last > t; t++){
+            const T* group = a + (t / chunks) * count;
+            std::size_t c = t % chunks;
+            std::size_t end = std::min(count, (c + 1) * chunk);
+            std::size_t* heap = candidates.data() + t * k;
+            auto before = [&](std::size_t x, std::size_t y){
+                return orderBefore(group[x], x, group[y], y, order);
+            };
+
+            // later elements lose ties, so once the heap is full blocks of elements not before its top are skipped
+            for(std::size_t i = c * chunk; end > i;){
+                std::size_t stop = std::min(end, i + 64);
+                if(sizes[t] == k && !anyBefore(group + i, stop - i, group[heap[0]], order)){
+                    i = stop;
+                    continue;
+                }
+                for(; stop > i; i++) offerHeap(heap, sizes[t], k, i, before);
+            }
+        }
+    });
+
+    parallelFor(0, groups, TASK_GRAIN / (chunks * k), [&](std::size_t first, std::size_t last){
+        std::vector<std::size_t> merged;
+
+        for(std::size_t g = first; last > g; g++){
+            const T* group = a + g * count;
+            auto before = [&](std::size_t x, std::size_t y){
+                return orderBefore(group[x], x, group[y], y, order);
+            };
+
+            std::size_t* heap = candidates.data() + g * chunks * k;
+            if(chunks == 1){
+                std::sort_heap(heap, heap + k, before);
+                std::copy(heap, heap + k, out + g * k);
+                continue;
+            }
+
+            merged.clear();
+            for(std::size_t c = 0; chunks > c; c++) merged.insert(merged.end(), heap + c * k, heap + c * k + sizes[g * chunks + c]);
+            std::partial_sort(merged.begin(), merged.begin() + k, merged.end(), before);
+            std::copy(merged.begin(), merged.begin() + k, out + g * k);
+        }
+    });
 }
 template<typename T>
-mcf::Mat<T>::operator const T*() const{
-    return arr;
-}
+void mcf::Mat<T>::topk(std::size_t k, Mat<std::size_t>& indices, ecl::Computer& video, REDUCE option, ORDER order, ecl::EXEC sync) const{
+    requireSelection(k, option, "topk");
+    indices.requireMatrixShape(indices, option == ROWS ? k : getGroupShape(option).first, option == ROWS ? w : k, "topk", true);
+    if(k == 0) return;
 
-template<typename T>
-void mcf::Mat<T>::send(ecl::Computer& video, ecl::EXEC sync){
-    video.send(arr, sync);
+    // work-item (g, c) keeps the best k of chunk c of group g in order, then one work-item per group merges
+    // the lists of its chunks in order; a new element moves the ones after it down, later ones lose ties
+    constexpr std::size_t CHUNK = 256;
+
+    std::string type = getTypeName();
+    std::string n = std::to_string(k);
+    auto [g_h, g_w] = getGroupShape(option);
+    std::size_t groups = g_h * g_w;
+    std::size_t count = getGroupCount(option);
+    std::size_t chunk = std::max(CHUNK, k);
+    std::size_t chunks = (count + chunk - 1) / chunk;
+
+    std::string C = std::to_string(chunks);
+    std::string L = std::to_string(chunk);
+
+    auto partial = deviceScratch<std::size_t>(video, groups * chunks, k);
+
+    auto insert = [&](const std::string& list, const std::string& list_step, const std::string& m){
+        std::string code = type + " x = a[base + " + m + " * step];\n";
+        code += "if(size == " + n + " && !before(x, a[base + " + list + "[out + (" + n + " - 1) * " + list_step + "] * step])) continue;\n";
+        code += "size_t r = size < " + n + " ? size++ : " + n + " - 1;\n";
+        code += "for(; r > 0; r--){\n";
+        code += "ulong p = " + list + "[out + (r - 1) * " + list_step + "];\n";
+        code += "if(!before(x, a[base + p * step])) break;\n";
+        code += list + "[out + r * " + list_step + "] = p;\n";
+        code += "}\n";
+        code += list + "[out + r * " + list_step + "] = " + m + ";\n";
+        return code;
+    };
+
+    ecl::Program partial_prog = getOrderBefore(order);
+    partial_prog += "__kernel void topk_partial";
+    partial_prog += "(__global " + type + "* a, __global ulong* partial){\n";
+    partial_prog += "size_t g = get_global_id(0);\n";
+    partial_prog += "size_t c = get_global_id(1);\n";
+    partial_prog += getGroupBase(option);
+    partial_prog += "size_t out = (g * " + C + " + c) * " + n + ";\n";
+    partial_prog += "size_t last = min((size_t)" + std::to_string(count) + ", (c + 1) * " + L + ");\n";
+    partial_prog += "size_t size = 0;\n";
+    partial_prog += "for(size_t m = c * " + L + "; m < last; m++){\n";
+    partial_prog += insert("partial", "1", "m");
+    partial_prog += "}\n";
+    partial_prog += "}";
+
+    ecl::Program prog = getOrderBefore(order);
+    prog += "__kernel void topk";
+    prog += "(__global " + type + "* a, __global ulong* partial, __global ulong* result){\n";
+    prog += "size_t g = get_global_id(0);\n";
+    prog += getGroupBase(option);
+    if(option == COLUMNS) prog += "size_t out = g * " + n + ";\nsize_t out_step = 1;\n";
+    else if(option == ROWS) prog += "size_t out = g;\nsize_t out_step = " + std::to_string(w) + ";\n";
+    else prog += "size_t out = 0;\nsize_t out_step = 1;\n";
+    prog += "size_t size = 0;\n";
+    prog += "for(size_t c = 0; c < " + C + "; c++){\n";
+    prog += "__global ulong* list = partial + (g * " + C + " + c) * " + n + ";\n";
+    prog += "size_t listed = min((size_t)" + n + ", min((size_t)" + std::to_string(count) + ", (c + 1) * " + L + ") - c * " + L + ");\n";
+    prog += "for(size_t t = 0; t < listed; t++){\n";
+    prog += "ulong m = list[t];\n";
+    prog += insert("result", "out_step", "m");
+    prog += "}\n";
+    prog += "}\n";
+    prog += "}";
+
+    ecl::Kernel partial_kernel = "topk_partial";
+    ecl::Kernel topk = "topk";
+
+    ecl::Frame partial_frame = {cacheProgram(partial_prog, video), partial_kernel, {&arr, &partial->arr}};
+    launch(video, partial_frame, {groups, chunks}, ASYNC, partial);
+
+    ecl::Frame frame = {cacheProgram(prog, video), topk, {&arr, &partial->arr, &indices.arr}};
+    launch(video, frame, {groups}, sync, partial);
 }
+
 template<typename T>
-void mcf::Mat<T>::receive(ecl::Computer& video, ecl::EXEC sync){
-    video.receive(arr, sync);
+template<typename F>
+void mcf::Mat<T>::groupSort(REDUCE option, ORDER order, ecl::Computer& video, const F& finish) const{
+    // bitonic network over every group padded to n2, keys are positions inside the group and padding sorts last
+    std::size_t groups = option == COLUMNS ? h : (option == ROWS ? w : 1);
+    std::size_t count = getGroupCount(option);
+    std::size_t n2 = 1;
+    while(count > n2) n2 *= 2;
+
+    std::string type = getTypeName();
+    std::string n = std::to_string(n2);
+
+    // the launches keep keys and state until the computer has run them
+    auto keys = deviceScratch<std::size_t>(video, 1, groups * n2);
+
+    // current pass lives on the device as the step of lu, so every pass runs the same program
+    auto state = deviceParameters<std::size_t>(video, {2, 1});
+
+    ecl::Program init_prog = "__kernel void bitonic_init";
+    init_prog += "(__global ulong* keys){\n";
+    init_prog += "size_t t = get_global_id(0);\n";
+    init_prog += "keys[t] = t % " + n + ";\n";
+    init_prog += "}";
+
+    ecl::Program step_prog = getOrderBefore(order);
+    step_prog += "__kernel void bitonic_step";
+    step_prog += "(__global " + type + "* a, __global ulong* keys, __global ulong* state){\n";
+    step_prog += "size_t t = get_global_id(0);\n";
+    step_prog += "size_t g = t / " + std::to_string(n2 / 2) + ";\n";
+    step_prog += "size_t p = t % " + std::to_string(n2 / 2) + ";\n";
+    step_prog += getGroupBase(option);
+    step_prog += "ulong k = state[0];\n";
+    step_prog += "ulong j = state[1];\n";
+    step_prog += "size_t i = g * " + n + " + (p / j) * 2 * j + p % j;\n";
+    step_prog += "ulong x = keys[i];\n";
+    step_prog += "ulong y = keys[i + j];\n";
+    step_prog += type + " vx = a[base + (x < " + std::to_string(count) + " ? x : 0) * step];\n";
+    step_prog += type + " vy = a[base + (y < " + std::to_string(count) + " ? y : 0) * step];\n";
+    step_prog += "int y_first = y < " + std::to_string(count) + " && (x >= " + std::to_string(count) + " || before(vy, vx) || (!before(vx, vy) && y < x));\n";
+    step_prog += "if(y_first == (((i % " + n + ") & k) == 0)){\n";
+    step_prog += "keys[i] = y;\n";
+    step_prog += "keys[i + j] = x;\n";
+    step_prog += "}\n";
+    step_prog += "}";
+
+    ecl::Program next_prog = "__kernel void bitonic_next";
+    next_prog += "(__global ulong* state){\n";
+    next_prog += "ulong j = state[1] >> 1;\n";
+    next_prog += "if(j == 0){\n";
+    next_prog += "state[0] <<= 1;\n";
+    next_prog += "j = state[0] >> 1;\n";
+    next_prog += "}\n";
+    next_prog += "state[1] = j;\n";
+    next_prog += "}";
+
+    ecl::Kernel bitonic_init = "bitonic_init";
+    ecl::Kernel bitonic_step = "bitonic_step";
+    ecl::Kernel bitonic_next = "bitonic_next";
+
+    ecl::Frame init_frame = {cacheProgram(init_prog, video), bitonic_init, {&keys->arr}};
+    ecl::Frame step_frame = {cacheProgram(step_prog, video), bitonic_step, {&arr, &keys->arr, &state->arr}};
+    ecl::Frame next_frame = {cacheProgram(next_prog, video), bitonic_next, {&state->arr}};
+
+    launch(video, init_frame, {groups * n2}, ASYNC, keys);
+    for(std::size_t k = 2; n2 >= k; k *= 2){
+        for(std::size_t j = k / 2; j > 0; j /= 2){
+            launch(video, step_frame, {groups * n2 / 2}, ASYNC, keys);
+            launch(video, next_frame, {1}, ASYNC, state);
+        }
+    }
+
+    finish(keys, n2);
 }
+
 template<typename T>
-void mcf::Mat<T>::release(ecl::Computer& video, ecl::EXEC sync){
-    video.release(arr, sync);
+void mcf::Mat<T>::argsort(Mat<std::size_t>& indices, REDUCE option, ORDER order) const{
+    indices.requireMatrixShape(indices, h, w, "argsort", true);
+
+    // (value, index) pairs keep the comparisons off the matrix, an indirect sort misses the cache on every one
+    using Pair = std::pair<T, std::size_t>;
+    auto before = [order](const Pair& x, const Pair& y){
+        return orderBefore(x.first, x.second, y.first, y.second, order);
+    };
+
+    const T* a = arr;
+    std::size_t* out = indices.arr;
+
+    if(option == FULL){
+        std::vector<Pair> pairs(total_size);
+        parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++) pairs[i] = Pair(a[i], i);
+        });
+        parallelSort(pairs.data(), total_size, before);
+        parallelFor(0, total_size, TASK_GRAIN, [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++) out[i] = pairs[i].second;
+        });
+        return;
+    }
+
+    std::size_t groups = option == COLUMNS ? h : w;
+    std::size_t count = getGroupCount(option);
+    std::size_t step = option == COLUMNS ? 1 : w;
+
+    parallelFor(0, groups, TASK_GRAIN / std::max<std::size_t>(count, 1), [&](std::size_t first, std::size_t last){
+        std::vector<Pair> pairs(count);
+
+        for(std::size_t g = first; last > g; g++){
+            std::size_t base = option == COLUMNS ? g * w : g;
+
+            for(std::size_t r = 0; count > r; r++) pairs[r] = Pair(a[base + r * step], r);
+            std::sort(pairs.begin(), pairs.end(), before);
+            for(std::size_t r = 0; count > r; r++) out[base + r * step] = pairs[r].second;
+        }
+    });
 }
 template<typename T>
-void mcf::Mat<T>::grab(ecl::Computer& video, ecl::EXEC sync){
-    video.grab(arr, sync);
+void mcf::Mat<T>::argsort(Mat<std::size_t>& indices, ecl::Computer& video, REDUCE option, ORDER order, ecl::EXEC sync) const{
+    requireImmediate(video, "argsort");
+    indices.requireMatrixShape(indices, h, w, "argsort", true);
+    if(total_size == 0) return;
+
+    std::size_t count = getGroupCount(option);
+
+    groupSort(option, order, video, [&](const std::shared_ptr<Mat<std::size_t>>& keys, std::size_t n2){
+        ecl::Program prog = "__kernel void argsort";
+        prog += "(__global ulong* keys, __global ulong* indices){\n";
+        prog += "size_t t = get_global_id(0);\n";
+        prog += "size_t g = t / " + std::to_string(count) + ";\n";
+        prog += "size_t r = t % " + std::to_string(count) + ";\n";
+        prog += getGroupBase(option);
+        prog += "indices[base + r * step] = keys[g * " + std::to_string(n2) + " + r];\n";
+        prog += "}";
+
+        ecl::Kernel argsort = "argsort";
+
+        ecl::Frame frame = {cacheProgram(prog, video), argsort, {&keys->arr, &indices.arr}};
+        launch(video, frame, {total_size}, sync, keys);
+    });
 }
 
 template<typename T>
-void mcf::Mat<T>::save(const std::string& json_filename) const{
-    std::ofstream f(json_filename);
-    if(!f.is_open()) throw std::runtime_error("unable to save matrix to json file");
+void mcf::Mat<T>::sort(Mat<T>& result, REDUCE option, ORDER order) const{
+    requireMatrixShape(result, h, w, "sort", true);
 
-    auto j = nlohmann::json();
-    j["w"] = static_cast<std::size_t>(w);
-    j["h"] = static_cast<std::size_t>(h);
-    j["total_size"] = static_cast<std::size_t>(total_size);
-    j["array"] = std::vector<T>(static_cast<const T*>(arr), arr + total_size);
+    if(&result != this) result.cpy(*this);
 
-    f << std::setw(4) << j;
-    f.close();
+    T* r = result.arr;
+    auto less = [order](const T& x, const T& y){
+        return order == DESCENDING ? orderLess(y, x) : orderLess(x, y);
+    };
+
+    if(option == FULL){
+        parallelSort(r, total_size, less);
+        return;
+    }
+
+    std::size_t groups = option == COLUMNS ? h : w;
+    std::size_t count = getGroupCount(option);
+    std::size_t step = option == COLUMNS ? 1 : w;
+
+    parallelFor(0, groups, TASK_GRAIN / std::max<std::size_t>(count, 1), [&](std::size_t first, std::size_t last){
+        std::vector<T> buffer(step == 1 ? 0 : count);
+
+        for(std::size_t g = first; last > g; g++){
+            if(step == 1){
+                std::sort(r + g * w, r + g * w + w, less);
+                continue;
+            }
+
+            for(std::size_t i = 0; count > i; i++) buffer[i] = r[i * step + g];
+            std::sort(buffer.begin(), buffer.end(), less);
+            for(std::size_t i = 0; count > i; i++) r[i * step + g] = buffer[i];
+        }
+    });
 }
 template<typename T>
-mcf::Mat<T> mcf::Mat<T>::load(const std::string& json_filename){
-    std::ifstream f(json_filename);
-        if(!f.is_open()) throw std::runtime_error("unable to load matrix to json file");
+void mcf::Mat<T>::sort(Mat<T>& result, ecl::Computer& video, REDUCE option, ORDER order, ecl::EXEC sync) const{
+    requireImmediate(video, "sort");
+    requireMatrixShape(result, h, w, "sort", true);
+    if(total_size == 0) return;
 
-        auto j = nlohmann::json::parse(f);
-        T* temp = new T[(std::size_t)j["total_size"]];
-        std::copy(j["array"].begin(), j["array"].end(), temp);
+    std::string type = getTypeName();
+    std::size_t count = getGroupCount(option);
+
+    // the gather reads values anywhere in the group, sorting in place reads a copy kept by the launch
+    std::shared_ptr<Mat<T>> copy;
+    const Mat<T>* src = this;
+    if(&result == this){
+        copy = deviceScratch<T>(video, h, w);
+        map("ret = v;", *copy, video, NONE, ASYNC);
+        src = copy.get();
+    }
 
-        Mat<T> result(temp, j["h"], j["w"]);
-        result.requireTotalSize(result, j["total_size"], "load");
+    groupSort(option, order, video, [&](const std::shared_ptr<Mat<std::size_t>>& keys, std::size_t n2){
+        ecl::Program prog = "__kernel void sort";
+        prog += "(__global " + type + "* a, __global ulong* keys, __global " + type + "* result){\n";
+        prog += "size_t t = get_global_id(0);\n";
+        prog += "size_t g = t / " + std::to_string(count) + ";\n";
+        prog += "size_t r = t % " + std::to_string(count) + ";\n";
+        prog += getGroupBase(option);
+        prog += "result[base + r * step] = a[base + keys[g * " + std::to_string(n2) + " + r] * step];\n";
+        prog += "}";
 
-        f.close();
+        ecl::Kernel sort = "sort";
 
-        return std::move(result);
+        ecl::Frame frame = {cacheProgram(prog, video), sort, {&src->arr, &keys->arr, &result.arr}};
+        launch(video, frame, {total_size}, sync, copy);
+    });
 }
 
-namespace mcf{
-    template<typename T>
-    std::ostream& operator<<(std::ostream& s, const Mat<T>& other){
-        for(std::size_t i = 0; other.h > i; i++){
-            s << "(" << other.getE(i, 0);
-            for(std::size_t j = 1; other.w > j; j++) s << ", " << other.getE(i, j);
-            s << ")\n";
+template<typename T>
+template<typename I>
+void mcf::Mat<T>::requireIndex(const Mat<I>& index, std::size_t bound, const std::string& where) const{
+    static_assert(std::is_integral<I>::value, "Require index: indices must be integers");
+
+    const I* p = index.arr;
+    for(std::size_t k = 0; index.total_size > k; k++){
+        bool negative = false;
+        if constexpr(std::is_signed<I>::value) negative = p[k] < 0;
+
+        if(negative || std::size_t(p[k]) >= bound){
+            std::string e = "Require index [" + where + "]: ";
+            e += "index " + std::to_string(p[k]) + " out of " + std::to_string(bound);
+            throw std::runtime_error(e);
         }
-        return s;
-    }
-
-    template<typename T>
-    ecl::Computer& operator<<(ecl::Computer& video, Mat<T>& other){
-        other.send(video);
-        return video;
-    }
-    template<typename T>
-    ecl::Computer& operator>>(ecl::Computer& video, Mat<T>& other){
-        other.receive(video);
-        return video;
     }
 }
-
-// methods (extra)
 template<typename T>
-bool mcf::Mat<T>::equals(const Mat<T>& X) const{
-    try{
-        requireMatrixShape(X, h, w, "equals");
-    } catch(int){
-        return false;
+std::string mcf::Mat<T>::getAtomicAdd(const std::string& where) const{
+    // compare-and-swap on the bits for floating point, atomic_add for 32-bit and atom_add for 64-bit integers
+    std::string type = getTypeName();
+    std::string add = "void atomicAdd(volatile __global " + type + "* p, " + type + " v){\n";
+
+    if constexpr(std::is_same<T, float>::value){
+        add += "uint old = as_uint(*p);\n";
+        add += "uint expected;\n";
+        add += "do{\n";
+        add += "expected = old;\n";
+        add += "old = atomic_cmpxchg((volatile __global uint*)p, expected, as_uint(as_float(expected) + v));\n";
+        add += "}while(old != expected);\n";
+    }else if constexpr(std::is_same<T, double>::value){
+        add = "#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n" + add;
+        add += "ulong old = as_ulong(*p);\n";
+        add += "ulong expected;\n";
+        add += "do{\n";
+        add += "expected = old;\n";
+        add += "old = atom_cmpxchg((volatile __global ulong*)p, expected, as_ulong(as_double(expected) + v));\n";
+        add += "}while(old != expected);\n";
+    }else if constexpr(std::is_integral<T>::value && sizeof(T) == 4) add += "atomic_add(p, v);\n";
+    else if constexpr(std::is_integral<T>::value && sizeof(T) == 8){
+        add = "#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n" + add;
+        add += "atom_add(p, v);\n";
+    }else{
+        std::string e = "Require atomic [" + where + "]: ";
+        e += "wrong matrix type " + type;
+        throw std::runtime_error(e);
     }
 
-    for(std::size_t i = 0; total_size > i; i++){
-        if(arr[i] != X.arr[i]) return false;
-    }
-    return true;
+    add += "}\n";
+    return add;
 }
 
 template<typename T>
-void mcf::Mat<T>::reshape(std::size_t new_h, std::size_t new_w){
-    requireTotalSize(*this, new_h * new_w, "reshape");
-    h = new_h;
-    w = new_w;
+template<typename I>
+void mcf::Mat<T>::gatherRows(const Mat<I>& index, Mat<T>& result) const{
+    std::size_t n = index.total_size;
+    requireMatrixShape(result, n, w, "gatherRows", true);
+    requireIndex(index, h, "gatherRows");
+
+    const I* p = index.arr;
+    const T* a = arr;
+    T* r = result.arr;
+
+    // lookups are random, so the rows a few steps ahead are prefetched
+    constexpr std::size_t AHEAD = 4;
+    parallelFor(0, n, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t k = first; last > k; k++){
+            if(last > k + AHEAD) prefetch(a + std::size_t(p[k + AHEAD]) * w, w * sizeof(T));
+
+            const T* src = a + std::size_t(p[k]) * w;
+            std::copy(src, src + w, r + k * w);
+        }
+    });
 }
 template<typename T>
-void mcf::Mat<T>::ravel(mcf::RAVEL option){
-    if(option == COLUMN) reshape(total_size, 1);
-    else reshape(1, total_size);
+template<typename I>
+void mcf::Mat<T>::gatherRows(const Mat<I>& index, Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    std::size_t n = index.total_size;
+    requireMatrixShape(result, n, w, "gatherRows", true);
+
+    std::string type = getTypeName();
+    std::string cols = std::to_string(w);
+
+    ecl::Program prog = "__kernel void gatherRows";
+    prog += "(__global " + type + "* a, __global " + index.getTypeName() + "* index, __global " + type + "* result){\n";
+    prog += "size_t r = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "if((size_t)index[r] >= " + std::to_string(h) + "UL) return;\n";
+    prog += "result[r * " + cols + " + j] = a[(size_t)index[r] * " + cols + " + j];\n";
+    prog += "}";
+
+    ecl::Kernel gather = "gatherRows";
+
+    ecl::Frame frame = {cacheProgram(prog, video), gather, {&arr, &index.arr, &result.arr}};
+    launch(video, frame, {n, w}, sync);
 }
 
-// methods (mutable)
 template<typename T>
-void mcf::Mat<T>::foreach(const std::function<void(std::size_t, std::size_t)>& f){
-    #ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for collapse(2)
-	#endif 
-    for(std::size_t i = 0; h > i; i++){
-        for(std::size_t j = 0; w > j; j++) f(i, j);
-    }
+template<typename I>
+void mcf::Mat<T>::gatherColumns(const Mat<I>& index, Mat<T>& result) const{
+    std::size_t n = index.total_size;
+    requireMatrixShape(result, h, n, "gatherColumns", true);
+    requireIndex(index, w, "gatherColumns");
+
+    const I* p = index.arr;
+    const T* a = arr;
+    T* r = result.arr;
+
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(n, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            const T* row = a + i * w;
+            for(std::size_t c = 0; n > c; c++) r[i * n + c] = row[std::size_t(p[c])];
+        }
+    });
 }
 template<typename T>
-void mcf::Mat<T>::foreach(const std::string& body, ecl::Computer& video, ecl::EXEC sync){
+template<typename I>
+void mcf::Mat<T>::gatherColumns(const Mat<I>& index, Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    std::size_t n = index.total_size;
+    requireMatrixShape(result, h, n, "gatherColumns", true);
+
     std::string type = getTypeName();
 
-    ecl::Program prog = "__kernel void foreach";
-    prog += "(__global " + type + "* result)";
-    prog += "{\n";
+    ecl::Program prog = "__kernel void gatherColumns";
+    prog += "(__global " + type + "* a, __global " + index.getTypeName() + "* index, __global " + type + "* result){\n";
     prog += "size_t i = get_global_id(0);\n";
-    prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t h = get_global_size(0);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += body + "\n";
+    prog += "size_t c = get_global_id(1);\n";
+    prog += "if((size_t)index[c] >= " + std::to_string(w) + "UL) return;\n";
+    prog += "result[i * " + std::to_string(n) + " + c] = a[i * " + std::to_string(w) + " + (size_t)index[c]];\n";
     prog += "}";
 
-    ecl::Kernel foreach = "foreach";
+    ecl::Kernel gather = "gatherColumns";
 
-    ecl::Frame frame = {cacheProgram(prog), foreach, {&arr}};
-    video.grid(frame, {h, w}, sync);
+    ecl::Frame frame = {cacheProgram(prog, video), gather, {&arr, &index.arr, &result.arr}};
+    launch(video, frame, {h, n}, sync);
 }
 
 template<typename T>
-void mcf::Mat<T>::gen(const std::function<T(std::size_t, std::size_t)>& f){
-	#ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for collapse(2)
-	#endif 
-    for(std::size_t i = 0; h > i; i++){
-        for(std::size_t j = 0; w > j; j++) setE(f(i, j), i, j);
+template<typename I>
+void mcf::Mat<T>::scatterAddRows(const Mat<I>& index, const Mat<T>& X, const T& alpha){
+    std::size_t n = index.total_size;
+    requireMatrixShape(X, n, w, "scatterAddRows");
+    requireIndex(index, h, "scatterAddRows");
+
+    // rows of X sorted by target, so every target row is summed by one task in the order of X
+    std::vector<std::pair<std::size_t, std::size_t>> order(n);
+    const I* p = index.arr;
+    for(std::size_t k = 0; n > k; k++) order[k] = {std::size_t(p[k]), k};
+    parallelSort(order.data(), n, std::less<std::pair<std::size_t, std::size_t>>());
+
+    std::vector<std::size_t> segments;
+    for(std::size_t k = 0; n > k; k++){
+        if(k == 0 || order[k].first != order[k - 1].first) segments.push_back(k);
     }
+    segments.push_back(n);
+
+    const T* x = X.arr;
+    T* a = arr;
+    T scale = alpha;
+
+    parallelFor(0, segments.size() - 1, TASK_GRAIN / std::max<std::size_t>(w, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t s = first; last > s; s++){
+            T* dst = a + order[segments[s]].first * w;
+
+            for(std::size_t k = segments[s]; segments[s + 1] > k; k++){
+                const T* src = x + order[k].second * w;
+
+                #ifdef MATRIXCF_USE_OPENMP
+                #pragma omp simd
+                #endif
+                for(std::size_t j = 0; w > j; j++) dst[j] += scale * src[j];
+            }
+        }
+    });
 }
 template<typename T>
-void mcf::Mat<T>::gen(const std::string& body, ecl::Computer& video, ecl::EXEC sync){
+template<typename I>
+void mcf::Mat<T>::scatterAddRows(const Mat<I>& index, const Mat<T>& X, ecl::Computer& video, const T& alpha, ecl::EXEC sync){
+    std::size_t n = index.total_size;
+    requireMatrixShape(X, n, w, "scatterAddRows");
+
     std::string type = getTypeName();
+    std::string cols = std::to_string(w);
 
-    ecl::Program prog = "__kernel void gen";
-    prog += "(__global " + type + "* result)";
-    prog += "{\n";
-    prog += "size_t i = get_global_id(0);\n";
+    ecl::Program prog = getAtomicAdd("scatterAddRows");
+    prog += "__kernel void scatterAddRows";
+    prog += "(__global " + type + "* a, __global " + index.getTypeName() + "* index, __global " + type + "* x, __global " + type + "* scale){\n";
+    prog += "size_t r = get_global_id(0);\n";
     prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t h = get_global_size(0);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += "size_t index = i * w + j;\n";
-    prog += type + " ret;\n";
-    prog += body + "\n";
-    prog += "result[index] = ret;";
+    prog += "if((size_t)index[r] >= " + std::to_string(h) + "UL) return;\n";
+    prog += "atomicAdd(a + (size_t)index[r] * " + cols + " + j, scale[0] * x[r * " + cols + " + j]);\n";
+    prog += "}";
+
+    ecl::Kernel scatter = "scatterAddRows";
+
+    auto scale = deviceParameters(video, {alpha});
+
+    ecl::Frame frame = {cacheProgram(prog, video), scatter, {&arr, &index.arr, &X.arr, &scale->arr}};
+    launch(video, frame, {n, w}, sync, scale);
+}
+
+template<typename T>
+template<typename I>
+void mcf::Mat<T>::scatterAddColumns(const Mat<I>& index, const Mat<T>& X, const T& alpha){
+    std::size_t n = index.total_size;
+    requireMatrixShape(X, h, n, "scatterAddColumns");
+    requireIndex(index, w, "scatterAddColumns");
+
+    const I* p = index.arr;
+    const T* x = X.arr;
+    T* a = arr;
+    T scale = alpha;
+
+    // a row per task, repeated columns of a row add up in order
+    parallelFor(0, h, TASK_GRAIN / std::max<std::size_t>(n, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            T* row = a + i * w;
+            for(std::size_t c = 0; n > c; c++) row[std::size_t(p[c])] += scale * x[i * n + c];
+        }
+    });
+}
+template<typename T>
+template<typename I>
+void mcf::Mat<T>::scatterAddColumns(const Mat<I>& index, const Mat<T>& X, ecl::Computer& video, const T& alpha, ecl::EXEC sync){
+    std::size_t n = index.total_size;
+    requireMatrixShape(X, h, n, "scatterAddColumns");
+
+    std::string type = getTypeName();
+
+    ecl::Program prog = getAtomicAdd("scatterAddColumns");
+    prog += "__kernel void scatterAddColumns";
+    prog += "(__global " + type + "* a, __global " + index.getTypeName() + "* index, __global " + type + "* x, __global " + type + "* scale){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t c = get_global_id(1);\n";
+    prog += "if((size_t)index[c] >= " + std::to_string(w) + "UL) return;\n";
+    prog += "atomicAdd(a + i * " + std::to_string(w) + " + (size_t)index[c], scale[0] * x[i * " + std::to_string(n) + " + c]);\n";
     prog += "}";
 
-    ecl::Kernel gen = "gen";
+    ecl::Kernel scatter = "scatterAddColumns";
 
-    ecl::Frame frame = {cacheProgram(prog), gen, {&arr}};
-    video.grid(frame, {h, w}, sync);
+    auto scale = deviceParameters(video, {alpha});
+
+    ecl::Frame frame = {cacheProgram(prog, video), scatter, {&arr, &index.arr, &X.arr, &scale->arr}};
+    launch(video, frame, {h, n}, sync, scale);
 }
 
+// methods (images)
 template<typename T>
-void mcf::Mat<T>::full(const T& value){
-    gen([&](std::size_t i, std::size_t j){
-        return value;
-    });
+void mcf::Mat<T>::requireConvolution(const Conv2D& g, std::size_t channels, const std::string& where) const{
+    bool fits = g.kernel_h > 0 && g.kernel_w > 0 && g.stride > 0 && g.dilation > 0;
+    fits = fits && g.height + 2 * g.padding >= g.dilation * (g.kernel_h - 1) + 1;
+    fits = fits && g.width + 2 * g.padding >= g.dilation * (g.kernel_w - 1) + 1;
+
+    if(!fits){
+        std::string e = "Require convolution [" + where + "]: ";
+        e += "kernel " + std::to_string(g.kernel_h) + "x" + std::to_string(g.kernel_w) + " doesn't fit image ";
+        e += std::to_string(g.height) + "x" + std::to_string(g.width);
+        throw std::runtime_error(e);
+    }
+    if(channels * g.height * g.width == 0) throw std::runtime_error("Require convolution [" + where + "]: empty image");
 }
 template<typename T>
-void mcf::Mat<T>::full(const T& value, ecl::Computer& video, ecl::EXEC sync){
-    std::string val = std::to_string(value);
-    gen("ret = " + val + ";", video, sync);
+std::string mcf::Mat<T>::getConvolutionTap(const Conv2D& g) const{
+    // v = image[ch][y0 + ky * dilation][x0 + kx * dilation] or 0 in the padding
+    std::string type = getTypeName();
+    std::string h = std::to_string(g.height);
+    std::string w = std::to_string(g.width);
+
+    std::string tap = "long iy = y0 + (long)(ky * " + std::to_string(g.dilation) + ");\n";
+    tap += "long ix = x0 + (long)(kx * " + std::to_string(g.dilation) + ");\n";
+    tap += type + " v = iy >= 0 && iy < " + h + " && ix >= 0 && ix < " + w + " ? image[(ch * " + h + " + iy) * " + w + " + ix] : 0;\n";
+    return tap;
 }
+
 template<typename T>
-void mcf::Mat<T>::zeros(){
-    gen([](std::size_t i, std::size_t j){
-        return T(0);
+void mcf::Mat<T>::im2col(const Conv2D& g, Mat<T>& result) const{
+    requireMatrixW(w, g.height * g.width, "im2col");
+    requireConvolution(g, h, "im2col");
+
+    std::size_t k = h * g.kernel_h * g.kernel_w;
+    std::size_t n = g.getOutputH() * g.getOutputW();
+    requireMatrixShape(result, k, n, "im2col", true);
+
+    const T* image = arr;
+    T* r = result.arr;
+    parallelFor(0, k, std::max<std::size_t>(1, TASK_GRAIN / n), [&](std::size_t first, std::size_t last){
+        for(std::size_t kk = first; last > kk; kk++) im2colRow(g, kk, 0, n, image, r + kk * n);
     });
 }
 template<typename T>
-void mcf::Mat<T>::zeros(ecl::Computer& video, ecl::EXEC sync){
-    gen("ret = 0;", video, sync);
+void mcf::Mat<T>::im2col(const Conv2D& g, Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    requireMatrixW(w, g.height * g.width, "im2col");
+    requireConvolution(g, h, "im2col");
+
+    std::size_t k = h * g.kernel_h * g.kernel_w;
+    std::size_t n = g.getOutputH() * g.getOutputW();
+    requireMatrixShape(result, k, n, "im2col", true);
+
+    std::string type = getTypeName();
+    std::string out_w = std::to_string(g.getOutputW());
+
+    ecl::Program prog = "__kernel void im2col";
+    prog += "(__global " + type + "* image, __global " + type + "* result){\n";
+    prog += "size_t kk = get_global_id(0);\n";
+    prog += "size_t q = get_global_id(1);\n";
+    prog += "size_t ch = kk / " + std::to_string(g.kernel_h * g.kernel_w) + ";\n";
+    prog += "size_t ky = kk / " + std::to_string(g.kernel_w) + " % " + std::to_string(g.kernel_h) + ";\n";
+    prog += "size_t kx = kk % " + std::to_string(g.kernel_w) + ";\n";
+    prog += "long y0 = (long)(q / " + out_w + " * " + std::to_string(g.stride) + ") - " + std::to_string(g.padding) + ";\n";
+    prog += "long x0 = (long)(q % " + out_w + " * " + std::to_string(g.stride) + ") - " + std::to_string(g.padding) + ";\n";
+    prog += getConvolutionTap(g);
+    prog += "result[kk * " + std::to_string(n) + " + q] = v;\n";
+    prog += "}";
+
+    ecl::Kernel im2col = "im2col";
+
+    ecl::Frame frame = {cacheProgram(prog, video), im2col, {&arr, &result.arr}};
+    launch(video, frame, {k, n}, sync);
 }
 
 template<typename T>
-void mcf::Mat<T>::ones(){
-    gen([](std::size_t i, std::size_t j){
-        return T(1);
+void mcf::Mat<T>::col2im(const Conv2D& g, Mat<T>& result) const{
+    requireConvolution(g, result.h, "col2im");
+    requireMatrixShape(*this, result.h * g.kernel_h * g.kernel_w, g.getOutputH() * g.getOutputW(), "col2im");
+    requireMatrixW(result.w, g.height * g.width, "col2im");
+
+    // the rows of a channel only add into its own plane
+    std::size_t taps = g.kernel_h * g.kernel_w;
+    const T* col = arr;
+    T* image = result.arr;
+    parallelFor(0, result.h, 1, [&](std::size_t first, std::size_t last){
+        for(std::size_t ch = first; last > ch; ch++){
+            std::fill(image + ch * result.w, image + (ch + 1) * result.w, T(0));
+            for(std::size_t kk = ch * taps; (ch + 1) * taps > kk; kk++) im2colRow<T, true>(g, kk, 0, w, col + kk * w, image);
+        }
     });
 }
 template<typename T>
-void mcf::Mat<T>::ones(ecl::Computer& video, ecl::EXEC sync){
-    gen("ret = 1;", video, sync);
+void mcf::Mat<T>::col2im(const Conv2D& g, Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    requireConvolution(g, result.h, "col2im");
+    requireMatrixShape(*this, result.h * g.kernel_h * g.kernel_w, g.getOutputH() * g.getOutputW(), "col2im");
+    requireMatrixW(result.w, g.height * g.width, "col2im");
+
+    std::string type = getTypeName();
+    std::string stride = std::to_string(g.stride);
+    std::string dilation = std::to_string(g.dilation);
+    std::string padding = std::to_string(g.padding);
+
+    // every pixel gathers the columns that read it, in the order of the cpu sum
+    ecl::Program prog = "__kernel void col2im";
+    prog += "(__global " + type + "* col, __global " + type + "* image){\n";
+    prog += "size_t index = get_global_id(0);\n";
+    prog += "size_t ch = index / " + std::to_string(result.w) + ";\n";
+    prog += "long iy = (long)(index / " + std::to_string(g.width) + " % " + std::to_string(g.height) + ");\n";
+    prog += "long ix = (long)(index % " + std::to_string(g.width) + ");\n";
+    prog += type + " sum = 0;\n";
+    prog += "for(size_t ky = 0; ky < " + std::to_string(g.kernel_h) + "; ky++){\n";
+    prog += "long ty = iy + " + padding + " - (long)(ky * " + dilation + ");\n";
+    prog += "if(ty < 0 || ty % " + stride + " || ty / " + stride + " >= " + std::to_string(g.getOutputH()) + ") continue;\n";
+    prog += "for(size_t kx = 0; kx < " + std::to_string(g.kernel_w) + "; kx++){\n";
+    prog += "long tx = ix + " + padding + " - (long)(kx * " + dilation + ");\n";
+    prog += "if(tx < 0 || tx % " + stride + " || tx / " + stride + " >= " + std::to_string(g.getOutputW()) + ") continue;\n";
+    prog += "size_t kk = (ch * " + std::to_string(g.kernel_h) + " + ky) * " + std::to_string(g.kernel_w) + " + kx;\n";
+    prog += "sum += col[kk * " + std::to_string(w) + " + (ty / " + stride + ") * " + std::to_string(g.getOutputW()) + " + tx / " + stride + "];\n";
+    prog += "}\n";
+    prog += "}\n";
+    prog += "image[index] = sum;\n";
+    prog += "}";
+
+    ecl::Kernel col2im = "col2im";
+
+    ecl::Frame frame = {cacheProgram(prog, video), col2im, {&arr, &result.arr}};
+    launch(video, frame, {result.total_size}, sync);
 }
 
 template<typename T>
-void mcf::Mat<T>::eye(const T& value){
-    gen([&](std::size_t i, std::size_t j){
-        return i == j ? value : T(0);
-    });
+void mcf::Mat<T>::conv2d(const Mat<T>& filters, Mat<T>& result, const Conv2D& g) const{
+    requireMatrixW(w, g.height * g.width, "conv2d");
+    requireConvolution(g, h, "conv2d");
+
+    std::size_t k = h * g.kernel_h * g.kernel_w;
+    std::size_t n = g.getOutputH() * g.getOutputW();
+    requireMatrixW(filters.w, k, "conv2d");
+    requireMatrixShape(result, filters.h, n, "conv2d", true);
+
+    const T* image = arr;
+    parallelImplicitGemm(false, filters.h, n, k, T(1), static_cast<const T*>(filters.arr), k, [&](std::size_t pc, std::size_t kc, std::size_t jc, std::size_t nc, T* pb){
+        for(std::size_t p = 0; kc > p; p++) im2colRow(g, pc + p, jc, nc, image, pb + p * nc);
+    }, static_cast<T*>(result.arr), n, T(0));
 }
 template<typename T>
-void mcf::Mat<T>::eye(const T& value, ecl::Computer& video, ecl::EXEC sync){
-    std::string val = std::to_string(value);
-    gen("ret = i == j ? + " + val + " : 0;", video, sync);
-}
+void mcf::Mat<T>::conv2d(const Mat<T>& filters, Mat<T>& result, const Conv2D& g, ecl::Computer& video, ecl::EXEC sync) const{
+    requireMatrixW(w, g.height * g.width, "conv2d");
+    requireConvolution(g, h, "conv2d");
 
-template<typename T>
-void mcf::Mat<T>::hstack(const Mat<T>& A, const Mat<T>& B){
-    requireMatrixH(A.h, B.h, "hstack");
-    requireMatrixShape(*this, A.h, A.w + B.w, "hstack", true);
+    std::size_t k = h * g.kernel_h * g.kernel_w;
+    std::size_t n = g.getOutputH() * g.getOutputW();
+    requireMatrixW(filters.w, k, "conv2d");
+    requireMatrixShape(result, filters.h, n, "conv2d", true);
 
-	#ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for collapse(2)
-	#endif
-    for(std::size_t i = 0; h > i; i++){
-        for(std::size_t j = 0; w > j; j++){
-            if(A.w > j) setE(A.getE(i, j), i, j);
-            else setE(B.getE(i, j - A.w), i, j);
-        }
+    // every work-item computes TILE out channels of one pixel, so each tap is read once per tile
+    constexpr std::size_t TILE = 4;
+    std::string type = getTypeName();
+    std::string out_w = std::to_string(g.getOutputW());
+    std::size_t tiles = (filters.h + TILE - 1) / TILE;
+
+    ecl::Program prog = "__kernel void conv2d";
+    prog += "(__global " + type + "* image, __global " + type + "* filters, __global " + type + "* result){\n";
+    prog += "size_t o = get_global_id(0) * " + std::to_string(TILE) + ";\n";
+    prog += "size_t q = get_global_id(1);\n";
+    prog += "long y0 = (long)(q / " + out_w + " * " + std::to_string(g.stride) + ") - " + std::to_string(g.padding) + ";\n";
+    prog += "long x0 = (long)(q % " + out_w + " * " + std::to_string(g.stride) + ") - " + std::to_string(g.padding) + ";\n";
+    for(std::size_t t = 0; TILE > t; t++){
+        std::string row = "o + " + std::to_string(t);
+        prog += "__global " + type + "* f" + std::to_string(t) + " = filters + (" + row + " < " + std::to_string(filters.h) + " ? " + row + " : 0) * " + std::to_string(k) + ";\n";
+        prog += type + " acc" + std::to_string(t) + " = 0;\n";
     }
+    prog += "size_t kk = 0;\n";
+    prog += "for(size_t ch = 0; ch < " + std::to_string(h) + "; ch++){\n";
+    prog += "for(size_t ky = 0; ky < " + std::to_string(g.kernel_h) + "; ky++){\n";
+    prog += "for(size_t kx = 0; kx < " + std::to_string(g.kernel_w) + "; kx++, kk++){\n";
+    prog += getConvolutionTap(g);
+    for(std::size_t t = 0; TILE > t; t++) prog += "acc" + std::to_string(t) + " += f" + std::to_string(t) + "[kk] * v;\n";
+    prog += "}\n";
+    prog += "}\n";
+    prog += "}\n";
+    for(std::size_t t = 0; TILE > t; t++){
+        std::string row = "o + " + std::to_string(t);
+        prog += "if(" + row + " < " + std::to_string(filters.h) + ") result[(" + row + ") * " + std::to_string(n) + " + q] = acc" + std::to_string(t) + ";\n";
+    }
+    prog += "}";
+
+    ecl::Kernel conv2d = "conv2d";
+
+    ecl::Frame frame = {cacheProgram(prog, video), conv2d, {&arr, &filters.arr, &result.arr}};
+    launch(video, frame, {tiles, n}, sync);
 }
 
+// methods (linear algebra)
 template<typename T>
-void mcf::Mat<T>::hstack(const Mat<T>& A, const Mat<T>& B, ecl::Computer& video, ecl::EXEC sync){
-    std::string type = getTypeName();
+void mcf::Mat<T>::lu(Mat<T>& result, Mat<std::size_t>& pivots) const{
+    requireFloatingPoint("lu");
+    requireMatrixShape(*this, h, h, "lu");
+    requireMatrixShape(result, h, h, "lu", true);
+    pivots.requireMatrixShape(pivots, 1, h, "lu", true);
+
+    if(&result != this) result.cpy(*this);
+
+    constexpr std::size_t NB = 64;
+    constexpr std::size_t TB = 256;
+
+    std::size_t n = h;
+    T* a = result.arr;
+    std::size_t* piv = pivots.arr;
+    bool singular = false;
+
+    parallelRegion([&](){
+        for(std::size_t k0 = 0; n > k0 && !singular; k0 += NB){
+            std::size_t k1 = std::min(k0 + NB, n);
+
+            // panel: unblocked factorization of columns k0..k1 with partial pivoting
+            for(std::size_t k = k0; k1 > k; k++){
+                std::size_t p = k;
+                T max = std::abs(a[k * n + k]);
+                for(std::size_t i = k + 1; n > i; i++){
+                    T v = std::abs(a[i * n + k]);
+                    if(v > max){
+                        max = v;
+                        p = i;
+                    }
+                }
+
+                piv[k] = p;
+                if(max == T(0)){
+                    singular = true;
+                    break;
+                }
+                if(p != k) std::swap_ranges(a + k * n, a + k * n + n, a + p * n);
+
+                T d = a[k * n + k];
+                for(std::size_t i = k + 1; n > i; i++){
+                    T l = a[i * n + k] /= d;
+                    for(std::size_t j = k + 1; k1 > j; j++) a[i * n + j] -= l * a[k * n + j];
+                }
+            }
+            if(singular || k1 == n) continue;
+
+            // U12 = L11^-1 * A12
+            for(std::size_t j0 = k1; n > j0; j0 += TB){
+                std::size_t jb = std::min(TB, n - j0);
+
+                spawn([&, j0, jb](){
+                    for(std::size_t k = k0; k1 > k; k++){
+                        for(std::size_t i = k + 1; k1 > i; i++){
+                            T l = a[i * n + k];
+                            T* dst = a + i * n + j0;
+                            const T* src = a + k * n + j0;
+
+                            #ifdef MATRIXCF_USE_OPENMP
+                            #pragma omp simd
+                            #endif
+                            for(std::size_t j = 0; jb > j; j++) dst[j] -= l * src[j];
+                        }
+                    }
+                });
+            }
+            sync();
+
+            // A22 -= L21 * U12
+            for(std::size_t i0 = k1; n > i0; i0 += TB){
+                for(std::size_t j0 = k1; n > j0; j0 += TB){
+                    spawn([&, i0, j0](){
+                        blockedGemm(false, false, std::min(TB, n - i0), std::min(TB, n - j0), k1 - k0, T(-1),
+                                    static_cast<const T*>(a + i0 * n + k0), n, static_cast<const T*>(a + k0 * n + j0), n, a + i0 * n + j0, n);
+                    });
+                }
+            }
+            sync();
+        }
+    });
 
-    requireMatrixH(A.h, B.h, "hstack");
-    requireMatrixShape(*this, A.h, A.w + B.w, "hstack", true);
+    if(singular) throw std::runtime_error("lu: matrix is singular");
+}
+template<typename T>
+void mcf::Mat<T>::lu(Mat<T>& result, Mat<std::size_t>& pivots, ecl::Computer& video, ecl::EXEC sync) const{
+    requireImmediate(video, "lu");
+    requireFloatingPoint("lu");
+    requireMatrixShape(*this, h, h, "lu");
+    requireMatrixShape(result, h, h, "lu", true);
+    pivots.requireMatrixShape(pivots, 1, h, "lu", true);
 
-    ecl::Program prog = "__kernel void hstack";
-    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-    prog += "{\n";
-    prog += "size_t i = get_global_id(0);\n";
-    prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
-    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
-    prog += "if(j < a_w) result[i * w + j] = a[i * a_w + j];\n";
-    prog += "else result[i * w + j] = b[i * b_w + j - a_w];\n";
-    prog += "}";
+    if(&result != this) map("ret = v;", result, video);
 
-    ecl::Kernel hstack = "hstack";
+    std::string type = getTypeName();
+    std::string n = std::to_string(h);
+
+    // current step lives on the device, so both kernels are compiled once;
+    // state[2] flags a zero pivot and is read back after the last step
+    Mat<std::size_t> state(1, 3);
+    state.zeros();
+    state.send(video);
+
+    ecl::Program pivot_prog = "__kernel void lu_pivot";
+    pivot_prog += "(__global " + type + "* a, __global ulong* pivots, __global ulong* state)";
+    pivot_prog += "{\n";
+    pivot_prog += "size_t n = " + n + ";\n";
+    pivot_prog += "size_t k = state[0];\n";
+    pivot_prog += "size_t p = k;\n";
+    pivot_prog += type + " max = fabs(a[k * n + k]);\n";
+    pivot_prog += "for(size_t i = k + 1; i < n; i++){\n";
+    pivot_prog += type + " v = fabs(a[i * n + k]);\n";
+    pivot_prog += "if(v > max){ max = v; p = i; }\n";
+    pivot_prog += "}\n";
+    pivot_prog += "pivots[k] = p;\n";
+    pivot_prog += "state[1] = k;\n";
+    pivot_prog += "state[0] = k + 1;\n";
+    pivot_prog += "if(max == 0){ state[2] = 1; return; }\n";
+    pivot_prog += "if(p != k) for(size_t j = 0; j < n; j++){\n";
+    pivot_prog += type + " t = a[k * n + j]; a[k * n + j] = a[p * n + j]; a[p * n + j] = t;\n";
+    pivot_prog += "}\n";
+    pivot_prog += type + " d = a[k * n + k];\n";
+    pivot_prog += "for(size_t i = k + 1; i < n; i++) a[i * n + k] /= d;\n";
+    pivot_prog += "}";
+
+    ecl::Program update_prog = "__kernel void lu_update";
+    update_prog += "(__global " + type + "* a, __global ulong* state)";
+    update_prog += "{\n";
+    update_prog += "size_t n = " + n + ";\n";
+    update_prog += "size_t k = state[1];\n";
+    update_prog += "size_t i = k + 1 + get_global_id(0);\n";
+    update_prog += "size_t j = k + 1 + get_global_id(1);\n";
+    update_prog += "a[i * n + j] -= a[i * n + k] * a[k * n + j];\n";
+    update_prog += "}";
+
+    ecl::Kernel lu_pivot = "lu_pivot";
+    ecl::Kernel lu_update = "lu_update";
+
+    ecl::Frame pivot_frame = {cacheProgram(pivot_prog, video), lu_pivot, {&result.arr, &pivots.arr, &state.arr}};
+    ecl::Frame update_frame = {cacheProgram(update_prog, video), lu_update, {&result.arr, &state.arr}};
+
+    for(std::size_t k = 0; h > k; k++){
+        video.grid(pivot_frame, {1}, ASYNC);
+        if(h > k + 1) video.grid(update_frame, {h - k - 1, h - k - 1}, ASYNC);
+    }
 
-    ecl::Frame frame = {cacheProgram(prog), hstack, {&A.arr, &B.arr, &arr}};
-    video.grid(frame, {h, w}, sync);
+    // the flag is read back, so lu always finishes before returning
+    state.receive(video);
+    state.release(video, sync);
+    if(state.arr[2]) throw std::runtime_error("lu: matrix is singular");
 }
 
 template<typename T>
-void mcf::Mat<T>::hstack(const std::vector<const mcf::Mat<T>*>& vec){
-    size_t total_h = vec[0]->getH();
-    size_t total_w = 0;
-
-    for(auto* m : vec){
-        requireMatrixH(total_h, m->getH(), "hstack");
-        total_w += m->getW();
-    }
-    requireMatrixShape(*this, total_h, total_w, "hstack", true);
-
-	#ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for
-	#endif
-    for(std::size_t i = 0; h > i; i++){
-        const auto* curr = vec[0];
-        size_t index = 0;
-        size_t offset = 0;
-        for(std::size_t j = 0; w > j; j++){
-            if(curr->w + offset <= j) {
-                index++;
-                offset += curr->getW();
-                curr = vec[index];
+void mcf::Mat<T>::cholesky(Mat<T>& result) const{
+    requireFloatingPoint("cholesky");
+    requireMatrixShape(*this, h, h, "cholesky");
+    requireMatrixShape(result, h, h, "cholesky", true);
+
+    if(&result != this) result.cpy(*this);
+
+    constexpr std::size_t NB = 64;
+    constexpr std::size_t TB = 256;
+
+    std::size_t n = h;
+    T* a = result.arr;
+    bool definite = true;
+
+    parallelRegion([&](){
+        for(std::size_t k0 = 0; n > k0 && definite; k0 += NB){
+            std::size_t k1 = std::min(k0 + NB, n);
+
+            // L11: unblocked factorization of the diagonal block
+            for(std::size_t k = k0; k1 > k; k++){
+                if(a[k * n + k] <= T(0)){
+                    definite = false;
+                    break;
+                }
+
+                T d = a[k * n + k] = std::sqrt(a[k * n + k]);
+                for(std::size_t i = k + 1; k1 > i; i++){
+                    T l = a[i * n + k] /= d;
+                    for(std::size_t j = k + 1; i >= j; j++) a[i * n + j] -= l * a[j * n + k];
+                }
+            }
+            if(!definite || k1 == n) continue;
+
+            // L21 = A21 * L11^-T
+            for(std::size_t i0 = k1; n > i0; i0 += TB){
+                std::size_t ib = std::min(TB, n - i0);
+
+                spawn([&, i0, ib](){
+                    for(std::size_t i = i0; i0 + ib > i; i++){
+                        T* row = a + i * n;
+                        for(std::size_t k = k0; k1 > k; k++){
+                            T sum = row[k];
+                            for(std::size_t p = k0; k > p; p++) sum -= row[p] * a[k * n + p];
+                            row[k] = sum / a[k * n + k];
+                        }
+                    }
+                });
             }
-            setE(curr->getE(i, j - offset), i, j);
+            sync();
+
+            // A22 -= L21 * L21^T (lower tiles only)
+            for(std::size_t i0 = k1; n > i0; i0 += TB){
+                for(std::size_t j0 = k1; i0 >= j0; j0 += TB){
+                    spawn([&, i0, j0](){
+                        blockedGemm(false, true, std::min(TB, n - i0), std::min(TB, n - j0), k1 - k0, T(-1),
+                                    static_cast<const T*>(a + i0 * n + k0), n, static_cast<const T*>(a + j0 * n + k0), n, a + i0 * n + j0, n);
+                    });
+                }
+            }
+            sync();
         }
-    }
-}
+    });
 
-template<typename T>
-void mcf::Mat<T>::vstack(const Mat<T>& A, const Mat<T>& B){
-    requireMatrixH(A.w, B.w, "vstack");
-    requireMatrixShape(*this, A.h + B.h, A.w, "vstack", true);
+    if(!definite) throw std::runtime_error("cholesky: matrix isn't positive definite");
 
-	#ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for collapse(2)
-	#endif
-    for(std::size_t i = 0; h > i; i++){
-        for(std::size_t j = 0; w > j; j++){
-            if(A.h > i) setE(A.getE(i, j), i, j);
-            else setE(B.getE(i - A.h, j), i, j);
-        }
-    }
+    parallelFor(0, n, TASK_GRAIN / std::max<std::size_t>(n, 1), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++) std::fill(a + i * n + i + 1, a + i * n + n, T(0));
+    });
 }
 template<typename T>
-void mcf::Mat<T>::vstack(const Mat<T>& A, const Mat<T>& B, ecl::Computer& video, ecl::EXEC sync){
-    std::string type = getTypeName();
+void mcf::Mat<T>::cholesky(Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    requireImmediate(video, "cholesky");
+    requireFloatingPoint("cholesky");
+    requireMatrixShape(*this, h, h, "cholesky");
+    requireMatrixShape(result, h, h, "cholesky", true);
 
-    requireMatrixH(A.w, B.w, "vstack");
-    requireMatrixShape(*this, A.h + B.h, A.w, "vstack", true);
+    if(&result != this) map("ret = v;", result, video);
 
-    ecl::Program prog = "__kernel void vstack";
-    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-    prog += "{\n";
-    prog += "size_t i = get_global_id(0);\n";
-    prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += "size_t a_h = " + std::to_string(A.h) + ";\n";
-    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
-    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
-    prog += "if(i < a_h) result[i * w + j] = a[i * a_w + j];\n";
-    prog += "else result[i * w + j] = b[(i - a_h) * b_w + j];\n";
-    prog += "}";
+    std::string type = getTypeName();
+    std::string n = std::to_string(h);
+
+    // current step lives on the device, so both kernels are compiled once;
+    // state[2] flags a diagonal that isn't positive and is read back after the last step
+    Mat<std::size_t> state(1, 3);
+    state.zeros();
+    state.send(video);
+
+    ecl::Program diag_prog = "__kernel void cholesky_diag";
+    diag_prog += "(__global " + type + "* a, __global ulong* state)";
+    diag_prog += "{\n";
+    diag_prog += "size_t n = " + n + ";\n";
+    diag_prog += "size_t k = state[0];\n";
+    diag_prog += "state[1] = k;\n";
+    diag_prog += "state[0] = k + 1;\n";
+    diag_prog += "if(!(a[k * n + k] > 0)){ state[2] = 1; return; }\n";
+    diag_prog += type + " d = sqrt(a[k * n + k]);\n";
+    diag_prog += "a[k * n + k] = d;\n";
+    diag_prog += "for(size_t i = k + 1; i < n; i++) a[i * n + k] /= d;\n";
+    diag_prog += "}";
+
+    ecl::Program update_prog = "__kernel void cholesky_update";
+    update_prog += "(__global " + type + "* a, __global ulong* state)";
+    update_prog += "{\n";
+    update_prog += "size_t n = " + n + ";\n";
+    update_prog += "size_t k = state[1];\n";
+    update_prog += "size_t i = k + 1 + get_global_id(0);\n";
+    update_prog += "size_t j = k + 1 + get_global_id(1);\n";
+    update_prog += "if(j <= i) a[i * n + j] -= a[i * n + k] * a[j * n + k];\n";
+    update_prog += "}";
+
+    ecl::Kernel cholesky_diag = "cholesky_diag";
+    ecl::Kernel cholesky_update = "cholesky_update";
+
+    ecl::Frame diag_frame = {cacheProgram(diag_prog, video), cholesky_diag, {&result.arr, &state.arr}};
+    ecl::Frame update_frame = {cacheProgram(update_prog, video), cholesky_update, {&result.arr, &state.arr}};
+
+    for(std::size_t k = 0; h > k; k++){
+        video.grid(diag_frame, {1}, ASYNC);
+        if(h > k + 1) video.grid(update_frame, {h - k - 1, h - k - 1}, ASYNC);
+    }
 
-    ecl::Kernel vstack = "vstack";
+    result.gen("ret = j > i ? 0 : result[index];", video, ASYNC);
 
-    ecl::Frame frame = {cacheProgram(prog), vstack, {&A.arr, &B.arr, &arr}};
-    video.grid(frame, {h, w}, sync);
+    // the flag is read back, so cholesky always finishes before returning
+    state.receive(video);
+    state.release(video, sync);
+    if(state.arr[2]) throw std::runtime_error("cholesky: matrix isn't positive definite");
 }
 
 template<typename T>
-void mcf::Mat<T>::vstack(const std::vector<const mcf::Mat<T>*>& vec){
-    size_t total_h = 0;
-    size_t total_w = vec[0]->getW();
+void mcf::Mat<T>::qr(Mat<T>& Q, Mat<T>& R) const{
+    requireFloatingPoint("qr");
+
+    std::size_t m = h;
+    std::size_t n = w;
+    std::size_t k_min = std::min(m, n);
+
+    requireMatrixShape(Q, m, k_min, "qr", true);
+    requireMatrixShape(R, k_min, n, "qr", true);
+
+    constexpr std::size_t CB = 64;
+
+    // householder vectors are stored below the diagonal of A
+    Mat<T> A = *this;
+    T* a = A.arr;
+    std::vector<T> tau(k_min);
+    std::vector<T> v(m);
+
+    auto reflect = [&](T* x, std::size_t ldx, std::size_t row0, std::size_t col0, std::size_t col1, T t){
+        std::size_t blocks = (col1 - col0 + CB - 1) / CB;
+
+        parallelFor(0, blocks, 1, [&](std::size_t first, std::size_t last){
+            for(std::size_t b = first; last > b; b++){
+                std::size_t j0 = col0 + b * CB;
+                std::size_t jb = std::min(CB, col1 - j0);
+                T s[CB];
+
+                // s = v^T * X, X -= t * v * s^T
+                std::fill(s, s + jb, T(0));
+                for(std::size_t i = row0; m > i; i++){
+                    const T* row = x + i * ldx + j0;
+                    for(std::size_t j = 0; jb > j; j++) s[j] += v[i] * row[j];
+                }
+                for(std::size_t i = row0; m > i; i++){
+                    T* row = x + i * ldx + j0;
+                    T vi = t * v[i];
+                    for(std::size_t j = 0; jb > j; j++) row[j] -= vi * s[j];
+                }
+            }
+        });
+    };
 
-    for(auto* m : vec){
-        requireMatrixW(total_w, m->getW(), "vstack");
-        total_h += m->getH();
-    }
-    requireMatrixShape(*this, total_h, total_w, "vstack", true);
+    for(std::size_t k = 0; k_min > k; k++){
+        T alpha = a[k * n + k];
+        T norm = 0;
+        for(std::size_t i = k + 1; m > i; i++) norm += a[i * n + k] * a[i * n + k];
 
-	#ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for
-	#endif
-    for(std::size_t j = 0; w > j; j++){
-        const auto* curr = vec[0];
-        size_t index = 0;
-        size_t offset = 0;
-        for(std::size_t i = 0; h > i; i++){
-            if(curr->h + offset <= i) {
-                index++;
-                offset += curr->getH();
-                curr = vec[index];
-            }
-            setE(curr->getE(i - offset, j), i, j);
+        if(norm == T(0)){
+            tau[k] = 0;
+            continue;
         }
+
+        T beta = alpha >= T(0) ? -std::sqrt(alpha * alpha + norm) : std::sqrt(alpha * alpha + norm);
+        tau[k] = (beta - alpha) / beta;
+
+        v[k] = 1;
+        for(std::size_t i = k + 1; m > i; i++) v[i] = a[i * n + k] /= alpha - beta;
+        a[k * n + k] = beta;
+
+        if(n > k + 1) reflect(a, n, k, k + 1, n, tau[k]);
     }
-}
 
-template<typename T>
-void mcf::Mat<T>::cpy(const Mat<T>& X){
-    requireMatrixShape(X, h, w, "cpy");
+    R.zeros();
+    for(std::size_t i = 0; k_min > i; i++)
+        for(std::size_t j = i; n > j; j++) R[i][j] = a[i * n + j];
 
-	#ifdef MATRIXCF_USE_OPENMP
-	#pragma omp parallel for collapse(2)
-	#endif
-    for(std::size_t i = 0; h > i; i++)
-        for(std::size_t j = 0; w > j; j++) setE(X.getE(i, j), i, j);
-}
-template<typename T>
-void mcf::Mat<T>::view(Mat<T>& X){
-    requireTotalSize(X, total_size, "view");
+    // Q = H_0 * H_1 * ... * H_(k_min - 1) * I
+    Q.eye();
+    for(std::size_t k = k_min; k-- > 0;){
+        if(tau[k] == T(0)) continue;
 
-	arr.view(X.getArray());
+        v[k] = 1;
+        for(std::size_t i = k + 1; m > i; i++) v[i] = a[i * n + k];
+
+        reflect(static_cast<T*>(Q.arr), k_min, k, k, k_min, tau[k]);
+    }
 }
 
-// higher-order methods (immutable)
 template<typename T>
-void mcf::Mat<T>::map(const std::function<T(const T&)>& f, mcf::Mat<T>& result, TRANSPOSE option) const
-{
-    if(option == NONE){
-        requireMatrixShape(result, h, w, "map", true);
+void mcf::Mat<T>::solveTriangular(const Mat<T>& B, Mat<T>& result, TRIANGLE option, bool unit_diagonal) const{
+    requireFloatingPoint("solveTriangular");
+    requireMatrixShape(*this, h, h, "solveTriangular");
+    requireMatrixH(B.h, h, "solveTriangular");
+    requireMatrixShape(result, B.h, B.w, "solveTriangular", true);
+
+    if(&result != &B) result.cpy(B);
+
+    constexpr std::size_t CB = 256;
+
+    std::size_t n = h;
+    std::size_t m = B.w;
+    std::size_t blocks = (m + CB - 1) / CB;
+    const T* a = arr;
+    T* x = result.arr;
+
+    parallelFor(0, blocks, 1, [&](std::size_t first, std::size_t last){
+        for(std::size_t b = first; last > b; b++){
+            std::size_t j0 = b * CB;
+            std::size_t jb = std::min(CB, m - j0);
+
+            for(std::size_t step = 0; n > step; step++){
+                std::size_t i = option == LOWER ? step : n - 1 - step;
+                std::size_t k0 = option == LOWER ? 0 : i + 1;
+                std::size_t k1 = option == LOWER ? i : n;
+                T* x_i = x + i * m + j0;
+
+                for(std::size_t k = k0; k1 > k; k++){
+                    T l = a[i * n + k];
+                    const T* x_k = x + k * m + j0;
+
+                    #ifdef MATRIXCF_USE_OPENMP
+                    #pragma omp simd
+                    #endif
+                    for(std::size_t j = 0; jb > j; j++) x_i[j] -= l * x_k[j];
+                }
+
+                if(!unit_diagonal){
+                    T d = a[i * n + i];
+                    for(std::size_t j = 0; jb > j; j++) x_i[j] /= d;
+                }
+            }
+        }
+    });
+}
 
-		#ifdef MATRIXCF_USE_OPENMP
-		#pragma omp parallel for
-		#endif
-        for(std::size_t i = 0; total_size > i; i++) result.arr[i] = f(arr[i]);
+template<typename T>
+void mcf::Mat<T>::solve(const Mat<T>& B, Mat<T>& result) const{
+    requireMatrixShape(*this, h, h, "solve");
+    requireMatrixH(B.h, h, "solve");
+    requireMatrixShape(result, B.h, B.w, "solve", true);
+
+    Mat<T> LU(h, h);
+    Mat<std::size_t> pivots(1, h);
+    lu(LU, pivots);
+
+    if(&result != &B) result.cpy(B);
+    for(std::size_t k = 0; h > k; k++){
+        std::size_t p = pivots[0][k];
+        if(p != k) std::swap_ranges(result[k], result[k] + result.w, result[p]);
     }
-    else{
-        requireMatrixShape(result, w, h, "map", true);
 
-		#ifdef MATRIXCF_USE_OPENMP
-		#pragma omp parallel for collapse(2)
-		#endif
-        for(std::size_t i = 0; w > i; i++){
-            for(std::size_t j = 0; h > j; j++) result[i][j] = f(getE(j, i));
-        }
-    }
+    LU.solveTriangular(result, result, LOWER, true);
+    LU.solveTriangular(result, result, UPPER);
 }
-template<typename T>
-void mcf::Mat<T>::map(const std::string& body, mcf::Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const
-{
-    std::string type = getTypeName();
 
-    if(option == NONE){
-        requireMatrixShape(result, h, w, "map", true);
 
-        ecl::Program prog = "__kernel void map";
-        prog += "(__global " + type + "* a, __global " + type + "* result){\n";
-        prog += "size_t index = get_global_id(0);\n";
-        prog += type + " v = a[index];\n";
-        prog += type + " ret;\n";
-        prog += body + "\n";
-        prog += "result[index] = ret;\n";
-        prog += "}";
+template<typename T>
+mcf::Mat<T>::~Mat(){
+    clear();
+}
 
-        ecl::Kernel map = "map";
+// Command list
+inline mcf::CommandList*& mcf::CommandList::getActive(){
+    thread_local CommandList* active = nullptr;
+    return active;
+}
 
-        ecl::Frame frame = {cacheProgram(prog), map, {&arr, &result.arr}};
-        video.grid(frame, {total_size}, sync);
-    }
-    else{
-        requireMatrixShape(result, w, h, "map", true);
+inline mcf::CommandList::CommandList(ecl::Computer& video) : video(&video){}
+inline mcf::CommandList::~CommandList(){
+    if(isRecording()) stop();
+}
 
-        ecl::Program prog = "__kernel void map";
-        prog += "(__global " + type + "* a, __global " + type + "* result)";
-        prog += "{\n";
-        prog += "";
-        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
-        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
-        prog += type + " v = a[index];\n";
-        prog += type + " ret;\n";
-        prog += body + "\n";
-        prog += "result[result_index] = ret;\n";
-        prog += "}";
+inline void mcf::CommandList::record(){
+    CommandList*& active = getActive();
+    if(active) throw std::runtime_error("CommandList: another list is recording on this thread");
 
-        ecl::Kernel map = "map";
+    active = this;
+}
+inline void mcf::CommandList::stop(){
+    CommandList*& active = getActive();
+    if(active != this) throw std::runtime_error("CommandList: list isn't recording on this thread");
 
-        ecl::Frame frame = {cacheProgram(prog), map, {&arr, &result.arr}};
-        video.grid(frame, {w, h}, sync);
+    active = nullptr;
+}
+inline void mcf::CommandList::run(ecl::EXEC sync){
+    if(isRecording()) throw std::runtime_error("CommandList: can't run while recording");
+
+    // only the last kernel waits, the queue keeps the order
+    for(std::size_t i = 0; commands.size() > i; i++){
+        Command& c = commands[i];
+        ecl::Frame frame = {*c.prog, c.kernel, c.args};
+        video->grid(frame, c.global, commands.size() == i + 1 ? sync : ASYNC);
     }
+    retain(*video, sync, nullptr);
 }
 
-template<typename T>
-void mcf::Mat<T>::transform(const Mat<T>& X, const std::function<T(const T&, const T&)>& f, Mat<T>& result, TRANSPOSE option) const{
-    if(option == NONE){
-        requireMatrixShape(X, h, w, "transform");
-        requireMatrixShape(result, h, w, "transform", true);
+inline void mcf::CommandList::clear(){
+    commands.clear();
+}
 
-		#ifdef MATRIXCF_USE_OPENMP
-		#pragma omp parallel for
-		#endif
-        for(std::size_t i = 0; total_size > i; i++) result.arr[i] = f(arr[i], X.arr[i]);
+inline void mcf::CommandList::build(){
+    if(isRecording()) throw std::runtime_error("CommandList: can't build while recording");
 
-    }else if(option == FIRST){
-        requireMatrixShape(X, w, h, "transform");
-        requireMatrixShape(result, w, h, "transform", true);
+    for(std::size_t i = 0; commands.size() > i; i++){
+        Command& c = commands[i];
+        ecl::Frame frame = {*c.prog, c.kernel, c.args};
+        video->grid(frame, std::vector<std::size_t>(c.global.size(), 1), commands.size() == i + 1 ? SYNC : ASYNC);
+    }
+    retain(*video, SYNC, nullptr);
+}
 
-		#ifdef MATRIXCF_USE_OPENMP
-		#pragma omp parallel for collapse(2)
-		#endif
-        for(std::size_t i = 0; w > i; i++){
-            for(std::size_t j = 0; h > j; j++) result[i][j] = f(getE(j, i), X.getE(i, j));
-        }
+inline void mcf::CommandList::add(ecl::Frame& frame, const std::vector<std::size_t>& global, std::shared_ptr<const void> keep){
+    commands.push_back({&frame.prog, frame.kern, frame.args, global, std::move(keep)});
+}
 
-    }else if(option == SECOND){
-        requireMatrixShape(*this, X.w, X.h, "transform");
-        requireMatrixShape(result, X.w, X.h, "transform", true);
+inline std::size_t mcf::CommandList::getSize() const{
+    return commands.size();
+}
+inline bool mcf::CommandList::isRecording() const{
+    return getActive() == this;
+}
+inline ecl::Computer& mcf::CommandList::getComputer() const{
+    return *video;
+}
 
-		#ifdef MATRIXCF_USE_OPENMP
-		#pragma omp parallel for collapse(2)
-		#endif
-        for(std::size_t i = 0; X.w > i; i++){
-            for(std::size_t j = 0; X.h > j; j++) result[i][j] = f(getE(i, j), X.getE(j, i));
-        }
-    }else{
-        requireMatrixShape(X, h, w, "transform");
-        requireMatrixShape(result, w, h, "transform", true);
+inline mcf::CommandList* mcf::CommandList::getRecording(const ecl::Computer& video){
+    CommandList* active = getActive();
+    return active && active->video == &video ? active : nullptr;
+}
 
-		#ifdef MATRIXCF_USE_OPENMP
-		#pragma omp parallel for collapse(2)
-		#endif
-        for(std::size_t i = 0; w > i; i++){
-            for(std::size_t j = 0; h > j; j++) result[i][j] = f(getE(j, i), X.getE(j, i));
-        }
+// Computer pool
+inline mcf::ComputerPool::ComputerPool(std::size_t size, const ecl::Platform& platform, ecl::DEVICE device, std::size_t device_index){
+    for(std::size_t i = 0; size > i; i++){
+        computers.emplace_back(new ecl::Computer(device_index, platform, device));
+        idle.push_back(computers.back().get());
     }
 }
-template<typename T>
-void mcf::Mat<T>::transform(const Mat<T>& X, const std::string& body, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
-    if(option == NONE){
-        requireMatrixShape(X, h, w, "transform");
-        requireMatrixShape(result, h, w, "transform", true);
-
-        std::string type = getTypeName();
+inline mcf::ComputerPool::~ComputerPool(){
+    for(auto& video : computers) releaseCache(*video);
+}
 
-        ecl::Program prog = "__kernel void transform";
-        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-        prog += "{\n";
-        prog += "size_t index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
-        prog += type + " v1 = a[index];\n";
-        prog += type + " v2 = b[index];\n";
-        prog += type + " ret;\n";
-        prog += body + "\n";
-        prog += "result[index] = ret;\n";
-        prog += "}";
+inline void mcf::ComputerPool::giveBack(ecl::Computer* video){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(video);
+    }
+    available.notify_one();
+}
 
-        ecl::Kernel transform = "transform";
+inline mcf::ComputerPool::Lease mcf::ComputerPool::lease(){
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this](){
+        return !idle.empty();
+    });
 
-        ecl::Frame frame = {cacheProgram(prog), transform, {&arr, &X.arr, &result.arr}};
-        video.grid(frame, {h, w}, sync);
+    ecl::Computer* video = idle.back();
+    idle.pop_back();
 
-    }else if(option == FIRST){
-        requireMatrixShape(X, w, h, "transform");
-        requireMatrixShape(result, w, h, "transform", true);
+    return Lease(*this, *video);
+}
+inline std::size_t mcf::ComputerPool::getSize() const{
+    return computers.size();
+}
 
-        std::string type = getTypeName();
+inline mcf::ComputerPool::Lease::Lease(ComputerPool& pool, ecl::Computer& video) : pool(&pool), video(&video){}
+inline mcf::ComputerPool::Lease::Lease(Lease&& other) : pool(other.pool), video(other.video){
+    other.pool = nullptr;
+    other.video = nullptr;
+}
+inline mcf::ComputerPool::Lease::~Lease(){
+    if(pool) pool->giveBack(video);
+}
 
-        ecl::Program prog = "__kernel void transform";
-        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-        prog += "{\n";
-        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
-        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
-        prog += type + " v1 = a[index];\n";
-        prog += type + " v2 = b[result_index];\n";
-        prog += type + " ret;\n";
-        prog += body + "\n";
-        prog += "result[result_index] = ret;\n";
-        prog += "}";
+inline ecl::Computer& mcf::ComputerPool::Lease::get(){
+    return *video;
+}
+inline mcf::ComputerPool::Lease::operator ecl::Computer&(){
+    return *video;
+}
 
-        ecl::Kernel transform = "transform";
+// Transport
+inline mcf::LocalHub::LocalHub(std::size_t size) : size(size), arrived(0), generation(0){}
 
-        ecl::Frame frame = {cacheProgram(prog), transform, {&arr, &X.arr, &result.arr}};
-        video.grid(frame, {w, h}, sync);
+inline mcf::LocalTransport::LocalTransport(LocalHub& hub, std::size_t rank) : hub(hub), rank(rank){}
 
-    }else if(option == SECOND){
-        requireMatrixShape(*this, X.w, X.h, "transform");
-        requireMatrixShape(result, X.w, X.h, "transform", true);
+inline std::size_t mcf::LocalTransport::getRank() const{
+    return rank;
+}
+inline std::size_t mcf::LocalTransport::getSize() const{
+    return hub.size;
+}
 
-        std::string type = getTypeName();
+inline void mcf::LocalTransport::send(std::size_t dst, const void* data, std::size_t bytes, int tag){
+    const char* p = static_cast<const char*>(data);
 
-        ecl::Program prog = "__kernel void transform";
-        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-        prog += "{\n";
-        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
-        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
-        prog += type + " v1 = a[result_index];\n";
-        prog += type + " v2 = b[index];\n";
-        prog += type + " ret;\n";
-        prog += body + "\n";
-        prog += "result[result_index] = ret;\n";
-        prog += "}";
+    std::lock_guard<std::mutex> lock(hub.mutex);
+    hub.mailbox[std::make_tuple(rank, dst, tag)].emplace_back(p, p + bytes);
+    hub.cv.notify_all();
+}
+inline void mcf::LocalTransport::receive(std::size_t src, void* data, std::size_t bytes, int tag){
+    std::unique_lock<std::mutex> lock(hub.mutex);
+    auto& queue = hub.mailbox[std::make_tuple(src, rank, tag)];
+    hub.cv.wait(lock, [&](){
+        return !queue.empty();
+    });
 
-        ecl::Kernel transform = "transform";
+    std::vector<char> message = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
 
-        ecl::Frame frame = {cacheProgram(prog), transform, {&arr, &X.arr, &result.arr}};
-        video.grid(frame, {X.w, X.h}, sync);
+    if(message.size() != bytes) throw std::runtime_error("LocalTransport: wrong message size " + std::to_string(message.size()) + " != " + std::to_string(bytes));
+    std::copy(message.begin(), message.end(), static_cast<char*>(data));
+}
+inline void mcf::LocalTransport::barrier(){
+    std::unique_lock<std::mutex> lock(hub.mutex);
+    std::size_t generation = hub.generation;
+
+    if(++hub.arrived == hub.size){
+        hub.arrived = 0;
+        hub.generation++;
+        hub.cv.notify_all();
     }else{
-        requireMatrixShape(X, h, w, "transform");
-        requireMatrixShape(result, w, h, "transform", true);
-
-        std::string type = getTypeName();
+        hub.cv.wait(lock, [&](){
+            return hub.generation != generation;
+        });
+    }
+}
 
-        ecl::Program prog = "__kernel void transform";
-        prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-        prog += "{\n";
-        prog += "size_t result_index = get_global_id(0) * get_global_size(1) + get_global_id(1);\n";
-        prog += "size_t index = get_global_id(1) * get_global_size(0) + get_global_id(0);\n";
-        prog += type + " v1 = a[index];\n";
-        prog += type + " v2 = b[index];\n";
-        prog += type + " ret;\n";
-        prog += body + "\n";
-        prog += "result[result_index] = ret;\n";
-        prog += "}";
+#ifdef MATRIXCF_USE_SOCKETS
+inline mcf::SocketTransport::SocketTransport(std::size_t rank, std::size_t size, std::vector<int>&& sockets) : rank(rank), size(size), sockets(std::move(sockets)), pending(size){}
+
+inline mcf::SocketTransport mcf::SocketTransport::fork(std::size_t size){
+    // pairs[a][b] is the end of the a <-> b connection owned by a
+    std::vector<std::vector<int>> pairs(size, std::vector<int>(size, -1));
+    for(std::size_t a = 0; size > a; a++){
+        for(std::size_t b = a + 1; size > b; b++){
+            int fds[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::runtime_error("SocketTransport: unable to create socket pair");
+            pairs[a][b] = fds[0];
+            pairs[b][a] = fds[1];
+        }
+    }
 
-        ecl::Kernel transform = "transform";
+    std::size_t rank = 0;
+    for(std::size_t r = 1; size > r; r++){
+        pid_t pid = ::fork();
+        if(pid < 0) throw std::runtime_error("SocketTransport: unable to fork");
+        if(pid == 0){
+            rank = r;
+            break;
+        }
+    }
 
-        ecl::Frame frame = {cacheProgram(prog), transform, {&arr, &X.arr, &result.arr}};
-        video.grid(frame, {w, h}, sync);
+    for(std::size_t a = 0; size > a; a++){
+        if(a == rank) continue;
+        for(int fd : pairs[a]) if(fd >= 0) close(fd);
     }
+
+    return SocketTransport(rank, size, std::move(pairs[rank]));
 }
 
-// methods (immutable)
-template<typename T>
-void mcf::Mat<T>::transpose(Mat<T>& result) const{
-    map([](const T& v){
-        return v;
-    }, result, FIRST);
+inline mcf::SocketTransport::SocketTransport(SocketTransport&& other) : rank(other.rank), size(other.size), sockets(std::move(other.sockets)), pending(std::move(other.pending)){
+    other.sockets.clear();
 }
-template<typename T>
-void mcf::Mat<T>::transpose(Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
-    map("ret = v;", result, video, FIRST, sync);
+
+inline std::size_t mcf::SocketTransport::getRank() const{
+    return rank;
+}
+inline std::size_t mcf::SocketTransport::getSize() const{
+    return size;
 }
 
-template<typename T>
-void mcf::Mat<T>::reduce(Mat<T>& result, REDUCE option, TRANSPOSE transpose_option) const{
-    if(transpose_option == NONE){
+inline void mcf::SocketTransport::write(std::size_t dst, const void* data, std::size_t bytes){
+    const char* p = static_cast<const char*>(data);
+    while(bytes > 0){
+        ssize_t n = ::write(sockets[dst], p, bytes);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) throw std::runtime_error("SocketTransport: unable to send to rank " + std::to_string(dst));
+        p += n;
+        bytes -= n;
+    }
+}
+inline void mcf::SocketTransport::read(std::size_t src, void* data, std::size_t bytes){
+    char* p = static_cast<char*>(data);
+    while(bytes > 0){
+        ssize_t n = ::read(sockets[src], p, bytes);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) throw std::runtime_error("SocketTransport: unable to receive from rank " + std::to_string(src));
+        p += n;
+        bytes -= n;
+    }
+}
 
-        if(option == FULL){
-            requireMatrixShape(result, 1, 1, "reduce", true);
-            result.zeros();
+// every message is framed by its tag and size, so a receive can skip messages of other tags
+inline void mcf::SocketTransport::send(std::size_t dst, const void* data, std::size_t bytes, int tag){
+    std::int64_t header[2] = {tag, static_cast<std::int64_t>(bytes)};
+    write(dst, header, sizeof(header));
+    write(dst, data, bytes);
+}
+inline void mcf::SocketTransport::receive(std::size_t src, void* data, std::size_t bytes, int tag){
+    auto check = [&](std::size_t size){
+        if(size != bytes) throw std::runtime_error("SocketTransport: wrong message size " + std::to_string(size) + " != " + std::to_string(bytes));
+    };
 
-            for(std::size_t i = 0; total_size > i; i++) result[0][0] += arr[i];
-        }else if(option == ROWS){
-            requireMatrixShape(result, 1, w, "reduce", true);
-            result.zeros();
+    auto found = pending[src].find(tag);
+    if(found != pending[src].end() && !found->second.empty()){
+        std::vector<char> message = std::move(found->second.front());
+        found->second.pop_front();
 
-            // #pragma omp parallel for
-            for(std::size_t j = 0; w > j; j++){
-                for(std::size_t i = 0; h > i; i++) result[0][j] += getE(i, j);
-            }
-        } else if(option == COLUMNS){
-            requireMatrixShape(result, h, 1, "reduce", true);
-            result.zeros();
+        check(message.size());
+        std::copy(message.begin(), message.end(), static_cast<char*>(data));
+        return;
+    }
 
-            // #pragma omp parallel for
-            for(std::size_t i = 0; h > i; i++){
-                for(std::size_t j = 0; w > j; j++) result[i][0] += getE(i, j);
-            }
+    while(true){
+        std::int64_t header[2];
+        read(src, header, sizeof(header));
+
+        std::size_t size = static_cast<std::size_t>(header[1]);
+        if(header[0] == tag){
+            check(size);
+            read(src, data, bytes);
+            return;
         }
+
+        std::vector<char> message(size);
+        read(src, message.data(), size);
+        pending[src][static_cast<int>(header[0])].push_back(std::move(message));
+    }
+}
+inline void mcf::SocketTransport::barrier(){
+    // a negative tag never meets the tags of the distributed ops
+    constexpr int BARRIER = -1;
+
+    char token = 0;
+    if(rank == 0){
+        for(std::size_t r = 1; size > r; r++) receive(r, &token, 1, BARRIER);
+        for(std::size_t r = 1; size > r; r++) send(r, &token, 1, BARRIER);
     }else{
-            if(option == FULL){
-            requireMatrixShape(result, 1, 1, "reduce", true);
-            result.zeros();
+        send(0, &token, 1, BARRIER);
+        receive(0, &token, 1, BARRIER);
+    }
+}
 
-            // #pragma omp parallel for
-            for(std::size_t j = 0; h > j; j++){
-                for(std::size_t i = 0; w > i; i++) result[0][0] += getE(j, i);
-            }
-        }else if(option == ROWS){
-            requireMatrixShape(result, 1, h, "reduce", true);
-            result.zeros();
+inline mcf::SocketTransport::~SocketTransport(){
+    if(sockets.empty()) return;
 
-            // #pragma omp parallel for
-            for(std::size_t j = 0; h > j; j++){
-                for(std::size_t i = 0; w > i; i++) result[0][j] += getE(j, i);
-            }
-        } else if(option == COLUMNS){
-            requireMatrixShape(result, w, 1, "reduce", true);
-            result.zeros();
+    for(int fd : sockets) if(fd >= 0) close(fd);
+    if(rank == 0) while(::wait(nullptr) > 0);
+}
+#endif // MATRIXCF_USE_SOCKETS
 
-            // #pragma omp parallel for
-            for(std::size_t i = 0; w > i; i++){
-                for(std::size_t j = 0; h > j; j++) result[i][0] += getE(j, i);
-            }
-        }
-    }
+#ifdef MATRIXCF_USE_MPI
+inline mcf::MPITransport::MPITransport(MPI_Comm comm) : comm(comm){}
+
+inline std::size_t mcf::MPITransport::getRank() const{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+}
+inline std::size_t mcf::MPITransport::getSize() const{
+    int size;
+    MPI_Comm_size(comm, &size);
+    return size;
 }
-template<typename T>
-void mcf::Mat<T>::reduce(Mat<T>& result, ecl::Computer& video, REDUCE option, TRANSPOSE transpose_option, ecl::EXEC sync) const{
-    if(transpose_option == NONE){
-        if(option == FULL){
-            throw std::runtime_error("full reduce on ecl::Computer temporary unavailable");
-        }else if(option == ROWS){
-            requireMatrixShape(result, 1, w, "reduce", true);
-            result.zeros(video);
 
-            std::string type = getTypeName();
+inline void mcf::MPITransport::send(std::size_t dst, const void* data, std::size_t bytes, int tag){
+    const char* p = static_cast<const char*>(data);
+    do{
+        int n = static_cast<int>(std::min(bytes, std::size_t(1) << 30));
+        MPI_Send(p, n, MPI_BYTE, static_cast<int>(dst), tag, comm);
+        p += n;
+        bytes -= n;
+    }while(bytes > 0);
+}
+inline void mcf::MPITransport::receive(std::size_t src, void* data, std::size_t bytes, int tag){
+    char* p = static_cast<char*>(data);
+    do{
+        int n = static_cast<int>(std::min(bytes, std::size_t(1) << 30));
+        MPI_Recv(p, n, MPI_BYTE, static_cast<int>(src), tag, comm, MPI_STATUS_IGNORE);
+        p += n;
+        bytes -= n;
+    }while(bytes > 0);
+}
+inline void mcf::MPITransport::barrier(){
+    MPI_Barrier(comm);
+}
+#endif // MATRIXCF_USE_MPI
 
-            ecl::Program prog = "__kernel void reduce";
-            prog += "(__global " + type + "* a, __global " + type + "* result)";
-            prog += "{\n";
-            prog += "size_t j = get_global_id(0);\n";
-            prog += "size_t w = get_global_size(0);\n";
-            prog += type + " sum = 0;\n";
-            prog += "for(size_t i = 0; i < " + std::to_string(h) + "; i++){\n";
-            prog += "sum += a[i * w + j];\n";
-            prog += "}\n";
-            prog += "result[j] = sum;\n";
-            prog += "}";
+// Distributed matrix
+template<typename T>
+mcf::DistMat<T>::DistMat(Transport& transport, std::size_t h, std::size_t w, std::size_t block, std::size_t grid_h) : h(h), w(w), block(block), transport(&transport){
+    std::size_t size = transport.getSize();
+    std::size_t rank = transport.getRank();
+
+    // as square as possible
+    if(grid_h == 0){
+        grid_h = 1;
+        for(std::size_t d = 1; size >= d * d; d++) if(size % d == 0) grid_h = d;
+    }
+    if(block == 0 || size % grid_h != 0) throw std::runtime_error("DistMat: wrong process grid " + std::to_string(grid_h) + " for " + std::to_string(size) + " ranks");
 
-            ecl::Kernel reduce = "reduce";
+    this->grid_h = grid_h;
+    grid_w = size / grid_h;
+    grid_i = rank / grid_w;
+    grid_j = rank % grid_w;
 
-            ecl::Frame frame = {cacheProgram(prog), reduce, {&arr, &result.arr}};
-            video.grid(frame, {w}, sync);
+    local = Mat<T>(localSize(h, grid_h, grid_i), localSize(w, grid_w, grid_j));
+}
 
-        } else if(option == COLUMNS){
-            requireMatrixShape(result, h, 1, "reduce", true);
-            result.zeros(video);
+template<typename T>
+std::size_t mcf::DistMat<T>::localSize(std::size_t n, std::size_t procs, std::size_t p) const{
+    std::size_t blocks = n / block;
+    std::size_t result = (blocks / procs) * block;
 
-            std::string type = getTypeName();
+    if(blocks % procs > p) result += block;
+    else if(blocks % procs == p) result += n % block;
 
-            ecl::Program prog = "__kernel void reduce";
-            prog += "(__global " + type + "* a, __global " + type + "* result)";
-            prog += "{\n";
-            prog += "size_t i = get_global_id(0);";
-            prog += "size_t h = get_global_size(0);";
-            prog += "size_t w = " + std::to_string(w) + ";";
-            prog += "size_t iw = i * w;\n";
-            prog += type + " sum = 0;\n";
-            prog += "for(size_t j = 0; j < w; j++){\n";
-            prog += "sum += a[iw + j];";
-            prog += "}\n";
-            prog += "result[i] = sum;\n";
-            prog += "}";
+    return result;
+}
+template<typename T>
+std::size_t mcf::DistMat<T>::owner(std::size_t bi, std::size_t bj) const{
+    return (bi % grid_h) * grid_w + bj % grid_w;
+}
+template<typename T>
+std::size_t mcf::DistMat<T>::blockSize(std::size_t index, std::size_t n) const{
+    return std::min(block, n - index * block);
+}
 
-            ecl::Kernel reduce = "reduce";
+template<typename T>
+void mcf::DistMat<T>::broadcast(T* data, std::size_t count, std::size_t root, const std::vector<std::size_t>& members, int tag) const{
+    std::size_t rank = transport->getRank();
 
-            ecl::Frame frame = {cacheProgram(prog), reduce, {&arr, &result.arr}};
-            video.grid(frame, {h}, sync);
+    if(rank == root){
+        for(std::size_t m : members) if(m != root) transport->send(m, data, count * sizeof(T), tag);
+    }else{
+        transport->receive(root, data, count * sizeof(T), tag);
+    }
+}
+template<typename T>
+void mcf::DistMat<T>::sum(T* data, std::size_t count, int tag) const{
+    std::size_t rank = transport->getRank();
+    std::size_t size = transport->getSize();
+
+    if(rank == 0){
+        std::vector<T> part(count);
+        for(std::size_t r = 1; size > r; r++){
+            transport->receive(r, part.data(), count * sizeof(T), tag);
+            for(std::size_t i = 0; count > i; i++) data[i] += part[i];
         }
+        for(std::size_t r = 1; size > r; r++) transport->send(r, data, count * sizeof(T), tag);
     }else{
-        if(option == FULL){
-            throw std::runtime_error("full reduce on ecl::Computer temporary unavailable");
-        }else if(option == ROWS){
-            requireMatrixShape(result, 1, h, "reduce", true);
-            result.zeros(video);
-
-            std::string type = getTypeName();
-
-            ecl::Program prog = "__kernel void reduce";
-            prog += "(__global " + type + "* a, __global " + type + "* result)";
-            prog += "{\n";
-            prog += "size_t j = get_global_id(0);\n";
-            prog += "size_t w = " + std::to_string(w) + ";\n";
-            prog += type + " sum = 0;\n";
-            prog += "for(size_t i = 0; i < w; i++){\n";
-            prog += "sum += a[j * w + i];\n";
-            prog += "}\n";
-            prog += "result[j] = sum;\n";
-            prog += "}";
+        transport->send(0, data, count * sizeof(T), tag);
+        transport->receive(0, data, count * sizeof(T), tag);
+    }
+}
 
-            ecl::Kernel reduce = "reduce";
+template<typename T>
+const std::size_t mcf::DistMat<T>::getH() const{
+    return h;
+}
+template<typename T>
+const std::size_t mcf::DistMat<T>::getW() const{
+    return w;
+}
+template<typename T>
+const std::size_t mcf::DistMat<T>::getBlock() const{
+    return block;
+}
+template<typename T>
+const std::size_t mcf::DistMat<T>::getGridH() const{
+    return grid_h;
+}
+template<typename T>
+const std::size_t mcf::DistMat<T>::getGridW() const{
+    return grid_w;
+}
 
-            ecl::Frame frame = {cacheProgram(prog), reduce, {&arr, &result.arr}};
-            video.grid(frame, {h}, sync);
+template<typename T>
+mcf::Mat<T>& mcf::DistMat<T>::getLocal(){
+    return local;
+}
+template<typename T>
+const mcf::Mat<T>& mcf::DistMat<T>::getConstLocal() const{
+    return local;
+}
 
-        } else if(option == COLUMNS){
-            requireMatrixShape(result, w, 1, "reduce", true);
-            result.zeros(video);
+template<typename T>
+void mcf::DistMat<T>::scatter(const Mat<T>& X, std::size_t root){
+    std::size_t rank = transport->getRank();
+    if(rank == root && (X.getH() != h || X.getW() != w)) throw std::runtime_error("DistMat scatter: wrong matrix shape");
+
+    std::vector<T> buffer(block * block);
+
+    for(std::size_t bi = 0; h > bi * block; bi++){
+        for(std::size_t bj = 0; w > bj * block; bj++){
+            std::size_t o = owner(bi, bj);
+            std::size_t bh = blockSize(bi, h);
+            std::size_t bw = blockSize(bj, w);
+
+            if(rank == root){
+                for(std::size_t i = 0; bh > i; i++){
+                    const T* src = static_cast<const T*>(X) + (bi * block + i) * w + bj * block;
+                    std::copy(src, src + bw, buffer.data() + i * bw);
+                }
+                if(o != root) transport->send(o, buffer.data(), bh * bw * sizeof(T), 0);
+            }else if(rank == o){
+                transport->receive(root, buffer.data(), bh * bw * sizeof(T), 0);
+            }
 
-            std::string type = getTypeName();
+            if(rank == o){
+                for(std::size_t i = 0; bh > i; i++){
+                    T* dst = local[(bi / grid_h) * block + i] + (bj / grid_w) * block;
+                    std::copy(buffer.data() + i * bw, buffer.data() + (i + 1) * bw, dst);
+                }
+            }
+        }
+    }
+}
+template<typename T>
+void mcf::DistMat<T>::gather(Mat<T>& X, std::size_t root) const{
+    std::size_t rank = transport->getRank();
+    if(rank == root && (X.getH() != h || X.getW() != w)) throw std::runtime_error("DistMat gather: wrong result matrix shape");
+
+    std::vector<T> buffer(block * block);
+
+    for(std::size_t bi = 0; h > bi * block; bi++){
+        for(std::size_t bj = 0; w > bj * block; bj++){
+            std::size_t o = owner(bi, bj);
+            std::size_t bh = blockSize(bi, h);
+            std::size_t bw = blockSize(bj, w);
+
+            if(rank == o){
+                for(std::size_t i = 0; bh > i; i++){
+                    const T* src = static_cast<const T*>(local) + ((bi / grid_h) * block + i) * local.getW() + (bj / grid_w) * block;
+                    std::copy(src, src + bw, buffer.data() + i * bw);
+                }
+                if(o != root) transport->send(root, buffer.data(), bh * bw * sizeof(T), 1);
+            }else if(rank == root){
+                transport->receive(o, buffer.data(), bh * bw * sizeof(T), 1);
+            }
 
-            ecl::Program prog = "__kernel void reduce";
-            prog += "(__global " + type + "* a, __global " + type + "* result)";
-            prog += "{\n";
-            prog += "size_t i = get_global_id(0);";
-            prog += "size_t h = " + std::to_string(h) + ";";
-            prog += "size_t w = get_global_size(0);";
-            prog += type + " sum = 0;\n";
-            prog += "for(size_t j = 0; j < h; j++){\n";
-            prog += "sum += a[j * w + i];";
-            prog += "}\n";
-            prog += "result[i] = sum;\n";
-            prog += "}";
+            if(rank == root){
+                for(std::size_t i = 0; bh > i; i++){
+                    T* dst = X[bi * block + i] + bj * block;
+                    std::copy(buffer.data() + i * bw, buffer.data() + (i + 1) * bw, dst);
+                }
+            }
+        }
+    }
+}
 
-            ecl::Kernel reduce = "reduce";
+// SUMMA: for every block column k of A (and block row k of X) the owners broadcast
+// their panel along process rows (columns), then everyone updates its local block
+template<typename T>
+void mcf::DistMat<T>::mul(const DistMat<T>& X, DistMat<T>& result) const{
+    if(w != X.h) throw std::runtime_error("DistMat mul: wrong matrix h " + std::to_string(X.h) + " != " + std::to_string(w));
+    if(result.h != h || result.w != X.w) throw std::runtime_error("DistMat mul: wrong result matrix shape");
+    if(X.block != block || result.block != block || X.grid_h != grid_h || result.grid_h != grid_h) throw std::runtime_error("DistMat mul: matrices have different layouts");
+
+    std::vector<std::size_t> row_members(grid_w);
+    std::vector<std::size_t> column_members(grid_h);
+    for(std::size_t j = 0; grid_w > j; j++) row_members[j] = grid_i * grid_w + j;
+    for(std::size_t i = 0; grid_h > i; i++) column_members[i] = i * grid_w + grid_j;
+
+    std::size_t local_h = local.getH();
+    std::size_t local_w = X.local.getW();
+
+    std::vector<T> a_panel(local_h * block);
+    std::vector<T> b_panel(block * local_w);
+
+    result.local.zeros();
+
+    for(std::size_t bk = 0; w > bk * block; bk++){
+        std::size_t kw = blockSize(bk, w);
+        std::size_t root_j = bk % grid_w;
+        std::size_t root_i = bk % grid_h;
+
+        if(grid_j == root_j){
+            std::size_t offset = (bk / grid_w) * block;
+            for(std::size_t i = 0; local_h > i; i++){
+                const T* src = static_cast<const T*>(local) + i * local.getW() + offset;
+                std::copy(src, src + kw, a_panel.data() + i * kw);
+            }
+        }
+        broadcast(a_panel.data(), local_h * kw, grid_i * grid_w + root_j, row_members, 2);
 
-            ecl::Frame frame = {cacheProgram(prog), reduce, {&arr, &result.arr}};
-            video.grid(frame, {w}, sync);
+        if(grid_i == root_i){
+            const T* src = static_cast<const T*>(X.local) + (bk / grid_h) * block * local_w;
+            std::copy(src, src + kw * local_w, b_panel.data());
         }
+        broadcast(b_panel.data(), kw * local_w, root_i * grid_w + grid_j, column_members, 3);
+
+        parallelGemm(false, false, local_h, local_w, kw, T(1), static_cast<const T*>(a_panel.data()), kw,
+                     static_cast<const T*>(b_panel.data()), local_w, static_cast<T*>(result.local), local_w);
     }
 }
 
+// blocks travel one at a time in a global order every rank follows, so blocking transports can't deadlock
 template<typename T>
-T mcf::Mat<T>::reduce() const{
-    T result = 0;
-
-    for(std::size_t i = 0; i < total_size; i++) result += arr[i];
+void mcf::DistMat<T>::transpose(DistMat<T>& result) const{
+    if(result.h != w || result.w != h) throw std::runtime_error("DistMat transpose: wrong result matrix shape");
+    if(result.block != block || result.grid_h != grid_h) throw std::runtime_error("DistMat transpose: matrices have different layouts");
+
+    std::size_t rank = transport->getRank();
+    std::vector<T> buffer(block * block);
+
+    for(std::size_t bi = 0; h > bi * block; bi++){
+        for(std::size_t bj = 0; w > bj * block; bj++){
+            std::size_t src = owner(bi, bj);
+            std::size_t dst = result.owner(bj, bi);
+            std::size_t bh = blockSize(bi, h);
+            std::size_t bw = blockSize(bj, w);
+
+            if(rank == src){
+                for(std::size_t i = 0; bh > i; i++){
+                    const T* row = static_cast<const T*>(local) + ((bi / grid_h) * block + i) * local.getW() + (bj / grid_w) * block;
+                    std::copy(row, row + bw, buffer.data() + i * bw);
+                }
+                if(dst != src) transport->send(dst, buffer.data(), bh * bw * sizeof(T), 5);
+            }else if(rank == dst){
+                transport->receive(src, buffer.data(), bh * bw * sizeof(T), 5);
+            }
 
-    return result;
+            if(rank == dst){
+                std::size_t i0 = (bj / result.grid_h) * block;
+                std::size_t j0 = (bi / result.grid_w) * block;
+                for(std::size_t i = 0; bw > i; i++){
+                    for(std::size_t j = 0; bh > j; j++) result.local[i0 + i][j0 + j] = buffer[j * bw + i];
+                }
+            }
+        }
+    }
 }
+
+// every rank gets the whole result
 template<typename T>
-T mcf::Mat<T>::mreduce(const std::function<T(const T&)>& f) const {
-	T result = 0;
+void mcf::DistMat<T>::reduce(Mat<T>& result, REDUCE option) const{
+    std::size_t r_h = option == COLUMNS ? h : 1;
+    std::size_t r_w = option == ROWS ? w : 1;
+    if(result.getH() != r_h || result.getW() != r_w) throw std::runtime_error("DistMat reduce: wrong result matrix shape");
 
-	for (std::size_t i = 0; i < total_size; i++) result += f(arr[i]);
+    std::vector<T> partial(r_h * r_w, T(0));
 
-	return result;
-}
+    for(std::size_t i = 0; local.getH() > i; i++){
+        std::size_t gi = ((i / block) * grid_h + grid_i) * block + i % block;
+        const T* row = static_cast<const T*>(local) + i * local.getW();
+
+        for(std::size_t j = 0; local.getW() > j; j++){
+            std::size_t gj = ((j / block) * grid_w + grid_j) * block + j % block;
 
+            if(option == FULL) partial[0] += row[j];
+            else if(option == ROWS) partial[gj] += row[j];
+            else partial[gi] += row[j];
+        }
+    }
+
+    sum(partial.data(), partial.size(), 4);
+    std::copy(partial.begin(), partial.end(), static_cast<T*>(result));
+}
 template<typename T>
-void mcf::Mat<T>::add(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
-    transform(X, [](const T& v1, const T& v2){
-        return v1 + v2;
-    }, result, option);
+T mcf::DistMat<T>::reduce() const{
+    Mat<T> result(1, 1);
+    reduce(result, FULL);
+    return result[0][0];
 }
+
+// Packed matrix
 template<typename T>
-void mcf::Mat<T>::add(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
-    transform(X, "ret = v1 + v2;", result, video, option, sync);
+mcf::SymMat<T>::SymMat() : n(0){}
+template<typename T>
+mcf::SymMat<T>::SymMat(std::size_t n) : n(n), packed(1, n * (n + 1) / 2){
+    packed.zeros();
 }
 
 template<typename T>
-void mcf::Mat<T>::sub(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
-    transform(X, [](const T& v1, const T& v2){
-        return v1 - v2;
-    }, result, option);
+const std::size_t mcf::SymMat<T>::getN() const{
+    return n;
 }
 template<typename T>
-void mcf::Mat<T>::sub(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
-    transform(X, "ret = v1 - v2;", result, video, option, sync);
+mcf::Mat<T>& mcf::SymMat<T>::getPacked(){
+    return packed;
+}
+template<typename T>
+const mcf::Mat<T>& mcf::SymMat<T>::getConstPacked() const{
+    return packed;
 }
 
 template<typename T>
-void mcf::Mat<T>::hadamard(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
-    transform(X, [](const T& v1, const T& v2){
-        return v1 * v2;
-    }, result, option);
+const T& mcf::SymMat<T>::getE(std::size_t i, std::size_t j) const{
+    if(j > i) std::swap(i, j);
+    return packed.arr[packedOffset(i, j, n, LOWER)];
 }
 template<typename T>
-void mcf::Mat<T>::hadamard(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
-    transform(X, "ret = v1 * v2;", result, video, option, sync);
+void mcf::SymMat<T>::setE(const T& value, std::size_t i, std::size_t j){
+    if(j > i) std::swap(i, j);
+    packed.arr[packedOffset(i, j, n, LOWER)] = value;
 }
 
 template<typename T>
-void mcf::Mat<T>::mul(const Mat<T>& X, Mat<T>& result, TRANSPOSE option) const{
-    std::size_t first_h = h;
-    std::size_t first_w = w;
-    std::size_t second_h = X.h;
-    std::size_t second_w = X.w;
-
-    if (option == FIRST){
-        first_h = w;
-        first_w = h;
-    }else if(option == SECOND){
-        second_h = X.w;
-        second_w = X.h;
-    }else if(option == BOTH){
-        first_h = w;
-        first_w = h;
-        second_h = X.w;
-        second_w = X.h;
-    }
+void mcf::SymMat<T>::syrk(const Mat<T>& A, TRANSPOSE option, const T& alpha, const T& beta){
+    if(option != NONE && option != FIRST) throw std::runtime_error("syrk: option must be NONE or FIRST");
+
+    std::size_t k = option == FIRST ? A.h : A.w;
+    packed.requireMatrixShape(A, option == FIRST ? k : n, option == FIRST ? n : k, "syrk");
+
+    // tiles of the lower half, a diagonal tile is computed whole and only its lower part is stored
+    constexpr std::size_t TB = 128;
+    std::size_t blocks = (n + TB - 1) / TB;
+    const T* a = A.arr;
+    T* p = packed.arr;
+
+    parallelFor(0, blocks * (blocks + 1) / 2, 1, [&](std::size_t first, std::size_t last){
+        std::vector<T> tile;
+
+        for(std::size_t pair = first; last > pair; pair++){
+            std::size_t bi = 0;
+            while((bi + 1) * (bi + 2) / 2 <= pair) bi++;
+            std::size_t bj = pair - bi * (bi + 1) / 2;
+
+            std::size_t i0 = bi * TB;
+            std::size_t j0 = bj * TB;
+            std::size_t mb = std::min(TB, n - i0);
+            std::size_t nb = std::min(TB, n - j0);
+
+            tile.assign(mb * nb, T(0));
+            if(option == FIRST) blockedGemm(true, false, mb, nb, k, alpha, a + i0, n, a + j0, n, tile.data(), nb);
+            else blockedGemm(false, true, mb, nb, k, alpha, a + i0 * k, k, a + j0 * k, k, tile.data(), nb);
+
+            for(std::size_t i = 0; mb > i; i++){
+                T* row = p + packedOffset(i0 + i, j0, n, LOWER);
+                const T* t = tile.data() + i * nb;
+                std::size_t count = bi == bj ? i + 1 : nb;
+
+                // beta = 0 ignores the old contents
+                if(beta == T(0)) std::copy(t, t + count, row);
+                else for(std::size_t j = 0; count > j; j++) row[j] = t[j] + beta * row[j];
+            }
+        }
+    });
+}
+template<typename T>
+void mcf::SymMat<T>::syrk(const Mat<T>& A, ecl::Computer& video, TRANSPOSE option, const T& alpha, const T& beta, ecl::EXEC sync){
+    if(option != NONE && option != FIRST) throw std::runtime_error("syrk: option must be NONE or FIRST");
+
+    std::size_t k = option == FIRST ? A.h : A.w;
+    packed.requireMatrixShape(A, option == FIRST ? k : n, option == FIRST ? n : k, "syrk");
+
+    std::string type = packed.getTypeName();
+    std::string K = std::to_string(k);
+    std::string N = std::to_string(n);
 
-    requireMatrixShape(result, first_h, second_w, "mul", true);
-    requireMatrixH(first_w, second_h, "mul");
+    // one work item per element of the lower half, alpha and beta are inputs and beta = 0 never reads p
+    ecl::Program prog = "__kernel void packed_syrk";
+    prog += "(__global " + type + "* p, __global " + type + "* a, __global " + type + "* scale){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += "if(j > i) return;\n";
+    prog += type + " sum = 0;\n";
+    if(option == FIRST) prog += "for(size_t q = 0; q < " + K + "; q++) sum += a[q * " + N + " + i] * a[q * " + N + " + j];\n";
+    else prog += "for(size_t q = 0; q < " + K + "; q++) sum += a[i * " + K + " + q] * a[j * " + K + " + q];\n";
+    prog += "size_t index = i * (i + 1) / 2 + j;\n";
+    prog += type + " v = scale[0] * sum;\n";
+    prog += "if(scale[1] != 0) v += scale[1] * p[index];\n";
+    prog += "p[index] = v;\n";
+    prog += "}";
 
-    result.zeros();
+    ecl::Kernel packed_syrk = "packed_syrk";
 
-    if(option == NONE){    
-        // #pragma omp parallel for
-        for(std::size_t i = 0; first_h > i; i++)
-            for(std::size_t k = 0; first_w > k; k++)
-                for(std::size_t j = 0; second_w > j; j++)
-                    result[i][j] += getE(i, k) * X.getE(k, j);
+    auto scale = deviceParameters(video, {alpha, beta});
 
-    }else if(option == FIRST){
-        // #pragma omp parallel for
-        for(std::size_t i = 0; first_h > i; i++)
-            for(std::size_t k = 0; first_w > k; k++) 
-                for(std::size_t j = 0; second_w > j; j++)
-                    result[i][j] += getE(k, i) * X.getE(k, j);
-
-    }else if(option == SECOND){    
-        // #pragma omp parallel for
-        for(std::size_t i = 0; first_h > i; i++)
-            for(std::size_t j = 0; second_w > j; j++)
-                for(std::size_t k = 0; first_w > k; k++)
-                    result[i][j] += getE(i, k) * X.getE(j, k);
-    }else{
-        // #pragma omp parallel for
-        for(std::size_t i = 0; first_h > i; i++)
-            for(std::size_t j = 0; second_w > j; j++)
-                for(std::size_t k = 0; first_w > k; k++)
-                    result[i][j] += getE(k, i) * X.getE(j, k);
-    }
+    ecl::Frame frame = {cacheProgram(prog, video), packed_syrk, {&packed.arr, &A.arr, &scale->arr}};
+    launch(video, frame, {n, n}, sync, scale);
+}
+
+template<typename T>
+void mcf::SymMat<T>::mul(const Mat<T>& B, Mat<T>& result) const{
+    packed.requireMatrixH(B.h, n, "mul");
+    packed.requireMatrixShape(result, n, B.w, "mul", true);
+    if(&B == &result) throw std::runtime_error("mul: the result can't be the second matrix");
+
+    // blocks of full rows are unpacked and multiplied as dense rows
+    constexpr std::size_t MB = 64;
+    std::size_t m = B.w;
+    const T* p = packed.arr;
+    const T* b = B.arr;
+    T* c = result.arr;
+
+    parallelFor(0, (n + MB - 1) / MB, 1, [&](std::size_t first, std::size_t last){
+        std::vector<T> rows;
+
+        for(std::size_t block = first; last > block; block++){
+            std::size_t i0 = block * MB;
+            std::size_t mb = std::min(MB, n - i0);
+
+            rows.resize(mb * n);
+            for(std::size_t i = 0; mb > i; i++){
+                std::size_t r = i0 + i;
+                std::copy(p + packedRow(r, n, LOWER), p + packedRow(r, n, LOWER) + r + 1, rows.data() + i * n);
+                for(std::size_t j = r + 1; n > j; j++) rows[i * n + j] = p[packedOffset(j, r, n, LOWER)];
+            }
+
+            std::fill(c + i0 * m, c + (i0 + mb) * m, T(0));
+            blockedGemm(false, false, mb, m, n, T(1), rows.data(), n, b, m, c + i0 * m, m);
+        }
+    });
 }
 template<typename T>
-void mcf::Mat<T>::mul(const Mat<T>& X, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
-    std::string type = getTypeName();
+void mcf::SymMat<T>::mul(const Mat<T>& B, Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    packed.requireMatrixH(B.h, n, "mul");
+    packed.requireMatrixShape(result, n, B.w, "mul", true);
+    if(&B == &result) throw std::runtime_error("mul: the result can't be the second matrix");
 
-    std::size_t first_h = h;
-    std::size_t first_w = w;
-    std::size_t second_h = X.h;
-    std::size_t second_w = X.w;
+    std::string type = packed.getTypeName();
+    std::string M = std::to_string(B.w);
 
-    std::string mul_optimized = "a[i * " + std::to_string(w) + " + k] * b[k * " + std::to_string(X.w) + " + j];";
+    ecl::Program prog = getPackedOffset(n, LOWER);
+    prog += "__kernel void packed_symm";
+    prog += "(__global " + type + "* p, __global " + type + "* b, __global " + type + "* c){\n";
+    prog += "size_t i = get_global_id(0);\n";
+    prog += "size_t j = get_global_id(1);\n";
+    prog += type + " sum = 0;\n";
+    prog += "for(size_t k = 0; k <= i; k++) sum += p[packedOffset(i, k)] * b[k * " + M + " + j];\n";
+    prog += "for(size_t k = i + 1; k < " + std::to_string(n) + "; k++) sum += p[packedOffset(k, i)] * b[k * " + M + " + j];\n";
+    prog += "c[i * " + M + " + j] = sum;\n";
+    prog += "}";
 
-    if (option == FIRST){
-        first_h = w;
-        first_w = h;
-        mul_optimized = "a[k * " + std::to_string(w) + " + i] * b[k * " + std::to_string(X.w) + " + j];";
-    }else if(option == SECOND){
-        second_h = X.w;
-        second_w = X.h;
-        mul_optimized = "a[i * " + std::to_string(w) + " + k] * b[j * " + std::to_string(X.w) + " + k];";
-    }else if(option == BOTH){
-        first_h = w;
-        first_w = h;
-        second_h = X.w;
-        second_w = X.h;
-        mul_optimized = "a[k * " + std::to_string(w) + " + i] * b[j * " + std::to_string(X.w) + " + k];";
-    }
+    ecl::Kernel packed_symm = "packed_symm";
+
+    ecl::Frame frame = {cacheProgram(prog, video), packed_symm, {&packed.arr, &B.arr, &result.arr}};
+    launch(video, frame, {n, B.w}, sync);
+}
 
-    requireMatrixShape(result, first_h, second_w, "mul", true);
-    requireMatrixH(first_w, second_h, "mul");
+template<typename T>
+void mcf::SymMat<T>::toDense(Mat<T>& result) const{
+    packed.requireMatrixShape(result, n, n, "toDense", true);
 
+    const T* p = packed.arr;
+    T* d = result.arr;
 
-    ecl::Program prog = "__kernel void mul";
-    prog += "(__global " + type +  "* a, __global " + type + "* b, __global " + type + "* result)";
-    prog += "{\n";
+    parallelFor(0, n, std::max<std::size_t>(1, TASK_GRAIN / std::max<std::size_t>(n, 1)), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            std::copy(p + packedRow(i, n, LOWER), p + packedRow(i, n, LOWER) + i + 1, d + i * n);
+            for(std::size_t j = i + 1; n > j; j++) d[i * n + j] = p[packedOffset(j, i, n, LOWER)];
+        }
+    });
+}
+template<typename T>
+void mcf::SymMat<T>::toDense(Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    packed.requireMatrixShape(result, n, n, "toDense", true);
+
+    std::string type = packed.getTypeName();
+
+    ecl::Program prog = getPackedOffset(n, LOWER);
+    prog += "__kernel void packed_symmetric";
+    prog += "(__global " + type + "* p, __global " + type + "* d){\n";
     prog += "size_t i = get_global_id(0);\n";
     prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += type + " sum = 0;\n";
-    prog += "for(size_t k = 0; k < " + std::to_string(first_w) + "; k++) ";
-    prog += "sum += " + mul_optimized + "\n";
-    prog += "result[i * w + j] = sum;\n";
+    prog += "d[i * " + std::to_string(n) + " + j] = j <= i ? p[packedOffset(i, j)] : p[packedOffset(j, i)];\n";
     prog += "}";
 
-    ecl::Kernel mul = "mul";
+    ecl::Kernel packed_symmetric = "packed_symmetric";
 
-    ecl::Frame frame = {cacheProgram(prog), mul, {&arr, &X.arr, &result.arr}};
-    video.grid(frame, {first_h, second_w}, sync);
+    ecl::Frame frame = {cacheProgram(prog, video), packed_symmetric, {&packed.arr, &result.arr}};
+    launch(video, frame, {n, n}, sync);
 }
 
 template<typename T>
-void mcf::Mat<T>::mul(const T& value, Mat<T>& result, TRANSPOSE option) const{
-    map([&](const T& v){
-        return v * value;
-    }, result, option);
+void mcf::SymMat<T>::fromDense(const Mat<T>& X){
+    packed.requireMatrixShape(X, X.h, X.h, "fromDense");
+
+    n = X.h;
+    packed = Mat<T>(1, n * (n + 1) / 2);
+
+    const T* x = X.arr;
+    T* p = packed.arr;
+    for(std::size_t i = 0; n > i; i++) std::copy(x + i * n, x + i * n + i + 1, p + packedRow(i, n, LOWER));
 }
+
 template<typename T>
-void mcf::Mat<T>::mul(const T& value, Mat<T>& result, ecl::Computer& video, TRANSPOSE option, ecl::EXEC sync) const{
-    std::string val = std::to_string(value);
-    map("ret = v * " + val + ";", result, video, option, sync);
+mcf::TriMat<T>::TriMat() : n(0), option(LOWER){}
+template<typename T>
+mcf::TriMat<T>::TriMat(std::size_t n, TRIANGLE option) : n(n), option(option), packed(1, n * (n + 1) / 2){
+    packed.zeros();
 }
 
 template<typename T>
-void mcf::Mat<T>::hsplit(Mat<T>& A, Mat<T>& B) const{
-    requireMatrixH(A.h, B.h, "hsplit");
-    requireMatrixShape(*this, A.h, A.w + B.w, "hsplit", true);
+const std::size_t mcf::TriMat<T>::getN() const{
+    return n;
+}
+template<typename T>
+mcf::TRIANGLE mcf::TriMat<T>::getTriangle() const{
+    return option;
+}
+template<typename T>
+mcf::Mat<T>& mcf::TriMat<T>::getPacked(){
+    return packed;
+}
+template<typename T>
+const mcf::Mat<T>& mcf::TriMat<T>::getConstPacked() const{
+    return packed;
+}
 
-    // #pragma omp parallel for collapse(2)
-    for(std::size_t i = 0; h > i; i++){
-        for(std::size_t j = 0; w > j; j++){
-            if(A.w > j) A[i][j] = getE(i, j);
-            else B[i][j - A.w] = getE(i, j);
+template<typename T>
+T mcf::TriMat<T>::getE(std::size_t i, std::size_t j) const{
+    if(option == LOWER ? j > i : i > j) return T(0);
+    return packed.arr[packedOffset(i, j, n, option)];
+}
+template<typename T>
+void mcf::TriMat<T>::setE(const T& value, std::size_t i, std::size_t j){
+    if(option == LOWER ? j > i : i > j){
+        std::string e = "Require triangle [setE]: ";
+        e += "element (" + std::to_string(i) + ", " + std::to_string(j) + ") is outside the ";
+        e += option == LOWER ? "lower triangle" : "upper triangle";
+        throw std::runtime_error(e);
+    }
+    packed.arr[packedOffset(i, j, n, option)] = value;
+}
+
+template<typename T>
+void mcf::TriMat<T>::solve(const Mat<T>& B, Mat<T>& result, bool unit_diagonal) const{
+    packed.requireFloatingPoint("solve");
+    packed.requireMatrixH(B.h, n, "solve");
+    packed.requireMatrixShape(result, B.h, B.w, "solve", true);
+
+    if(&result != &B) result.cpy(B);
+
+    // same substitution as Mat::solveTriangular, row i of the triangle is contiguous
+    constexpr std::size_t CB = 256;
+
+    std::size_t m = B.w;
+    std::size_t blocks = (m + CB - 1) / CB;
+    const T* p = packed.arr;
+    T* x = result.arr;
+
+    parallelFor(0, blocks, 1, [&](std::size_t first, std::size_t last){
+        for(std::size_t b = first; last > b; b++){
+            std::size_t j0 = b * CB;
+            std::size_t jb = std::min(CB, m - j0);
+
+            for(std::size_t step = 0; n > step; step++){
+                std::size_t i = option == LOWER ? step : n - 1 - step;
+                std::size_t k0 = option == LOWER ? 0 : i + 1;
+                std::size_t k1 = option == LOWER ? i : n;
+                T* x_i = x + i * m + j0;
+
+                // element (i, k) is row[k]
+                const T* row = p + packedRow(i, n, option) - (option == LOWER ? 0 : i);
+
+                for(std::size_t k = k0; k1 > k; k++){
+                    T l = row[k];
+                    const T* x_k = x + k * m + j0;
+
+                    #ifdef MATRIXCF_USE_OPENMP
+                    #pragma omp simd
+                    #endif
+                    for(std::size_t j = 0; jb > j; j++) x_i[j] -= l * x_k[j];
+                }
+
+                if(!unit_diagonal){
+                    T d = row[i];
+                    for(std::size_t j = 0; jb > j; j++) x_i[j] /= d;
+                }
+            }
         }
+    });
+}
+template<typename T>
+void mcf::TriMat<T>::solve(const Mat<T>& B, Mat<T>& result, ecl::Computer& video, bool unit_diagonal, ecl::EXEC sync) const{
+    packed.requireFloatingPoint("solve");
+    packed.requireMatrixH(B.h, n, "solve");
+    packed.requireMatrixShape(result, B.h, B.w, "solve", true);
+
+    if(n == 0 || B.w == 0) return;
+    if(&result != &B) B.map("ret = v;", result, video, NONE, ASYNC);
+
+    std::string type = packed.getTypeName();
+    std::string N = std::to_string(n);
+    std::string M = std::to_string(B.w);
+
+    // column oriented substitution: once row i holds b_i minus its solved terms, the step of row i subtracts
+    // l_ri * x_i from every row r still to solve, one work item per (r, j); x_i is divided by the diagonal on the fly
+    // and for good at the end. The current row lives on the device, so every step runs the same program
+    auto state = deviceParameters<std::size_t>(video, {0});
+
+    ecl::Program step_prog = getPackedOffset(n, option);
+    step_prog += "__kernel void packed_trsm_step";
+    step_prog += "(__global " + type + "* p, __global " + type + "* x, __global ulong* state){\n";
+    if(option == LOWER){
+        step_prog += "size_t i = state[0];\n";
+        step_prog += "size_t r = i + 1 + get_global_id(0);\n";
+    }else{
+        step_prog += "size_t i = " + N + " - 1 - state[0];\n";
+        step_prog += "size_t r = get_global_id(0);\n";
+    }
+    step_prog += "size_t j = get_global_id(1);\n";
+    step_prog += type + " x_i = x[i * " + M + " + j];\n";
+    if(!unit_diagonal) step_prog += "x_i /= p[packedOffset(i, i)];\n";
+    step_prog += "x[r * " + M + " + j] -= p[packedOffset(r, i)] * x_i;\n";
+    step_prog += "}";
+
+    ecl::Program next_prog = "__kernel void packed_trsm_next";
+    next_prog += "(__global ulong* state){\n";
+    next_prog += "state[0]++;\n";
+    next_prog += "}";
+
+    // the row is reset, so a recorded list solves again from the first row
+    ecl::Program finish_prog = getPackedOffset(n, option);
+    finish_prog += "__kernel void packed_trsm_finish";
+    finish_prog += "(__global " + type + "* p, __global " + type + "* x, __global ulong* state){\n";
+    finish_prog += "size_t i = get_global_id(0);\n";
+    finish_prog += "size_t j = get_global_id(1);\n";
+    if(!unit_diagonal) finish_prog += "x[i * " + M + " + j] /= p[packedOffset(i, i)];\n";
+    finish_prog += "if(i == 0 && j == 0) state[0] = 0;\n";
+    finish_prog += "}";
+
+    ecl::Kernel packed_trsm_step = "packed_trsm_step";
+    ecl::Kernel packed_trsm_next = "packed_trsm_next";
+    ecl::Kernel packed_trsm_finish = "packed_trsm_finish";
+
+    ecl::Frame step_frame = {cacheProgram(step_prog, video), packed_trsm_step, {&packed.arr, &result.arr, &state->arr}};
+    ecl::Frame next_frame = {cacheProgram(next_prog, video), packed_trsm_next, {&state->arr}};
+    ecl::Frame finish_frame = {cacheProgram(finish_prog, video), packed_trsm_finish, {&packed.arr, &result.arr, &state->arr}};
+
+    for(std::size_t step = 0; n > step + 1; step++){
+        launch(video, step_frame, {n - 1 - step, B.w}, ASYNC, state);
+        launch(video, next_frame, {1}, ASYNC, state);
     }
+    launch(video, finish_frame, {n, B.w}, sync, state);
 }
+
 template<typename T>
-void mcf::Mat<T>::hsplit(Mat<T>& A, Mat<T>& B, ecl::Computer& video, ecl::EXEC sync) const{
-    std::string type = getTypeName();
+void mcf::TriMat<T>::toDense(Mat<T>& result) const{
+    packed.requireMatrixShape(result, n, n, "toDense", true);
+
+    const T* p = packed.arr;
+    T* d = result.arr;
+
+    parallelFor(0, n, std::max<std::size_t>(1, TASK_GRAIN / std::max<std::size_t>(n, 1)), [&](std::size_t first, std::size_t last){
+        for(std::size_t i = first; last > i; i++){
+            std::size_t j0 = option == LOWER ? 0 : i;
+            std::size_t j1 = option == LOWER ? i + 1 : n;
+            std::fill(d + i * n, d + (i + 1) * n, T(0));
+            std::copy(p + packedRow(i, n, option), p + packedRow(i, n, option) + (j1 - j0), d + i * n + j0);
+        }
+    });
+}
+template<typename T>
+void mcf::TriMat<T>::toDense(Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    packed.requireMatrixShape(result, n, n, "toDense", true);
 
-    requireMatrixH(A.h, B.h, "hsplit");
-    requireMatrixShape(*this, A.h, A.w + B.w, "hsplit", true);
+    std::string type = packed.getTypeName();
+    std::string inside = option == LOWER ? "j <= i" : "j >= i";
 
-    ecl::Program prog = "__kernel void hsplit";
-    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-    prog += "{\n";
+    ecl::Program prog = getPackedOffset(n, option);
+    prog += "__kernel void packed_triangular";
+    prog += "(__global " + type + "* p, __global " + type + "* d){\n";
     prog += "size_t i = get_global_id(0);\n";
     prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
-    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
-    prog += "if(j < a_w) a[i * a_w + j] = result[i * w + j];\n";
-    prog += "else b[i * b_w + j - a_w] = result[i * w + j];\n";
+    prog += "d[i * " + std::to_string(n) + " + j] = " + inside + " ? p[packedOffset(i, j)] : 0;\n";
     prog += "}";
 
-    ecl::Kernel hsplit = "hsplit";
+    ecl::Kernel packed_triangular = "packed_triangular";
 
-    ecl::Frame frame = {cacheProgram(prog), hsplit, {&A.arr, &B.arr, &arr}};
-    video.grid(frame, {h, w}, sync);
+    ecl::Frame frame = {cacheProgram(prog, video), packed_triangular, {&packed.arr, &result.arr}};
+    launch(video, frame, {n, n}, sync);
 }
 
 template<typename T>
-void mcf::Mat<T>::vsplit(Mat<T>& A, Mat<T>& B) const{
-    requireMatrixH(A.w, B.w, "vsplit");
-    requireMatrixShape(*this, A.h + B.h, A.w, "vsplit", true);
+void mcf::TriMat<T>::fromDense(const Mat<T>& X){
+    packed.requireMatrixShape(X, X.h, X.h, "fromDense");
+
+    n = X.h;
+    packed = Mat<T>(1, n * (n + 1) / 2);
+
+    const T* x = X.arr;
+    T* p = packed.arr;
+    for(std::size_t i = 0; n > i; i++){
+        std::size_t j0 = option == LOWER ? 0 : i;
+        std::size_t j1 = option == LOWER ? i + 1 : n;
+        std::copy(x + i * n + j0, x + i * n + j1, p + packedRow(i, n, option));
+    }
+}
 
-    // #pragma omp parallel for collapse(2)
-    for(std::size_t i = 0; h > i; i++){
-        for(std::size_t j = 0; w > j; j++){
-            if(A.h > i) A[i][j] = getE(i, j);
-            else B[i - A.h][j] = getE(i, j);
+// Layout matrix
+template<typename T, typename L>
+mcf::Mat<T, L>::Mat() : h(0), w(0){}
+template<typename T, typename L>
+mcf::Mat<T, L>::Mat(std::size_t h, std::size_t w) : h(h), w(w), block(L::getExtent(h, w).first, L::getExtent(h, w).second){
+    block.zeros();
+}
+
+template<typename T, typename L>
+void mcf::Mat<T, L>::requireLayoutShape(const Mat<T, L>& X, std::size_t require_h, std::size_t require_w, const std::string& where, bool is_result) const{
+    if(X.h != require_h || X.w != require_w){
+        std::string what = is_result ? "result matrix" : "matrix";
+
+        std::string e = "Require shape [" + where + "]: ";
+        e += "wrong " + what + " shape ";
+        e += std::to_string(X.h) + "x" + std::to_string(X.w);
+        e += " != ";
+        e += std::to_string(require_h) + "x" + std::to_string(require_w);
+
+        throw std::runtime_error(e);
+    }
+}
+
+template<typename T, typename L>
+const std::size_t mcf::Mat<T, L>::getH() const{
+    return h;
+}
+template<typename T, typename L>
+const std::size_t mcf::Mat<T, L>::getW() const{
+    return w;
+}
+template<typename T, typename L>
+mcf::Mat<T>& mcf::Mat<T, L>::getBlock(){
+    return block;
+}
+template<typename T, typename L>
+const mcf::Mat<T>& mcf::Mat<T, L>::getConstBlock() const{
+    return block;
+}
+
+template<typename T, typename L>
+const T& mcf::Mat<T, L>::getE(std::size_t i, std::size_t j) const{
+    return block.arr[L::offset(i, j, h, w)];
+}
+template<typename T, typename L>
+void mcf::Mat<T, L>::setE(const T& value, std::size_t i, std::size_t j){
+    block.arr[L::offset(i, j, h, w)] = value;
+}
+
+template<typename T, typename L>
+void mcf::Mat<T, L>::toDense(Mat<T>& result) const{
+    block.requireMatrixShape(result, h, w, "toDense", true);
+
+    if constexpr(std::is_same<L, ColumnMajor>::value) block.transpose(result);
+    else{
+        const T* b = block.arr;
+        T* d = result.arr;
+        layoutBlocks(h, w, [&](std::size_t i, std::size_t j, std::size_t){
+            d[i * w + j] = b[L::offset(i, j, h, w)];
+        });
+    }
+}
+template<typename T, typename L>
+void mcf::Mat<T, L>::toDense(Mat<T>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    block.requireMatrixShape(result, h, w, "toDense", true);
+
+    if constexpr(std::is_same<L, ColumnMajor>::value) block.transpose(result, video, sync);
+    else{
+        std::string type = block.getTypeName();
+
+        ecl::Program prog = L::getOffset("layoutOffset", h, w);
+        prog += "__kernel void layout_to_dense";
+        prog += "(__global " + type + "* b, __global " + type + "* d){\n";
+        prog += "size_t i = get_global_id(0);\n";
+        prog += "size_t j = get_global_id(1);\n";
+        prog += "d[i * " + std::to_string(w) + " + j] = b[layoutOffset(i, j)];\n";
+        prog += "}";
+
+        ecl::Kernel layout_to_dense = "layout_to_dense";
+
+        ecl::Frame frame = {cacheProgram(prog, video), layout_to_dense, {&block.arr, &result.arr}};
+        launch(video, frame, {h, w}, sync);
+    }
+}
+
+template<typename T, typename L>
+void mcf::Mat<T, L>::fromDense(const Mat<T>& X){
+    h = X.h;
+    w = X.w;
+
+    auto extent = L::getExtent(h, w);
+    block = Mat<T>(extent.first, extent.second);
+
+    if constexpr(std::is_same<L, ColumnMajor>::value) X.transpose(block);
+    else{
+        block.zeros();
+
+        const T* x = X.arr;
+        T* b = block.arr;
+        layoutBlocks(h, w, [&](std::size_t i, std::size_t j, std::size_t){
+            b[L::offset(i, j, h, w)] = x[i * w + j];
+        });
+    }
+}
+template<typename T, typename L>
+void mcf::Mat<T, L>::fromDense(const Mat<T>& X, ecl::Computer& video, ecl::EXEC sync){
+    block.requireMatrixShape(X, h, w, "fromDense");
+
+    if constexpr(std::is_same<L, ColumnMajor>::value) X.transpose(block, video, sync);
+    else{
+        std::string type = block.getTypeName();
+
+        // padding isn't written, it keeps the zeros of the block
+        ecl::Program prog = L::getOffset("layoutOffset", h, w);
+        prog += "__kernel void layout_from_dense";
+        prog += "(__global " + type + "* x, __global " + type + "* b){\n";
+        prog += "size_t i = get_global_id(0);\n";
+        prog += "size_t j = get_global_id(1);\n";
+        prog += "b[layoutOffset(i, j)] = x[i * " + std::to_string(w) + " + j];\n";
+        prog += "}";
+
+        ecl::Kernel layout_from_dense = "layout_from_dense";
+
+        ecl::Frame frame = {cacheProgram(prog, video), layout_from_dense, {&X.arr, &block.arr}};
+        launch(video, frame, {h, w}, sync);
+    }
+}
+
+template<typename T, typename L>
+void mcf::Mat<T, L>::reduce(Mat<T>& result, REDUCE option) const{
+    std::size_t r_h = option == COLUMNS ? h : 1;
+    std::size_t r_w = option == ROWS ? w : 1;
+    block.requireMatrixShape(result, r_h, r_w, "reduce", true);
+
+    if constexpr(std::is_same<L, ColumnMajor>::value){
+        if(option == FULL) return block.reduce(result, FULL);
+
+        // a column is a contiguous row of the block, so ROWS sums the rows of the block and COLUMNS its columns
+        result.reshape(r_w, r_h);
+        block.reduce(result, option == ROWS ? COLUMNS : ROWS);
+        result.reshape(r_h, r_w);
+    }else{
+        // partial sums per band of rows, merged in band order
+        std::size_t bands = (h + LAYOUT_BLOCK - 1) / LAYOUT_BLOCK;
+        std::size_t n = option == ROWS ? w : 1;
+        std::vector<T> partial(option == COLUMNS ? 0 : bands * n, T(0));
+
+        result.zeros();
+        const T* b = block.arr;
+        T* r = result.arr;
+        layoutBlocks(h, w, [&](std::size_t i, std::size_t j, std::size_t band){
+            T v = b[L::offset(i, j, h, w)];
+            if(option == COLUMNS) r[i] += v;
+            else partial[band * n + (option == ROWS ? j : 0)] += v;
+        });
+
+        if(option != COLUMNS){
+            for(std::size_t band = 0; bands > band; band++){
+                for(std::size_t j = 0; n > j; j++) r[j] += partial[band * n + j];
+            }
         }
     }
 }
-template<typename T>
-void mcf::Mat<T>::vsplit(Mat<T>& A, Mat<T>& B, ecl::Computer& video, ecl::EXEC sync) const{
-    std::string type = getTypeName();
+template<typename T, typename L>
+void mcf::Mat<T, L>::reduce(Mat<T>& result, ecl::Computer& video, REDUCE option, ecl::EXEC sync) const{
+    std::size_t r_h = option == COLUMNS ? h : 1;
+    std::size_t r_w = option == ROWS ? w : 1;
+    block.requireMatrixShape(result, r_h, r_w, "reduce", true);
+
+    if constexpr(std::is_same<L, ColumnMajor>::value){
+        if(option == FULL) return block.reduce(result, video, FULL, NONE, sync);
+
+        result.reshape(r_w, r_h);
+        block.reduce(result, video, option == ROWS ? COLUMNS : ROWS, NONE, sync);
+        result.reshape(r_h, r_w);
+    }else{
+        if(option == FULL) throw std::runtime_error("full reduce on ecl::Computer temporary unavailable");
+
+        std::string type = block.getTypeName();
+        std::size_t n = option == ROWS ? h : w;
+
+        // a work item per column (ROWS) or row (COLUMNS)
+        ecl::Program prog = L::getOffset("layoutOffset", h, w);
+        prog += "__kernel void layout_reduce";
+        prog += "(__global " + type + "* b, __global " + type + "* r){\n";
+        prog += "size_t g = get_global_id(0);\n";
+        prog += type + " sum = 0;\n";
+        prog += "for(size_t k = 0; k < " + std::to_string(n) + "; k++) sum += b[" + (option == ROWS ? "layoutOffset(k, g)" : "layoutOffset(g, k)") + "];\n";
+        prog += "r[g] = sum;\n";
+        prog += "}";
 
-    requireMatrixH(A.w, B.w, "vsplit");
-    requireMatrixShape(*this, A.h + B.h, A.w, "vsplit", true);
+        ecl::Kernel layout_reduce = "layout_reduce";
 
-    ecl::Program prog = "__kernel void vsplit";
-    prog += "(__global " + type + "* a, __global " + type + "* b, __global " + type + "* result)";
-    prog += "{\n";
-    prog += "size_t i = get_global_id(0);\n";
-    prog += "size_t j = get_global_id(1);\n";
-    prog += "size_t w = get_global_size(1);\n";
-    prog += "size_t a_h = " + std::to_string(A.h) + ";\n";
-    prog += "size_t a_w = " + std::to_string(A.w) + ";\n";
-    prog += "size_t b_w = " + std::to_string(B.w) + ";\n";
-    prog += "if(i < a_h) a[i * a_w + j] = result[i * w + j];\n";
-    prog += "else b[(i - a_h) * b_w + j] = result[i * w + j];\n";
-    prog += "}";
+        ecl::Frame frame = {cacheProgram(prog, video), layout_reduce, {&block.arr, &result.arr}};
+        launch(video, frame, {option == ROWS ? w : h}, sync);
+    }
+}
 
-    ecl::Kernel vsplit = "vsplit";
+template<typename T, typename L>
+void mcf::Mat<T, L>::transpose(Mat<T, L>& result) const{
+    requireLayoutShape(result, w, h, "transpose", true);
+    if(&result == this) throw std::runtime_error("transpose: the result can't be the matrix");
 
-    ecl::Frame frame = {cacheProgram(prog), vsplit, {&A.arr, &B.arr, &arr}};
-    video.grid(frame, {h, w}, sync);
+    if constexpr(std::is_same<L, ColumnMajor>::value) block.transpose(result.block);
+    else{
+        const T* b = block.arr;
+        T* r = result.block.arr;
+        layoutBlocks(h, w, [&](std::size_t i, std::size_t j, std::size_t){
+            r[L::offset(j, i, w, h)] = b[L::offset(i, j, h, w)];
+        });
+    }
 }
+template<typename T, typename L>
+void mcf::Mat<T, L>::transpose(Mat<T, L>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    requireLayoutShape(result, w, h, "transpose", true);
+    if(&result == this) throw std::runtime_error("transpose: the result can't be the matrix");
 
+    if constexpr(std::is_same<L, ColumnMajor>::value) block.transpose(result.block, video, sync);
+    else{
+        std::string type = block.getTypeName();
+
+        ecl::Program prog = L::getOffset("offsetA", h, w);
+        prog += L::getOffset("offsetT", w, h);
+        prog += "__kernel void layout_transpose";
+        prog += "(__global " + type + "* a, __global " + type + "* t){\n";
+        prog += "size_t i = get_global_id(0);\n";
+        prog += "size_t j = get_global_id(1);\n";
+        prog += "t[offsetT(j, i)] = a[offsetA(i, j)];\n";
+        prog += "}";
 
-template<typename T>
-mcf::Mat<T>::~Mat(){
-    clear();
-}
\ No newline at end of file
+        ecl::Kernel layout_transpose = "layout_transpose";
+
+        ecl::Frame frame = {cacheProgram(prog, video), layout_transpose, {&block.arr, &result.block.arr}};
+        launch(video, frame, {h, w}, sync);
+    }
+}
+
+template<typename T, typename L>
+void mcf::Mat<T, L>::mul(const Mat<T, L>& X, Mat<T, L>& result) const{
+    requireLayoutShape(X, w, X.w, "mul");
+    requireLayoutShape(result, h, X.w, "mul", true);
+    if(&result == this || &result == &X) throw std::runtime_error("mul: the result can't be one of the matrices");
+
+    // (this * X)^T = X^T * this^T, so the blocks multiply as they are
+    if constexpr(std::is_same<L, ColumnMajor>::value) X.block.mul(block, result.block);
+    else{
+        // a square of the result per task, the squares of both sides are unpacked to row-major and multiplied
+        constexpr std::size_t S = LAYOUT_BLOCK;
+        std::size_t m = h;
+        std::size_t k = w;
+        std::size_t n = X.w;
+        std::size_t columns = (n + S - 1) / S;
+        const T* a = block.arr;
+        const T* x = X.block.arr;
+        T* r = result.block.arr;
+
+        parallelFor(0, ((m + S - 1) / S) * columns, 1, [&](std::size_t first, std::size_t last){
+            std::vector<T> a_square(S * S);
+            std::vector<T> x_square(S * S);
+            std::vector<T> c(S * S);
+
+            for(std::size_t t = first; last > t; t++){
+                std::size_t i0 = (t / columns) * S;
+                std::size_t j0 = (t % columns) * S;
+                std::size_t mb = std::min(S, m - i0);
+                std::size_t nb = std::min(S, n - j0);
+
+                std::fill(c.begin(), c.begin() + mb * nb, T(0));
+                for(std::size_t p0 = 0; k > p0; p0 += S){
+                    std::size_t kb = std::min(S, k - p0);
+
+                    for(std::size_t i = 0; mb > i; i++){
+                        for(std::size_t p = 0; kb > p; p++) a_square[i * kb + p] = a[L::offset(i0 + i, p0 + p, m, k)];
+                    }
+                    for(std::size_t p = 0; kb > p; p++){
+                        for(std::size_t j = 0; nb > j; j++) x_square[p * nb + j] = x[L::offset(p0 + p, j0 + j, k, n)];
+                    }
+                    blockedGemm(false, false, mb, nb, kb, T(1), a_square.data(), kb, x_square.data(), nb, c.data(), nb);
+                }
+
+                for(std::size_t i = 0; mb > i; i++){
+                    for(std::size_t j = 0; nb > j; j++) r[L::offset(i0 + i, j0 + j, m, n)] = c[i * nb + j];
+                }
+            }
+        });
+    }
+}
+template<typename T, typename L>
+void mcf::Mat<T, L>::mul(const Mat<T, L>& X, Mat<T, L>& result, ecl::Computer& video, ecl::EXEC sync) const{
+    requireLayoutShape(X, w, X.w, "mul");
+    requireLayoutShape(result, h, X.w, "mul", true);
+    if(&result == this || &result == &X) throw std::runtime_error("mul: the result can't be one of the matrices");
+
+    if constexpr(std::is_same<L, ColumnMajor>::value) X.block.mul(block, result.block, video, NONE, sync);
+    else{
+        std::string type = block.getTypeName();
+
+        ecl::Program prog = L::getOffset("offsetA", h, w);
+        prog += L::getOffset("offsetX", w, X.w);
+        prog += L::getOffset("offsetC", h, X.w);
+        prog += "__kernel void layout_mul";
+        prog += "(__global " + type + "* a, __global " + type + "* x, __global " + type + "* c){\n";
+        prog += "size_t i = get_global_id(0);\n";
+        prog += "size_t j = get_global_id(1);\n";
+        prog += type + " sum = 0;\n";
+        prog += "for(size_t k = 0; k < " + std::to_string(w) + "; k++) sum += a[offsetA(i, k)] * x[offsetX(k, j)];\n";
+        prog += "c[offsetC(i, j)] = sum;\n";
+        prog += "}";
+
+        ecl::Kernel layout_mul = "layout_mul";
+
+        ecl::Frame frame = {cacheProgram(prog, video), layout_mul, {&block.arr, &X.block.arr, &result.block.arr}};
+        launch(video, frame, {h, X.w}, sync);
+    }
+}
@@ -105,4 +105,1396 @@ TEST_CASE("Constructor"){
             CHECK(B.isRef() == true);
         }
     }
+}
+
+TEST_CASE("Equals"){
+    mcf::Mat<float> A(100, 90);
+    A.gen([](size_t i, size_t j){
+        return std::sin(float(i * 90 + j));
+    });
+
+    SECTION("exact"){
+        mcf::Mat<float> B = A;
+        CHECK(A.equals(B));
+
+        B.setE(std::nextafter(B.getE(99, 89), 2.0f), 99, 89);
+        CHECK(!A.equals(B));
+
+        mcf::Mat<float> C(90, 100);
+        CHECK(!A.equals(C));
+
+        mcf::Mat<int> D(100, 90);
+        D.gen([](size_t i, size_t j){
+            return int(i * j);
+        });
+        mcf::Mat<int> E = D;
+        CHECK(D.equals(E));
+
+        E.setE(-1, 50, 3);
+        CHECK(!D.equals(E));
+        CHECK(D.equals(E, mcf::ABSOLUTE, 151));
+    }
+
+    SECTION("tolerance"){
+        mcf::Mat<float> B = A;
+        B.setE(std::nextafter(std::nextafter(B.getE(7, 3), 2.0f), 2.0f), 7, 3);
+
+        CHECK(A.equals(B, mcf::ULP, 2));
+        CHECK(!A.equals(B, mcf::ULP, 1));
+        CHECK(A.equals(B, mcf::RELATIVE, 1e-6));
+        CHECK(A.equals(B, mcf::ABSOLUTE, 1e-6));
+
+        B.setE(B.getE(0, 0) + 0.01f, 0, 0);
+        CHECK(!A.equals(B, mcf::ABSOLUTE, 1e-3));
+        CHECK(A.equals(B, mcf::ABSOLUTE, 2e-2));
+
+        // ulps across zero
+        mcf::Mat<float> Z(1, 1);
+        mcf::Mat<float> N(1, 1);
+        Z.setE(std::numeric_limits<float>::denorm_min(), 0, 0);
+        N.setE(-std::numeric_limits<float>::denorm_min(), 0, 0);
+        CHECK(Z.equals(N, mcf::ULP, 2));
+        CHECK(!Z.equals(N, mcf::ULP, 1));
+
+        N.setE(std::nanf(""), 0, 0);
+        CHECK(!N.equals(N, mcf::ULP, 1000));
+
+        // integer distances are exact, also where a double can't tell the values apart
+        mcf::Mat<long> L(1, 2);
+        mcf::Mat<long> M(1, 2);
+        L.setE(1L << 60, 0, 0);
+        M.setE((1L << 60) + 1, 0, 0);
+        L.setE(std::numeric_limits<long>::min(), 0, 1);
+        M.setE(std::numeric_limits<long>::min(), 0, 1);
+        CHECK(!L.equals(M, mcf::ABSOLUTE, 0.5));
+        CHECK(L.equals(M, mcf::ABSOLUTE, 1));
+        CHECK(L.equals(M, mcf::RELATIVE, 1e-18));
+
+        M.setE(std::numeric_limits<long>::max(), 0, 1);
+        CHECK(!L.equals(M, mcf::ABSOLUTE, 1e19));
+        CHECK(L.equals(M, mcf::ABSOLUTE, 2e19));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Equality on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    // the device gives the same answers as the cpu, for integers beyond 2^24 too
+    mcf::Mat<long> L(2, 2);
+    mcf::Mat<long> M(2, 2);
+    L.gen([](size_t i, size_t j){
+        return (1L << 60) + long(i * 2 + j);
+    });
+    M.gen([](size_t i, size_t j){
+        return (1L << 60) + long(i * 2 + j) + (i == 1 && j == 1 ? 3 : 0);
+    });
+
+    mcf::Mat<int> I(1, 2);
+    mcf::Mat<int> J(1, 2);
+    I.setE((1 << 24) + 1, 0, 0);
+    J.setE(1 << 24, 0, 0);
+    I.setE(-5, 0, 1);
+    J.setE(-5, 0, 1);
+
+    video << L << M << I << J;
+    for(double tolerance : {0.0, 0.5, 2.0, 3.0, 1e19}){
+        CHECK(L.equals(M, video, mcf::ABSOLUTE, tolerance) == L.equals(M, mcf::ABSOLUTE, tolerance));
+        CHECK(I.equals(J, video, mcf::ABSOLUTE, tolerance) == I.equals(J, mcf::ABSOLUTE, tolerance));
+    }
+    for(double tolerance : {1e-19, 3e-18, 1e-7}){
+        CHECK(L.equals(M, video, mcf::RELATIVE, tolerance) == L.equals(M, mcf::RELATIVE, tolerance));
+        CHECK(I.equals(J, video, mcf::RELATIVE, tolerance) == I.equals(J, mcf::RELATIVE, tolerance));
+    }
+
+    // a negative or NaN ulp count is exact, a huge one accepts every pair of numbers
+    mcf::Mat<float> F(1, 2);
+    mcf::Mat<float> G(1, 2);
+    F.setE(1.0f, 0, 0);
+    G.setE(std::nextafter(1.0f, 2.0f), 0, 0);
+    video << F << G;
+    for(double tolerance : {-1.0, std::nan(""), 0.0, 1.0, 1e30}){
+        CHECK(F.equals(G, video, mcf::ULP, tolerance) == F.equals(G, mcf::ULP, tolerance));
+    }
+
+    mcf::Mat<float> E(0, 3);
+    CHECK(E.equals(E, video));
+}
+
+TEST_CASE("Broadcast"){
+    mcf::Mat<int> A(4, 3);
+    A.gen([](size_t i, size_t j){
+        return int(i * 3 + j);
+    });
+
+    mcf::Mat<int> row(1, 3);
+    mcf::Mat<int> column(4, 1);
+    mcf::Mat<int> scalar(1, 1);
+    row.gen([](size_t i, size_t j){
+        return int(10 * j);
+    });
+    column.gen([](size_t i, size_t j){
+        return int(100 * i);
+    });
+    scalar.setE(7, 0, 0);
+
+    SECTION("row"){
+        mcf::Mat<int> result(4, 3);
+        A.add(row, result);
+
+        mcf::Mat<int> expected(4, 3);
+        expected.gen([](size_t i, size_t j){
+            return int(i * 3 + j + 10 * j);
+        });
+        CHECK(result.equals(expected));
+    }
+
+    SECTION("column"){
+        mcf::Mat<int> result(4, 3);
+        column.sub(A, result);
+
+        mcf::Mat<int> expected(4, 3);
+        expected.gen([](size_t i, size_t j){
+            return int(100 * i) - int(i * 3 + j);
+        });
+        CHECK(result.equals(expected));
+    }
+
+    SECTION("scalar"){
+        mcf::Mat<int> result(4, 3);
+        A.hadamard(scalar, result);
+
+        mcf::Mat<int> expected(4, 3);
+        expected.gen([](size_t i, size_t j){
+            return int(7 * (i * 3 + j));
+        });
+        CHECK(result.equals(expected));
+    }
+
+    SECTION("outer"){
+        mcf::Mat<int> result(4, 3);
+        column.add(row, result);
+
+        mcf::Mat<int> expected(4, 3);
+        expected.gen([](size_t i, size_t j){
+            return int(100 * i + 10 * j);
+        });
+        CHECK(result.equals(expected));
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<int> result(4, 3);
+        mcf::Mat<int> B(2, 3);
+        CHECK_THROWS(A.add(B, result));
+        CHECK_THROWS(A.add(row, row));
+    }
+}
+
+TEST_CASE("Storage"){
+    mcf::Mat<float> A(300, 200, mcf::PINNED);
+    A.gen([](size_t i, size_t j){
+        return float(i * 200 + j);
+    });
+
+    SECTION("pinned"){
+        CHECK(A.getStorage() == mcf::PINNED);
+        CHECK(A.isRef() == false);
+        CHECK(reinterpret_cast<std::uintptr_t>(static_cast<float*>(A)) % 4096 == 0);
+        CHECK(A.getE(299, 199) == 299 * 200 + 199);
+    }
+
+    SECTION("copy"){
+        mcf::Mat<float> B = A;
+
+        CHECK(B.getStorage() == mcf::PINNED);
+        CHECK(static_cast<float*>(B) != static_cast<float*>(A));
+        CHECK(B.equals(A));
+
+        mcf::Mat<float> C(3, 3);
+        C = A;
+        CHECK(C.getStorage() == mcf::PINNED);
+        CHECK(C.equals(A));
+    }
+
+    SECTION("move"){
+        float* data = A;
+        mcf::Mat<float> B(2, 2, mcf::PINNED);
+        B = std::move(A);
+
+        CHECK(B.getStorage() == mcf::PINNED);
+        CHECK(static_cast<float*>(B) == data);
+        CHECK(A.getStorage() == mcf::PAGEABLE);
+        CHECK(A.getTotalSize() == 0);
+    }
+}
+
+TEST_CASE("Layout"){
+    const size_t h = 70;
+    const size_t w = 45;
+
+    // small integers, so every order of the sums is exact
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return double((i * 7 + j * 3) % 11) - 5;
+    });
+    mcf::Mat<double> X(w, 33);
+    X.gen([](size_t i, size_t j){
+        return double((i * 5 + j) % 7) - 3;
+    });
+
+    mcf::Mat<double> T(w, h);
+    mcf::Mat<double> C(h, 33);
+    A.transpose(T);
+    A.mul(X, C);
+
+    SECTION("column major"){
+        mcf::Mat<double, mcf::ColumnMajor> B(h, w);
+        B.fromDense(A);
+        CHECK(B.getE(69, 44) == A.getE(69, 44));
+
+        // the block is the row-major transpose
+        CHECK(B.getConstBlock().equals(T));
+
+        B.setE(100, 3, 4);
+        CHECK(B.getConstBlock().getE(4, 3) == 100);
+        B.setE(A.getE(3, 4), 3, 4);
+
+        mcf::Mat<double> D(h, w);
+        B.toDense(D);
+        CHECK(D.equals(A));
+    }
+
+    SECTION("tiled"){
+        using L = mcf::Tiled<16>;
+        auto extent = L::getExtent(h, w);
+        CHECK(extent.first == 5 * 3);
+        CHECK(extent.second == 256);
+
+        // every element of the padded tiles has its own offset
+        std::vector<int> seen(extent.first * extent.second, 0);
+        for(size_t i = 0; 80 > i; i++){
+            for(size_t j = 0; 48 > j; j++) seen[L::offset(i, j, h, w)]++;
+        }
+        CHECK(std::count(seen.begin(), seen.end(), 1) == int(seen.size()));
+
+        // z order inside a tile, tiles row by row
+        CHECK(L::offset(0, 1, h, w) == 1);
+        CHECK(L::offset(1, 0, h, w) == 2);
+        CHECK(L::offset(1, 1, h, w) == 3);
+        CHECK(L::offset(0, 2, h, w) == 4);
+        CHECK(L::offset(0, 16, h, w) == 256);
+        CHECK(L::offset(16, 0, h, w) == 3 * 256);
+
+        mcf::Mat<double, L> B;
+        B.fromDense(A);
+        CHECK(B.getH() == h);
+        CHECK(B.getE(69, 44) == A.getE(69, 44));
+        CHECK(static_cast<double*>(B.getBlock())[L::offset(69, 45, h, w)] == 0);
+
+        mcf::Mat<double> D(h, w);
+        B.toDense(D);
+        CHECK(D.equals(A));
+    }
+
+    SECTION("ops"){
+        auto check = [&](auto B, auto BT, auto BX, auto BC){
+            B.fromDense(A);
+            BX.fromDense(X);
+
+            for(mcf::REDUCE option : {mcf::FULL, mcf::ROWS, mcf::COLUMNS}){
+                mcf::Mat<double> result(option == mcf::COLUMNS ? h : 1, option == mcf::ROWS ? w : 1);
+                mcf::Mat<double> expected(result.getH(), result.getW());
+                B.reduce(result, option);
+                A.reduce(expected, option);
+                CHECK(result.equals(expected));
+            }
+
+            mcf::Mat<double> D(w, h);
+            B.transpose(BT);
+            BT.toDense(D);
+            CHECK(D.equals(T));
+
+            mcf::Mat<double> P(h, 33);
+            B.mul(BX, BC);
+            BC.toDense(P);
+            CHECK(P.equals(C));
+
+            CHECK_THROWS(B.mul(B, BC));
+            CHECK_THROWS(B.transpose(B));
+            mcf::Mat<double> wrong(h, h);
+            CHECK_THROWS(B.reduce(wrong, mcf::ROWS));
+        };
+
+        using L = mcf::Tiled<16>;
+        check(mcf::Mat<double, mcf::ColumnMajor>(h, w), mcf::Mat<double, mcf::ColumnMajor>(w, h), mcf::Mat<double, mcf::ColumnMajor>(), mcf::Mat<double, mcf::ColumnMajor>(h, 33));
+        check(mcf::Mat<double, L>(h, w), mcf::Mat<double, L>(w, h), mcf::Mat<double, L>(), mcf::Mat<double, L>(h, 33));
+        check(mcf::Mat<double, mcf::Tiled<>>(h, w), mcf::Mat<double, mcf::Tiled<>>(w, h), mcf::Mat<double, mcf::Tiled<>>(), mcf::Mat<double, mcf::Tiled<>>(h, 33));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Layout on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    const size_t h = 37;
+    const size_t w = 29;
+
+    mcf::Mat<float> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return float((i * 7 + j * 3) % 11) - 5;
+    });
+    mcf::Mat<float> X(w, 6);
+    X.gen([](size_t i, size_t j){
+        return float((i * 5 + j) % 7) - 3;
+    });
+    video << A << X;
+
+    // the device gives the blocks of the cpu, every sum is exact
+    auto check = [&](auto B, auto BT, auto BX, auto BC){
+        video << B.getBlock() << BT.getBlock() << BX.getBlock() << BC.getBlock();
+        B.fromDense(A, video);
+        BX.fromDense(X, video);
+
+        mcf::Mat<float> rows(1, w);
+        mcf::Mat<float> columns(h, 1);
+        video << rows << columns;
+        B.reduce(rows, video, mcf::ROWS);
+        B.reduce(columns, video, mcf::COLUMNS);
+        B.transpose(BT, video);
+        B.mul(BX, BC, video);
+
+        mcf::Mat<float> D(h, w);
+        video << D;
+        B.toDense(D, video);
+
+        video >> rows >> columns >> D >> BT.getBlock() >> BC.getBlock();
+        CHECK(D.equals(A));
+
+        decltype(B) E;
+        decltype(B) ET(w, h);
+        decltype(B) EC(h, 6);
+        E.fromDense(A);
+        E.transpose(ET);
+        mcf::Mat<float> expected_rows(1, w);
+        mcf::Mat<float> expected_columns(h, 1);
+        E.reduce(expected_rows, mcf::ROWS);
+        E.reduce(expected_columns, mcf::COLUMNS);
+        CHECK(rows.equals(expected_rows));
+        CHECK(columns.equals(expected_columns));
+        CHECK(BT.getConstBlock().equals(ET.getConstBlock()));
+
+        decltype(B) EX;
+        EX.fromDense(X);
+        E.mul(EX, EC);
+        CHECK(BC.getConstBlock().equals(EC.getConstBlock()));
+
+        for(mcf::Mat<float>* M : {&B.getBlock(), &BT.getBlock(), &BX.getBlock(), &BC.getBlock(), &rows, &columns, &D}) M->release(video);
+    };
+
+    using L = mcf::Tiled<8>;
+    check(mcf::Mat<float, mcf::ColumnMajor>(h, w), mcf::Mat<float, mcf::ColumnMajor>(w, h), mcf::Mat<float, mcf::ColumnMajor>(w, 6), mcf::Mat<float, mcf::ColumnMajor>(h, 6));
+    check(mcf::Mat<float, L>(h, w), mcf::Mat<float, L>(w, h), mcf::Mat<float, L>(w, 6), mcf::Mat<float, L>(h, 6));
+
+    A.release(video);
+    X.release(video);
+}
+
+TEST_CASE("Math"){
+    mcf::Mat<float> A(64, 64);
+    mcf::Mat<double> B(64, 64);
+    A.gen([](size_t i, size_t j){
+        return 40 * std::sin(float(i * 64 + j));
+    });
+    B.gen([](size_t i, size_t j){
+        return 40 * std::sin(double(i * 64 + j));
+    });
+
+    mcf::Mat<float> A_precise(64, 64);
+    mcf::Mat<float> A_fast(64, 64);
+    mcf::Mat<double> B_precise(64, 64);
+    mcf::Mat<double> B_fast(64, 64);
+
+    SECTION("exp"){
+        A.exp(A_precise);
+        A.exp(A_fast, mcf::FAST);
+        CHECK(A_fast.equals(A_precise, mcf::ULP, 2));
+
+        B.exp(B_precise);
+        B.exp(B_fast, mcf::FAST);
+        CHECK(B_fast.equals(B_precise, mcf::ULP, 2));
+    }
+
+    SECTION("log"){
+        mcf::Mat<float> X(64, 64);
+        mcf::Mat<double> Y(64, 64);
+        A.exp(X);
+        B.exp(Y);
+
+        X.log(A_precise);
+        X.log(A_fast, mcf::FAST);
+        CHECK(A_fast.equals(A_precise, mcf::ULP, 4));
+
+        Y.log(B_precise);
+        Y.log(B_fast, mcf::FAST);
+        CHECK(B_fast.equals(B_precise, mcf::ULP, 4));
+    }
+
+    SECTION("sigmoid"){
+        A.sigmoid(A_precise);
+        A.sigmoid(A_fast, mcf::FAST);
+        CHECK(A_fast.equals(A_precise, mcf::ULP, 4));
+
+        B.sigmoid(B_precise);
+        B.sigmoid(B_fast, mcf::FAST);
+        CHECK(B_fast.equals(B_precise, mcf::ULP, 4));
+    }
+
+    SECTION("tanh"){
+        A.tanh(A_precise);
+        A.tanh(A_fast, mcf::FAST);
+        CHECK(A_fast.equals(A_precise, mcf::ULP, 4));
+
+        B.tanh(B_precise);
+        B.tanh(B_fast, mcf::FAST);
+        CHECK(B_fast.equals(B_precise, mcf::ULP, 4));
+    }
+
+    SECTION("pow"){
+        A.pow(3, A_precise);
+        A.pow(3, A_fast, mcf::FAST);
+        CHECK(A_fast.equals(A_precise, mcf::ULP, 2));
+
+        mcf::Mat<float> X(64, 64);
+        A.exp(X);
+        X.pow(0.5f, A_precise);
+        X.pow(0.5f, A_fast, mcf::FAST);
+        CHECK(A_fast.equals(A_precise, mcf::ULP, 2));
+    }
+
+    SECTION("special"){
+        float ptr[] = {0, -0.0f, -1, 1, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::nanf(""), 1e-40f};
+        mcf::Mat<float> X(ptr, 1, 8);
+        mcf::Mat<float> precise(1, 8);
+        mcf::Mat<float> fast(1, 8);
+
+        // nan never equals, the other values match the c++ library
+        X.exp(precise);
+        X.exp(fast, mcf::FAST);
+        CHECK(std::isnan(fast.getE(0, 6)));
+        fast.setE(0, 0, 6);
+        precise.setE(0, 0, 6);
+        CHECK(fast.equals(precise, mcf::ULP, 1));
+
+        X.log(precise);
+        X.log(fast, mcf::FAST);
+        CHECK(std::isnan(fast.getE(0, 2)));
+        CHECK(std::isnan(fast.getE(0, 5)));
+        CHECK(std::isnan(fast.getE(0, 6)));
+        CHECK(fast.getE(0, 0) == precise.getE(0, 0));
+        CHECK(fast.getE(0, 1) == precise.getE(0, 1));
+        CHECK(fast.getE(0, 3) == precise.getE(0, 3));
+        CHECK(fast.getE(0, 4) == precise.getE(0, 4));
+        CHECK(fast.getE(0, 7) == Approx(precise.getE(0, 7)));
+
+        X.tanh(fast, mcf::FAST);
+        CHECK(std::signbit(fast.getE(0, 1)));
+        CHECK(fast.getE(0, 5) == -1);
+
+        mcf::Mat<float> Y(1, 8);
+        Y.gen([](size_t, size_t){
+            return -2.0f;
+        });
+        Y.pow(3, fast, mcf::FAST);
+        CHECK(fast.getE(0, 0) == -8);
+        Y.pow(0.5f, fast, mcf::FAST);
+        CHECK(std::isnan(fast.getE(0, 0)));
+        Y.pow(0, fast, mcf::FAST);
+        CHECK(fast.getE(0, 0) == 1);
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<int> I(2, 2);
+        mcf::Mat<int> result(2, 2);
+        CHECK_THROWS(I.exp(result));
+
+        mcf::Mat<float> C(2, 3);
+        CHECK_THROWS(A.exp(C));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Math on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    mcf::Mat<float> A(64, 64);
+    A.gen([](size_t i, size_t j){
+        return 40 * std::sin(float(i * 64 + j));
+    });
+    mcf::Mat<float> X(64, 64);
+    A.exp(X);
+
+    mcf::Mat<float> expected(64, 64);
+    mcf::Mat<float> precise(64, 64);
+    mcf::Mat<float> fast(64, 64);
+    video << A << X << precise << fast;
+
+    // PRECISE stays within the OpenCL bounds of the c++ library, FAST uses native_ built-ins that OpenCL gives
+    // no bound, so they only get a loose check
+    auto check = [&](const std::function<void(const mcf::Mat<float>&, mcf::Mat<float>&)>& cpu,
+                     const std::function<void(const mcf::Mat<float>&, mcf::Mat<float>&, mcf::ACCURACY)>& device,
+                     const mcf::Mat<float>& in, double ulp, mcf::COMPARE option, double tolerance){
+        cpu(in, expected);
+        device(in, precise, mcf::PRECISE);
+        device(in, fast, mcf::FAST);
+        video >> precise >> fast;
+        CHECK(precise.equals(expected, mcf::ULP, ulp));
+        CHECK(fast.equals(expected, option, tolerance));
+    };
+
+    SECTION("exp"){
+        check([](const mcf::Mat<float>& in, mcf::Mat<float>& out){ in.exp(out); },
+              [&](const mcf::Mat<float>& in, mcf::Mat<float>& out, mcf::ACCURACY a){ in.exp(out, video, a); }, A, 4, mcf::RELATIVE, 1e-3);
+    }
+
+    SECTION("log"){
+        check([](const mcf::Mat<float>& in, mcf::Mat<float>& out){ in.log(out); },
+              [&](const mcf::Mat<float>& in, mcf::Mat<float>& out, mcf::ACCURACY a){ in.log(out, video, a); }, X, 4, mcf::ABSOLUTE, 1e-3);
+    }
+
+    SECTION("sigmoid"){
+        check([](const mcf::Mat<float>& in, mcf::Mat<float>& out){ in.sigmoid(out); },
+              [&](const mcf::Mat<float>& in, mcf::Mat<float>& out, mcf::ACCURACY a){ in.sigmoid(out, video, a); }, A, 8, mcf::RELATIVE, 1e-3);
+    }
+
+    SECTION("tanh"){
+        check([](const mcf::Mat<float>& in, mcf::Mat<float>& out){ in.tanh(out); },
+              [&](const mcf::Mat<float>& in, mcf::Mat<float>& out, mcf::ACCURACY a){ in.tanh(out, video, a); }, A, 6, mcf::ULP, 6);
+    }
+
+    SECTION("pow"){
+        check([](const mcf::Mat<float>& in, mcf::Mat<float>& out){ in.pow(3, out); },
+              [&](const mcf::Mat<float>& in, mcf::Mat<float>& out, mcf::ACCURACY a){ in.pow(3, out, video, a); }, A, 17, mcf::ULP, 17);
+        check([](const mcf::Mat<float>& in, mcf::Mat<float>& out){ in.pow(0.5f, out); },
+              [&](const mcf::Mat<float>& in, mcf::Mat<float>& out, mcf::ACCURACY a){ in.pow(0.5f, out, video, a); }, X, 17, mcf::RELATIVE, 1e-3);
+    }
+
+    for(auto* M : {&A, &X, &precise, &fast}) M->release(video);
+}
+
+TEST_CASE("Statistics"){
+    const size_t h = 300;
+    const size_t w = 200;
+
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return 1e4 + 10 * std::sin(double(i * 200 + j)) + double(i % 7);
+    });
+
+    // reference per group, for every option the group of (i, j) and its size
+    auto group = [&](mcf::REDUCE option, size_t i, size_t j){
+        return option == mcf::COLUMNS ? i : (option == mcf::ROWS ? j : 0);
+    };
+    auto groups = [&](mcf::REDUCE option){
+        return option == mcf::COLUMNS ? h : (option == mcf::ROWS ? w : 1);
+    };
+    auto shape = [&](mcf::REDUCE option){
+        return option == mcf::COLUMNS ? mcf::Mat<double>(h, 1) : (option == mcf::ROWS ? mcf::Mat<double>(1, w) : mcf::Mat<double>(1, 1));
+    };
+    std::vector<mcf::REDUCE> options = {mcf::COLUMNS, mcf::ROWS, mcf::FULL};
+
+    SECTION("softmax"){
+        for(auto option : options){
+            mcf::Mat<double> result(h, w);
+            A.softmax(result, option);
+
+            std::vector<double> m(groups(option), -INFINITY);
+            std::vector<double> sum(groups(option), 0);
+            for(size_t i = 0; h > i; i++){
+                for(size_t j = 0; w > j; j++) m[group(option, i, j)] = std::max(m[group(option, i, j)], A.getE(i, j));
+            }
+            for(size_t i = 0; h > i; i++){
+                for(size_t j = 0; w > j; j++) sum[group(option, i, j)] += std::exp(A.getE(i, j) - m[group(option, i, j)]);
+            }
+
+            mcf::Mat<double> expected(h, w);
+            expected.gen([&](size_t i, size_t j){
+                return std::exp(A.getE(i, j) - m[group(option, i, j)]) / sum[group(option, i, j)];
+            });
+            CHECK(result.equals(expected, mcf::RELATIVE, 1e-12));
+
+            mcf::Mat<double> fast(h, w);
+            A.softmax(fast, option, mcf::FAST);
+            CHECK(fast.equals(expected, mcf::RELATIVE, 1e-12));
+
+            mcf::Mat<double> lse = shape(option);
+            A.logsumexp(lse, option);
+
+            mcf::Mat<double> lse_expected = shape(option);
+            for(size_t g = 0; groups(option) > g; g++) lse_expected.getArray()[g] = m[g] + std::log(sum[g]);
+            CHECK(lse.equals(lse_expected, mcf::RELATIVE, 1e-14));
+        }
+
+        // -inf groups don't turn into nan
+        mcf::Mat<float> B(2, 3);
+        B.gen([](size_t i, size_t j){
+            return i == 0 ? -INFINITY : 1000.0f * j;
+        });
+        mcf::Mat<float> lse(2, 1);
+        B.logsumexp(lse);
+        CHECK(lse.getE(0, 0) == -INFINITY);
+        CHECK(lse.getE(1, 0) == Approx(2000));
+
+        mcf::Mat<float> result(2, 3);
+        B.softmax(result);
+        CHECK(result.getE(1, 2) == Approx(1));
+    }
+
+    SECTION("moments"){
+        for(auto option : options){
+            mcf::Mat<double> mean = shape(option);
+            mcf::Mat<double> variance = shape(option);
+            A.moments(mean, variance, option);
+
+            std::vector<double> n(groups(option), 0);
+            std::vector<double> m(groups(option), 0);
+            std::vector<double> v(groups(option), 0);
+            for(size_t i = 0; h > i; i++){
+                for(size_t j = 0; w > j; j++){
+                    n[group(option, i, j)]++;
+                    m[group(option, i, j)] += A.getE(i, j);
+                }
+            }
+            for(size_t g = 0; groups(option) > g; g++) m[g] /= n[g];
+            for(size_t i = 0; h > i; i++){
+                for(size_t j = 0; w > j; j++) v[group(option, i, j)] += (A.getE(i, j) - m[group(option, i, j)]) * (A.getE(i, j) - m[group(option, i, j)]);
+            }
+
+            for(size_t g = 0; groups(option) > g; g++){
+                CHECK(mean.getArray()[g] == Approx(m[g]).epsilon(1e-14));
+                CHECK(variance.getArray()[g] == Approx(v[g] / n[g]).epsilon(1e-10));
+            }
+        }
+    }
+
+    SECTION("norm"){
+        for(auto option : options){
+            for(auto kind : {mcf::L1, mcf::L2, mcf::LINF}){
+                mcf::Mat<double> result = shape(option);
+                A.norm(result, option, kind);
+
+                std::vector<double> expected(groups(option), 0);
+                for(size_t i = 0; h > i; i++){
+                    for(size_t j = 0; w > j; j++){
+                        double v = std::abs(A.getE(i, j));
+                        double& e = expected[group(option, i, j)];
+                        e = kind == mcf::L1 ? e + v : (kind == mcf::L2 ? e + v * v : std::max(e, v));
+                    }
+                }
+                for(size_t g = 0; groups(option) > g; g++){
+                    if(kind == mcf::L2) expected[g] = std::sqrt(expected[g]);
+                    CHECK(result.getArray()[g] == Approx(expected[g]).epsilon(1e-13));
+                }
+            }
+
+            mcf::Mat<double> normalized(h, w);
+            A.normalize(normalized, option);
+
+            mcf::Mat<double> result = shape(option);
+            normalized.norm(result, option);
+            for(size_t g = 0; groups(option) > g; g++) CHECK(result.getArray()[g] == Approx(1));
+        }
+
+        // zero rows stay zero
+        mcf::Mat<float> Z(2, 3);
+        Z.gen([](size_t i, size_t j){
+            return float(i * j);
+        });
+        mcf::Mat<float> result(2, 3);
+        Z.normalize(result, mcf::COLUMNS, mcf::LINF);
+        CHECK(result.getE(0, 1) == 0);
+        CHECK(result.getE(1, 2) == 1);
+        CHECK(result.getE(1, 1) == 0.5f);
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<double> result(h, 1);
+        CHECK_THROWS(A.logsumexp(result, mcf::ROWS));
+        CHECK_THROWS(A.softmax(result));
+
+        mcf::Mat<int> I(2, 2);
+        mcf::Mat<int> I_result(2, 1);
+        CHECK_THROWS(I.norm(I_result));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Statistics on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    // groups longer than a chunk are folded in parallel and merged, values far apart test the rescaled sums
+    mcf::Mat<double> A(37, 600);
+    A.gen([](size_t i, size_t j){
+        return 30 * std::sin(double(i * 600 + j)) + (j > 400 ? 200 : 0);
+    });
+
+    mcf::Mat<double> R(37, 600);
+    mcf::Mat<double> E(37, 600);
+    video << A << R;
+
+    for(mcf::REDUCE option : {mcf::COLUMNS, mcf::ROWS, mcf::FULL}){
+        size_t g_h = option == mcf::COLUMNS ? 37 : 1;
+        size_t g_w = option == mcf::ROWS ? 600 : 1;
+        mcf::Mat<double> g(g_h, g_w);
+        mcf::Mat<double> g2(g_h, g_w);
+        mcf::Mat<double> e(g_h, g_w);
+        mcf::Mat<double> e2(g_h, g_w);
+        video << g << g2;
+
+        A.softmax(E, option);
+        A.softmax(R, video, option);
+        video >> R;
+        CHECK(R.equals(E, mcf::RELATIVE, 1e-12));
+
+        A.logsumexp(e, option);
+        A.logsumexp(g, video, option);
+        video >> g;
+        CHECK(g.equals(e, mcf::RELATIVE, 1e-12));
+
+        A.moments(e, e2, option);
+        A.moments(g, g2, video, option);
+        video >> g >> g2;
+        CHECK(g.equals(e, mcf::ABSOLUTE, 1e-9));
+        CHECK(g2.equals(e2, mcf::RELATIVE, 1e-9));
+
+        for(mcf::NORM norm : {mcf::L1, mcf::L2, mcf::LINF}){
+            A.norm(e, option, norm);
+            A.norm(g, video, option, norm);
+            video >> g;
+            CHECK(g.equals(e, mcf::RELATIVE, 1e-12));
+
+            A.normalize(E, option, norm);
+            A.normalize(R, video, option, norm);
+            video >> R;
+            CHECK(R.equals(E, mcf::RELATIVE, 1e-12));
+        }
+
+        g.release(video);
+        g2.release(video);
+    }
+
+    A.release(video);
+    R.release(video);
+}
+
+TEST_CASE("Ordering"){
+    const size_t h = 300;
+    const size_t w = 200;
+
+    // few distinct values, so most groups have ties
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return double((i * 7 + j * 13) % 50) - 20;
+    });
+
+    // reference order of a group by stable sort, members are indices inside the group
+    auto reference = [&](mcf::REDUCE option, size_t g, mcf::ORDER order){
+        size_t count = option == mcf::COLUMNS ? w : (option == mcf::ROWS ? h : h * w);
+        auto at = [&, option, g](size_t m){
+            if(option == mcf::COLUMNS) return A.getE(g, m);
+            if(option == mcf::ROWS) return A.getE(m, g);
+            return A.getE(m / w, m % w);
+        };
+
+        std::vector<size_t> members(count);
+        std::iota(members.begin(), members.end(), size_t(0));
+        std::stable_sort(members.begin(), members.end(), [&](size_t x, size_t y){
+            return order == mcf::ASCENDING ? at(x) < at(y) : at(x) > at(y);
+        });
+        return members;
+    };
+    auto groups = [&](mcf::REDUCE option){
+        return option == mcf::COLUMNS ? h : (option == mcf::ROWS ? w : 1);
+    };
+    // position of the r-th member of group g in a result laid out like the matrix
+    auto position = [&](mcf::REDUCE option, size_t g, size_t r){
+        return option == mcf::COLUMNS ? g * w + r : (option == mcf::ROWS ? r * w + g : r);
+    };
+    std::vector<mcf::REDUCE> options = {mcf::COLUMNS, mcf::ROWS, mcf::FULL};
+
+    SECTION("argmax"){
+        for(auto option : options){
+            mcf::Mat<size_t> max = option == mcf::COLUMNS ? mcf::Mat<size_t>(h, 1) : mcf::Mat<size_t>(1, groups(option));
+            mcf::Mat<size_t> min = max;
+            A.argmax(max, option);
+            A.argmin(min, option);
+
+            for(size_t g = 0; groups(option) > g; g++){
+                CHECK(max.getArray()[g] == reference(option, g, mcf::DESCENDING)[0]);
+                CHECK(min.getArray()[g] == reference(option, g, mcf::ASCENDING)[0]);
+            }
+        }
+    }
+
+    SECTION("topk"){
+        const size_t k = 10;
+        for(auto option : options){
+            for(auto order : {mcf::DESCENDING, mcf::ASCENDING}){
+                mcf::Mat<size_t> result = option == mcf::ROWS ? mcf::Mat<size_t>(k, w) : mcf::Mat<size_t>(groups(option), k);
+                A.topk(k, result, option, order);
+
+                for(size_t g = 0; groups(option) > g; g++){
+                    auto expected = reference(option, g, order);
+                    for(size_t r = 0; k > r; r++){
+                        size_t p = option == mcf::ROWS ? r * w + g : g * k + r;
+                        CHECK(result.getArray()[p] == expected[r]);
+                    }
+                }
+            }
+        }
+
+        // k of the whole group sorts it
+        mcf::Mat<size_t> all(h, w);
+        A.topk(w, all, mcf::COLUMNS, mcf::ASCENDING);
+        for(size_t r = 0; w > r; r++) CHECK(all.getArray()[7 * w + r] == reference(mcf::COLUMNS, 7, mcf::ASCENDING)[r]);
+    }
+
+    SECTION("sort"){
+        for(auto option : options){
+            for(auto order : {mcf::ASCENDING, mcf::DESCENDING}){
+                mcf::Mat<size_t> indices(h, w);
+                mcf::Mat<double> values(h, w);
+                A.argsort(indices, option, order);
+                A.sort(values, option, order);
+
+                bool same = true;
+                for(size_t g = 0; groups(option) > g; g++){
+                    auto expected = reference(option, g, order);
+                    for(size_t r = 0; expected.size() > r; r++){
+                        size_t p = position(option, g, r);
+                        size_t q = position(option, g, expected[r]);
+                        same = same && indices.getArray()[p] == expected[r] && values.getArray()[p] == A.getArray()[q];
+                    }
+                }
+                CHECK(same);
+            }
+        }
+
+        // in place
+        mcf::Mat<double> B = A;
+        B.sort(B, mcf::ROWS, mcf::DESCENDING);
+        mcf::Mat<double> expected(h, w);
+        A.sort(expected, mcf::ROWS, mcf::DESCENDING);
+        CHECK(B.equals(expected));
+    }
+
+    SECTION("nan"){
+        // NaN is above every number, ties keep the lower index
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        mcf::Mat<float> N(1, 5);
+        N.gen([&](size_t, size_t j){
+            float v[] = {1.0f, nan, 3.0f, nan, 1.0f};
+            return v[j];
+        });
+
+        mcf::Mat<size_t> index(1, 1);
+        N.argmax(index);
+        CHECK(index.getArray()[0] == 1);
+        N.argmin(index);
+        CHECK(index.getArray()[0] == 0);
+
+        mcf::Mat<size_t> indices(1, 5);
+        N.argsort(indices);
+        std::vector<size_t> ascending = {0, 4, 2, 1, 3};
+        CHECK(std::equal(ascending.begin(), ascending.end(), static_cast<const size_t*>(indices.getArray())));
+
+        N.argsort(indices, mcf::COLUMNS, mcf::DESCENDING);
+        std::vector<size_t> descending = {1, 3, 2, 0, 4};
+        CHECK(std::equal(descending.begin(), descending.end(), static_cast<const size_t*>(indices.getArray())));
+    }
+
+    SECTION("long"){
+        // groups longer than a task are split into chunks and merged
+        const size_t n = 100000;
+        mcf::Mat<int> L(1, n);
+        L.gen([](size_t, size_t j){
+            return int((j * 7919) % 100003) - 50000;
+        });
+
+        std::vector<size_t> expected(n);
+        std::iota(expected.begin(), expected.end(), size_t(0));
+        std::stable_sort(expected.begin(), expected.end(), [&](size_t x, size_t y){
+            return L.getArray()[x] > L.getArray()[y];
+        });
+
+        mcf::Mat<size_t> top(1, 100);
+        L.topk(100, top, mcf::FULL);
+        const size_t* t = top.getArray();
+        CHECK(std::equal(t, t + 100, expected.begin()));
+
+        mcf::Mat<size_t> indices(1, n);
+        L.argsort(indices, mcf::FULL, mcf::DESCENDING);
+        CHECK(std::equal(expected.begin(), expected.end(), static_cast<const size_t*>(indices.getArray())));
+
+        mcf::Mat<int> values(1, n);
+        L.sort(values, mcf::FULL);
+        const int* v = values.getArray();
+        CHECK(std::is_sorted(v, v + n));
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<size_t> result(h, 1);
+        CHECK_THROWS(A.argmax(result, mcf::ROWS));
+        CHECK_THROWS(A.topk(w + 1, result));
+        CHECK_THROWS(A.topk(1, result, mcf::ROWS));
+        CHECK_THROWS(A.argsort(result));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Ordering on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    // groups longer than a chunk are searched in parallel and merged, few distinct values give ties
+    mcf::Mat<double> A(37, 600);
+    A.gen([](size_t i, size_t j){
+        return double((i * 7 + j * 13) % 50) - 20;
+    });
+    video << A;
+
+    for(mcf::REDUCE option : {mcf::COLUMNS, mcf::ROWS, mcf::FULL}){
+        size_t g_h = option == mcf::COLUMNS ? 37 : 1;
+        size_t g_w = option == mcf::ROWS ? 600 : 1;
+        mcf::Mat<size_t> arg(g_h, g_w);
+        mcf::Mat<size_t> expected_arg(g_h, g_w);
+        video << arg;
+
+        A.argmax(expected_arg, option);
+        A.argmax(arg, video, option);
+        video >> arg;
+        CHECK(arg.equals(expected_arg));
+
+        A.argmin(expected_arg, option);
+        A.argmin(arg, video, option);
+        video >> arg;
+        CHECK(arg.equals(expected_arg));
+
+        for(size_t k : {size_t(5), size_t(300)}){
+            if(option == mcf::ROWS && k > 37) continue;
+            mcf::Mat<size_t> top = option == mcf::ROWS ? mcf::Mat<size_t>(k, 600) : mcf::Mat<size_t>(g_h, k);
+            mcf::Mat<size_t> expected_top = top;
+            video << top;
+
+            for(mcf::ORDER order : {mcf::DESCENDING, mcf::ASCENDING}){
+                A.topk(k, expected_top, option, order);
+                A.topk(k, top, video, option, order);
+                video >> top;
+                CHECK(top.equals(expected_top));
+            }
+            top.release(video);
+        }
+
+        // ASYNC sorts return before the computer is done, their temporaries are kept until it is
+        mcf::Mat<size_t> indices(37, 600);
+        mcf::Mat<double> values(37, 600);
+        mcf::Mat<double> B = A;
+        video << indices << values << B;
+        A.argsort(indices, video, option, mcf::DESCENDING, mcf::ASYNC);
+        A.sort(values, video, option, mcf::DESCENDING, mcf::ASYNC);
+        B.sort(B, video, option, mcf::DESCENDING, mcf::ASYNC);
+        mcf::finish(video);
+        video >> indices >> values >> B;
+
+        mcf::Mat<size_t> expected_indices(37, 600);
+        mcf::Mat<double> expected_values(37, 600);
+        A.argsort(expected_indices, option, mcf::DESCENDING);
+        A.sort(expected_values, option, mcf::DESCENDING);
+        CHECK(indices.equals(expected_indices));
+        CHECK(values.equals(expected_values));
+        CHECK(B.equals(expected_values));
+
+        arg.release(video);
+        indices.release(video);
+        values.release(video);
+        B.release(video);
+    }
+
+    A.release(video);
+}
+
+TEST_CASE("Gather"){
+    const size_t h = 50;
+    const size_t w = 8;
+
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return double(i * 100 + j);
+    });
+
+    mcf::Mat<int> rows(3, 4);
+    rows.gen([](size_t i, size_t j){
+        return int((i * 17 + j * 5) % 7) * 7;
+    });
+
+    SECTION("gather"){
+        mcf::Mat<double> result(12, w);
+        A.gatherRows(rows, result);
+        for(size_t k = 0; 12 > k; k++){
+            for(size_t j = 0; w > j; j++) CHECK(result.getE(k, j) == A.getE(rows.getArray()[k], j));
+        }
+
+        mcf::Mat<size_t> columns(1, 5);
+        columns.gen([](size_t, size_t j){
+            return (7 - j) % 3;
+        });
+        mcf::Mat<double> picked(h, 5);
+        A.gatherColumns(columns, picked);
+        for(size_t i = 0; h > i; i++){
+            for(size_t c = 0; 5 > c; c++) CHECK(picked.getE(i, c) == A.getE(i, columns.getArray()[c]));
+        }
+    }
+
+    SECTION("scatter"){
+        // repeated indices add up in the order of X, as a serial loop would
+        const size_t n = 100000;
+        mcf::Mat<size_t> index(n, 1);
+        index.gen([](size_t i, size_t){
+            return (i * 7919) % h;
+        });
+        mcf::Mat<double> X(n, w);
+        X.gen([](size_t i, size_t j){
+            return std::sin(double(i * w + j));
+        });
+
+        mcf::Mat<double> expected = A;
+        for(size_t k = 0; n > k; k++){
+            for(size_t j = 0; w > j; j++) expected.getArray()[index.getArray()[k] * w + j] += 0.5 * X.getE(k, j);
+        }
+
+        mcf::Mat<double> result = A;
+        result.scatterAddRows(index, X, 0.5);
+        CHECK(result.equals(expected));
+
+        mcf::Mat<int> columns(1, 6);
+        columns.gen([](size_t, size_t j){
+            return int(j % 3) * 2;
+        });
+        mcf::Mat<double> Y(h, 6);
+        Y.gen([](size_t i, size_t j){
+            return double(i + 10 * j);
+        });
+
+        expected = A;
+        for(size_t i = 0; h > i; i++){
+            for(size_t c = 0; 6 > c; c++) expected.getArray()[i * w + columns.getArray()[c]] += Y.getE(i, c);
+        }
+        result = A;
+        result.scatterAddColumns(columns, Y);
+        CHECK(result.equals(expected));
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<double> result(12, w);
+        mcf::Mat<int> negative(1, 12);
+        negative.full(-1);
+        CHECK_THROWS(A.gatherRows(negative, result));
+
+        mcf::Mat<size_t> outside(1, 12);
+        outside.full(h);
+        CHECK_THROWS(A.gatherRows(outside, result));
+        CHECK_THROWS(A.scatterAddRows(outside, result));
+
+        mcf::Mat<double> small(11, w);
+        CHECK_THROWS(A.gatherRows(rows, small));
+        CHECK_THROWS(A.gatherColumns(rows, result));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Gather on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    const size_t h = 50;
+    const size_t w = 8;
+
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return double(i * 100 + j);
+    });
+
+    mcf::Mat<int> rows(3, 4);
+    rows.gen([](size_t i, size_t j){
+        return int((i * 17 + j * 5) % 7) * 7;
+    });
+    mcf::Mat<size_t> columns(1, 6);
+    columns.gen([](size_t, size_t j){
+        return (j % 3) * 2;
+    });
+    video << A << rows << columns;
+
+    SECTION("gather"){
+        mcf::Mat<double> result(12, w);
+        mcf::Mat<double> expected(12, w);
+        video << result;
+        A.gatherRows(rows, expected);
+        A.gatherRows(rows, result, video);
+        video >> result;
+        CHECK(result.equals(expected));
+
+        mcf::Mat<double> picked(h, 6);
+        mcf::Mat<double> expected_picked(h, 6);
+        video << picked;
+        A.gatherColumns(columns, expected_picked);
+        A.gatherColumns(columns, picked, video);
+        video >> picked;
+        CHECK(picked.equals(expected_picked));
+
+        result.release(video);
+        picked.release(video);
+    }
+
+    SECTION("scatter"){
+        // integers and alpha = 0.5 add up exactly, so the atomics may run in any order
+        const size_t n = 1000;
+        mcf::Mat<int> index(n, 1);
+        index.gen([](size_t i, size_t){
+            return int((i * 7919) % h);
+        });
+        mcf::Mat<double> X(n, w);
+        X.gen([](size_t i, size_t j){
+            return double((i * w + j) % 13);
+        });
+        mcf::Mat<float> Xf(n, w);
+        Xf.gen([](size_t i, size_t j){
+            return float((i * w + j) % 13);
+        });
+        mcf::Mat<double> Y(h, 6);
+        Y.gen([](size_t i, size_t j){
+            return double(i + 10 * j);
+        });
+
+        mcf::Mat<double> expected = A;
+        mcf::Mat<double> result = A;
+        video << index << X << Y << result;
+
+        expected.scatterAddRows(index, X, 0.5);
+        result.scatterAddRows(index, X, video, 0.5);
+        expected.scatterAddColumns(columns, Y, 2.0);
+        result.scatterAddColumns(columns, Y, video, 2.0);
+
+        // a new alpha is an input, not a new program
+        std::size_t programs = mcf::cache.size();
+        expected.scatterAddRows(index, X, -1.5);
+        result.scatterAddRows(index, X, video, -1.5);
+        CHECK(mcf::cache.size() == programs);
+
+        video >> result;
+        CHECK(result.equals(expected));
+
+        mcf::Mat<float> F(h, w);
+        F.full(1);
+        mcf::Mat<float> expected_f = F;
+        video << Xf << F;
+        expected_f.scatterAddRows(index, Xf, 0.5f);
+        F.scatterAddRows(index, Xf, video, 0.5f);
+        video >> F;
+        CHECK(F.equals(expected_f));
+
+        index.release(video);
+        X.release(video);
+        Xf.release(video);
+        Y.release(video);
+        result.release(video);
+        F.release(video);
+    }
+
+    SECTION("out of range"){
+        // a negative or too large index is skipped, its row is left as it was
+        mcf::Mat<int> index(1, 3);
+        index.setE(-1, 0, 0);
+        index.setE(2, 0, 1);
+        index.setE(int(h), 0, 2);
+        mcf::Mat<double> result(3, w);
+        result.full(7);
+        video << index << result;
+        A.gatherRows(index, result, video);
+        video >> result;
+
+        mcf::Mat<double> expected(3, w);
+        expected.full(7);
+        for(size_t j = 0; w > j; j++) expected.setE(A.getE(2, j), 1, j);
+        CHECK(result.equals(expected));
+
+        mcf::Mat<double> X(3, w);
+        X.full(1);
+        mcf::Mat<double> B = A;
+        video << X << B;
+        B.scatterAddRows(index, X, video);
+        video >> B;
+
+        mcf::Mat<double> expected_b = A;
+        for(size_t j = 0; w > j; j++) expected_b.setE(A.getE(2, j) + 1, 2, j);
+        CHECK(B.equals(expected_b));
+
+        index.release(video);
+        result.release(video);
+        X.release(video);
+        B.release(video);
+    }
+
+    A.release(video);
+    rows.release(video);
+    columns.release(video);
+}
+
+TEST_CASE("Random"){
+    SECTION("philox"){
+        // known answers of Random123
+        std::uint32_t a[4] = {0, 0, 0, 0};
+        mcf::philox(a, 0, 0);
+        CHECK(a[0] == 0x6627e8d5);
+        CHECK(a[3] == 0x9b00dbd8);
+
+        std::uint32_t b[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+        mcf::philox(b, 0xffffffff, 0xffffffff);
+        CHECK(b[0] == 0x408f276d);
+        CHECK(b[3] == 0x6d5451fd);
+
+        std::uint32_t c[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+        mcf::philox(c, 0xa4093822, 0x299f31d0);
+        CHECK(c[0] == 0xd16cfe09);
+        CHECK(c[1] == 0x94fdcceb);
+        CHECK(c[2] == 0x5001e420);
+        CHECK(c[3] == 0x24126ea1);
+    }
+
+    SECTION("seed"){
+        mcf::Mat<float> A(301, 203);
+        mcf::Mat<float> B(301, 203);
+        A.random(42);
+        B.random(42);
+        CHECK(A.equals(B));
+
+        B.random(43);
+        CHECK(!A.equals(B));
+
+        // element k only depends on k, so a smaller matrix is a prefix of a larger one
+        mcf::Mat<float> C(7, 3);
+        C.random(42);
+        for(size_t k = 0; 21 > k; k++) CHECK(C.getArray()[k] == A.getArray()[k]);
+    }
+
+    SECTION("uniform"){
+        mcf::Mat<double> A(500, 400);
+        A.random(1, mcf::UNIFORM, -2, 3);
+
+        mcf::Mat<double> mean(1, 1);
+        mcf::Mat<double> variance(1, 1);
+        A.moments(mean, variance, mcf::FULL);
+        CHECK(mean.getE(0, 0) == Approx(0.5).margin(0.01));
+        CHECK(variance.getE(0, 0) == Approx(25.0 / 12).epsilon(0.01));
+        const double* a = A.getArray();
+        CHECK(*std::min_element(a, a + A.getTotalSize()) >= -2);
+        CHECK(*std::max_element(a, a + A.getTotalSize()) < 3);
+
+        mcf::Mat<int> I(500, 400);
+        I.random(1, mcf::UNIFORM, -5, 5);
+        const int* i = I.getArray();
+        CHECK(*std::min_element(i, i + I.getTotalSize()) == -5);
+        CHECK(*std::max_element(i, i + I.getTotalSize()) == 4);
+
+        // a + range * u rounds up to b for u near 1 when the range is a few ulp of a
+        mcf::Mat<float> F(64, 64);
+        F.random(1, mcf::UNIFORM, 1, 1 + 0x1p-20);
+        const float* f = F.getArray();
+        CHECK(*std::min_element(f, f + F.getTotalSize()) >= 1);
+        CHECK(*std::max_element(f, f + F.getTotalSize()) < 1 + 0x1p-20f);
+    }
+
+    SECTION("normal"){
+        for(auto seed : {1, 2, 3}){
+            mcf::Mat<float> A(500, 400);
+            A.random(seed, mcf::NORMAL, 1, 2);
+
+            mcf::Mat<float> mean(1, 1);
+            mcf::Mat<float> variance(1, 1);
+            A.moments(mean, variance, mcf::FULL);
+            CHECK(mean.getE(0, 0) == Approx(1).margin(0.02));
+            CHECK(variance.getE(0, 0) == Approx(4).epsilon(0.02));
+
+            // about 4.55% is farther than two deviations
+            const float* a = A.getArray();
+            size_t far = std::count_if(a, a + A.getTotalSize(), [](float v){ return std::abs(v - 1) > 4; });
+            CHECK(double(far) / A.getTotalSize() == Approx(0.0455).margin(0.002));
+        }
+
+        // the quantile itself
+        CHECK(mcf::normalQuantile(0.975) == Approx(1.959963985).epsilon(1e-6));
+        CHECK(mcf::normalQuantile(0.5f) == 0);
+        CHECK(mcf::normalQuantile(1e-9) == Approx(-5.997807015).epsilon(1e-4));
+    }
+
+    SECTION("bernoulli"){
+        mcf::Mat<int> A(500, 400);
+        A.random(7, mcf::BERNOULLI, 0.3);
+
+        const int* a = A.getArray();
+        long ones = std::accumulate(a, a + A.getTotalSize(), 0L);
+        CHECK(double(ones) / A.getTotalSize() == Approx(0.3).margin(0.005));
+
+        A.random(7, mcf::BERNOULLI, 1);
+        CHECK(std::all_of(a, a + A.getTotalSize(), [](int v){ return v == 1; }));
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<int> A(2, 2);
+        CHECK_THROWS(A.random(1, mcf::NORMAL));
+        CHECK_THROWS(A.random(1, mcf::UNIFORM, 3, 3));
+        CHECK_THROWS(A.random(1, mcf::BERNOULLI, 1.5));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Random on a computer", "[.device]"){
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    // the device gives the same bits as the cpu, sizes aren't a multiple of the values per block
+    auto same = [&](auto& A, auto& B, mcf::DISTRIBUTION distribution, double a, double b){
+        A.random(42, distribution, a, b);
+        B.random(42, video, distribution, a, b);
+        video >> B;
+        CHECK(std::memcmp(A.getArray(), B.getArray(), A.getTotalSize() * sizeof(*A.getArray())) == 0);
+    };
+
+    mcf::Mat<float> F(37, 29);
+    mcf::Mat<float> FD(37, 29);
+    mcf::Mat<double> D(37, 29);
+    mcf::Mat<double> DD(37, 29);
+    mcf::Mat<int> I(37, 29);
+    mcf::Mat<int> ID(37, 29);
+    video << FD << DD << ID;
+
+    for(mcf::DISTRIBUTION distribution : {mcf::UNIFORM, mcf::NORMAL, mcf::BERNOULLI}){
+        double a = distribution == mcf::BERNOULLI ? 0.3 : -1;
+        same(F, FD, distribution, a, 3);
+        same(D, DD, distribution, a, 3);
+    }
+    same(F, FD, mcf::UNIFORM, 1, 1 + 0x1p-20);
+    same(I, ID, mcf::UNIFORM, -5, 100);
+    same(I, ID, mcf::BERNOULLI, 0.7, 0);
+
+    // the seed isn't in the program
+    size_t cached = mcf::cache.size();
+    FD.random(43, video);
+    CHECK(mcf::cache.size() == cached);
+
+    FD.release(video);
+    DD.release(video);
+    ID.release(video);
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <thread>
+#include <MatrixCF/MatrixCF.hpp>
+
+
+// every rank runs f in its own thread on top of a shared LocalHub
+void runRanks(std::size_t size, const std::function<void(mcf::Transport&)>& f){
+    mcf::LocalHub hub(size);
+    std::vector<std::thread> ranks;
+
+    for(std::size_t r = 0; size > r; r++){
+        ranks.emplace_back([&, r](){
+            mcf::LocalTransport transport(hub, r);
+            f(transport);
+        });
+    }
+    for(auto& t : ranks) t.join();
+}
+
+TEST_CASE("Distributed"){
+    const std::size_t h = 37;
+    const std::size_t k = 29;
+    const std::size_t w = 23;
+
+    mcf::Mat<double> A(h, k);
+    mcf::Mat<double> B(k, w);
+    A.gen([](size_t i, size_t j){
+        return double(i) - 2.0 * double(j);
+    });
+    B.gen([](size_t i, size_t j){
+        return double(i * j % 7);
+    });
+
+    SECTION("scatter-gather"){
+        mcf::Mat<double> result(h, k);
+        result.zeros();
+
+        runRanks(4, [&](mcf::Transport& transport){
+            mcf::DistMat<double> dA(transport, h, k, 8);
+            dA.scatter(A);
+            dA.gather(result);
+        });
+
+        CHECK(result.equals(A));
+    }
+
+    SECTION("mul"){
+        mcf::Mat<double> C(h, w);
+        mcf::Mat<double> result(h, w);
+        A.mul(B, C);
+
+        runRanks(6, [&](mcf::Transport& transport){
+            mcf::DistMat<double> dA(transport, h, k, 5);
+            mcf::DistMat<double> dB(transport, k, w, 5);
+            mcf::DistMat<double> dC(transport, h, w, 5);
+
+            dA.scatter(A);
+            dB.scatter(B);
+            dA.mul(dB, dC);
+            dC.gather(result);
+        });
+
+        CHECK(result.equals(C));
+    }
+
+    SECTION("transpose"){
+        mcf::Mat<double> C(k, h);
+        A.transpose(C);
+
+        // a 1 x 4 and a 2 x 2 process grid
+        for(std::size_t grid_h : {1, 2}){
+            mcf::Mat<double> result(k, h);
+            result.zeros();
+
+            runRanks(4, [&](mcf::Transport& transport){
+                mcf::DistMat<double> dA(transport, h, k, 6, grid_h);
+                mcf::DistMat<double> dC(transport, k, h, 6, grid_h);
+
+                dA.scatter(A);
+                dA.transpose(dC);
+                dC.gather(result);
+            });
+
+            CHECK(result.equals(C));
+        }
+    }
+
+    SECTION("reduce"){
+        mcf::Mat<double> rows(1, k);
+        mcf::Mat<double> columns(h, 1);
+        A.reduce(rows, mcf::REDUCE::ROWS);
+        A.reduce(columns, mcf::REDUCE::COLUMNS);
+
+        std::vector<double> full(4);
+        std::vector<char> same(4);
+
+        runRanks(4, [&](mcf::Transport& transport){
+            mcf::DistMat<double> dA(transport, h, k, 4);
+            dA.scatter(A);
+
+            mcf::Mat<double> r(1, k);
+            mcf::Mat<double> c(h, 1);
+            dA.reduce(r, mcf::REDUCE::ROWS);
+            dA.reduce(c, mcf::REDUCE::COLUMNS);
+
+            full[transport.getRank()] = dA.reduce();
+            same[transport.getRank()] = r.equals(rows) && c.equals(columns);
+        });
+
+        for(std::size_t r = 0; 4 > r; r++){
+            CHECK(full[r] == A.reduce());
+            CHECK(same[r]);
+        }
+    }
+}
+
+#if defined(MATRIXCF_USE_SOCKETS) && defined(__linux__)
+// SocketTransport::fork has to run before any OpenMP region,
+// so these ranks run in a fresh process started by the test case below
+TEST_CASE("Sockets", "[.sockets]"){
+    const std::size_t h = 37;
+    const std::size_t k = 29;
+    const std::size_t w = 23;
+
+    mcf::Mat<double> C(h, w);
+    mcf::Mat<double> T(w, h);
+    double first = 0;
+    double second = 0;
+    std::size_t rank = 0;
+    {
+        auto transport = mcf::SocketTransport::fork(4);
+        rank = transport.getRank();
+
+        // messages are matched by tag, not by arrival
+        if(rank == 1){
+            double one = 1;
+            double two = 2;
+            transport.send(0, &one, sizeof(one), 7);
+            transport.send(0, &two, sizeof(two), 3);
+        }
+        if(rank == 0){
+            transport.receive(1, &second, sizeof(second), 3);
+            transport.receive(1, &first, sizeof(first), 7);
+        }
+
+        mcf::Mat<double> A(h, k);
+        mcf::Mat<double> B(k, w);
+        A.gen([](size_t i, size_t j){
+            return double(i) - 2.0 * double(j);
+        });
+        B.gen([](size_t i, size_t j){
+            return double(i * j % 7);
+        });
+
+        // 2 x 2 process grid
+        mcf::DistMat<double> dA(transport, h, k, 5, 2);
+        mcf::DistMat<double> dB(transport, k, w, 5, 2);
+        mcf::DistMat<double> dC(transport, h, w, 5, 2);
+        mcf::DistMat<double> dT(transport, w, h, 5, 2);
+
+        dA.scatter(A);
+        dB.scatter(B);
+        dA.mul(dB, dC);
+        dC.transpose(dT);
+        dC.gather(C);
+        dT.gather(T);
+
+        if(rank == 0){
+            mcf::Mat<double> expected(h, w);
+            A.mul(B, expected);
+            CHECK(C.equals(expected));
+
+            mcf::Mat<double> transposed(w, h);
+            expected.transpose(transposed);
+            CHECK(T.equals(transposed));
+        }
+    }
+
+    // the children only take part, the root waited for them when its transport went away
+    if(rank != 0) std::_Exit(0);
+
+    CHECK(first == 1);
+    CHECK(second == 2);
+}
+
+TEST_CASE("Distributed processes"){
+    char path[4096] = {};
+    REQUIRE(readlink("/proc/self/exe", path, sizeof(path) - 1) > 0);
+
+    int status = std::system(("\"" + std::string(path) + "\" [sockets]").c_str());
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+}
+#endif
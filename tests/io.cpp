@@ -0,0 +1,346 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <cstdio>
+#include <MatrixCF/MatrixCF.hpp>
+
+
+// reference formatting through the stream, as operator<< did element by element
+template<typename T>
+std::string streamed(const mcf::Mat<T>& m, std::ios_base& (*manip)(std::ios_base&), int precision){
+    std::ostringstream s;
+    s << manip << std::setprecision(precision);
+    for(std::size_t i = 0; m.getH() > i; i++){
+        s << "(" << m.getE(i, 0);
+        for(std::size_t j = 1; m.getW() > j; j++) s << ", " << m.getE(i, j);
+        s << ")\n";
+    }
+    return s.str();
+}
+
+TEST_CASE("Text"){
+    const std::size_t h = 123;
+    const std::size_t w = 45;
+
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return std::sin(double(i * 45 + j)) * std::pow(10.0, double(int(j % 13) - 6));
+    });
+
+    mcf::Mat<int> B(h, w);
+    B.gen([](size_t i, size_t j){
+        return int(i * j) - 1000;
+    });
+
+    SECTION("operator<<"){
+        for(int precision : {0, 3, 6, 17}){
+            for(auto manip : {std::defaultfloat, std::fixed, std::scientific}){
+                std::ostringstream s;
+                s << manip << std::setprecision(precision) << A;
+                REQUIRE(s.str() == streamed(A, manip, precision));
+            }
+        }
+
+        std::ostringstream s;
+        s << B;
+        REQUIRE(s.str() == streamed(B, std::defaultfloat, 6));
+
+        std::ostringstream hex;
+        hex << std::hex << B;
+        REQUIRE(hex.str() == streamed(B, std::hex, 6));
+    }
+
+    SECTION("csv"){
+        A.saveCSV("test_io.csv");
+        auto C = mcf::Mat<double>::loadCSV("test_io.csv");
+        std::remove("test_io.csv");
+
+        REQUIRE(C.getH() == h);
+        REQUIRE(C.getW() == w);
+        REQUIRE(std::equal(static_cast<const double*>(A), static_cast<const double*>(A) + h * w, static_cast<const double*>(C)));
+
+        B.saveCSV("test_io.tsv", '\t');
+        auto D = mcf::Mat<int>::loadCSV("test_io.tsv", '\t');
+        std::remove("test_io.tsv");
+
+        REQUIRE(D.equals(B));
+    }
+
+    SECTION("parse"){
+        std::ofstream("test_io.csv") << " 1.5, -2 ,+3e2\r\n4,5,6\n\n";
+        auto C = mcf::Mat<float>::loadCSV("test_io.csv");
+
+        REQUIRE(C.getH() == 2);
+        REQUIRE(C.getW() == 3);
+        REQUIRE(C.getE(0, 0) == 1.5f);
+        REQUIRE(C.getE(0, 1) == -2.0f);
+        REQUIRE(C.getE(0, 2) == 300.0f);
+        REQUIRE(C.getE(1, 2) == 6.0f);
+
+        std::ofstream("test_io.csv") << "1,2,3\n4,x,6\n";
+        REQUIRE_THROWS(mcf::Mat<float>::loadCSV("test_io.csv"));
+
+        std::ofstream("test_io.csv") << "1,2,3\n4,5\n";
+        REQUIRE_THROWS(mcf::Mat<float>::loadCSV("test_io.csv"));
+        std::remove("test_io.csv");
+    }
+}
+
+TEST_CASE("Binary"){
+    const std::size_t h = 600;
+    const std::size_t w = 701;
+
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return std::sin(double(i * 701 + j));
+    });
+
+    SECTION("hash"){
+        std::string bytes;
+        for(std::size_t i = 0; 111 > i; i++) bytes += char((i * 7 + 3) % 256);
+
+        CHECK(mcf::xxHash64("", 0) == 0xEF46DB3751D8E999ULL);
+        CHECK(mcf::xxHash64("abc", 3) == 0x44BC2CF5AD770999ULL);
+        CHECK(mcf::xxHash64(bytes.data(), 101, 7) == 0x45224C3DC7F26AE5ULL);
+        CHECK(mcf::xxHash64(bytes.data(), 111, 7) == 0x28BA85C73CCC9AFFULL);
+
+        mcf::Mat<double> B = A;
+        CHECK(B.hash() == A.hash());
+        CHECK(A.hash(1) != A.hash());
+
+        B.setE(h - 1, w - 1, 0);
+        CHECK(B.hash() != A.hash());
+
+        // same bytes in another shape or as another type
+        B = A;
+        B.reshape(w, h);
+        CHECK(B.hash() != A.hash());
+
+        mcf::Mat<float> F(h, 2 * w);
+        std::memcpy(static_cast<float*>(F), static_cast<const double*>(A), h * w * sizeof(double));
+        CHECK(F.hash() != A.hash());
+    }
+
+    SECTION("appended rows"){
+        mcf::Mat<double> grown(0, w);
+        mcf::HashState state(3);
+        grown.hashRows(state);
+
+        // blocks that end inside and across chunks
+        for(std::size_t first = 0, rows = 1; h > first; first += rows, rows = rows * 3 + 1){
+            rows = std::min(rows, h - first);
+            mcf::Mat<double> block(rows, w);
+            block.gen([&](size_t i, size_t j){
+                return A.getE(first + i, j);
+            });
+
+            grown.appendRows(block);
+            block.hashRows(state);
+            CHECK(mcf::hashDigest(state) == grown.hash(3));
+        }
+        CHECK(mcf::hashDigest(state) == A.hash(3));
+
+        mcf::Mat<double> narrow(2, w - 1);
+        CHECK_THROWS(narrow.hashRows(state));
+    }
+
+    SECTION("binary"){
+        A.saveBinary("test_io.bin");
+        auto B = mcf::Mat<double>::loadBinary("test_io.bin");
+
+        CHECK(B.equals(A));
+        CHECK(mcf::Mat<double>::loadHash("test_io.bin") == A.hash());
+        CHECK_THROWS(mcf::Mat<float>::loadBinary("test_io.bin"));
+        CHECK_THROWS(mcf::Mat<long>::loadBinary("test_io.bin"));
+
+        // a flipped bit in the elements and a cut file
+        std::fstream f("test_io.bin", std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(sizeof(mcf::BinaryHeader) + 12345);
+        f.put(0x55);
+        f.close();
+        CHECK_THROWS(mcf::Mat<double>::loadBinary("test_io.bin"));
+
+        A.saveBinary("test_io.bin");
+        std::string text;
+        {
+            std::ifstream in("test_io.bin", std::ios::binary);
+            text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        std::ofstream("test_io.bin", std::ios::binary).write(text.data(), text.size() - 8);
+        CHECK_THROWS(mcf::Mat<double>::loadBinary("test_io.bin"));
+        std::remove("test_io.bin");
+
+        mcf::Mat<int> C(0, 5);
+        C.saveBinary("test_io.bin");
+        auto D = mcf::Mat<int>::loadBinary("test_io.bin");
+        std::remove("test_io.bin");
+
+        CHECK(D.getH() == 0);
+        CHECK(D.getW() == 5);
+
+        // a header whose shape the file can't hold, or whose size overflows, throws before allocating
+        mcf::BinaryHeader header;
+        header.element = sizeof(double);
+        header.kind = 'f';
+        header.h = std::uint64_t(1) << 50;
+        header.w = std::uint64_t(1) << 20;
+        std::ofstream("test_io.bin", std::ios::binary).write(reinterpret_cast<const char*>(&header), sizeof(header));
+        CHECK_THROWS_WITH(mcf::Mat<double>::loadBinary("test_io.bin"), Catch::Contains("too large"));
+
+        header.h = 1000000;
+        header.w = 1000000;
+        std::ofstream("test_io.bin", std::ios::binary).write(reinterpret_cast<const char*>(&header), sizeof(header));
+        CHECK_THROWS_WITH(mcf::Mat<double>::loadBinary("test_io.bin"), Catch::Contains("shorter"));
+        CHECK_THROWS(mcf::Mat<double>::loadRows("test_io.bin", 0, 1));
+
+        header.codec = mcf::SHUFFLE_LZ;
+        header.block_rows = 1;
+        std::ofstream("test_io.bin", std::ios::binary).write(reinterpret_cast<const char*>(&header), sizeof(header));
+        CHECK_THROWS_WITH(mcf::Mat<double>::loadBinary("test_io.bin"), Catch::Contains("shorter"));
+        std::remove("test_io.bin");
+    }
+
+    SECTION("codec"){
+        std::vector<std::string> inputs = {"", "a", "abcd", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", std::string(100000, 'x')};
+
+        std::string text;
+        for(std::size_t i = 0; 20000 > i; i++) text += "row " + std::to_string(i % 97) + (i % 3 ? ", " : "\n");
+        inputs.push_back(text);
+
+        std::string noise;
+        std::uint32_t x = 12345;
+        for(std::size_t i = 0; 70000 > i; i++){
+            x = x * 1664525 + 1013904223;
+            noise += char(x >> 24);
+        }
+        inputs.push_back(noise);
+
+        // short periods give matches overlapping their own output
+        for(std::size_t period = 1; 10 > period; period++){
+            std::string repeated;
+            for(std::size_t i = 0; 1000 > i; i++) repeated += char('a' + i % period);
+            inputs.push_back(noise.substr(0, 17) + repeated);
+        }
+
+        for(const auto& input : inputs){
+            const unsigned char* src = reinterpret_cast<const unsigned char*>(input.data());
+            std::vector<unsigned char> packed(mcf::lzBound(input.size()));
+            std::size_t bytes = mcf::lzCompress(src, input.size(), packed.data());
+            CHECK(packed.size() >= bytes);
+
+            std::vector<unsigned char> plain(input.size());
+            CHECK(mcf::lzDecompress(packed.data(), bytes, plain.data(), plain.size()));
+            CHECK(std::equal(plain.begin(), plain.end(), src));
+
+            // cut or with a wrong size
+            if(bytes > 1) CHECK_FALSE(mcf::lzDecompress(packed.data(), bytes - 1, plain.data(), plain.size()));
+            if(!input.empty()) CHECK_FALSE(mcf::lzDecompress(packed.data(), bytes, plain.data(), plain.size() - 1));
+        }
+
+        std::vector<unsigned char> repeats(100000, 'x');
+        std::vector<unsigned char> packed(mcf::lzBound(repeats.size()));
+        CHECK(1000 > mcf::lzCompress(repeats.data(), repeats.size(), packed.data()));
+
+        std::vector<unsigned char> shuffled(7 * 3), unshuffled(7 * 3);
+        for(std::size_t i = 0; shuffled.size() > i; i++) unshuffled[i] = static_cast<unsigned char>(i);
+        mcf::shuffleBytes<3>(unshuffled.data(), shuffled.data(), 7);
+        CHECK(shuffled[1] == 3);
+        CHECK(shuffled[7] == 1);
+
+        std::vector<unsigned char> back(7 * 3);
+        mcf::unshuffleBytes<3>(shuffled.data(), back.data(), 7);
+        CHECK(back == unshuffled);
+    }
+
+    SECTION("compressed"){
+        // a smooth field
+        mcf::Mat<float> S(h, w);
+        S.gen([](size_t i, size_t j){
+            return float(std::sin(0.01 * double(i)) * std::cos(0.003 * double(j)));
+        });
+
+        S.saveBinary("test_io.bin");
+        std::ifstream raw("test_io.bin", std::ios::binary | std::ios::ate);
+        std::size_t raw_bytes = raw.tellg();
+        raw.close();
+
+        std::size_t sizes[2];
+        for(auto codec : {mcf::SHUFFLE_LZ, mcf::DELTA_SHUFFLE_LZ}){
+            S.saveBinary("test_io.mcfz", codec);
+            std::ifstream packed("test_io.mcfz", std::ios::binary | std::ios::ate);
+            sizes[codec - 1] = packed.tellg();
+            packed.close();
+
+            CHECK(mcf::Mat<float>::loadBinary("test_io.mcfz").equals(S));
+            CHECK(mcf::Mat<float>::loadHash("test_io.mcfz") == S.hash());
+
+            // rows across block boundaries, also from the raw file
+            S.saveBinary("test_io.mcfz", codec, 7);
+            for(std::size_t first : {0, 5, 6, 7, 300, 599}){
+                for(std::size_t count : {0, 1, 2, 8, 15}){
+                    if(first + count > h) continue;
+
+                    mcf::Mat<float> rows(count, w);
+                    rows.gen([&](size_t i, size_t j){
+                        return S.getE(first + i, j);
+                    });
+
+                    CHECK(mcf::Mat<float>::loadRows("test_io.mcfz", first, count).equals(rows));
+                    CHECK(mcf::Mat<float>::loadRows("test_io.bin", first, count).equals(rows));
+                }
+            }
+        }
+        CHECK(raw_bytes > sizes[0]);
+        CHECK(sizes[0] > sizes[1]);
+        CHECK_THROWS(mcf::Mat<float>::loadRows("test_io.mcfz", 595, 6));
+        CHECK_THROWS(mcf::Mat<float>::loadRows("test_io.bin", 601, 0));
+
+        // incompressible blocks are kept plain
+        A.saveBinary("test_io.mcfz", mcf::SHUFFLE_LZ);
+        CHECK(mcf::Mat<double>::loadBinary("test_io.mcfz").equals(A));
+
+        // a wrong block hash, a smooth block may still decode the same after a flipped bit
+        S.saveBinary("test_io.mcfz", mcf::SHUFFLE_LZ);
+        std::fstream f("test_io.mcfz", std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(sizeof(mcf::BinaryHeader) + offsetof(mcf::BinaryBlock, hash));
+        f.put(0x55);
+        f.close();
+        CHECK_THROWS(mcf::Mat<float>::loadBinary("test_io.mcfz"));
+        CHECK_NOTHROW(mcf::Mat<float>::loadRows("test_io.mcfz", h - 1, 1));
+        CHECK_THROWS(mcf::Mat<float>::loadRows("test_io.mcfz", 0, 1));
+
+        mcf::Mat<int> I(h, w);
+        I.gen([](size_t i, size_t j){
+            return int(i * 3 + j) - 100;
+        });
+        I.saveBinary("test_io.mcfz", mcf::DELTA_SHUFFLE_LZ, 10);
+        CHECK(mcf::Mat<int>::loadBinary("test_io.mcfz").equals(I));
+
+        mcf::Mat<int> E(0, 5);
+        E.saveBinary("test_io.mcfz", mcf::SHUFFLE_LZ);
+        CHECK(mcf::Mat<int>::loadBinary("test_io.mcfz").getW() == 5);
+
+        // version 1 files are RAW, a codec in a version 1 file or a later version isn't read
+        S.saveBinary("test_io.bin");
+        std::fstream v("test_io.bin", std::ios::binary | std::ios::in | std::ios::out);
+        mcf::BinaryHeader header;
+        v.read(reinterpret_cast<char*>(&header), sizeof(header));
+        CHECK(header.version == 2);
+        header.version = 1;
+        v.seekp(0);
+        v.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        v.close();
+        CHECK(mcf::Mat<float>::loadBinary("test_io.bin").equals(S));
+
+        S.saveBinary("test_io.mcfz", mcf::SHUFFLE_LZ);
+        for(std::uint32_t version : {1, 3}){
+            v.open("test_io.mcfz", std::ios::binary | std::ios::in | std::ios::out);
+            v.seekp(offsetof(mcf::BinaryHeader, version));
+            v.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            v.close();
+            CHECK_THROWS(mcf::Mat<float>::loadBinary("test_io.mcfz"));
+        }
+
+        std::remove("test_io.bin");
+        std::remove("test_io.mcfz");
+    }
+}
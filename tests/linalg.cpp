@@ -0,0 +1,944 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <MatrixCF/MatrixCF.hpp>
+
+
+TEST_CASE("Linear algebra"){
+    const std::size_t n = 150;
+
+    mcf::Mat<double> A(n, n);
+    A.gen([&](size_t i, size_t j){
+        return std::sin(double(i * n + j)) + (i == j ? double(n) : 0.0);
+    });
+
+    SECTION("lu"){
+        mcf::Mat<double> LU(n, n);
+        mcf::Mat<std::size_t> pivots(1, n);
+        A.lu(LU, pivots);
+
+        // P * A == L * U
+        mcf::Mat<double> PA = A;
+        for(std::size_t k = 0; n > k; k++){
+            std::size_t p = pivots[0][k];
+            if(p != k) std::swap_ranges(PA[k], PA[k] + n, PA[p]);
+        }
+
+        mcf::Mat<double> L(n, n);
+        mcf::Mat<double> U(n, n);
+        L.gen([&](size_t i, size_t j){
+            return i == j ? 1.0 : (i > j ? LU.getE(i, j) : 0.0);
+        });
+        U.gen([&](size_t i, size_t j){
+            return i <= j ? LU.getE(i, j) : 0.0;
+        });
+
+        mcf::Mat<double> C(n, n);
+        L.mul(U, C);
+
+        for(std::size_t i = 0; n * n > i; i++) CHECK(C[0][i] == Approx(PA[0][i]).margin(1e-9));
+    }
+
+    SECTION("pivoting"){
+        // the large entries sit one column right of the diagonal, so nearly every step exchanges rows
+        mcf::Mat<double> B(n, n);
+        B.gen([&](size_t i, size_t j){
+            return std::sin(double(i * n + j)) + (j == (i + 1) % n ? double(n) : 0.0);
+        });
+
+        mcf::Mat<double> LU(n, n);
+        mcf::Mat<std::size_t> pivots(1, n);
+        B.lu(LU, pivots);
+
+        mcf::Mat<double> PB = B;
+        std::size_t exchanges = 0;
+        for(std::size_t k = 0; n > k; k++){
+            std::size_t p = pivots[0][k];
+            if(p != k){
+                std::swap_ranges(PB[k], PB[k] + n, PB[p]);
+                exchanges++;
+            }
+        }
+        CHECK(exchanges > n / 2);
+
+        mcf::Mat<double> L(n, n);
+        mcf::Mat<double> U(n, n);
+        L.gen([&](size_t i, size_t j){
+            return i == j ? 1.0 : (i > j ? LU.getE(i, j) : 0.0);
+        });
+        U.gen([&](size_t i, size_t j){
+            return i <= j ? LU.getE(i, j) : 0.0;
+        });
+
+        mcf::Mat<double> C(n, n);
+        L.mul(U, C);
+        CHECK(C.equals(PB, mcf::ABSOLUTE, 1e-9));
+
+        mcf::Mat<double> X(n, 2);
+        X.gen([](size_t i, size_t j){
+            return double(i % 7) - double(j);
+        });
+        mcf::Mat<double> R(n, 2);
+        B.mul(X, R);
+
+        mcf::Mat<double> result(n, 2);
+        B.solve(R, result);
+        CHECK(result.equals(X, mcf::ABSOLUTE, 1e-9));
+    }
+
+    SECTION("cholesky"){
+        mcf::Mat<double> S(n, n);
+        A.mul(A, S, mcf::TRANSPOSE::FIRST);
+
+        mcf::Mat<double> L(n, n);
+        S.cholesky(L);
+
+        mcf::Mat<double> C(n, n);
+        L.mul(L, C, mcf::TRANSPOSE::SECOND);
+
+        CHECK(L.getE(0, 1) == 0.0);
+        for(std::size_t i = 0; n * n > i; i++) CHECK(C[0][i] == Approx(S[0][i]).epsilon(1e-9));
+    }
+
+    SECTION("qr"){
+        mcf::Mat<double> B(n, n / 2);
+        B.gen([&](size_t i, size_t j){
+            return A.getE(i, j);
+        });
+
+        mcf::Mat<double> Q(n, n / 2);
+        mcf::Mat<double> R(n / 2, n / 2);
+        B.qr(Q, R);
+
+        mcf::Mat<double> C(n, n / 2);
+        Q.mul(R, C);
+
+        mcf::Mat<double> I(n / 2, n / 2);
+        Q.mul(Q, I, mcf::TRANSPOSE::FIRST);
+
+        for(std::size_t i = 0; C.getTotalSize() > i; i++) CHECK(C[0][i] == Approx(B[0][i]).margin(1e-9));
+        for(std::size_t i = 0; n / 2 > i; i++){
+            for(std::size_t j = 0; n / 2 > j; j++) CHECK(I.getE(i, j) == Approx(i == j ? 1.0 : 0.0).margin(1e-12));
+        }
+    }
+
+    SECTION("solve"){
+        mcf::Mat<double> X(n, 3);
+        X.gen([](size_t i, size_t j){
+            return double(i) - double(j);
+        });
+
+        mcf::Mat<double> B(n, 3);
+        A.mul(X, B);
+
+        mcf::Mat<double> result(n, 3);
+        A.solve(B, result);
+
+        for(std::size_t i = 0; X.getTotalSize() > i; i++) CHECK(result[0][i] == Approx(X[0][i]).margin(1e-9));
+    }
+
+    SECTION("singular"){
+        mcf::Mat<double> Z(3, 3);
+        mcf::Mat<double> LU(3, 3);
+        mcf::Mat<std::size_t> pivots(1, 3);
+        Z.zeros();
+
+        mcf::Mat<int> Zi(3, 3);
+        mcf::Mat<int> LUi(3, 3);
+        Zi.eye();
+
+        CHECK_THROWS(Z.lu(LU, pivots));
+        CHECK_THROWS(Zi.lu(LUi, pivots));
+    }
+}
+
+TEST_CASE("Strassen"){
+    // Winograd's variant is only norm-wise stable: every recursion level can grow the
+    // error by up to 12x, so results are compared with the blocked kernel using
+    // |C - C_ref| <= 4 * 12^levels * k * eps * max|A| * max|B|
+    auto check = [](std::size_t m, std::size_t k, std::size_t n, std::size_t crossover){
+        mcf::Mat<float> A(m, k);
+        mcf::Mat<float> B(k, n);
+        A.gen([](size_t i, size_t j){
+            return std::sin(float(i * 7 + j * 3));
+        });
+        B.gen([](size_t i, size_t j){
+            return std::cos(float(i * 5 + j));
+        });
+
+        mcf::Mat<float> C(m, n);
+        mcf::Mat<float> C_ref(m, n);
+        A.strassen(B, C, crossover);
+        A.mul(B, C_ref);
+
+        std::size_t levels = 0;
+        for(std::size_t s = std::min({m, k, n}); s > crossover; s /= 2) levels++;
+
+        float tol = 4 * std::pow(12.0f, float(levels)) * k * std::numeric_limits<float>::epsilon();
+
+        float err = 0;
+        for(std::size_t i = 0; C.getTotalSize() > i; i++) err = std::max(err, std::abs(C[0][i] - C_ref[0][i]));
+        CHECK(err <= tol);
+    };
+
+    SECTION("square"){
+        check(256, 256, 256, 32);
+    }
+    SECTION("odd"){
+        check(203, 177, 191, 24);
+    }
+    SECTION("crossover"){
+        check(40, 40, 40, 64);
+    }
+}
+
+TEST_CASE("Gemm"){
+    const std::size_t m = 130;
+    const std::size_t k = 70;
+    const std::size_t n = 600;
+
+    mcf::Mat<double> A(m, k);
+    mcf::Mat<double> B(k, n);
+    mcf::Mat<double> C(m, n);
+    A.gen([](size_t i, size_t j){
+        return std::sin(double(i + 3 * j));
+    });
+    B.gen([](size_t i, size_t j){
+        return std::cos(double(2 * i + j));
+    });
+    C.gen([](size_t i, size_t j){
+        return double(i) - double(j) / 10;
+    });
+
+    mcf::Mat<double> bias(1, n);
+    bias.gen([](size_t i, size_t j){
+        return double(j % 5) - 2;
+    });
+
+    // naive alpha * A * B + beta * C + bias with f applied
+    auto expected = [&](double alpha, double beta, bool with_bias, const std::function<double(double)>& f){
+        mcf::Mat<double> E(m, n);
+        E.gen([&](size_t i, size_t j){
+            double sum = 0;
+            for(std::size_t p = 0; k > p; p++) sum += A.getE(i, p) * B.getE(p, j);
+            return f(alpha * sum + beta * C.getE(i, j) + (with_bias ? bias.getE(0, j) : 0.0));
+        });
+        return E;
+    };
+    auto identity = [](double v){
+        return v;
+    };
+
+    SECTION("scale"){
+        mcf::Mat<double> result = C;
+        A.gemm(B, result, 0.5, -2.0);
+        CHECK(result.equals(expected(0.5, -2.0, false, identity), mcf::ABSOLUTE, 1e-12));
+
+        // beta = 0 ignores nan in result
+        result.gen([](size_t i, size_t j){
+            return std::nan("");
+        });
+        A.gemm(B, result);
+        CHECK(result.equals(expected(1.0, 0.0, false, identity), mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("epilogue"){
+        mcf::Mat<double> result = C;
+        A.gemm(B, result, bias, mcf::RELU, 2.0, 1.0);
+        CHECK(result.equals(expected(2.0, 1.0, true, [](double v){ return v > 0 ? v : 0; }), mcf::ABSOLUTE, 1e-12));
+
+        A.gemm(B, result, bias, mcf::TANH);
+        CHECK(result.equals(expected(1.0, 0.0, true, [](double v){ return std::tanh(v); }), mcf::ABSOLUTE, 1e-12));
+
+        mcf::Mat<double> column(m, 1);
+        column.gen([](size_t i, size_t j){
+            return double(i);
+        });
+        A.gemm(B, result, column, [](const double& v){
+            return v * v;
+        });
+
+        mcf::Mat<double> E = expected(1.0, 0.0, false, identity);
+        E.gen([&](size_t i, size_t j){
+            return (E.getE(i, j) + double(i)) * (E.getE(i, j) + double(i));
+        });
+        CHECK(result.equals(E, mcf::RELATIVE, 1e-12));
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<double> result(m, n);
+        mcf::Mat<double> wrong(1, n - 1);
+        CHECK_THROWS(A.gemm(B, result, wrong));
+        CHECK_THROWS(A.gemm(B, result, mcf::Mat<double>(m, 2)));
+        CHECK_THROWS(A.gemm(B, result, mcf::Mat<double>(m + 1, 1)));
+        CHECK_NOTHROW(A.gemm(B, result, mcf::Mat<double>(1, 1)));
+        CHECK_NOTHROW(A.gemm(B, result, mcf::Mat<double>(m, n)));
+    }
+}
+
+
+TEST_CASE("Convolution"){
+    // channels, image, kernel, stride, padding, dilation
+    std::vector<std::pair<std::size_t, mcf::Conv2D>> shapes = {
+        {3, {17, 23, 3, 3}},
+        {2, {16, 16, 3, 5, 2, 1}},
+        {4, {9, 12, 3, 3, 1, 2, 2}},
+        {1, {5, 6, 5, 6}},
+        {5, {40, 30, 1, 1, 3}},
+        // k = 288 spans two KC panels and the 750 pixels two NB tiles, the second starting inside a row
+        {32, {30, 25, 3, 3, 1, 1}}
+    };
+
+    for(auto& [channels, g] : shapes){
+        std::size_t out_h = g.getOutputH();
+        std::size_t out_w = g.getOutputW();
+        std::size_t k = channels * g.kernel_h * g.kernel_w;
+
+        mcf::Mat<double> image(channels, g.height * g.width);
+        image.gen([](size_t i, size_t j){
+            return std::sin(double(i * 31 + j));
+        });
+        mcf::Mat<double> filters(7, k);
+        filters.gen([](size_t i, size_t j){
+            return std::cos(double(i * 7 + j * 3));
+        });
+
+        // image value read by tap kk of output pixel q, 0 in the padding
+        auto tap = [&](const mcf::Mat<double>& X, size_t kk, size_t q){
+            size_t ch = kk / (g.kernel_h * g.kernel_w);
+            long iy = long(q / out_w * g.stride + kk / g.kernel_w % g.kernel_h * g.dilation) - long(g.padding);
+            long ix = long(q % out_w * g.stride + kk % g.kernel_w * g.dilation) - long(g.padding);
+            if(iy < 0 || ix < 0 || iy >= long(g.height) || ix >= long(g.width)) return 0.0;
+            return X.getE(ch, size_t(iy) * g.width + size_t(ix));
+        };
+
+        SECTION("im2col " + std::to_string(channels)){
+            mcf::Mat<double> col(k, out_h * out_w);
+            image.im2col(g, col);
+
+            mcf::Mat<double> expected(k, out_h * out_w);
+            expected.gen([&](size_t kk, size_t q){
+                return tap(image, kk, q);
+            });
+            CHECK(col.equals(expected));
+        }
+
+        SECTION("col2im " + std::to_string(channels)){
+            // adjoint: <im2col(x), y> = <x, col2im(y)>
+            mcf::Mat<double> y(k, out_h * out_w);
+            y.gen([](size_t i, size_t j){
+                return std::cos(double(i + 5 * j));
+            });
+            mcf::Mat<double> back(channels, g.height * g.width);
+            y.col2im(g, back);
+
+            mcf::Mat<double> col(k, out_h * out_w);
+            image.im2col(g, col);
+
+            double left = 0;
+            double right = 0;
+            for(size_t i = 0; col.getTotalSize() > i; i++) left += col.getArray()[i] * y.getArray()[i];
+            for(size_t i = 0; image.getTotalSize() > i; i++) right += image.getArray()[i] * back.getArray()[i];
+            CHECK(left == Approx(right).epsilon(1e-12));
+        }
+
+        SECTION("conv2d " + std::to_string(channels)){
+            mcf::Mat<double> result(7, out_h * out_w);
+            image.conv2d(filters, result, g);
+
+            mcf::Mat<double> expected(7, out_h * out_w);
+            expected.gen([&](size_t o, size_t q){
+                double sum = 0;
+                for(size_t kk = 0; k > kk; kk++) sum += filters.getE(o, kk) * tap(image, kk, q);
+                return sum;
+            });
+            CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+        }
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<float> image(3, 100);
+        mcf::Mat<float> result(3 * 9, 64);
+        CHECK_THROWS(image.im2col({10, 11, 3, 3}, result));
+        CHECK_THROWS(image.im2col({10, 10, 11, 3}, result));
+        CHECK_THROWS(image.im2col({10, 10, 3, 3, 0}, result));
+
+        mcf::Mat<float> filters(4, 3 * 9 + 1);
+        mcf::Mat<float> output(4, 64);
+        CHECK_THROWS(image.conv2d(filters, output, {10, 10, 3, 3}));
+    }
+}
+
+
+TEST_CASE("Updates"){
+    const std::size_t h = 150;
+    const std::size_t w = 90;
+    const std::size_t k = 7;
+
+    mcf::Mat<double> A(h, w);
+    A.gen([](size_t i, size_t j){
+        return std::sin(double(i * w + j));
+    });
+    mcf::Mat<double> U(h, k);
+    U.gen([](size_t i, size_t j){
+        return std::cos(double(3 * i + j));
+    });
+    mcf::Mat<double> V(w, k);
+    V.gen([](size_t i, size_t j){
+        return double(i % 5) - double(j);
+    });
+
+    SECTION("ger"){
+        mcf::Mat<double> u(h, 1);
+        mcf::Mat<double> v(1, w);
+        u.gen([](size_t i, size_t j){
+            return double(i) / 10;
+        });
+        v.gen([](size_t i, size_t j){
+            return double(j % 3) - 1;
+        });
+
+        mcf::Mat<double> result = A;
+        result.ger(u, v, 2.0);
+
+        mcf::Mat<double> expected(h, w);
+        expected.gen([&](size_t i, size_t j){
+            return A.getE(i, j) + 2.0 * u.getE(i, 0) * v.getE(0, j);
+        });
+        CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("rank"){
+        mcf::Mat<double> result = A;
+        result.rankUpdate(U, V, -0.5);
+
+        mcf::Mat<double> expected = A;
+        U.gemm(V, expected, -0.5, 1.0, mcf::SECOND);
+        CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("syrk"){
+        // larger than one tile, so off-diagonal and diagonal tiles both run
+        const std::size_t n = 300;
+        mcf::Mat<double> S(n, n);
+        S.gen([](size_t i, size_t j){
+            return double(i) - double(j);
+        });
+        mcf::Mat<double> W(n, k);
+        W.gen([](size_t i, size_t j){
+            return std::sin(double(i + 7 * j));
+        });
+
+        for(auto option : {mcf::LOWER, mcf::UPPER}){
+            mcf::Mat<double> result = S;
+            result.syrk(W, 3.0, option);
+
+            mcf::Mat<double> expected(n, n);
+            expected.gen([&](size_t i, size_t j){
+                if(option == mcf::LOWER ? j > i : j < i) return S.getE(i, j);
+
+                double sum = 0;
+                for(size_t p = 0; k > p; p++) sum += W.getE(i, p) * W.getE(j, p);
+                return S.getE(i, j) + 3.0 * sum;
+            });
+            CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+        }
+    }
+
+    SECTION("append"){
+        mcf::Mat<double> result;
+        result.appendRows(A);
+        CHECK(result.equals(A));
+
+        mcf::Mat<double> row(1, w);
+        row.full(7);
+        result.appendRows(row);
+        result.appendRows(result);
+        CHECK(result.getH() == 2 * (h + 1));
+        CHECK(result.getE(h, 3) == 7);
+        CHECK(result.getE(h + 1, 3) == A.getE(0, 3));
+        CHECK(result.getE(2 * h + 1, w - 1) == 7);
+
+        mcf::Mat<double> columns = A;
+        columns.appendColumns(U);
+        CHECK(columns.getW() == w + k);
+        CHECK(columns.getE(5, w - 1) == A.getE(5, w - 1));
+        CHECK(columns.getE(5, w + 2) == U.getE(5, 2));
+
+        // pinned storage stays pinned
+        mcf::Mat<double> pinned(2, w, mcf::PINNED);
+        pinned.full(1);
+        pinned.appendRows(row);
+        CHECK(pinned.getStorage() == mcf::PINNED);
+        CHECK(pinned.getE(2, 0) == 7);
+    }
+
+    SECTION("capacity"){
+        mcf::Mat<double> result;
+        result.reserve(4 * w);
+        CHECK(result.getCapacity() == 4 * w);
+        CHECK(result.getTotalSize() == 0);
+
+        // appends within the capacity keep the buffer
+        mcf::Mat<double> row(1, w);
+        row.gen([](size_t, size_t j){ return double(j); });
+        const double* data = result.getArray();
+        for(size_t i = 0; 4 > i; i++) result.appendRows(row);
+        CHECK(static_cast<const double*>(result.getArray()) == data);
+        CHECK(result.getH() == 4);
+
+        // growth doubles, so n appends reallocate O(log n) times
+        size_t reallocations = 0;
+        for(size_t i = 0; 1000 > i; i++){
+            size_t capacity = result.getCapacity();
+            result.appendRows(row);
+            if(result.getCapacity() != capacity) reallocations++;
+        }
+        CHECK(reallocations <= 9);
+        CHECK(result.getH() == 1004);
+        CHECK(result.getCapacity() >= result.getTotalSize());
+        CHECK(result.totalMemoryUsed() == result.getCapacity() * sizeof(double));
+        CHECK(result.getE(1003, w - 1) == w - 1);
+
+        result.shrinkToFit();
+        CHECK(result.getCapacity() == result.getTotalSize());
+        CHECK(result.getE(517, 3) == 3);
+
+        // resize keeps the top-left block and zeroes the rest
+        mcf::Mat<double> resized = A;
+        resized.resize(h + 3, w + 2);
+        CHECK(resized.getH() == h + 3);
+        CHECK(resized.getW() == w + 2);
+        for(size_t i = 0; h + 3 > i; i++){
+            for(size_t j = 0; w + 2 > j; j++) CHECK(resized.getE(i, j) == (h > i && w > j ? A.getE(i, j) : 0));
+        }
+
+        data = resized.getArray();
+        resized.resize(h - 2, w - 3);
+        CHECK(static_cast<const double*>(resized.getArray()) == data);
+        for(size_t i = 0; h - 2 > i; i++){
+            for(size_t j = 0; w - 3 > j; j++) CHECK(resized.getE(i, j) == A.getE(i, j));
+        }
+        resized.resize(h - 2, w);
+        CHECK(resized.getE(1, w - 1) == 0);
+        CHECK(resized.getE(1, 2) == A.getE(1, 2));
+
+        // copies of a view or pinned matrix don't write into the original block
+        mcf::Mat<double> pinned(2, w, mcf::PINNED);
+        pinned.full(1);
+        pinned.reserve(100 * w);
+        CHECK(pinned.getStorage() == mcf::PINNED);
+        CHECK(pinned.getE(1, w - 1) == 1);
+
+        mcf::Mat<double> view(h, w);
+        view.view(A);
+        view.appendRows(row);
+        CHECK(view.getH() == h + 1);
+        CHECK(A.getH() == h);
+        CHECK(view.getE(h - 1, 2) == A.getE(h - 1, 2));
+
+        // resizing a view, even within its block, leaves the block alone
+        mcf::Mat<double> B = A;
+        mcf::Mat<double> small(h, w);
+        small.view(B);
+        small.resize(h - 1, w - 1);
+        CHECK(B.equals(A));
+        CHECK(small.getE(1, 0) == A.getE(1, 0));
+        small.resize(h, w + 1);
+        CHECK(B.equals(A));
+        CHECK(small.getE(h - 1, w) == 0);
+    }
+
+    SECTION("wrong"){
+        mcf::Mat<double> u(h + 1, 1);
+        mcf::Mat<double> v(w, 1);
+        CHECK_THROWS(A.ger(u, v));
+        CHECK_THROWS(A.rankUpdate(V, U));
+        CHECK_THROWS(A.syrk(U));
+        CHECK_THROWS(A.appendRows(U));
+        CHECK_THROWS(A.appendColumns(V));
+    }
+}
+
+TEST_CASE("Packed"){
+    // more than one syrk tile and one row block of the symmetric mul
+    const std::size_t n = 200;
+    const std::size_t k = 9;
+    const std::size_t m = 5;
+
+    mcf::Mat<double> A(k, n);
+    A.gen([](size_t i, size_t j){
+        return std::sin(double(i * n + j));
+    });
+    mcf::Mat<double> B(n, m);
+    B.gen([](size_t i, size_t j){
+        return std::cos(double(i + 3 * j));
+    });
+
+    SECTION("layout"){
+        mcf::Mat<double> D(n, n);
+        D.gen([](size_t i, size_t j){
+            return double(i * n + j);
+        });
+
+        mcf::SymMat<double> S;
+        S.fromDense(D);
+        CHECK(S.getConstPacked().getTotalSize() == n * (n + 1) / 2);
+        CHECK(S.getE(3, 7) == D.getE(7, 3));
+
+        mcf::Mat<double> dense(n, n);
+        S.toDense(dense);
+        for(std::size_t i = 0; n > i; i++){
+            for(std::size_t j = 0; n > j; j++) CHECK(dense.getE(i, j) == D.getE(std::max(i, j), std::min(i, j)));
+        }
+
+        for(auto option : {mcf::LOWER, mcf::UPPER}){
+            mcf::TriMat<double> T(n, option);
+            T.fromDense(D);
+            T.toDense(dense);
+
+            mcf::Mat<double> expected(n, n);
+            expected.gen([&](size_t i, size_t j){
+                return (option == mcf::LOWER ? j <= i : j >= i) ? D.getE(i, j) : 0.0;
+            });
+            CHECK(dense.equals(expected));
+            CHECK(T.getE(n - 1, n - 1) == D.getE(n - 1, n - 1));
+        }
+    }
+
+    SECTION("syrk"){
+        mcf::Mat<double> dense(n, n);
+        mcf::Mat<double> expected(n, n);
+
+        mcf::SymMat<double> S(n);
+        S.syrk(A, mcf::FIRST, 2.0);
+        S.toDense(dense);
+        A.mul(A, expected, mcf::FIRST);
+        expected.mul(2.0, expected);
+        CHECK(dense.equals(expected, mcf::ABSOLUTE, 1e-12));
+
+        mcf::Mat<double> At(n, k);
+        At.gen([&](size_t i, size_t j){
+            return A.getE(j, i);
+        });
+        S.syrk(At, mcf::NONE, 1.0, 2.0);
+        S.toDense(dense);
+        expected.mul(2.5, expected);
+        CHECK(dense.equals(expected, mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("mul"){
+        mcf::SymMat<double> S(n);
+        S.syrk(A);
+
+        mcf::Mat<double> dense(n, n);
+        S.toDense(dense);
+
+        mcf::Mat<double> result(n, m);
+        mcf::Mat<double> expected(n, m);
+        S.mul(B, result);
+        dense.mul(B, expected);
+        CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("solve"){
+        mcf::Mat<double> D(n, n);
+        D.gen([](size_t i, size_t j){
+            return std::sin(double(i + 2 * j)) / 4 + (i == j ? 2.0 : 0.0);
+        });
+
+        for(auto option : {mcf::LOWER, mcf::UPPER}){
+            for(bool unit_diagonal : {false, true}){
+                mcf::TriMat<double> T(n, option);
+                T.fromDense(D);
+
+                mcf::Mat<double> result(n, m);
+                mcf::Mat<double> expected(n, m);
+                T.solve(B, result, unit_diagonal);
+                D.solveTriangular(B, expected, option, unit_diagonal);
+                CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+
+                // in place
+                result.cpy(B);
+                T.solve(result, result, unit_diagonal);
+                CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+            }
+        }
+    }
+
+    SECTION("wrong"){
+        mcf::SymMat<double> S(n);
+        mcf::TriMat<double> T(n, mcf::UPPER);
+        mcf::Mat<double> result(n, m);
+        mcf::Mat<double> C(n + 1, m);
+
+        CHECK_THROWS(S.syrk(B, mcf::FIRST));
+        CHECK_THROWS(S.syrk(A, mcf::SECOND));
+        CHECK_THROWS(S.mul(C, result));
+        CHECK_THROWS(S.mul(B, B));
+        CHECK_THROWS(T.solve(C, result));
+        CHECK_THROWS(T.setE(1.0, 3, 2));
+        CHECK(T.getE(3, 2) == 0.0);
+
+        mcf::TriMat<int> Ti(3);
+        mcf::Mat<int> Bi(3, 1);
+        mcf::Mat<int> Ri(3, 1);
+        CHECK_THROWS(Ti.solve(Bi, Ri));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Packed on a computer", "[.device]"){
+    const std::size_t n = 200;
+    const std::size_t k = 9;
+    const std::size_t m = 5;
+
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    mcf::Mat<double> A(k, n);
+    A.gen([](size_t i, size_t j){
+        return std::sin(double(i * n + j));
+    });
+    mcf::Mat<double> B(n, m);
+    B.gen([](size_t i, size_t j){
+        return std::cos(double(i + 3 * j));
+    });
+    video << A << B;
+
+    SECTION("syrk"){
+        mcf::SymMat<double> S(n);
+        mcf::SymMat<double> expected(n);
+        video << S.getPacked();
+
+        expected.syrk(A, mcf::FIRST, 2.0);
+        S.syrk(A, video, mcf::FIRST, 2.0);
+
+        // alpha and beta are inputs, not new programs
+        std::size_t programs = mcf::cache.size();
+        expected.syrk(A, mcf::FIRST, -1.0, 0.5);
+        S.syrk(A, video, mcf::FIRST, -1.0, 0.5);
+        CHECK(mcf::cache.size() == programs);
+
+        mcf::Mat<double> dense(n, n);
+        mcf::Mat<double> expected_dense(n, n);
+        video << dense;
+        S.toDense(dense, video);
+        expected.toDense(expected_dense);
+        video >> dense;
+        CHECK(dense.equals(expected_dense, mcf::ABSOLUTE, 1e-12));
+
+        mcf::Mat<double> result(n, m);
+        mcf::Mat<double> expected_result(n, m);
+        video << result;
+        S.mul(B, result, video);
+        expected.mul(B, expected_result);
+        video >> result;
+        CHECK(result.equals(expected_result, mcf::ABSOLUTE, 1e-12));
+
+        S.getPacked().release(video);
+        dense.release(video);
+        result.release(video);
+    }
+
+    SECTION("solve"){
+        mcf::Mat<double> D(n, n);
+        D.gen([](size_t i, size_t j){
+            return std::sin(double(i + 2 * j)) / 4 + (i == j ? 2.0 : 0.0);
+        });
+
+        // a single right-hand side is solved in parallel over the rows too
+        mcf::Mat<double> b(n, 1);
+        b.gen([](size_t i, size_t){
+            return std::cos(double(i));
+        });
+        video << b;
+
+        for(auto option : {mcf::LOWER, mcf::UPPER}){
+            for(bool unit_diagonal : {false, true}){
+                mcf::TriMat<double> T(n, option);
+                T.fromDense(D);
+                video << T.getPacked();
+
+                for(const mcf::Mat<double>* rhs : {&B, &b}){
+                    mcf::Mat<double> result(n, rhs->getW());
+                    mcf::Mat<double> expected(n, rhs->getW());
+                    video << result;
+                    T.solve(*rhs, expected, unit_diagonal);
+                    T.solve(*rhs, result, video, unit_diagonal);
+                    video >> result;
+                    CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+
+                    // in place
+                    mcf::Mat<double> X = *rhs;
+                    video << X;
+                    T.solve(X, X, video, unit_diagonal);
+                    video >> X;
+                    CHECK(X.equals(expected, mcf::ABSOLUTE, 1e-12));
+
+                    result.release(video);
+                    X.release(video);
+                }
+
+                T.getPacked().release(video);
+            }
+        }
+
+        b.release(video);
+    }
+
+    A.release(video);
+    B.release(video);
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Linear algebra on a computer", "[.device]"){
+    const std::size_t n = 40;
+
+    auto p = ecl::System::getPlatform(0);
+    ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+    mcf::Mat<double> A(n, n);
+    A.gen([&](size_t i, size_t j){
+        return std::sin(double(i * n + j)) + (j == (i + 1) % n ? double(n) : 0.0);
+    });
+
+    SECTION("lu"){
+        mcf::Mat<double> expected(n, n);
+        mcf::Mat<std::size_t> expected_pivots(1, n);
+        A.lu(expected, expected_pivots);
+
+        mcf::Mat<double> LU(n, n);
+        mcf::Mat<std::size_t> pivots(1, n);
+        video << A << LU << pivots;
+        A.lu(LU, pivots, video);
+        video >> LU >> pivots;
+
+        CHECK(pivots.equals(expected_pivots));
+        CHECK(LU.equals(expected, mcf::ABSOLUTE, 1e-9));
+
+        // a zero column throws as on the cpu
+        mcf::Mat<double> Z = A;
+        for(std::size_t i = 0; n > i; i++) Z.setE(0, i, 3);
+        video << Z;
+        CHECK_THROWS(Z.lu(LU, pivots, video));
+    }
+
+    SECTION("gemm"){
+        mcf::Mat<double> B(n, 7);
+        mcf::Mat<double> bias(1, 7);
+        B.gen([](size_t i, size_t j){
+            return std::cos(double(2 * i + j));
+        });
+        bias.gen([](size_t i, size_t j){
+            return double(j) - 3;
+        });
+
+        mcf::Mat<double> C(n, 7);
+        mcf::Mat<double> expected(n, 7);
+        C.gen([](size_t i, size_t j){
+            return double(i) - double(j);
+        });
+        expected = C;
+        A.gemm(B, expected, bias, mcf::RELU, 0.5, -2.0);
+
+        video << A << B << bias << C;
+        A.gemm(B, C, bias, video, mcf::RELU, 0.5, -2.0);
+        video >> C;
+        CHECK(C.equals(expected, mcf::ABSOLUTE, 1e-12));
+
+        // alpha and beta are inputs, a new pair reuses the program
+        std::size_t programs = mcf::cache.size();
+        A.gemm(B, C, bias, video, mcf::RELU, 3.0, 0.0);
+        CHECK(mcf::cache.size() == programs);
+
+        A.gemm(B, expected, bias, mcf::RELU, 3.0, 0.0);
+        video >> C;
+        CHECK(C.equals(expected, mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("cholesky"){
+        mcf::Mat<double> S(n, n);
+        A.mul(A, S, mcf::TRANSPOSE::FIRST);
+
+        mcf::Mat<double> expected(n, n);
+        S.cholesky(expected);
+
+        mcf::Mat<double> L(n, n);
+        video << S << L;
+        S.cholesky(L, video);
+        video >> L;
+        CHECK(L.equals(expected, mcf::ABSOLUTE, 1e-9));
+
+        mcf::Mat<double> I(n, n);
+        I.eye();
+        I.setE(-1, n - 1, n - 1);
+        video << I;
+        CHECK_THROWS(I.cholesky(L, video));
+    }
+
+    SECTION("updates"){
+        mcf::Mat<double> u(n, 1);
+        mcf::Mat<double> v(1, n);
+        mcf::Mat<double> U(n, 5);
+        u.gen([](size_t i, size_t j){
+            return double(i) / 10;
+        });
+        v.gen([](size_t i, size_t j){
+            return double(j % 3) - 1;
+        });
+        U.gen([](size_t i, size_t j){
+            return std::sin(double(i + 7 * j));
+        });
+
+        mcf::Mat<double> expected = A;
+        mcf::Mat<double> result = A;
+        video << u << v << U << result;
+
+        // alpha is an input, a new one reuses the program
+        expected.ger(u, v, 2.0);
+        result.ger(u, v, video, 2.0);
+        std::size_t programs = mcf::cache.size();
+        expected.ger(u, v, -0.5);
+        result.ger(u, v, video, -0.5);
+        CHECK(mcf::cache.size() == programs);
+
+        expected.syrk(U, 3.0, mcf::LOWER);
+        result.syrk(U, video, 3.0, mcf::LOWER);
+        programs = mcf::cache.size();
+        expected.syrk(U, 0.25, mcf::LOWER);
+        result.syrk(U, video, 0.25, mcf::LOWER);
+        CHECK(mcf::cache.size() == programs);
+
+        video >> result;
+        CHECK(result.equals(expected, mcf::ABSOLUTE, 1e-12));
+    }
+
+    SECTION("append"){
+        mcf::Mat<double> row(1, n);
+        row.gen([](size_t, size_t j){
+            return double(j);
+        });
+
+        // appends within the capacity copy into the tail, the offset is an input
+        mcf::Mat<double> result(2, n);
+        result.full(1);
+        result.reserve(8 * n);
+        video << result << row << A;
+
+        result.appendRows(row, video);
+        std::size_t programs = mcf::cache.size();
+        for(size_t i = 0; 5 > i; i++) result.appendRows(row, video);
+        CHECK(mcf::cache.size() == programs);
+
+        // growing past the capacity moves the data through the host
+        result.appendRows(row, video);
+        result.appendRows(A, video);
+        CHECK(result.getCapacity() >= (n + 9) * n);
+
+        video >> result;
+        CHECK(result.getH() == n + 9);
+        CHECK(result.getE(1, 5) == 1);
+        for(size_t i = 2; 9 > i; i++) CHECK(result.getE(i, 5) == 5);
+        CHECK(result.getE(9 + 3, 7) == A.getE(3, 7));
+    }
+}
@@ -0,0 +1,263 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <thread>
+#include <MatrixCF/MatrixCF.hpp>
+
+
+TEST_CASE("Threads"){
+    const std::size_t threads = 8;
+
+    SECTION("tasks"){
+        // every index is visited exactly once
+        std::vector<std::atomic<int>> visits(100000);
+        mcf::parallelFor(0, visits.size(), 1000, [&](std::size_t first, std::size_t last){
+            for(std::size_t i = first; last > i; i++) visits[i]++;
+        });
+        CHECK(std::all_of(visits.begin(), visits.end(), [](const std::atomic<int>& v){ return v.load() == 1; }));
+
+        mcf::Mat<double> A(300, 300);
+        mcf::Mat<double> B(300, 300);
+        A.gen([](size_t i, size_t j){
+            return std::sin(double(i + j));
+        });
+        B.gen([](size_t i, size_t j){
+            return std::cos(double(i * j));
+        });
+
+        mcf::Mat<double> C(300, 300);
+        mcf::Mat<double> D(300, 300);
+        A.mul(B, C);
+        B.mul(A, D);
+
+        // independent ops nest into one team, and so do concurrent callers
+        mcf::Mat<double> E(300, 300);
+        mcf::Mat<double> F(300, 300);
+        mcf::parallelInvoke([&](){
+            A.mul(B, E);
+        }, [&](){
+            B.mul(A, F);
+        });
+        CHECK(E.equals(C));
+        CHECK(F.equals(D));
+
+        std::vector<mcf::Mat<double>> results(threads, mcf::Mat<double>(300, 300));
+        std::vector<std::thread> workers;
+        for(std::size_t t = 0; threads > t; t++){
+            workers.emplace_back([&, t](){
+                A.mul(B, results[t]);
+            });
+        }
+        for(auto& w : workers) w.join();
+
+        for(auto& R : results) CHECK(R.equals(C));
+        CHECK(mcf::idleWorkers().load() == omp_get_max_threads());
+    }
+
+    SECTION("numa"){
+        CHECK(mcf::parseCpuList("0-3,8,10-11\n") == std::vector<std::size_t>{0, 1, 2, 3, 8, 10, 11});
+        CHECK(mcf::parseCpuList("5") == std::vector<std::size_t>{5});
+        CHECK(mcf::parseCpuList("").empty());
+        CHECK(mcf::numaNodes() >= 1);
+
+        // placement moves pages, never the values on them
+        mcf::Mat<double> A(1001, 513);
+        A.gen([](size_t i, size_t j){
+            return double(i * 513 + j);
+        });
+        mcf::Mat<double> B = A;
+
+        A.place(mcf::PARTITION);
+        CHECK(A.equals(B));
+        A.place(mcf::INTERLEAVE);
+        CHECK(A.equals(B));
+    }
+
+    SECTION("random"){
+        // the stream doesn't depend on how the blocks are split
+        mcf::Mat<double> A(1001, 513);
+        A.random(5, mcf::NORMAL);
+
+        int previous = omp_get_max_threads();
+        omp_set_num_threads(1);
+        mcf::Mat<double> B(1001, 513);
+        B.random(5, mcf::NORMAL);
+        omp_set_num_threads(previous);
+
+        CHECK(A.equals(B));
+    }
+}
+
+// needs an OpenCL device, run with the [device] tag
+TEST_CASE("Computer threads", "[.device]"){
+    const std::size_t threads = 8;
+
+    SECTION("cache"){
+        auto p = ecl::System::getPlatform(0);
+        ecl::Computer first(0, p, ecl::DEVICE::GPU);
+        ecl::Computer second(0, p, ecl::DEVICE::GPU);
+
+        // every thread caches the same sources on two computers
+        std::vector<std::vector<ecl::Program*>> found(threads);
+        std::vector<std::thread> workers;
+        for(std::size_t t = 0; threads > t; t++){
+            workers.emplace_back([&, t](){
+                for(std::size_t i = 0; 200 > i; i++){
+                    ecl::Program prog = "__kernel void k" + std::to_string(i % 50) + "(){}";
+                    found[t].push_back(&mcf::cacheProgram(prog, (i / 50) % 2 ? first : second));
+                }
+            });
+        }
+        for(auto& w : workers) w.join();
+
+        for(std::size_t t = 1; threads > t; t++) CHECK(found[t] == found[0]);
+        CHECK(found[0][0] == found[0][100]);
+        CHECK(found[0][0] != found[0][50]);
+        CHECK(found[0][0]->getSource() == found[0][50]->getSource());
+
+        // released computers free and rebuild their programs
+        std::size_t cached = mcf::cache.size();
+        mcf::releaseCache(first);
+        CHECK(mcf::cache.size() == cached - 50);
+        ecl::Program prog = "__kernel void k1(){}";
+        CHECK(&mcf::cacheProgram(prog, first) != found[0][51]);
+    }
+
+    SECTION("pool"){
+        mcf::ComputerPool pool(2, ecl::System::getPlatform(0));
+        REQUIRE(pool.getSize() == 2);
+
+        std::atomic<std::size_t> leased(0);
+        std::atomic<std::size_t> peak(0);
+        std::vector<std::thread> workers;
+
+        for(std::size_t t = 0; threads > t; t++){
+            workers.emplace_back([&](){
+                for(std::size_t i = 0; 50 > i; i++){
+                    auto lease = pool.lease();
+
+                    std::size_t now = ++leased;
+                    std::size_t old = peak.load();
+                    while(now > old && !peak.compare_exchange_weak(old, now));
+
+                    mcf::Mat<int> A(8, 8);
+                    ecl::Computer& video = lease;
+                    A.send(video);
+                    A.zeros(video);
+                    A.receive(video);
+                    A.release(video);
+
+                    leased--;
+                }
+            });
+        }
+        for(auto& w : workers) w.join();
+
+        CHECK(peak.load() <= 2);
+        CHECK(leased.load() == 0);
+    }
+
+    SECTION("commands"){
+        auto p = ecl::System::getPlatform(0);
+        ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+        mcf::Mat<float> A(64, 32);
+        mcf::Mat<float> B(32, 16);
+        mcf::Mat<float> C(64, 16);
+        mcf::Mat<float> D(64, 16);
+
+        // the kernels of the ops go into the list, cpu ops and other computers run as usual
+        mcf::CommandList list(video);
+        list.record();
+        CHECK(list.isRecording());
+        CHECK(mcf::CommandList::getRecording(video) == &list);
+
+        A.mul(B, C, video);
+        C.map("ret = v > 0 ? v : 0;", D, video);
+        D.softmax(C, video);
+        A.mul(B, D);
+
+        // shapes are checked while recording, and ops reading back refuse to be recorded
+        CHECK_THROWS(A.mul(A, C, video));
+        CHECK_THROWS(C.equals(D, video));
+
+        mcf::Mat<size_t> order(64, 16);
+        CHECK_THROWS(C.argsort(order, video));
+
+        // a second list can't record on the same thread, another thread isn't recorded
+        mcf::CommandList other(video);
+        CHECK_THROWS(other.record());
+
+        std::thread worker([&](){
+            CHECK(mcf::CommandList::getRecording(video) == nullptr);
+            A.mul(B, C, video);
+        });
+        worker.join();
+
+        CHECK_THROWS(list.run());
+        list.stop();
+        CHECK(!list.isRecording());
+        // mul and map launch one kernel each, softmax folds, merges and scales
+        CHECK(list.getSize() == 5);
+
+        // replays don't add commands or record new ones
+        list.run();
+        list.run(ecl::ASYNC);
+        video.await();
+        CHECK(list.getSize() == 5);
+
+        list.clear();
+        CHECK(list.getSize() == 0);
+        CHECK_THROWS(list.stop());
+
+        // a list going away stops recording
+        {
+            mcf::CommandList temporary(video);
+            temporary.record();
+        }
+        CHECK(mcf::CommandList::getRecording(video) == nullptr);
+    }
+
+    SECTION("warmup"){
+        auto p = ecl::System::getPlatform(0);
+        ecl::Computer video(0, p, ecl::DEVICE::GPU);
+
+        // warmup caches the programs of its ops, calls with the same shapes reuse them
+        std::size_t cached = mcf::cache.size();
+        mcf::Mat<float>::warmup(video, 64, 32);
+        CHECK(mcf::cache.size() > cached);
+        cached = mcf::cache.size();
+
+        mcf::Mat<float> A(64, 32);
+        mcf::Mat<float> At(32, 64);
+        mcf::Mat<float> S(64, 64);
+        A.gen([](size_t i, size_t j){ return float(i + j); });
+
+        A.send(video);
+        At.send(video);
+        S.send(video);
+        A.transpose(At, video);
+        A.mul(At, S, video);
+        S.receive(video);
+        CHECK(mcf::cache.size() == cached);
+
+        mcf::Mat<float> T(32, 64);
+        mcf::Mat<float> expected(64, 64);
+        A.transpose(T);
+        A.mul(T, expected);
+        CHECK(S.equals(expected));
+
+        // a list recorded after warmup reuses the programs
+        mcf::CommandList list(video);
+        list.record();
+        A.mul(At, S, video);
+        list.stop();
+        CHECK(list.getSize() == 1);
+        CHECK(mcf::cache.size() == cached);
+
+        list.run();
+        S.receive(video);
+        CHECK(S.equals(expected));
+
+        for(auto* M : {&A, &At, &S}) M->release(video);
+    }
+}